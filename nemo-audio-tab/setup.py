@@ -28,7 +28,7 @@ setup( packages=[],
     # ]
 
     data_files   = [
-        ('/usr/share/nemo-python/extensions', ['nemo-extension/nemo-audio-tab.py']),
+        ('/usr/share/nemo-python/extensions', ['nemo-extension/nemo-audio-tab.py', 'nemo-extension/nemo-audio-tab.nemo-python']),
         ('/usr/share/nemo-audio-tab',         ['nemo-extension/nemo-audio-tab.glade'])
     ]
 )
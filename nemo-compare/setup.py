@@ -23,7 +23,7 @@ setup( packages=[],
     #                     'python-nemo >=3.8',
     #                     'meld'],
     data_files   = [
-        ('/usr/share/nemo-python/extensions', ['src/nemo-compare.py']),
+        ('/usr/share/nemo-python/extensions', ['src/nemo-compare.py', 'src/nemo-compare.nemo-python']),
         ('/usr/share/nemo-compare', ['src/nemo-compare-preferences.py', 'src/utils.py']),
         ('/usr/bin', ['src/nemo-compare-preferences'])
     ]
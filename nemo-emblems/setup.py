@@ -38,6 +38,6 @@ setup( packages=[],
     # install_requires = ['gir1.2-nemo-3.0>=3.9',
     #                     'python-nemo >=3.9'],
     data_files   = [
-        ('/usr/share/nemo-python/extensions', ['nemo-extension/nemo-emblems.py'])
+        ('/usr/share/nemo-python/extensions', ['nemo-extension/nemo-emblems.py', 'nemo-extension/nemo-emblems.nemo-python'])
     ]
 )
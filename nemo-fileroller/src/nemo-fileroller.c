@@ -30,11 +30,58 @@
 #include <libnemo-extension/nemo-menu-provider.h>
 #include <libnemo-extension/nemo-name-and-desc-provider.h>
 #include "nemo-fileroller.h"
+#include "nemo-fr-browser.h"
+#include "nemo-fr-extract.h"
 
 
 static GObjectClass *parent_class;
 static gboolean always_show_extract_to = FALSE;
 
+/* The archives as GFiles, or NULL if some aren't local and have to be
+ * left to file-roller */
+static GList *
+get_local_archives (GList *files)
+{
+	GList *archives = NULL;
+	GList *scan;
+
+	for (scan = files; scan; scan = scan->next) {
+		GFile *location = nemo_file_info_get_location (scan->data);
+
+		if (! g_file_is_native (location)) {
+			g_object_unref (location);
+			g_list_free_full (archives, g_object_unref);
+			return NULL;
+		}
+
+		archives = g_list_prepend (archives, location);
+	}
+
+	return g_list_reverse (archives);
+}
+
+
+static void
+extract_to_response_cb (GtkDialog *dialog,
+			int        response_id,
+			gpointer   user_data)
+{
+	GList *archives = user_data;
+
+	if (response_id == GTK_RESPONSE_ACCEPT) {
+		GFile *destination = gtk_file_chooser_get_file (GTK_FILE_CHOOSER (dialog));
+
+		if (destination != NULL) {
+			nemo_fr_extract (archives, destination);
+			g_object_unref (destination);
+		}
+	}
+
+	g_list_free_full (archives, g_object_unref);
+	gtk_widget_destroy (GTK_WIDGET (dialog));
+}
+
+
 static void
 extract_to_callback (NemoMenuItem *item,
 		     gpointer          user_data)
@@ -44,10 +91,35 @@ extract_to_callback (NemoMenuItem *item,
 	char             *uri, *default_dir;
 	char             *quoted_uri, *quoted_default_dir;
 	GString          *cmd;
+	GList            *archives;
 
 	files = g_object_get_data (G_OBJECT (item), "files");
 	file = files->data;
 
+	archives = get_local_archives (files);
+	if (archives != NULL) {
+		GtkWidget *dialog;
+		GFile     *parent;
+
+		dialog = gtk_file_chooser_dialog_new (_("Extract To"),
+						      NULL,
+						      GTK_FILE_CHOOSER_ACTION_SELECT_FOLDER,
+						      _("_Cancel"), GTK_RESPONSE_CANCEL,
+						      _("_Extract"), GTK_RESPONSE_ACCEPT,
+						      NULL);
+		gtk_dialog_set_default_response (GTK_DIALOG (dialog), GTK_RESPONSE_ACCEPT);
+
+		parent = g_file_get_parent (archives->data);
+		if (parent != NULL) {
+			gtk_file_chooser_set_current_folder_file (GTK_FILE_CHOOSER (dialog), parent, NULL);
+			g_object_unref (parent);
+		}
+
+		g_signal_connect (dialog, "response", G_CALLBACK (extract_to_response_cb), archives);
+		gtk_widget_show (dialog);
+		return;
+	}
+
 	uri = nemo_file_info_get_uri (file);
 	default_dir = nemo_file_info_get_parent_uri (file);
 
@@ -79,10 +151,18 @@ extract_here_callback (NemoMenuItem *item,
 		       gpointer          user_data)
 {
 	GList            *files, *scan;
+	GList            *archives;
 	GString          *cmd;
 
 	files = g_object_get_data (G_OBJECT (item), "files");
 
+	archives = get_local_archives (files);
+	if (archives != NULL) {
+		nemo_fr_extract (archives, NULL);
+		g_list_free_full (archives, g_object_unref);
+		return;
+	}
+
 	cmd = g_string_new ("file-roller --extract-here");
 
 	for (scan = files; scan; scan = scan->next) {
@@ -107,6 +187,20 @@ extract_here_callback (NemoMenuItem *item,
 }
 
 
+static void
+show_contents_callback (NemoMenuItem *item,
+			gpointer      user_data)
+{
+	GList *files;
+	GFile *location;
+
+	files = g_object_get_data (G_OBJECT (item), "files");
+	location = nemo_file_info_get_location (files->data);
+	nemo_fr_browse (location);
+	g_object_unref (location);
+}
+
+
 static void
 add_callback (NemoMenuItem *item,
 	      gpointer          user_data)
@@ -212,38 +306,99 @@ typedef struct {
 } FileMimeInfo;
 
 
+/* Content type of each archive_mime_types entry -> its index + 1 */
+static GHashTable *archive_content_types = NULL;
+
+/* MIME type of a file -> FileMimeInfo, filled in as types are first seen.
+ * A selection rarely has more than a handful of types, however big. */
+static GHashTable *file_mime_infos = NULL;
+
+
+static void
+build_mime_tables (void)
+{
+	int i;
+
+	archive_content_types = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	for (i = 0; archive_mime_types[i].mime_type != NULL; i++) {
+		char *content_type = g_content_type_from_mime_type (archive_mime_types[i].mime_type);
+
+		if (content_type == NULL)
+			content_type = g_strdup (archive_mime_types[i].mime_type);
+
+		/* Aliases, such as application/x-zip, keep the first entry */
+		if (! g_hash_table_contains (archive_content_types, content_type))
+			g_hash_table_insert (archive_content_types, content_type, GINT_TO_POINTER (i + 1));
+		else
+			g_free (content_type);
+	}
+
+	file_mime_infos = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+}
+
+
 static FileMimeInfo
-get_file_mime_info (NemoFileInfo *file)
+lookup_mime_info (const char *mime_type)
 {
-	FileMimeInfo file_mime_info;
-	int          i;
+	FileMimeInfo *cached;
+	FileMimeInfo  file_mime_info;
+	char         *content_type;
+	int           i;
+
+	cached = g_hash_table_lookup (file_mime_infos, mime_type);
+	if (cached != NULL)
+		return *cached;
 
 	file_mime_info.is_archive = FALSE;
 	file_mime_info.is_derived_archive = FALSE;
 	file_mime_info.is_compressed_archive = FALSE;
 
-	for (i = 0; archive_mime_types[i].mime_type != NULL; i++)
-		if (nemo_file_info_is_mime_type (file, archive_mime_types[i].mime_type)) {
-			char *mime_type;
-			char *content_type_mime_file;
-			char *content_type_mime_compare;
+	content_type = g_content_type_from_mime_type (mime_type);
+	if (content_type == NULL)
+		content_type = g_strdup (mime_type);
+
+	i = GPOINTER_TO_INT (g_hash_table_lookup (archive_content_types, content_type)) - 1;
+	if (i >= 0) {
+		file_mime_info.is_archive = TRUE;
+		file_mime_info.is_compressed_archive = archive_mime_types[i].is_compressed;
+	}
+	else {
+		/* Types built on an archive format, such as OpenDocument on zip */
+		for (i = 0; archive_mime_types[i].mime_type != NULL; i++)
+			if (g_content_type_is_a (content_type, archive_mime_types[i].mime_type)) {
+				file_mime_info.is_archive = TRUE;
+				file_mime_info.is_derived_archive = TRUE;
+				file_mime_info.is_compressed_archive = archive_mime_types[i].is_compressed;
+				break;
+			}
+	}
+
+	g_free (content_type);
 
-			mime_type = nemo_file_info_get_mime_type (file);
+	cached = g_new (FileMimeInfo, 1);
+	*cached = file_mime_info;
+	g_hash_table_insert (file_mime_infos, g_strdup (mime_type), cached);
 
-			content_type_mime_file = g_content_type_from_mime_type (mime_type);
-			content_type_mime_compare = g_content_type_from_mime_type (archive_mime_types[i].mime_type);
+	return file_mime_info;
+}
 
-			file_mime_info.is_archive = TRUE;
-			file_mime_info.is_compressed_archive = archive_mime_types[i].is_compressed;
-			if ((content_type_mime_file != NULL) && (content_type_mime_compare != NULL))
-				file_mime_info.is_derived_archive = ! g_content_type_equals (content_type_mime_file, content_type_mime_compare);
 
-			g_free (mime_type);
-			g_free (content_type_mime_file);
-			g_free (content_type_mime_compare);
+static FileMimeInfo
+get_file_mime_info (NemoFileInfo *file)
+{
+	FileMimeInfo  file_mime_info;
+	char         *mime_type;
+
+	mime_type = nemo_file_info_get_mime_type (file);
+	if (mime_type == NULL) {
+		file_mime_info.is_archive = FALSE;
+		file_mime_info.is_derived_archive = FALSE;
+		file_mime_info.is_compressed_archive = FALSE;
+		return file_mime_info;
+	}
 
-			return file_mime_info;
-		}
+	file_mime_info = lookup_mime_info (mime_type);
+	g_free (mime_type);
 
 	return file_mime_info;
 }
@@ -290,6 +445,7 @@ nemo_fr_get_file_items (NemoMenuProvider *provider,
 	gboolean  all_archives = TRUE;
 	gboolean  all_archives_derived = TRUE;
 	gboolean  all_archives_compressed = TRUE;
+	NemoFileInfo *last_parent = NULL;
 
 	if (files == NULL)
 		return NULL;
@@ -303,24 +459,36 @@ nemo_fr_get_file_items (NemoMenuProvider *provider,
 
 		file_mime_info = get_file_mime_info (file);
 
-		if (all_archives && ! file_mime_info.is_archive)
+		if (! file_mime_info.is_archive) {
+			/* That settles it: only "Compress..." is offered, and
+			 * nothing else about the selection matters for it */
 			all_archives = FALSE;
+			break;
+		}
 
-		if (all_archives_compressed && file_mime_info.is_archive && ! file_mime_info.is_compressed_archive)
+		if (! file_mime_info.is_compressed_archive)
 			all_archives_compressed = FALSE;
 
-		if (all_archives_derived && file_mime_info.is_archive && ! file_mime_info.is_derived_archive)
+		if (! file_mime_info.is_derived_archive)
 			all_archives_derived = FALSE;
 
 		if (can_write) {
 			NemoFileInfo *parent;
 
+			/* Selections nearly always come from a single folder */
 			parent = nemo_file_info_get_parent_info (file);
-			can_write = nemo_file_info_can_write (parent);
-			g_object_unref (parent);
+			if (parent != last_parent)
+				can_write = parent != NULL && nemo_file_info_can_write (parent);
+
+			if (last_parent != NULL)
+				g_object_unref (last_parent);
+			last_parent = parent;
 		}
 	}
 
+	if (last_parent != NULL)
+		g_object_unref (last_parent);
+
 	/**/
 
 	one_item = (files != NULL) && (files->next == NULL);
@@ -368,6 +536,31 @@ nemo_fr_get_file_items (NemoMenuProvider *provider,
 
 	}
 
+	if (one_archive && ! one_derived_archive) {
+		GFile *location = nemo_file_info_get_location (files->data);
+
+		if (g_file_is_native (location)) {
+			NemoMenuItem *item;
+
+			item = nemo_menu_item_new ("NemoFr::show_contents",
+						   _("Show Contents"),
+						   _("List the files in the selected archive"),
+						   "view-list-symbolic");
+			g_signal_connect (item,
+					  "activate",
+					  G_CALLBACK (show_contents_callback),
+					  provider);
+			g_object_set_data_full (G_OBJECT (item),
+						"files",
+						nemo_file_info_list_copy (files),
+						(GDestroyNotify) nemo_file_info_list_free);
+
+			items = g_list_append (items, item);
+		}
+
+		g_object_unref (location);
+	}
+
 	if (! one_compressed_archive || one_derived_archive) {
 		NemoMenuItem *item;
 
@@ -422,6 +615,8 @@ static void
 nemo_fr_class_init (NemoFrClass *class)
 {
 	parent_class = g_type_class_peek_parent (class);
+
+	build_mime_tables ();
 }
 
 
@@ -0,0 +1,232 @@
+/*
+ *  nemo-fr-browser.c
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <config.h>
+#include <sys/stat.h>
+#include <glib/gi18n-lib.h>
+#include <gio/gio.h>
+#include <gtk/gtk.h>
+#include "nemo-fr-browser.h"
+#include "nemo-fr-index.h"
+
+
+#define PAGE_SIZE 1000
+
+enum {
+	NAME_COLUMN,
+	SIZE_COLUMN,
+	N_COLUMNS
+};
+
+
+typedef struct {
+	GCancellable *cancellable;
+	NemoFrIndex  *index;
+	guint         n_shown;
+	gboolean      loading;
+	gboolean      destroyed;
+
+	GtkWidget    *window;
+	GtkWidget    *stack;
+	GtkWidget    *status_label;
+	GtkWidget    *spinner;
+	GtkListStore *store;
+} Browser;
+
+
+static void
+browser_free (Browser *browser)
+{
+	g_object_unref (browser->cancellable);
+	g_clear_pointer (&browser->index, nemo_fr_index_free);
+	g_clear_object (&browser->store);
+	g_free (browser);
+}
+
+
+static void
+show_next_page (Browser *browser)
+{
+	guint n_entries, last, i;
+	char *status;
+
+	n_entries = nemo_fr_index_get_n_entries (browser->index);
+	last = MIN (browser->n_shown + PAGE_SIZE, n_entries);
+
+	for (i = browser->n_shown; i < last; i++) {
+		NemoFrIndexEntry  entry;
+		const char       *name;
+		char             *display_name, *size = NULL;
+
+		if (! nemo_fr_index_get_entry (browser->index, i, &entry))
+			continue;
+
+		name = entry.name;
+		if (g_str_has_prefix (name, "./"))
+			name += 2;
+
+		display_name = g_filename_display_name (name);
+		if (! S_ISDIR (entry.mode))
+			size = g_format_size (entry.size);
+
+		gtk_list_store_insert_with_values (browser->store, NULL, -1,
+						   NAME_COLUMN, display_name,
+						   SIZE_COLUMN, size,
+						   -1);
+		g_free (size);
+		g_free (display_name);
+	}
+
+	browser->n_shown = last;
+
+	status = g_strdup_printf (ngettext ("%u item", "%u items", n_entries), n_entries);
+	gtk_label_set_text (GTK_LABEL (browser->status_label), status);
+	g_free (status);
+}
+
+
+static void
+edge_reached_cb (GtkScrolledWindow *scrolled_window,
+		 GtkPositionType    position,
+		 gpointer           user_data)
+{
+	Browser *browser = user_data;
+
+	if (position == GTK_POS_BOTTOM && browser->index != NULL)
+		show_next_page (browser);
+}
+
+
+static void
+index_loaded_cb (GObject      *source_object,
+		 GAsyncResult *result,
+		 gpointer      user_data)
+{
+	Browser *browser = user_data;
+	GError  *error = NULL;
+
+	browser->loading = FALSE;
+	browser->index = nemo_fr_index_load_finish (result, &error);
+
+	if (browser->destroyed) {
+		g_clear_error (&error);
+		browser_free (browser);
+		return;
+	}
+
+	gtk_spinner_stop (GTK_SPINNER (browser->spinner));
+
+	if (browser->index == NULL) {
+		gtk_label_set_text (GTK_LABEL (browser->status_label), error->message);
+		g_error_free (error);
+		return;
+	}
+
+	show_next_page (browser);
+	gtk_stack_set_visible_child_name (GTK_STACK (browser->stack), "list");
+}
+
+
+static void
+window_destroy_cb (GtkWidget *widget,
+		   gpointer   user_data)
+{
+	Browser *browser = user_data;
+
+	browser->destroyed = TRUE;
+
+	/* Indexing stops, and the browser goes when it has */
+	if (browser->loading)
+		g_cancellable_cancel (browser->cancellable);
+	else
+		browser_free (browser);
+}
+
+
+void
+nemo_fr_browse (GFile *archive)
+{
+	Browser           *browser;
+	GtkWidget         *box, *scrolled_window, *tree_view, *loading_box;
+	GtkCellRenderer   *renderer;
+	GtkTreeViewColumn *column;
+	char              *name, *title;
+
+	browser = g_new0 (Browser, 1);
+	browser->cancellable = g_cancellable_new ();
+	browser->store = gtk_list_store_new (N_COLUMNS, G_TYPE_STRING, G_TYPE_STRING);
+
+	name = g_file_get_basename (archive);
+	title = g_filename_display_name (name);
+
+	browser->window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+	gtk_window_set_title (GTK_WINDOW (browser->window), title);
+	gtk_window_set_default_size (GTK_WINDOW (browser->window), 600, 500);
+	g_signal_connect (browser->window, "destroy", G_CALLBACK (window_destroy_cb), browser);
+
+	g_free (title);
+	g_free (name);
+
+	box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 6);
+	gtk_container_set_border_width (GTK_CONTAINER (box), 6);
+	gtk_container_add (GTK_CONTAINER (browser->window), box);
+
+	browser->stack = gtk_stack_new ();
+	gtk_box_pack_start (GTK_BOX (box), browser->stack, TRUE, TRUE, 0);
+
+	loading_box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 6);
+	gtk_widget_set_valign (loading_box, GTK_ALIGN_CENTER);
+	browser->spinner = gtk_spinner_new ();
+	gtk_spinner_start (GTK_SPINNER (browser->spinner));
+	gtk_box_pack_start (GTK_BOX (loading_box), browser->spinner, FALSE, FALSE, 0);
+	gtk_stack_add_named (GTK_STACK (browser->stack), loading_box, "loading");
+
+	scrolled_window = gtk_scrolled_window_new (NULL, NULL);
+	gtk_scrolled_window_set_shadow_type (GTK_SCROLLED_WINDOW (scrolled_window), GTK_SHADOW_IN);
+	g_signal_connect (scrolled_window, "edge-reached", G_CALLBACK (edge_reached_cb), browser);
+	gtk_stack_add_named (GTK_STACK (browser->stack), scrolled_window, "list");
+
+	tree_view = gtk_tree_view_new_with_model (GTK_TREE_MODEL (browser->store));
+	gtk_container_add (GTK_CONTAINER (scrolled_window), tree_view);
+
+	renderer = gtk_cell_renderer_text_new ();
+	g_object_set (renderer, "ellipsize", PANGO_ELLIPSIZE_MIDDLE, NULL);
+	column = gtk_tree_view_column_new_with_attributes (_("Name"), renderer,
+							   "text", NAME_COLUMN,
+							   NULL);
+	gtk_tree_view_column_set_expand (column, TRUE);
+	gtk_tree_view_append_column (GTK_TREE_VIEW (tree_view), column);
+
+	renderer = gtk_cell_renderer_text_new ();
+	g_object_set (renderer, "xalign", 1.0, NULL);
+	column = gtk_tree_view_column_new_with_attributes (_("Size"), renderer,
+							   "text", SIZE_COLUMN,
+							   NULL);
+	gtk_tree_view_append_column (GTK_TREE_VIEW (tree_view), column);
+
+	browser->status_label = gtk_label_new (_("Reading the archive…"));
+	gtk_label_set_ellipsize (GTK_LABEL (browser->status_label), PANGO_ELLIPSIZE_END);
+	gtk_widget_set_halign (browser->status_label, GTK_ALIGN_START);
+	gtk_box_pack_start (GTK_BOX (box), browser->status_label, FALSE, FALSE, 0);
+
+	gtk_widget_show_all (browser->window);
+
+	browser->loading = TRUE;
+	nemo_fr_index_load_async (archive, browser->cancellable, index_loaded_cb, browser);
+}
@@ -0,0 +1,33 @@
+/*
+ *  nemo-fr-browser.h
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef NEMO_FR_BROWSER_H
+#define NEMO_FR_BROWSER_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* Opens a window listing the entries of a local archive, from its index.
+ * Rows are added a page at a time as the list is scrolled. */
+void nemo_fr_browse (GFile *archive);
+
+G_END_DECLS
+
+#endif /* NEMO_FR_BROWSER_H */
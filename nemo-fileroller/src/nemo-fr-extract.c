@@ -0,0 +1,1047 @@
+/*
+ *  nemo-fr-extract.c
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <config.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <archive.h>
+#include <archive_entry.h>
+#include <glib/gi18n-lib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <gtk/gtk.h>
+#include "nemo-fr-extract.h"
+
+
+#define READ_BLOCK_SIZE    (1024 * 1024)
+#define PROGRESS_INTERVAL  100 /* ms */
+#define MAX_FAILURES_SHOWN 10
+#define RATE_INTERVAL      G_USEC_PER_SEC
+
+/* Archives extracted at once onto one device.  Writers interleaved on a
+ * spinning disk make it seek, on anything else they keep it busy. */
+#define ROTATIONAL_THREADS     1
+#define NON_ROTATIONAL_THREADS 8
+#define UNKNOWN_THREADS        2
+
+
+/* Decompressors used instead of libarchive's own filters when they are
+ * installed.  They run as a separate process, so decompression happens
+ * on other cores while this side writes to disk, and pigz and xz spread
+ * it over several cores where the stream allows. */
+static const struct {
+	const char  *program;
+	const char  *signature;
+	size_t       signature_length;
+	int        (*builtin) (struct archive *);
+} parallel_filters[] = {
+	{ "pigz -dc", "\x1f\x8b", 2, archive_read_support_filter_gzip },
+	{ "xz -dc -T0", "\xfd" "7zXZ\0", 6, archive_read_support_filter_xz },
+	{ "zstd -dcq", "\x28\xb5\x2f\xfd", 4, archive_read_support_filter_zstd },
+	{ "lbzip2 -dc", "BZh", 3, archive_read_support_filter_bzip2 },
+};
+
+/* The rest of libarchive's filters, archive_read_support_filter_all()
+ * would outbid the programs above */
+static int (*other_filters[]) (struct archive *) = {
+	archive_read_support_filter_compress,
+	archive_read_support_filter_grzip,
+	archive_read_support_filter_lrzip,
+	archive_read_support_filter_lz4,
+	archive_read_support_filter_lzip,
+	archive_read_support_filter_lzma,
+	archive_read_support_filter_lzop,
+	archive_read_support_filter_rpm,
+	archive_read_support_filter_uu,
+};
+
+static const char *compound_extensions[] = {
+	".tar.gz", ".tar.bz2", ".tar.xz", ".tar.zst", ".tar.lz",
+	".tar.lzma", ".tar.lzo", ".tar.Z", ".tar.7z", NULL
+};
+
+
+typedef struct {
+	GList        *archives;
+	GFile        *destination;
+	GCancellable *cancellable;
+
+	/* Shared between the worker threads */
+	GMutex        lock;
+	goffset       total_bytes;
+	goffset       done_bytes;
+	char         *current_name;
+	int           n_running;
+	GList        *failed;
+	GList        *unsupported;
+
+	GtkWidget    *progress_dialog;
+	GtkWidget    *progress_bar;
+	GtkWidget    *progress_label;
+	guint         progress_timeout;
+	gint64        rate_time;
+	goffset       rate_done_bytes;
+	goffset       rate;
+} ExtractJob;
+
+
+typedef struct {
+	GFile        *archive;
+	goffset       size;
+} ExtractItem;
+
+
+static void
+extract_job_free (ExtractJob *job)
+{
+	g_list_free_full (job->archives, g_object_unref);
+	g_clear_object (&job->destination);
+	g_object_unref (job->cancellable);
+	g_mutex_clear (&job->lock);
+	g_free (job->current_name);
+	g_list_free_full (job->failed, g_free);
+	g_list_free_full (job->unsupported, g_object_unref);
+	g_free (job);
+}
+
+
+static void
+extract_item_free (ExtractItem *item)
+{
+	g_object_unref (item->archive);
+	g_free (item);
+}
+
+
+static void
+set_error_from_archive (GError         **error,
+			struct archive  *archive)
+{
+	const char *message = archive_error_string (archive);
+	int         code = G_IO_ERROR_FAILED;
+
+	/* Formats and features libarchive doesn't handle are left to file-roller */
+	if (archive_errno (archive) == ARCHIVE_ERRNO_FILE_FORMAT)
+		code = G_IO_ERROR_NOT_SUPPORTED;
+	else if (archive_errno (archive) == ENOSPC)
+		code = G_IO_ERROR_NO_SPACE;
+
+	g_set_error_literal (error, G_IO_ERROR, code,
+			     message != NULL ? message : _("Could not extract the archive"));
+}
+
+
+static void
+set_error_from_errno (GError     **error,
+		      const char  *path)
+{
+	int saved_errno = errno;
+
+	g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+		     "%s: %s", path, g_strerror (saved_errno));
+}
+
+
+char *
+nemo_fr_strip_extension (const char *name)
+{
+	const char *dot;
+	gsize       length = strlen (name);
+	int         i;
+
+	for (i = 0; compound_extensions[i] != NULL; i++) {
+		gsize extension_length = strlen (compound_extensions[i]);
+
+		if (length > extension_length &&
+		    g_ascii_strcasecmp (name + length - extension_length, compound_extensions[i]) == 0)
+			return g_strndup (name, length - extension_length);
+	}
+
+	dot = strrchr (name, '.');
+	if (dot == NULL || dot == name)
+		return g_strdup (name);
+
+	return g_strndup (name, dot - name);
+}
+
+
+/* A name in dir that isn't taken yet, numbering name if needed */
+static char *
+get_unique_path (const char *dir,
+		 const char *name,
+		 gboolean    is_dir)
+{
+	char       *base, *path;
+	const char *extension = "";
+	int         i;
+
+	path = g_build_filename (dir, name, NULL);
+	if (! g_file_test (path, G_FILE_TEST_EXISTS | G_FILE_TEST_IS_SYMLINK))
+		return path;
+	g_free (path);
+
+	base = is_dir ? g_strdup (name) : nemo_fr_strip_extension (name);
+	if (! is_dir)
+		extension = name + strlen (base);
+
+	for (i = 2; ; i++) {
+		char *numbered = g_strdup_printf ("%s (%d)%s", base, i, extension);
+
+		path = g_build_filename (dir, numbered, NULL);
+		g_free (numbered);
+
+		if (! g_file_test (path, G_FILE_TEST_EXISTS | G_FILE_TEST_IS_SYMLINK))
+			break;
+		g_free (path);
+	}
+
+	g_free (base);
+
+	return path;
+}
+
+
+static void
+remove_recursively (const char *path)
+{
+	GStatBuf     buf;
+	GDir        *dir;
+	const char  *name;
+
+	if (g_lstat (path, &buf) != 0)
+		return;
+
+	if (S_ISDIR (buf.st_mode)) {
+		/* Read-only folders from the archive have to be emptied too */
+		g_chmod (path, 0700);
+
+		dir = g_dir_open (path, 0, NULL);
+		if (dir != NULL) {
+			while ((name = g_dir_read_name (dir)) != NULL) {
+				char *child = g_build_filename (path, name, NULL);
+
+				remove_recursively (child);
+				g_free (child);
+			}
+			g_dir_close (dir);
+		}
+
+		g_rmdir (path);
+	}
+	else
+		g_unlink (path);
+}
+
+
+/* Entry names are put under the temporary folder, so they must not be
+ * able to climb out of it, whether by name or through a symbolic link
+ * extracted earlier.  last_dir saves checking the same folder for every
+ * file in it. */
+static gboolean
+is_safe_path (const char  *base,
+	      const char  *name,
+	      char       **last_dir)
+{
+	char     **components;
+	char      *dir, *path;
+	gboolean   safe = TRUE;
+	int        i;
+
+	if (g_path_is_absolute (name))
+		return FALSE;
+
+	components = g_strsplit (name, "/", -1);
+	for (i = 0; components[i] != NULL; i++)
+		if (strcmp (components[i], "..") == 0)
+			safe = FALSE;
+
+	dir = g_path_get_dirname (name);
+	if (safe && g_strcmp0 (dir, *last_dir) != 0) {
+		path = g_strdup (base);
+		for (i = 0; safe && components[i] != NULL && components[i + 1] != NULL; i++) {
+			GStatBuf  buf;
+			char     *next;
+
+			if (components[i][0] == '\0' || strcmp (components[i], ".") == 0)
+				continue;
+
+			next = g_build_filename (path, components[i], NULL);
+			g_free (path);
+			path = next;
+
+			if (g_lstat (path, &buf) == 0 && S_ISLNK (buf.st_mode))
+				safe = FALSE;
+		}
+		g_free (path);
+
+		if (safe) {
+			g_free (*last_dir);
+			*last_dir = dir;
+			dir = NULL;
+		}
+	}
+
+	g_free (dir);
+	g_strfreev (components);
+
+	return safe;
+}
+
+
+static gboolean *
+find_programs (void)
+{
+	static gboolean *have_program = NULL;
+
+	if (g_once_init_enter (&have_program)) {
+		gboolean *found_programs = g_new0 (gboolean, G_N_ELEMENTS (parallel_filters));
+		guint     i;
+
+		for (i = 0; i < G_N_ELEMENTS (parallel_filters); i++) {
+			char *program = g_strndup (parallel_filters[i].program,
+						   strcspn (parallel_filters[i].program, " "));
+			char *found = g_find_program_in_path (program);
+
+			found_programs[i] = found != NULL;
+			g_free (found);
+			g_free (program);
+		}
+
+		g_once_init_leave (&have_program, found_programs);
+	}
+
+	return have_program;
+}
+
+
+struct archive *
+nemo_fr_open_archive (const char  *path,
+		      GError     **error)
+{
+	struct archive *reader;
+	gboolean       *have_program;
+	guint           i;
+
+	have_program = find_programs ();
+	reader = archive_read_new ();
+
+	for (i = 0; i < G_N_ELEMENTS (parallel_filters); i++) {
+		if (have_program[i])
+			archive_read_support_filter_program_signature (reader,
+								       parallel_filters[i].program,
+								       parallel_filters[i].signature,
+								       parallel_filters[i].signature_length);
+		else
+			parallel_filters[i].builtin (reader);
+	}
+	for (i = 0; i < G_N_ELEMENTS (other_filters); i++)
+		other_filters[i] (reader);
+
+	archive_read_support_format_all (reader);
+	/* A lone compressed file, such as foo.gz */
+	archive_read_support_format_raw (reader);
+
+	if (archive_read_open_filename (reader, path, READ_BLOCK_SIZE) != ARCHIVE_OK) {
+		set_error_from_archive (error, reader);
+		archive_read_free (reader);
+		return NULL;
+	}
+
+	return reader;
+}
+
+
+static void
+add_progress (ExtractJob *job,
+	      goffset     bytes)
+{
+	g_mutex_lock (&job->lock);
+	job->done_bytes += bytes;
+	g_mutex_unlock (&job->lock);
+}
+
+
+static gboolean
+copy_data (ExtractJob      *job,
+	   struct archive  *reader,
+	   struct archive  *writer,
+	   goffset         *read_bytes,
+	   GError         **error)
+{
+	const void *buffer;
+	size_t      size;
+	la_int64_t  offset;
+	int         r;
+
+	while ((r = archive_read_data_block (reader, &buffer, &size, &offset)) == ARCHIVE_OK) {
+		goffset position;
+
+		if (archive_write_data_block (writer, buffer, size, offset) < ARCHIVE_WARN) {
+			set_error_from_archive (error, writer);
+			return FALSE;
+		}
+
+		/* Progress goes by the compressed bytes read */
+		position = archive_filter_bytes (reader, -1);
+		add_progress (job, position - *read_bytes);
+		*read_bytes = position;
+
+		if (g_cancellable_set_error_if_cancelled (job->cancellable, error))
+			return FALSE;
+	}
+
+	if (r != ARCHIVE_EOF) {
+		set_error_from_archive (error, reader);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+static gboolean
+extract_entries (ExtractJob      *job,
+		 struct archive  *reader,
+		 const char      *tmp_dir,
+		 const char      *archive_name,
+		 goffset         *read_bytes,
+		 GError         **error)
+{
+	struct archive       *writer;
+	struct archive_entry *entry;
+	char                 *last_dir = NULL;
+	gboolean              ok = TRUE;
+	int                   r;
+
+	writer = archive_write_disk_new ();
+	archive_write_disk_set_options (writer,
+					ARCHIVE_EXTRACT_TIME |
+					ARCHIVE_EXTRACT_UNLINK |
+					ARCHIVE_EXTRACT_SECURE_NODOTDOT);
+	archive_write_disk_set_standard_lookup (writer);
+
+	while (ok) {
+		const char *name;
+		char       *path;
+		char       *raw_name = NULL;
+
+		if (g_cancellable_set_error_if_cancelled (job->cancellable, error)) {
+			ok = FALSE;
+			break;
+		}
+
+		r = archive_read_next_header (reader, &entry);
+		if (r == ARCHIVE_EOF)
+			break;
+		if (r < ARCHIVE_WARN) {
+			set_error_from_archive (error, reader);
+			ok = FALSE;
+			break;
+		}
+
+		if (archive_format (reader) == ARCHIVE_FORMAT_RAW) {
+			/* Anything is a raw archive, only take compressed files */
+			if (archive_filter_code (reader, 0) == ARCHIVE_FILTER_NONE) {
+				g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+						     _("Unknown archive type"));
+				ok = FALSE;
+				break;
+			}
+			raw_name = nemo_fr_strip_extension (archive_name);
+		}
+
+		/* file-roller asks for the password */
+		if (archive_entry_is_encrypted (entry)) {
+			g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+					     _("The archive is encrypted"));
+			ok = FALSE;
+			break;
+		}
+
+		name = raw_name != NULL ? raw_name : archive_entry_pathname (entry);
+		if (name == NULL || ! is_safe_path (tmp_dir, name, &last_dir)) {
+			g_set_error (error, G_IO_ERROR, G_IO_ERROR_PERMISSION_DENIED,
+				     _("The archive contains an unsafe file name: %s"),
+				     name != NULL ? name : "");
+			g_free (raw_name);
+			ok = FALSE;
+			break;
+		}
+
+		path = g_build_filename (tmp_dir, name, NULL);
+		archive_entry_set_pathname (entry, path);
+		g_free (path);
+		g_free (raw_name);
+
+		name = archive_entry_hardlink (entry);
+		if (name != NULL) {
+			char *no_dir = NULL;
+
+			if (! is_safe_path (tmp_dir, name, &no_dir)) {
+				g_set_error (error, G_IO_ERROR, G_IO_ERROR_PERMISSION_DENIED,
+					     _("The archive contains an unsafe file name: %s"), name);
+				g_free (no_dir);
+				ok = FALSE;
+				break;
+			}
+			g_free (no_dir);
+
+			path = g_build_filename (tmp_dir, name, NULL);
+			archive_entry_set_hardlink (entry, path);
+			g_free (path);
+		}
+
+		if (archive_write_header (writer, entry) < ARCHIVE_WARN) {
+			set_error_from_archive (error, writer);
+			ok = FALSE;
+			break;
+		}
+
+		if (! archive_entry_size_is_set (entry) || archive_entry_size (entry) > 0)
+			ok = copy_data (job, reader, writer, read_bytes, error);
+
+		if (ok && archive_write_finish_entry (writer) < ARCHIVE_WARN) {
+			set_error_from_archive (error, writer);
+			ok = FALSE;
+		}
+	}
+
+	/* Sets the times of the folders, which writing into them changed */
+	if (archive_write_close (writer) != ARCHIVE_OK && ok) {
+		set_error_from_archive (error, writer);
+		ok = FALSE;
+	}
+	archive_write_free (writer);
+	g_free (last_dir);
+
+	return ok;
+}
+
+
+/* Moves what was extracted from tmp_dir to its final name in dest_dir */
+static gboolean
+move_into_place (const char  *tmp_dir,
+		 const char  *dest_dir,
+		 const char  *archive_name,
+		 GError     **error)
+{
+	GDir       *dir;
+	const char *name;
+	char       *first = NULL;
+	char       *source, *target, *folder_name;
+	int         n_children = 0;
+	gboolean    ok = TRUE;
+
+	dir = g_dir_open (tmp_dir, 0, error);
+	if (dir == NULL)
+		return FALSE;
+
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		if (n_children++ == 0)
+			first = g_strdup (name);
+	}
+	g_dir_close (dir);
+
+	if (n_children == 1) {
+		source = g_build_filename (tmp_dir, first, NULL);
+		target = get_unique_path (dest_dir, first, g_file_test (source, G_FILE_TEST_IS_DIR));
+
+		if (g_rename (source, target) != 0) {
+			set_error_from_errno (error, target);
+			ok = FALSE;
+		}
+		else
+			g_rmdir (tmp_dir);
+
+		g_free (source);
+		g_free (target);
+	}
+	else if (n_children > 1) {
+		folder_name = nemo_fr_strip_extension (archive_name);
+		target = get_unique_path (dest_dir, folder_name, TRUE);
+
+		if (g_rename (tmp_dir, target) != 0) {
+			set_error_from_errno (error, target);
+			ok = FALSE;
+		}
+		else
+			/* g_mkdtemp() made it private */
+			g_chmod (target, 0755);
+
+		g_free (folder_name);
+		g_free (target);
+	}
+	else
+		g_rmdir (tmp_dir);
+
+	g_free (first);
+
+	return ok;
+}
+
+
+static char *
+get_dest_dir (ExtractJob *job,
+	      GFile      *archive)
+{
+	GFile *parent;
+	char  *dest_dir;
+
+	if (job->destination != NULL)
+		return g_file_get_path (job->destination);
+
+	parent = g_file_get_parent (archive);
+	dest_dir = g_file_get_path (parent);
+	g_object_unref (parent);
+
+	return dest_dir;
+}
+
+
+static gboolean
+extract_archive (ExtractJob  *job,
+		 GFile       *archive,
+		 goffset     *read_bytes,
+		 GError     **error)
+{
+	struct archive *reader;
+	char           *path, *archive_name, *dest_dir, *tmp_dir;
+	gboolean        ok;
+
+	path = g_file_get_path (archive);
+	archive_name = g_path_get_basename (path);
+	dest_dir = get_dest_dir (job, archive);
+
+	g_mutex_lock (&job->lock);
+	g_free (job->current_name);
+	job->current_name = g_filename_display_name (archive_name);
+	job->n_running++;
+	g_mutex_unlock (&job->lock);
+
+	/* Extract next to the destination, so that moving the result into
+	 * place is a rename and nothing is copied twice */
+	tmp_dir = g_build_filename (dest_dir, ".nemo-fr-XXXXXX", NULL);
+	if (g_mkdtemp (tmp_dir) == NULL) {
+		set_error_from_errno (error, dest_dir);
+		ok = FALSE;
+		goto out;
+	}
+
+	reader = nemo_fr_open_archive (path, error);
+	if (reader == NULL) {
+		g_rmdir (tmp_dir);
+		ok = FALSE;
+		goto out;
+	}
+
+	ok = extract_entries (job, reader, tmp_dir, archive_name, read_bytes, error);
+	archive_read_free (reader);
+
+	if (ok)
+		ok = move_into_place (tmp_dir, dest_dir, archive_name, error);
+
+	if (! ok)
+		remove_recursively (tmp_dir);
+
+out:
+	g_mutex_lock (&job->lock);
+	job->n_running--;
+	g_mutex_unlock (&job->lock);
+
+	g_free (tmp_dir);
+	g_free (dest_dir);
+	g_free (archive_name);
+	g_free (path);
+
+	return ok;
+}
+
+
+/* How many archives to extract at once onto device, going by whether
+ * the block device under it spins */
+static int
+get_device_threads (dev_t device)
+{
+	char *path, *contents = NULL;
+	int   threads = UNKNOWN_THREADS;
+
+	path = g_strdup_printf ("/sys/dev/block/%u:%u/queue/rotational",
+				major (device), minor (device));
+	if (! g_file_get_contents (path, &contents, NULL, NULL)) {
+		g_free (path);
+		/* A partition goes by its disk */
+		path = g_strdup_printf ("/sys/dev/block/%u:%u/../queue/rotational",
+					major (device), minor (device));
+		g_file_get_contents (path, &contents, NULL, NULL);
+	}
+
+	if (contents != NULL)
+		threads = contents[0] == '1' ? ROTATIONAL_THREADS :
+			CLAMP ((int) g_get_num_processors (), UNKNOWN_THREADS, NON_ROTATIONAL_THREADS);
+
+	g_free (contents);
+	g_free (path);
+
+	return threads;
+}
+
+
+static void
+extract_item_func (gpointer data,
+		   gpointer user_data)
+{
+	ExtractItem *item = data;
+	ExtractJob  *job = user_data;
+	GError      *error = NULL;
+	goffset      read_bytes = 0;
+
+	if (g_cancellable_is_cancelled (job->cancellable))
+		return;
+
+	if (! extract_archive (job, item->archive, &read_bytes, &error)) {
+		g_mutex_lock (&job->lock);
+		if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED)) {
+			job->unsupported = g_list_prepend (job->unsupported, g_object_ref (item->archive));
+		}
+		else if (! g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			char *name = g_file_get_parse_name (item->archive);
+
+			job->failed = g_list_prepend (job->failed,
+						      g_strdup_printf ("%s: %s", name, error->message));
+			g_free (name);
+		}
+		g_mutex_unlock (&job->lock);
+		g_error_free (error);
+	}
+
+	/* Count the whole archive as done, whatever was read of it */
+	add_progress (job, MAX (item->size - read_bytes, 0));
+}
+
+
+static int
+compare_size_descending (gconstpointer a,
+			 gconstpointer b)
+{
+	const ExtractItem *item_a = *(ExtractItem **) a;
+	const ExtractItem *item_b = *(ExtractItem **) b;
+
+	return (item_a->size < item_b->size) - (item_a->size > item_b->size);
+}
+
+
+/* Each destination device gets a pool of its own, so that a slow disk
+ * doesn't hold back extracting onto a fast one */
+static void
+extract_thread (GTask        *task,
+		gpointer      source_object,
+		gpointer      task_data,
+		GCancellable *cancellable)
+{
+	ExtractJob     *job = task_data;
+	GPtrArray      *items;
+	GHashTable     *pools;
+	GHashTableIter  iter;
+	GThreadPool    *pool;
+	GList          *scan;
+	guint           i;
+
+	items = g_ptr_array_new_with_free_func ((GDestroyNotify) extract_item_free);
+	for (scan = job->archives; scan; scan = scan->next) {
+		ExtractItem *item;
+		GFileInfo   *info;
+
+		item = g_new0 (ExtractItem, 1);
+		item->archive = g_object_ref (scan->data);
+
+		info = g_file_query_info (item->archive, G_FILE_ATTRIBUTE_STANDARD_SIZE,
+					  G_FILE_QUERY_INFO_NONE, NULL, NULL);
+		if (info != NULL) {
+			item->size = g_file_info_get_size (info);
+			g_object_unref (info);
+		}
+
+		g_mutex_lock (&job->lock);
+		job->total_bytes += item->size;
+		g_mutex_unlock (&job->lock);
+
+		g_ptr_array_add (items, item);
+	}
+
+	/* The biggest archives go first, rather than one of them being
+	 * left to run alone at the end */
+	g_ptr_array_sort (items, compare_size_descending);
+
+	pools = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, NULL);
+	for (i = 0; i < items->len; i++) {
+		ExtractItem *item = g_ptr_array_index (items, i);
+		char        *dest_dir;
+		GStatBuf     buf;
+		gint64       device = 0;
+
+		dest_dir = get_dest_dir (job, item->archive);
+		if (g_stat (dest_dir, &buf) == 0)
+			device = buf.st_dev;
+		g_free (dest_dir);
+
+		pool = g_hash_table_lookup (pools, &device);
+		if (pool == NULL) {
+			gint64 *key = g_new (gint64, 1);
+
+			*key = device;
+			pool = g_thread_pool_new (extract_item_func, job,
+						  get_device_threads (device), FALSE, NULL);
+			g_hash_table_insert (pools, key, pool);
+		}
+
+		g_thread_pool_push (pool, item, NULL);
+	}
+
+	/* Waits for every pool to run out of archives */
+	g_hash_table_iter_init (&iter, pools);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &pool))
+		g_thread_pool_free (pool, FALSE, TRUE);
+
+	g_hash_table_destroy (pools);
+	g_ptr_array_unref (items);
+
+	g_task_return_boolean (task, TRUE);
+}
+
+
+static gboolean
+update_progress (gpointer user_data)
+{
+	ExtractJob *job = user_data;
+	char       *done, *total, *text, *markup = NULL;
+	double      fraction;
+	goffset     done_bytes;
+	gint64      now;
+
+	g_mutex_lock (&job->lock);
+
+	done_bytes = job->done_bytes;
+	fraction = job->total_bytes > 0 ? (double) done_bytes / job->total_bytes : 0;
+	done = g_format_size (done_bytes);
+	total = g_format_size (job->total_bytes);
+	if (job->n_running > 1)
+		markup = g_strdup_printf (ngettext ("<i>Extracting %d archive</i>",
+						    "<i>Extracting %d archives</i>",
+						    job->n_running),
+					  job->n_running);
+	else if (job->current_name != NULL)
+		markup = g_markup_printf_escaped (_("<i>Extracting \"%s\"</i>"), job->current_name);
+
+	g_mutex_unlock (&job->lock);
+
+	/* The rate of all the archives together, measured over a second
+	 * rather than between updates, which would make it jitter */
+	now = g_get_monotonic_time ();
+	if (job->rate_time == 0) {
+		job->rate_time = now;
+		job->rate_done_bytes = done_bytes;
+	}
+	else if (now - job->rate_time >= RATE_INTERVAL) {
+		job->rate = (done_bytes - job->rate_done_bytes) * G_USEC_PER_SEC / (now - job->rate_time);
+		job->rate_time = now;
+		job->rate_done_bytes = done_bytes;
+	}
+
+	if (job->rate > 0) {
+		char *rate = g_format_size (job->rate);
+
+		/* Translators: the first two %s are amounts of data, such as
+		 * "12 MB", the last one is a rate, such as "3 MB" per second */
+		text = g_strdup_printf (_("%s of %s (%s/s)"), done, total, rate);
+		g_free (rate);
+	}
+	else
+		/* Translators: the first %s is an amount of data, such as "12 MB" */
+		text = g_strdup_printf (_("%s of %s"), done, total);
+	gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (job->progress_bar), CLAMP (fraction, 0, 1));
+	gtk_progress_bar_set_text (GTK_PROGRESS_BAR (job->progress_bar), text);
+	if (markup != NULL)
+		gtk_label_set_markup (GTK_LABEL (job->progress_label), markup);
+
+	g_free (markup);
+	g_free (text);
+	g_free (total);
+	g_free (done);
+
+	return G_SOURCE_CONTINUE;
+}
+
+
+static void
+progress_response_cb (GtkDialog *dialog,
+		      int        response_id,
+		      gpointer   user_data)
+{
+	ExtractJob *job = user_data;
+
+	if (response_id != GTK_RESPONSE_CANCEL) {
+		/* Closing the window leaves the extraction running */
+		gtk_widget_hide (GTK_WIDGET (dialog));
+		return;
+	}
+
+	g_cancellable_cancel (job->cancellable);
+	gtk_dialog_set_response_sensitive (dialog, GTK_RESPONSE_CANCEL, FALSE);
+}
+
+
+static void
+show_progress_dialog (ExtractJob *job)
+{
+	GtkWidget *content_area;
+
+	job->progress_dialog = gtk_dialog_new_with_buttons (_("Extracting archives"),
+							    NULL, 0,
+							    _("_Cancel"), GTK_RESPONSE_CANCEL,
+							    NULL);
+	gtk_window_set_default_size (GTK_WINDOW (job->progress_dialog), 400, -1);
+	gtk_container_set_border_width (GTK_CONTAINER (job->progress_dialog), 6);
+
+	content_area = gtk_dialog_get_content_area (GTK_DIALOG (job->progress_dialog));
+	gtk_box_set_spacing (GTK_BOX (content_area), 6);
+
+	job->progress_label = gtk_label_new (NULL);
+	gtk_label_set_ellipsize (GTK_LABEL (job->progress_label), PANGO_ELLIPSIZE_MIDDLE);
+	gtk_widget_set_halign (job->progress_label, GTK_ALIGN_START);
+	gtk_box_pack_start (GTK_BOX (content_area), job->progress_label, FALSE, FALSE, 0);
+
+	job->progress_bar = gtk_progress_bar_new ();
+	gtk_progress_bar_set_show_text (GTK_PROGRESS_BAR (job->progress_bar), TRUE);
+	gtk_box_pack_start (GTK_BOX (content_area), job->progress_bar, FALSE, FALSE, 0);
+
+	g_signal_connect (job->progress_dialog, "response",
+			  G_CALLBACK (progress_response_cb), job);
+	/* The default handler would destroy it under the running job */
+	g_signal_connect (job->progress_dialog, "delete-event",
+			  G_CALLBACK (gtk_widget_hide_on_delete), NULL);
+
+	update_progress (job);
+	gtk_widget_show_all (job->progress_dialog);
+
+	job->progress_timeout = g_timeout_add (PROGRESS_INTERVAL, update_progress, job);
+}
+
+
+static void
+spawn_file_roller (GList *archives,
+		   GFile *destination)
+{
+	GPtrArray *argv;
+	GList     *scan;
+
+	argv = g_ptr_array_new_with_free_func (g_free);
+	g_ptr_array_add (argv, g_strdup ("file-roller"));
+
+	if (destination != NULL) {
+		char *uri = g_file_get_uri (destination);
+
+		g_ptr_array_add (argv, g_strdup_printf ("--extract-to=%s", uri));
+		g_free (uri);
+	}
+	else
+		g_ptr_array_add (argv, g_strdup ("--extract-here"));
+
+	for (scan = archives; scan; scan = scan->next)
+		g_ptr_array_add (argv, g_file_get_uri (scan->data));
+	g_ptr_array_add (argv, NULL);
+
+	g_spawn_async (NULL, (char **) argv->pdata, NULL, G_SPAWN_SEARCH_PATH,
+		       NULL, NULL, NULL, NULL);
+
+	g_ptr_array_free (argv, TRUE);
+}
+
+
+static void
+show_failures (GList *failed)
+{
+	GtkWidget *dialog;
+	GString   *names;
+	GList     *scan;
+	int        n_failed, i;
+
+	n_failed = g_list_length (failed);
+	names = g_string_new (NULL);
+	for (scan = failed, i = 0; scan != NULL && i < MAX_FAILURES_SHOWN; scan = scan->next, i++)
+		g_string_append_printf (names, "%s\n", (char *) scan->data);
+	if (n_failed > MAX_FAILURES_SHOWN)
+		g_string_append_printf (names, _("and %d more"), n_failed - MAX_FAILURES_SHOWN);
+
+	dialog = gtk_message_dialog_new (NULL, 0, GTK_MESSAGE_ERROR, GTK_BUTTONS_CLOSE,
+					 ngettext ("%d archive could not be extracted.",
+						   "%d archives could not be extracted.",
+						   n_failed),
+					 n_failed);
+	gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (dialog), "%s", names->str);
+	g_string_free (names, TRUE);
+
+	g_signal_connect (dialog, "response", G_CALLBACK (gtk_widget_destroy), NULL);
+	gtk_widget_show (dialog);
+}
+
+
+static void
+extract_done_cb (GObject      *source_object,
+		 GAsyncResult *result,
+		 gpointer      user_data)
+{
+	ExtractJob *job = g_task_get_task_data (G_TASK (result));
+
+	g_source_remove (job->progress_timeout);
+	gtk_widget_destroy (job->progress_dialog);
+
+	if (job->unsupported != NULL) {
+		job->unsupported = g_list_reverse (job->unsupported);
+		spawn_file_roller (job->unsupported, job->destination);
+	}
+
+	if (job->failed != NULL) {
+		job->failed = g_list_reverse (job->failed);
+		show_failures (job->failed);
+	}
+}
+
+
+void
+nemo_fr_extract (GList *archives,
+		 GFile *destination)
+{
+	ExtractJob *job;
+	GTask      *task;
+
+	job = g_new0 (ExtractJob, 1);
+	job->archives = g_list_copy_deep (archives, (GCopyFunc) g_object_ref, NULL);
+	job->destination = destination != NULL ? g_object_ref (destination) : NULL;
+	job->cancellable = g_cancellable_new ();
+	g_mutex_init (&job->lock);
+
+	show_progress_dialog (job);
+
+	task = g_task_new (NULL, job->cancellable, extract_done_cb, NULL);
+	g_task_set_task_data (task, job, (GDestroyNotify) extract_job_free);
+	g_task_run_in_thread (task, extract_thread);
+	g_object_unref (task);
+}
@@ -0,0 +1,51 @@
+/*
+ *  nemo-fr-extract.h
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef NEMO_FR_EXTRACT_H
+#define NEMO_FR_EXTRACT_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+struct archive;
+
+/* Opens a local archive for reading with libarchive, decompressing with
+ * the external programs where they are installed */
+struct archive *nemo_fr_open_archive (const char  *path,
+				      GError     **error);
+
+/* The name an archive extracts to: name without its extension, or
+ * both extensions of a compressed tar such as foo.tar.gz */
+char *nemo_fr_strip_extension (const char *name);
+
+/* Extracts each archive in a list of local GFiles with libarchive, on
+ * worker threads, showing the progress in a window.  Several archives are
+ * extracted at once, as many as suits the device they are going onto.  The archives go into
+ * destination, or next to themselves if it is NULL.  Like file-roller,
+ * an archive holding a single top-level item extracts to just that item,
+ * anything else gets a folder named after the archive.  Archives
+ * libarchive can't read are passed on to file-roller.
+ */
+void nemo_fr_extract (GList *archives,
+		      GFile *destination);
+
+G_END_DECLS
+
+#endif /* NEMO_FR_EXTRACT_H */
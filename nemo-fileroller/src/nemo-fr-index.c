@@ -0,0 +1,371 @@
+/*
+ *  nemo-fr-index.c
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <config.h>
+#include <errno.h>
+#include <string.h>
+#include <archive.h>
+#include <archive_entry.h>
+#include <glib/gi18n-lib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include "nemo-fr-extract.h"
+#include "nemo-fr-index.h"
+
+
+/* An index file is an IndexHeader, an IndexRecord for each entry, then
+ * the entry names, each ending in a NUL.  It is in host byte order, as
+ * it never leaves the cache it was written to. */
+
+#define INDEX_MAGIC "NFRIDX02"
+
+typedef struct {
+	char    magic[8];
+	guint64 archive_mtime;  /* in nanoseconds */
+	guint64 archive_size;
+	guint32 n_entries;
+	guint32 reserved;
+} IndexHeader;
+
+typedef struct {
+	guint64 size;
+	guint64 offset;
+	guint32 name_offset;
+	guint32 mode;
+} IndexRecord;
+
+
+struct _NemoFrIndex {
+	GBytes            *data;
+	const IndexHeader *header;
+	const IndexRecord *records;
+	const char        *names;
+	gsize              names_length;
+};
+
+
+static char *
+get_index_path (GFile *archive)
+{
+	char *uri, *checksum, *name, *path;
+
+	uri = g_file_get_uri (archive);
+	checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, uri, -1);
+	name = g_strconcat (checksum, ".index", NULL);
+	path = g_build_filename (g_get_user_cache_dir (), "nemo-fileroller", name, NULL);
+
+	g_free (name);
+	g_free (checksum);
+	g_free (uri);
+
+	return path;
+}
+
+
+/* Takes the data, NULL if it isn't an index of an archive with this
+ * mtime and size */
+static NemoFrIndex *
+index_new (GBytes  *data,
+	   guint64  archive_mtime,
+	   guint64  archive_size)
+{
+	NemoFrIndex       *index;
+	const IndexHeader *header;
+	const char        *contents;
+	gsize              length, records_end;
+
+	contents = g_bytes_get_data (data, &length);
+	header = (const IndexHeader *) contents;
+
+	if (length < sizeof (IndexHeader) ||
+	    memcmp (header->magic, INDEX_MAGIC, sizeof (header->magic)) != 0 ||
+	    header->archive_mtime != archive_mtime ||
+	    header->archive_size != archive_size ||
+	    header->n_entries > (length - sizeof (IndexHeader)) / sizeof (IndexRecord)) {
+		g_bytes_unref (data);
+		return NULL;
+	}
+
+	/* Names are only looked up within the data, and end in a NUL */
+	records_end = sizeof (IndexHeader) + (gsize) header->n_entries * sizeof (IndexRecord);
+	if (records_end < length && contents[length - 1] != '\0') {
+		g_bytes_unref (data);
+		return NULL;
+	}
+
+	index = g_new0 (NemoFrIndex, 1);
+	index->data = data;
+	index->header = header;
+	index->records = (const IndexRecord *) (contents + sizeof (IndexHeader));
+	index->names = contents + records_end;
+	index->names_length = length - records_end;
+
+	return index;
+}
+
+
+static NemoFrIndex *
+load_index (const char *index_path,
+	    guint64     archive_mtime,
+	    guint64     archive_size)
+{
+	GMappedFile *file;
+	GBytes      *data;
+
+	file = g_mapped_file_new (index_path, FALSE, NULL);
+	if (file == NULL)
+		return NULL;
+
+	data = g_mapped_file_get_bytes (file);
+	g_mapped_file_unref (file);
+
+	return index_new (data, archive_mtime, archive_size);
+}
+
+
+static char *
+get_raw_name (const char *archive_path)
+{
+	char *basename = g_path_get_basename (archive_path);
+	char *name = nemo_fr_strip_extension (basename);
+
+	g_free (basename);
+
+	return name;
+}
+
+
+/* Rewriting an archive to the same size within a second has to show */
+static guint64
+get_mtime_ns (const GStatBuf *buf)
+{
+	return (guint64) buf->st_mtime * G_GUINT64_CONSTANT (1000000000) + buf->st_mtim.tv_nsec;
+}
+
+
+static NemoFrIndex *
+build_index (const char    *archive_path,
+	     const char    *index_path,
+	     guint64        archive_mtime,
+	     guint64        archive_size,
+	     GCancellable  *cancellable,
+	     GError       **error)
+{
+	struct archive       *reader;
+	struct archive_entry *entry;
+	GArray               *records;
+	GString              *names;
+	IndexHeader           header;
+	char                 *contents, *dir;
+	gsize                 length;
+	gboolean              ok = TRUE;
+	int                   r;
+
+	reader = nemo_fr_open_archive (archive_path, error);
+	if (reader == NULL)
+		return NULL;
+
+	records = g_array_new (FALSE, FALSE, sizeof (IndexRecord));
+	names = g_string_new (NULL);
+
+	/* Only the headers are read, libarchive skips over the data */
+	while ((r = archive_read_next_header (reader, &entry)) != ARCHIVE_EOF) {
+		IndexRecord  record;
+		const char  *name;
+		char        *raw_name = NULL;
+
+		if (r < ARCHIVE_WARN) {
+			g_set_error_literal (error, G_IO_ERROR,
+					     archive_errno (reader) == ARCHIVE_ERRNO_FILE_FORMAT ?
+					     G_IO_ERROR_NOT_SUPPORTED : G_IO_ERROR_FAILED,
+					     archive_error_string (reader) != NULL ?
+					     archive_error_string (reader) : _("Could not read the archive"));
+			ok = FALSE;
+			break;
+		}
+
+		if (g_cancellable_set_error_if_cancelled (cancellable, error)) {
+			ok = FALSE;
+			break;
+		}
+
+		if (archive_format (reader) == ARCHIVE_FORMAT_RAW) {
+			/* Anything is a raw archive, only take compressed files */
+			if (archive_filter_code (reader, 0) == ARCHIVE_FILTER_NONE) {
+				g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+						     _("Unknown archive type"));
+				ok = FALSE;
+				break;
+			}
+			raw_name = get_raw_name (archive_path);
+		}
+
+		name = raw_name != NULL ? raw_name : archive_entry_pathname (entry);
+		if (name == NULL)
+			name = "";
+
+		if (names->len > G_MAXUINT32 - strlen (name) - 1) {
+			g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+					     _("The archive has too many files"));
+			g_free (raw_name);
+			ok = FALSE;
+			break;
+		}
+
+		record.size = archive_entry_size_is_set (entry) ? archive_entry_size (entry) : 0;
+		record.offset = archive_read_header_position (reader);
+		record.name_offset = names->len;
+		record.mode = archive_entry_mode (entry);
+		g_array_append_val (records, record);
+
+		g_string_append_len (names, name, strlen (name) + 1);
+		g_free (raw_name);
+	}
+
+	archive_read_free (reader);
+
+	if (! ok) {
+		g_array_free (records, TRUE);
+		g_string_free (names, TRUE);
+		return NULL;
+	}
+
+	memset (&header, 0, sizeof (header));
+	memcpy (header.magic, INDEX_MAGIC, sizeof (header.magic));
+	header.archive_mtime = archive_mtime;
+	header.archive_size = archive_size;
+	header.n_entries = records->len;
+
+	length = sizeof (header) + records->len * sizeof (IndexRecord) + names->len;
+	contents = g_malloc (length);
+	memcpy (contents, &header, sizeof (header));
+	memcpy (contents + sizeof (header), records->data, records->len * sizeof (IndexRecord));
+	memcpy (contents + sizeof (header) + records->len * sizeof (IndexRecord), names->str, names->len);
+
+	g_array_free (records, TRUE);
+	g_string_free (names, TRUE);
+
+	/* Without a cache the archive is just read again next time */
+	dir = g_path_get_dirname (index_path);
+	if (g_mkdir_with_parents (dir, 0700) != 0 ||
+	    ! g_file_set_contents (index_path, contents, length, NULL))
+		g_debug ("Could not write %s", index_path);
+	g_free (dir);
+
+	return index_new (g_bytes_new_take (contents, length), archive_mtime, archive_size);
+}
+
+
+static void
+load_thread (GTask        *task,
+	     gpointer      source_object,
+	     gpointer      task_data,
+	     GCancellable *cancellable)
+{
+	GFile       *archive = task_data;
+	NemoFrIndex *index;
+	GError      *error = NULL;
+	char        *archive_path, *index_path;
+	GStatBuf     buf;
+
+	archive_path = g_file_get_path (archive);
+	if (g_stat (archive_path, &buf) != 0) {
+		int saved_errno = errno;
+
+		g_task_return_new_error (task, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+					 "%s: %s", archive_path, g_strerror (saved_errno));
+		g_free (archive_path);
+		return;
+	}
+
+	index_path = get_index_path (archive);
+
+	index = load_index (index_path, get_mtime_ns (&buf), buf.st_size);
+	if (index == NULL)
+		index = build_index (archive_path, index_path, get_mtime_ns (&buf), buf.st_size,
+				     cancellable, &error);
+
+	if (index != NULL)
+		g_task_return_pointer (task, index, (GDestroyNotify) nemo_fr_index_free);
+	else
+		g_task_return_error (task, error);
+
+	g_free (index_path);
+	g_free (archive_path);
+}
+
+
+void
+nemo_fr_index_load_async (GFile               *archive,
+			  GCancellable        *cancellable,
+			  GAsyncReadyCallback  callback,
+			  gpointer             user_data)
+{
+	GTask *task;
+
+	task = g_task_new (NULL, cancellable, callback, user_data);
+	g_task_set_task_data (task, g_object_ref (archive), g_object_unref);
+	g_task_run_in_thread (task, load_thread);
+	g_object_unref (task);
+}
+
+
+NemoFrIndex *
+nemo_fr_index_load_finish (GAsyncResult  *result,
+			   GError       **error)
+{
+	return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+
+void
+nemo_fr_index_free (NemoFrIndex *index)
+{
+	g_bytes_unref (index->data);
+	g_free (index);
+}
+
+
+guint
+nemo_fr_index_get_n_entries (NemoFrIndex *index)
+{
+	return index->header->n_entries;
+}
+
+
+gboolean
+nemo_fr_index_get_entry (NemoFrIndex      *index,
+			 guint             i,
+			 NemoFrIndexEntry *entry)
+{
+	const IndexRecord *record;
+
+	g_return_val_if_fail (i < index->header->n_entries, FALSE);
+
+	record = index->records + i;
+	if (record->name_offset >= index->names_length)
+		return FALSE;
+
+	entry->name = index->names + record->name_offset;
+	entry->size = record->size;
+	entry->offset = record->offset;
+	entry->mode = record->mode;
+
+	return TRUE;
+}
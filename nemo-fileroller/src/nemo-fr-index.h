@@ -0,0 +1,56 @@
+/*
+ *  nemo-fr-index.h
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef NEMO_FR_INDEX_H
+#define NEMO_FR_INDEX_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* The list of entries in an archive, read from a file in the user's
+ * cache.  The file is written the first time the archive is listed, and
+ * used for as long as the archive keeps the same size and mtime.  It is
+ * mapped, so even a huge index costs nothing until it is paged through.
+ */
+typedef struct _NemoFrIndex NemoFrIndex;
+
+typedef struct {
+	const char *name;
+	goffset     size;
+	goffset     offset;   /* of the header, in the uncompressed archive */
+	guint32     mode;
+} NemoFrIndexEntry;
+
+void          nemo_fr_index_load_async   (GFile                *archive,
+					  GCancellable         *cancellable,
+					  GAsyncReadyCallback   callback,
+					  gpointer              user_data);
+NemoFrIndex * nemo_fr_index_load_finish  (GAsyncResult         *result,
+					  GError              **error);
+void          nemo_fr_index_free         (NemoFrIndex          *index);
+
+guint         nemo_fr_index_get_n_entries (NemoFrIndex         *index);
+gboolean      nemo_fr_index_get_entry     (NemoFrIndex         *index,
+					   guint                i,
+					   NemoFrIndexEntry    *entry);
+
+G_END_DECLS
+
+#endif /* NEMO_FR_INDEX_H */
@@ -26,6 +26,7 @@
 #endif
 
 #include "nemo-image-converter.h"
+#include "nemo-image-batch.h"
 
 #include <libintl.h>
 
@@ -36,6 +37,13 @@ void nemo_module_shutdown   (void);
 void nemo_module_list_types (const GType **types,
 				 int          *num_types);
 
+static gboolean
+resume_batches (gpointer user_data)
+{
+	nemo_image_batch_resume_all ();
+
+	return G_SOURCE_REMOVE;
+}
 
 void
 nemo_module_initialize (GTypeModule *module)
@@ -47,6 +55,9 @@ nemo_module_initialize (GTypeModule *module)
 
 	bindtextdomain (GETTEXT_PACKAGE, GNOMELOCALEDIR);
 	bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
+
+	/* Pick up batches left behind when the session ended */
+	g_idle_add (resume_batches, NULL);
 }
 
 void
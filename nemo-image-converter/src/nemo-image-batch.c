@@ -0,0 +1,339 @@
+/*
+ *  nemo-image-batch.c
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+ #include <config.h> /* for GETTEXT_PACKAGE */
+#endif
+
+#include "nemo-image-batch.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib/gi18n.h>
+#include <gio/gio.h>
+#include <gtk/gtk.h>
+
+/* Failed images are listed by name in the summary, up to this many */
+#define MAX_FAILURES_SHOWN 10
+
+/* Progress of a single image, in thousandths */
+#define PROGRESS_DONE 1000
+
+typedef struct {
+	NemoImageJournal *journal;
+	gboolean rotate;
+
+	GSubprocess *queue;
+	GDataInputStream *output;
+
+	gint images_total;
+	gint images_finished;
+	gint64 progress;
+	gint *item_progress;
+	GList *failed;
+
+	GtkWidget *progress_dialog;
+	GtkWidget *progress_bar;
+	GtkWidget *progress_label;
+} NemoImageBatch;
+
+static void
+batch_free (NemoImageBatch *batch)
+{
+	nemo_image_journal_free (batch->journal);
+	g_clear_object (&batch->queue);
+	g_clear_object (&batch->output);
+	g_free (batch->item_progress);
+	g_list_free_full (batch->failed, g_free);
+	g_free (batch);
+}
+
+static gchar *
+item_name (NemoImageBatch *batch, guint index)
+{
+	return g_filename_display_basename (nemo_image_journal_get_item (batch->journal, index)->input);
+}
+
+static void
+update_progress (NemoImageBatch *batch)
+{
+	char *tmp;
+
+	gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (batch->progress_bar),
+		(double) batch->progress / ((gint64) batch->images_total * PROGRESS_DONE));
+	tmp = g_strdup_printf (batch->rotate ? _("Rotating image: %d of %d") : _("Resizing image: %d of %d"),
+		batch->images_finished, batch->images_total);
+	gtk_progress_bar_set_text (GTK_PROGRESS_BAR (batch->progress_bar), tmp);
+	g_free (tmp);
+}
+
+static void
+summary_response_cb (GtkDialog *dialog, gint response_id, gpointer user_data)
+{
+	gtk_widget_destroy (GTK_WIDGET (dialog));
+}
+
+static void
+show_summary (NemoImageBatch *batch)
+{
+	GString *names;
+	GList *l;
+	int n_failed, i;
+
+	n_failed = g_list_length (batch->failed);
+	if (n_failed == 0)
+		return;
+
+	names = g_string_new (NULL);
+	batch->failed = g_list_reverse (batch->failed);
+	for (l = batch->failed, i = 0; l != NULL && i < MAX_FAILURES_SHOWN; l = l->next, i++)
+		g_string_append_printf (names, "%s\n", (char *) l->data);
+	if (n_failed > MAX_FAILURES_SHOWN)
+		g_string_append_printf (names, _("and %d more"), n_failed - MAX_FAILURES_SHOWN);
+
+	GtkWidget *msg_dialog = gtk_message_dialog_new (NULL, 0, GTK_MESSAGE_ERROR, GTK_BUTTONS_CLOSE,
+		batch->rotate ?
+		ngettext ("%d image could not be rotated. Check whether you have permission to write to its folder.",
+		          "%d images could not be rotated. Check whether you have permission to write to their folders.",
+		          n_failed) :
+		ngettext ("%d image could not be resized. Check whether you have permission to write to its folder.",
+		          "%d images could not be resized. Check whether you have permission to write to their folders.",
+		          n_failed),
+		n_failed);
+	gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (msg_dialog), "%s", names->str);
+	g_string_free (names, TRUE);
+
+	g_signal_connect (msg_dialog, "response", G_CALLBACK (summary_response_cb), NULL);
+	gtk_widget_show (msg_dialog);
+}
+
+static void
+progress_response_cb (GtkDialog *dialog, gint response_id, gpointer user_data)
+{
+	NemoImageBatch *batch = user_data;
+	GOutputStream *input;
+
+	if (response_id != GTK_RESPONSE_CANCEL) {
+		/* Closing the window leaves the batch running */
+		gtk_widget_hide (GTK_WIDGET (dialog));
+		return;
+	}
+
+	/* Images already being converted are left to finish */
+	input = g_subprocess_get_stdin_pipe (batch->queue);
+	g_output_stream_write_all (input, "cancel\n", strlen ("cancel\n"), NULL, NULL, NULL);
+	gtk_dialog_set_response_sensitive (dialog, GTK_RESPONSE_CANCEL, FALSE);
+}
+
+static void
+show_progress_dialog (NemoImageBatch *batch)
+{
+	GtkWidget *content_area;
+
+	batch->progress_dialog = gtk_dialog_new_with_buttons (batch->rotate ? _("Rotating images") : _("Resizing images"),
+		NULL, 0, _("_Cancel"), GTK_RESPONSE_CANCEL, NULL);
+	gtk_window_set_default_size (GTK_WINDOW (batch->progress_dialog), 400, -1);
+	gtk_container_set_border_width (GTK_CONTAINER (batch->progress_dialog), 6);
+
+	content_area = gtk_dialog_get_content_area (GTK_DIALOG (batch->progress_dialog));
+	gtk_box_set_spacing (GTK_BOX (content_area), 6);
+
+	batch->progress_label = gtk_label_new (NULL);
+	gtk_label_set_ellipsize (GTK_LABEL (batch->progress_label), PANGO_ELLIPSIZE_MIDDLE);
+	gtk_widget_set_halign (batch->progress_label, GTK_ALIGN_START);
+	gtk_box_pack_start (GTK_BOX (content_area), batch->progress_label, FALSE, FALSE, 0);
+
+	batch->progress_bar = gtk_progress_bar_new ();
+	gtk_progress_bar_set_show_text (GTK_PROGRESS_BAR (batch->progress_bar), TRUE);
+	gtk_box_pack_start (GTK_BOX (content_area), batch->progress_bar, FALSE, FALSE, 0);
+
+	g_signal_connect (batch->progress_dialog, "response",
+			  (GCallback) progress_response_cb, batch);
+	/* The default handler would destroy it under the running batch */
+	g_signal_connect (batch->progress_dialog, "delete-event",
+			  (GCallback) gtk_widget_hide_on_delete, NULL);
+
+	update_progress (batch);
+	gtk_widget_show_all (batch->progress_dialog);
+}
+
+static void
+set_item_progress (NemoImageBatch *batch, guint index, gint progress)
+{
+	batch->progress += progress - batch->item_progress[index];
+	batch->item_progress[index] = progress;
+}
+
+static void
+handle_line (NemoImageBatch *batch, gchar *line)
+{
+	gchar **fields;
+	guint64 index;
+	guint n_items;
+	char *name, *tmp;
+
+	fields = g_strsplit (line, "\t", 3);
+	n_items = nemo_image_journal_get_n_items (batch->journal);
+
+	if (fields[0] == NULL)
+		goto out;
+
+	if (strcmp (fields[0], "total") == 0 && fields[1] != NULL && fields[2] != NULL) {
+		/* Only sent once the queue got hold of the journal */
+		batch->images_total = n_items;
+		batch->images_finished = MIN (atoi (fields[2]), (gint) n_items);
+		batch->progress = (gint64) batch->images_finished * PROGRESS_DONE;
+		batch->item_progress = g_new0 (gint, n_items);
+		if (batch->images_finished < batch->images_total)
+			show_progress_dialog (batch);
+		goto out;
+	}
+
+	if (batch->progress_dialog == NULL || fields[1] == NULL || n_items == 0 ||
+	    !g_ascii_string_to_unsigned (fields[1], 10, 0, n_items - 1, &index, NULL))
+		goto out;
+
+	if (strcmp (fields[0], "start") == 0) {
+		set_item_progress (batch, index, 1);
+		name = item_name (batch, index);
+		tmp = g_markup_printf_escaped (batch->rotate ? _("<i>Rotating \"%s\"</i>") : _("<i>Resizing \"%s\"</i>"), name);
+		gtk_label_set_markup (GTK_LABEL (batch->progress_label), tmp);
+		g_free (tmp);
+		g_free (name);
+	} else if (strcmp (fields[0], "progress") == 0 && fields[2] != NULL) {
+		set_item_progress (batch, index, CLAMP (atoi (fields[2]), 1, PROGRESS_DONE - 1));
+	} else if (strcmp (fields[0], "done") == 0) {
+		set_item_progress (batch, index, PROGRESS_DONE);
+		batch->images_finished++;
+	} else if (strcmp (fields[0], "failed") == 0) {
+		gchar *message = g_strcompress (fields[2] != NULL ? fields[2] : "");
+
+		set_item_progress (batch, index, PROGRESS_DONE);
+		batch->images_finished++;
+
+		name = item_name (batch, index);
+		batch->failed = g_list_prepend (batch->failed, g_strdup_printf ("%s: %s", name, message));
+		g_free (name);
+		g_free (message);
+	}
+
+	update_progress (batch);
+
+out:
+	g_strfreev (fields);
+}
+
+static void
+read_line_cb (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+	NemoImageBatch *batch = user_data;
+	gchar *line;
+
+	line = g_data_input_stream_read_line_finish (batch->output, result, NULL, NULL);
+
+	if (line != NULL) {
+		handle_line (batch, line);
+		g_free (line);
+		g_data_input_stream_read_line_async (batch->output, G_PRIORITY_DEFAULT, NULL, read_line_cb, batch);
+		return;
+	}
+
+	/* The queue has exited */
+	if (batch->progress_dialog != NULL)
+		gtk_widget_destroy (batch->progress_dialog);
+
+	show_summary (batch);
+	batch_free (batch);
+}
+
+static void
+show_error (const gchar *message)
+{
+	GtkWidget *msg_dialog = gtk_message_dialog_new (NULL, 0, GTK_MESSAGE_ERROR, GTK_BUTTONS_CLOSE,
+		"%s", _("The images could not be converted."));
+	gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (msg_dialog), "%s", message);
+	g_signal_connect (msg_dialog, "response", G_CALLBACK (summary_response_cb), NULL);
+	gtk_widget_show (msg_dialog);
+}
+
+void
+nemo_image_batch_run (NemoImageJournal *journal)
+{
+	NemoImageBatch *batch;
+	GError *error = NULL;
+
+	/* Everything has to be on disk before anything is touched */
+	if (!nemo_image_journal_sync (journal, &error)) {
+		show_error (error->message);
+		g_error_free (error);
+		nemo_image_journal_remove (journal);
+		nemo_image_journal_free (journal);
+		return;
+	}
+
+	batch = g_new0 (NemoImageBatch, 1);
+	batch->journal = journal;
+	batch->rotate = g_strcmp0 (nemo_image_journal_get (journal, "operation"), "rotate") == 0;
+
+	batch->queue = g_subprocess_new (G_SUBPROCESS_FLAGS_STDIN_PIPE | G_SUBPROCESS_FLAGS_STDOUT_PIPE, &error,
+		NEMO_IMAGE_CONVERTER_QUEUE, nemo_image_journal_get_path (journal), NULL);
+	if (batch->queue == NULL) {
+		show_error (error->message);
+		g_error_free (error);
+		nemo_image_journal_remove (journal);
+		batch_free (batch);
+		return;
+	}
+
+	batch->output = g_data_input_stream_new (g_subprocess_get_stdout_pipe (batch->queue));
+	g_data_input_stream_read_line_async (batch->output, G_PRIORITY_DEFAULT, NULL, read_line_cb, batch);
+}
+
+void
+nemo_image_batch_resume_all (void)
+{
+	gchar *dir;
+	GDir *queue_dir;
+	const gchar *name;
+
+	dir = nemo_image_journal_get_dir ();
+	queue_dir = g_dir_open (dir, 0, NULL);
+
+	if (queue_dir != NULL) {
+		while ((name = g_dir_read_name (queue_dir)) != NULL) {
+			NemoImageJournal *journal;
+			gchar *path;
+
+			if (!g_str_has_suffix (name, ".journal"))
+				continue;
+
+			/* A queue that is still running just exits again */
+			path = g_build_filename (dir, name, NULL);
+			journal = nemo_image_journal_open (path, NULL);
+			if (journal != NULL)
+				nemo_image_batch_run (journal);
+			g_free (path);
+		}
+
+		g_dir_close (queue_dir);
+	}
+
+	g_free (dir);
+}
@@ -0,0 +1,36 @@
+/*
+ *  nemo-image-batch.h
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#ifndef NEMO_IMAGE_BATCH_H
+#define NEMO_IMAGE_BATCH_H
+
+#include "nemo-image-journal.h"
+
+G_BEGIN_DECLS
+
+/* Hands the journal to nemo-image-converter-queue and shows its progress.
+ * Takes ownership of the journal. */
+void nemo_image_batch_run        (NemoImageJournal *journal);
+
+/* Restarts batches whose queue process went away before finishing */
+void nemo_image_batch_resume_all (void);
+
+G_END_DECLS
+
+#endif /* NEMO_IMAGE_BATCH_H */
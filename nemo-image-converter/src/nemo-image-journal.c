@@ -0,0 +1,339 @@
+/*
+ *  nemo-image-journal.c
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+ #include <config.h>
+#endif
+
+#include "nemo-image-journal.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+
+/* Lines are tab separated, with g_strescape()d fields:
+ *
+ *   set	KEY	VALUE
+ *   item	INPUT	OUTPUT
+ *   state	INDEX	pending|writing|converted|done|failed
+ */
+
+static const gchar *state_names[] = {
+	"pending",
+	"writing",
+	"converted",
+	"done",
+	"failed",
+};
+
+struct _NemoImageJournal {
+	gchar *path;
+	FILE *file;
+	gboolean torn;
+	GMutex lock;
+
+	GHashTable *settings;
+	GPtrArray *items;
+};
+
+static void
+item_free (NemoImageJournalItem *item)
+{
+	g_free (item->input);
+	g_free (item->output);
+	g_free (item);
+}
+
+static NemoImageJournal *
+journal_new (const gchar *path, FILE *file)
+{
+	NemoImageJournal *journal = g_new0 (NemoImageJournal, 1);
+
+	journal->path = g_strdup (path);
+	journal->file = file;
+	g_mutex_init (&journal->lock);
+	journal->settings = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	journal->items = g_ptr_array_new_with_free_func ((GDestroyNotify) item_free);
+
+	return journal;
+}
+
+static void
+write_line (NemoImageJournal *journal, const gchar *kind, const gchar *first, const gchar *second)
+{
+	gchar *escaped_first = g_strescape (first, NULL);
+	gchar *escaped_second = g_strescape (second, NULL);
+
+	fprintf (journal->file, "%s\t%s\t%s\n", kind, escaped_first, escaped_second);
+
+	g_free (escaped_first);
+	g_free (escaped_second);
+}
+
+gchar *
+nemo_image_journal_get_dir (void)
+{
+	return g_build_filename (g_get_user_data_dir (), "nemo-image-converter", "queue", NULL);
+}
+
+NemoImageJournal *
+nemo_image_journal_new (GError **error)
+{
+	gchar *dir, *path;
+	FILE *file;
+	int fd;
+
+	dir = nemo_image_journal_get_dir ();
+	if (g_mkdir_with_parents (dir, 0700) != 0) {
+		int saved_errno = errno;
+		g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+		             "%s: %s", dir, g_strerror (saved_errno));
+		g_free (dir);
+		return NULL;
+	}
+
+	path = g_build_filename (dir, "batch-XXXXXX.journal", NULL);
+	g_free (dir);
+
+	fd = g_mkstemp (path);
+	if (fd < 0 || (file = fdopen (fd, "a")) == NULL) {
+		int saved_errno = errno;
+		g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+		             "%s: %s", path, g_strerror (saved_errno));
+		if (fd >= 0)
+			close (fd);
+		g_free (path);
+		return NULL;
+	}
+
+	NemoImageJournal *journal = journal_new (path, file);
+	g_free (path);
+
+	return journal;
+}
+
+static gboolean
+parse_line (NemoImageJournal *journal, gchar *line)
+{
+	gchar **fields;
+	gchar *first, *second;
+	guint64 index;
+	guint i;
+	gboolean ok = FALSE;
+
+	fields = g_strsplit (line, "\t", 3);
+	if (g_strv_length (fields) != 3) {
+		g_strfreev (fields);
+		return FALSE;
+	}
+
+	first = g_strcompress (fields[1]);
+	second = g_strcompress (fields[2]);
+
+	if (strcmp (fields[0], "set") == 0) {
+		g_hash_table_replace (journal->settings, first, second);
+		first = second = NULL;
+		ok = TRUE;
+	} else if (strcmp (fields[0], "item") == 0) {
+		NemoImageJournalItem *item = g_new0 (NemoImageJournalItem, 1);
+		item->input = first;
+		item->output = second;
+		item->state = NEMO_IMAGE_JOURNAL_PENDING;
+		g_ptr_array_add (journal->items, item);
+		first = second = NULL;
+		ok = TRUE;
+	} else if (strcmp (fields[0], "state") == 0 && journal->items->len > 0 &&
+	           g_ascii_string_to_unsigned (first, 10, 0, journal->items->len - 1, &index, NULL)) {
+		for (i = 0; i < G_N_ELEMENTS (state_names); i++) {
+			if (strcmp (second, state_names[i]) == 0) {
+				NemoImageJournalItem *item = g_ptr_array_index (journal->items, index);
+				item->state = i;
+				ok = TRUE;
+			}
+		}
+	}
+
+	g_free (first);
+	g_free (second);
+	g_strfreev (fields);
+
+	return ok;
+}
+
+NemoImageJournal *
+nemo_image_journal_open (const gchar *path, GError **error)
+{
+	NemoImageJournal *journal;
+	gchar *contents, *line, *end;
+	gsize length;
+	FILE *file;
+
+	if (!g_file_get_contents (path, &contents, &length, error))
+		return NULL;
+
+	file = g_fopen (path, "a");
+	if (file == NULL) {
+		int saved_errno = errno;
+		g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+		             "%s: %s", path, g_strerror (saved_errno));
+		g_free (contents);
+		return NULL;
+	}
+
+	journal = journal_new (path, file);
+
+	/* A line without its newline was cut short by a crash, and is ignored */
+	for (line = contents; (end = strchr (line, '\n')) != NULL; line = end + 1) {
+		*end = '\0';
+		if (!parse_line (journal, line))
+			g_warning ("Ignoring malformed line in %s: %s", path, line);
+	}
+	journal->torn = *line != '\0';
+
+	g_free (contents);
+
+	return journal;
+}
+
+void
+nemo_image_journal_free (NemoImageJournal *journal)
+{
+	if (journal->file != NULL)
+		fclose (journal->file);
+
+	g_mutex_clear (&journal->lock);
+	g_hash_table_destroy (journal->settings);
+	g_ptr_array_free (journal->items, TRUE);
+	g_free (journal->path);
+	g_free (journal);
+}
+
+const gchar *
+nemo_image_journal_get_path (NemoImageJournal *journal)
+{
+	return journal->path;
+}
+
+gboolean
+nemo_image_journal_lock (NemoImageJournal *journal)
+{
+	/* Released when the process exits, however that happens */
+	if (flock (fileno (journal->file), LOCK_EX | LOCK_NB) != 0)
+		return FALSE;
+
+	/* Only the holder of the lock writes, so now the next line can be
+	 * started on a fresh one */
+	if (journal->torn) {
+		fputc ('\n', journal->file);
+		journal->torn = FALSE;
+	}
+
+	return TRUE;
+}
+
+gboolean
+nemo_image_journal_sync (NemoImageJournal *journal, GError **error)
+{
+	gboolean ok = TRUE;
+
+	g_mutex_lock (&journal->lock);
+
+	if (fflush (journal->file) != 0 || fsync (fileno (journal->file)) != 0) {
+		int saved_errno = errno;
+		g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+		             "%s: %s", journal->path, g_strerror (saved_errno));
+		ok = FALSE;
+	}
+
+	g_mutex_unlock (&journal->lock);
+
+	return ok;
+}
+
+void
+nemo_image_journal_remove (NemoImageJournal *journal)
+{
+	g_unlink (journal->path);
+}
+
+void
+nemo_image_journal_set (NemoImageJournal *journal, const gchar *key, const gchar *value)
+{
+	g_return_if_fail (journal->items->len == 0);
+
+	g_hash_table_replace (journal->settings, g_strdup (key), g_strdup (value));
+	write_line (journal, "set", key, value);
+}
+
+const gchar *
+nemo_image_journal_get (NemoImageJournal *journal, const gchar *key)
+{
+	return g_hash_table_lookup (journal->settings, key);
+}
+
+void
+nemo_image_journal_add_item (NemoImageJournal *journal, const gchar *input, const gchar *output)
+{
+	NemoImageJournalItem *item = g_new0 (NemoImageJournalItem, 1);
+
+	item->input = g_strdup (input);
+	item->output = g_strdup (output);
+	item->state = NEMO_IMAGE_JOURNAL_PENDING;
+	g_ptr_array_add (journal->items, item);
+
+	write_line (journal, "item", input, output);
+}
+
+guint
+nemo_image_journal_get_n_items (NemoImageJournal *journal)
+{
+	return journal->items->len;
+}
+
+NemoImageJournalItem *
+nemo_image_journal_get_item (NemoImageJournal *journal, guint index)
+{
+	g_return_val_if_fail (index < journal->items->len, NULL);
+
+	return g_ptr_array_index (journal->items, index);
+}
+
+void
+nemo_image_journal_set_state (NemoImageJournal *journal, guint index, NemoImageJournalState state)
+{
+	NemoImageJournalItem *item = nemo_image_journal_get_item (journal, index);
+	gchar *number;
+
+	g_mutex_lock (&journal->lock);
+
+	item->state = state;
+
+	number = g_strdup_printf ("%u", index);
+	write_line (journal, "state", number, state_names[state]);
+	g_free (number);
+
+	if (fflush (journal->file) != 0)
+		g_warning ("Could not update %s: %s", journal->path, g_strerror (errno));
+
+	g_mutex_unlock (&journal->lock);
+}
@@ -0,0 +1,83 @@
+/*
+ *  nemo-image-journal.h
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#ifndef NEMO_IMAGE_JOURNAL_H
+#define NEMO_IMAGE_JOURNAL_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* A batch of conversions written down before any of them is run, so
+ * nemo-image-converter-queue can pick it up again after a crash.  The
+ * file is append-only: the settings and items come first, then one line
+ * for each change of state.
+ */
+typedef struct _NemoImageJournal NemoImageJournal;
+
+typedef enum {
+	NEMO_IMAGE_JOURNAL_PENDING,
+	NEMO_IMAGE_JOURNAL_WRITING,   /* the output didn't exist, so it is the job's own */
+	NEMO_IMAGE_JOURNAL_CONVERTED, /* output written but not yet moved over the input */
+	NEMO_IMAGE_JOURNAL_DONE,
+	NEMO_IMAGE_JOURNAL_FAILED
+} NemoImageJournalState;
+
+typedef struct {
+	gchar *input;
+	gchar *output;
+	NemoImageJournalState state;
+} NemoImageJournalItem;
+
+gchar                *nemo_image_journal_get_dir     (void);
+
+NemoImageJournal     *nemo_image_journal_new         (GError               **error);
+NemoImageJournal     *nemo_image_journal_open        (const gchar           *path,
+                                                      GError               **error);
+void                  nemo_image_journal_free        (NemoImageJournal      *journal);
+
+const gchar          *nemo_image_journal_get_path    (NemoImageJournal      *journal);
+gboolean              nemo_image_journal_lock        (NemoImageJournal      *journal);
+gboolean              nemo_image_journal_sync        (NemoImageJournal      *journal,
+                                                      GError               **error);
+void                  nemo_image_journal_remove      (NemoImageJournal      *journal);
+
+/* Settings and items can only be added to a new journal */
+void                  nemo_image_journal_set         (NemoImageJournal      *journal,
+                                                      const gchar           *key,
+                                                      const gchar           *value);
+const gchar          *nemo_image_journal_get         (NemoImageJournal      *journal,
+                                                      const gchar           *key);
+void                  nemo_image_journal_add_item    (NemoImageJournal      *journal,
+                                                      const gchar           *input,
+                                                      const gchar           *output);
+
+guint                 nemo_image_journal_get_n_items (NemoImageJournal      *journal);
+NemoImageJournalItem *nemo_image_journal_get_item    (NemoImageJournal      *journal,
+                                                      guint                  index);
+
+/* Thread safe; the line is written out before it returns, so it survives
+ * the process crashing */
+void                  nemo_image_journal_set_state   (NemoImageJournal      *journal,
+                                                      guint                  index,
+                                                      NemoImageJournalState  state);
+
+G_END_DECLS
+
+#endif /* NEMO_IMAGE_JOURNAL_H */
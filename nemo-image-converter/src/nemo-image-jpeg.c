@@ -0,0 +1,866 @@
+/*
+ *  nemo-image-jpeg.c
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+ #include <config.h> /* for GETTEXT_PACKAGE */
+#endif
+
+#include "nemo-image-jpeg.h"
+
+#include <errno.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+
+#include <jpeglib.h>
+
+#define EXIF_ORIENTATION_TAG 0x0112
+#define EXIF_THUMBNAIL_OFFSET_TAG 0x0201
+#define EXIF_THUMBNAIL_LENGTH_TAG 0x0202
+#define EXIF_TYPE_SHORT 3
+
+#define JPEG_SOI 0xd8
+#define JPEG_SOS 0xda
+#define JPEG_DQT 0xdb
+#define JPEG_APP1 (JPEG_APP0 + 1)
+#define JPEG_APP2 (JPEG_APP0 + 2)
+
+static const guchar exif_header[] = { 'E', 'x', 'i', 'f', 0, 0 };
+static const gchar xmp_header[] = "http://ns.adobe.com/xap/1.0/";
+static const gchar icc_header[] = "ICC_PROFILE";
+
+/* The luminance table of the JPEG standard, which libjpeg scales for
+ * the quality it is given */
+static const guint std_luminance_quant_tbl[DCTSIZE2] = {
+	16,  11,  10,  16,  24,  40,  51,  61,
+	12,  12,  14,  19,  26,  58,  60,  55,
+	14,  13,  16,  24,  40,  57,  69,  56,
+	14,  17,  22,  29,  51,  87,  80,  62,
+	18,  22,  37,  56,  68, 109, 103,  77,
+	24,  35,  55,  64,  81, 104, 113,  92,
+	49,  64,  78,  87, 103, 121, 120, 101,
+	72,  92,  95,  98, 112, 100, 103,  99
+};
+
+/* The EXIF orientation that shows an image tagged with orientation
+ * turned a further degrees clockwise.  Mirrored orientations stay
+ * mirrored: the eight of them make up the symmetries of the square. */
+static guint
+orientation_turn (guint orientation, gint degrees)
+{
+	static const guchar turns[8][4] = {
+		{ 1, 6, 3, 8 },
+		{ 2, 7, 4, 5 },
+		{ 3, 8, 1, 6 },
+		{ 4, 5, 2, 7 },
+		{ 5, 2, 7, 4 },
+		{ 6, 3, 8, 1 },
+		{ 7, 4, 5, 2 },
+		{ 8, 1, 6, 3 }
+	};
+
+	if (orientation < 1 || orientation > 8)
+		orientation = 1;
+
+	return turns[orientation - 1][(degrees / 90) & 3];
+}
+
+gboolean
+nemo_image_jpeg_is_jpeg (const gchar *filename)
+{
+	guchar magic[3];
+	gboolean is_jpeg = FALSE;
+	FILE *f;
+
+	f = g_fopen (filename, "rb");
+	if (f == NULL)
+		return FALSE;
+
+	if (fread (magic, 1, sizeof (magic), f) == sizeof (magic))
+		is_jpeg = magic[0] == 0xff && magic[1] == JPEG_SOI && magic[2] == 0xff;
+
+	fclose (f);
+
+	return is_jpeg;
+}
+
+static gsize
+read16 (const guchar *p, gboolean big_endian)
+{
+	return big_endian ? (p[0] << 8 | p[1]) : (p[1] << 8 | p[0]);
+}
+
+static gsize
+read32 (const guchar *p, gboolean big_endian)
+{
+	return big_endian ? ((gsize) p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3])
+	                  : ((gsize) p[3] << 24 | p[2] << 16 | p[1] << 8 | p[0]);
+}
+
+/* Finds the start of the TIFF data in an EXIF block, and its byte order */
+static const guchar *
+exif_get_tiff (const guchar *data, gsize length, gsize *tiff_length, gboolean *big_endian)
+{
+	const guchar *tiff;
+
+	if (length < sizeof (exif_header) + 8 || memcmp (data, exif_header, sizeof (exif_header)) != 0)
+		return NULL;
+
+	tiff = data + sizeof (exif_header);
+	*tiff_length = length - sizeof (exif_header);
+
+	if (tiff[0] == 'M' && tiff[1] == 'M')
+		*big_endian = TRUE;
+	else if (tiff[0] == 'I' && tiff[1] == 'I')
+		*big_endian = FALSE;
+	else
+		return NULL;
+
+	return tiff;
+}
+
+/* Returns the offset of the entry for tag in the IFD at ifd, or 0.  The
+ * offset of the next IFD goes to *next_ifd if it isn't NULL. */
+static gsize
+exif_find_entry (const guchar *tiff, gsize tiff_length, gboolean big_endian,
+                 gsize ifd, guint tag, gsize *next_ifd)
+{
+	gsize n_entries, i, entry = 0;
+
+	if (next_ifd != NULL)
+		*next_ifd = 0;
+
+	if (ifd == 0 || ifd + 2 > tiff_length)
+		return 0;
+
+	n_entries = read16 (tiff + ifd, big_endian);
+	for (i = 0; i < n_entries; i++) {
+		if (ifd + 2 + (i + 1) * 12 > tiff_length)
+			return entry;
+
+		if (entry == 0 && read16 (tiff + ifd + 2 + i * 12, big_endian) == tag)
+			entry = ifd + 2 + i * 12;
+	}
+
+	if (next_ifd != NULL && ifd + 2 + n_entries * 12 + 4 <= tiff_length)
+		*next_ifd = read32 (tiff + ifd + 2 + n_entries * 12, big_endian);
+
+	return entry;
+}
+
+/* Returns the position of the orientation value inside the TIFF data of
+ * an EXIF block, or 0 if there isn't one.  *big_endian tells how to
+ * write it back.
+ */
+static gsize
+exif_find_orientation (const guchar *data, gsize length, gboolean *big_endian)
+{
+	const guchar *tiff;
+	gsize tiff_length, entry;
+
+	tiff = exif_get_tiff (data, length, &tiff_length, big_endian);
+	if (tiff == NULL)
+		return 0;
+
+	entry = exif_find_entry (tiff, tiff_length, *big_endian, read32 (tiff + 4, *big_endian),
+	                         EXIF_ORIENTATION_TAG, NULL);
+	if (entry == 0 || read16 (tiff + entry + 2, *big_endian) != EXIF_TYPE_SHORT)
+		return 0;
+
+	return sizeof (exif_header) + entry + 8;
+}
+
+/* Reads the EXIF segment of a JPEG file, without reading any further */
+static guchar *
+read_exif (const gchar *filename, gsize *length)
+{
+	guchar header[4];
+	guchar *data = NULL;
+	gsize segment_length;
+	FILE *f;
+
+	f = g_fopen (filename, "rb");
+	if (f == NULL)
+		return NULL;
+
+	if (fread (header, 1, 2, f) != 2 || header[0] != 0xff || header[1] != JPEG_SOI)
+		goto out;
+
+	while (fread (header, 1, sizeof (header), f) == sizeof (header) && header[0] == 0xff) {
+		if (header[1] == JPEG_EOI || header[1] == JPEG_SOS)
+			break;
+
+		segment_length = header[2] << 8 | header[3];
+		if (segment_length < 2)
+			break;
+
+		if (header[1] == JPEG_APP1 && segment_length >= 2 + sizeof (exif_header)) {
+			data = g_malloc (segment_length - 2);
+			if (fread (data, 1, segment_length - 2, f) == segment_length - 2 &&
+			    memcmp (data, exif_header, sizeof (exif_header)) == 0) {
+				*length = segment_length - 2;
+				break;
+			}
+			g_clear_pointer (&data, g_free);
+		} else if (fseek (f, segment_length - 2, SEEK_CUR) != 0) {
+			break;
+		}
+	}
+
+out:
+	fclose (f);
+
+	return data;
+}
+
+guint
+nemo_image_jpeg_get_orientation (const gchar *filename)
+{
+	guchar *exif;
+	gsize length, offset;
+	gboolean big_endian;
+	guint orientation = 1;
+
+	exif = read_exif (filename, &length);
+	if (exif == NULL)
+		return 1;
+
+	offset = exif_find_orientation (exif, length, &big_endian);
+	if (offset != 0)
+		orientation = read16 (exif + offset, big_endian);
+	g_free (exif);
+
+	return orientation >= 1 && orientation <= 8 ? orientation : 1;
+}
+
+GBytes *
+nemo_image_jpeg_get_exif_thumbnail (const gchar *filename)
+{
+	const guchar *tiff;
+	guchar *exif;
+	gsize length, tiff_length, ifd1, entry, start, size;
+	gboolean big_endian;
+	GBytes *thumbnail = NULL;
+
+	exif = read_exif (filename, &length);
+	if (exif == NULL)
+		return NULL;
+
+	tiff = exif_get_tiff (exif, length, &tiff_length, &big_endian);
+	if (tiff == NULL)
+		goto out;
+
+	/* IFD1 describes the thumbnail */
+	exif_find_entry (tiff, tiff_length, big_endian, read32 (tiff + 4, big_endian), 0, &ifd1);
+
+	entry = exif_find_entry (tiff, tiff_length, big_endian, ifd1, EXIF_THUMBNAIL_OFFSET_TAG, NULL);
+	if (entry == 0)
+		goto out;
+	start = read32 (tiff + entry + 8, big_endian);
+
+	entry = exif_find_entry (tiff, tiff_length, big_endian, ifd1, EXIF_THUMBNAIL_LENGTH_TAG, NULL);
+	if (entry == 0)
+		goto out;
+	size = read32 (tiff + entry + 8, big_endian);
+
+	if (size > 0 && start < tiff_length && size <= tiff_length - start)
+		thumbnail = g_bytes_new (tiff + start, size);
+
+out:
+	g_free (exif);
+
+	return thumbnail;
+}
+
+/* Undoes libjpeg's quality scaling on the luminance table, the way
+ * convert estimates the quality of its input */
+static gint
+quality_from_table (const guchar *data, gsize length)
+{
+	guint64 sum = 0, std_sum = 0;
+	gsize i, table_size;
+	gboolean wide;
+	gdouble scale;
+
+	while (length > 0) {
+		wide = data[0] >> 4 != 0;
+		table_size = 1 + DCTSIZE2 * (wide ? 2 : 1);
+		if (length < table_size)
+			return 0;
+
+		if ((data[0] & 0x0f) == 0) {
+			for (i = 0; i < DCTSIZE2; i++) {
+				sum += wide ? (data[1 + 2 * i] << 8 | data[2 + 2 * i]) : data[1 + i];
+				std_sum += std_luminance_quant_tbl[i];
+			}
+
+			scale = sum * 100.0 / std_sum;
+			if (scale <= 100)
+				return CLAMP ((gint) ((200 - scale) / 2 + 0.5), 1, 100);
+			return CLAMP ((gint) (5000 / scale + 0.5), 1, 100);
+		}
+
+		data += table_size;
+		length -= table_size;
+	}
+
+	return 0;
+}
+
+void
+nemo_image_jpeg_get_metadata (const gchar *filename,
+                              gboolean *has_exif,
+                              gboolean *has_icc_profile,
+                              gint *quality)
+{
+	guchar header[4];
+	guchar *data;
+	gsize segment_length;
+	FILE *f;
+
+	*has_exif = FALSE;
+	*has_icc_profile = FALSE;
+	*quality = 0;
+
+	f = g_fopen (filename, "rb");
+	if (f == NULL)
+		return;
+
+	if (fread (header, 1, 2, f) != 2 || header[0] != 0xff || header[1] != JPEG_SOI)
+		goto out;
+
+	while (fread (header, 1, sizeof (header), f) == sizeof (header) && header[0] == 0xff) {
+		if (header[1] == JPEG_EOI || header[1] == JPEG_SOS)
+			break;
+
+		segment_length = header[2] << 8 | header[3];
+		if (segment_length < 2)
+			break;
+
+		if (header[1] != JPEG_APP1 && header[1] != JPEG_APP2 && header[1] != JPEG_DQT) {
+			if (fseek (f, segment_length - 2, SEEK_CUR) != 0)
+				break;
+			continue;
+		}
+
+		data = g_malloc (segment_length - 2);
+		if (fread (data, 1, segment_length - 2, f) != segment_length - 2) {
+			g_free (data);
+			break;
+		}
+
+		if (header[1] == JPEG_APP1) {
+			if ((segment_length - 2 >= sizeof (exif_header) &&
+			     memcmp (data, exif_header, sizeof (exif_header)) == 0) ||
+			    (segment_length - 2 >= sizeof (xmp_header) &&
+			     memcmp (data, xmp_header, sizeof (xmp_header)) == 0))
+				*has_exif = TRUE;
+		} else if (header[1] == JPEG_APP2) {
+			if (segment_length - 2 >= sizeof (icc_header) &&
+			    memcmp (data, icc_header, sizeof (icc_header)) == 0)
+				*has_icc_profile = TRUE;
+		} else if (*quality == 0) {
+			*quality = quality_from_table (data, segment_length - 2);
+		}
+
+		g_free (data);
+	}
+
+out:
+	fclose (f);
+}
+
+static void
+exif_write_orientation (guchar *data, gsize offset, gboolean big_endian, guint orientation)
+{
+	data[offset] = big_endian ? 0 : orientation;
+	data[offset + 1] = big_endian ? orientation : 0;
+}
+
+/* A big endian EXIF block holding nothing but the orientation */
+static guchar *
+exif_new_orientation (guint orientation, gsize *length)
+{
+	static const guchar template[] = {
+		'E', 'x', 'i', 'f', 0, 0,
+		'M', 'M', 0, 42, 0, 0, 0, 8,          /* TIFF header, IFD0 follows */
+		0, 1,                                 /* one entry */
+		0x01, 0x12, 0, EXIF_TYPE_SHORT,       /* orientation, SHORT */
+		0, 0, 0, 1, 0, 0, 0, 0,               /* count 1, value */
+		0, 0, 0, 0                            /* no IFD1 */
+	};
+	guchar *data = g_malloc (sizeof (template));
+
+	memcpy (data, template, sizeof (template));
+
+	exif_write_orientation (data, 24, TRUE, orientation);
+	*length = sizeof (template);
+
+	return data;
+}
+
+gboolean
+nemo_image_jpeg_set_orientation (const gchar *src, const gchar *dest, gint degrees, GError **error)
+{
+	gchar *contents;
+	gsize length, pos, insert_at, offset;
+	gboolean big_endian, ok;
+
+	if (!g_file_get_contents (src, &contents, &length, error))
+		return FALSE;
+
+	if (length < 4 || (guchar) contents[0] != 0xff || (guchar) contents[1] != JPEG_SOI) {
+		g_free (contents);
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, _("Not a JPEG image"));
+		return FALSE;
+	}
+
+	/* Walk the header segments looking for EXIF; a new one goes right
+	 * after SOI, or after the JFIF segment which has to come first */
+	pos = 2;
+	insert_at = 2;
+
+	while (pos + 4 <= length && (guchar) contents[pos] == 0xff) {
+		guchar marker = contents[pos + 1];
+		gsize segment_length = ((guchar) contents[pos + 2] << 8) | (guchar) contents[pos + 3];
+
+		if (marker == JPEG_EOI || marker == JPEG_SOS || pos + 2 + segment_length > length)
+			break;
+
+		if (marker == JPEG_APP1) {
+			offset = exif_find_orientation ((guchar *) contents + pos + 4, segment_length - 2, &big_endian);
+			if (offset != 0) {
+				guchar *exif = (guchar *) contents + pos + 4;
+
+				exif_write_orientation (exif, offset, big_endian,
+				                        orientation_turn (read16 (exif + offset, big_endian), degrees));
+				ok = g_file_set_contents (dest, contents, length, error);
+				g_free (contents);
+				return ok;
+			}
+			if (segment_length >= 2 + sizeof (exif_header) &&
+			    memcmp (contents + pos + 4, exif_header, sizeof (exif_header)) == 0) {
+				/* Adding a tag would mean rewriting every offset in it */
+				g_free (contents);
+				g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+				             _("The EXIF data has no orientation"));
+				return FALSE;
+			}
+		} else if (marker == JPEG_APP0 && pos == 2) {
+			insert_at = pos + 2 + segment_length;
+		}
+
+		pos += 2 + segment_length;
+	}
+
+	/* No EXIF at all, add a minimal block */
+	GString *out = g_string_sized_new (length + 64);
+	guchar *exif;
+	gsize exif_length;
+
+	exif = exif_new_orientation (orientation_turn (1, degrees), &exif_length);
+
+	g_string_append_len (out, contents, insert_at);
+	g_string_append_c (out, (gchar) 0xff);
+	g_string_append_c (out, (gchar) JPEG_APP1);
+	g_string_append_c (out, (gchar) ((exif_length + 2) >> 8));
+	g_string_append_c (out, (gchar) ((exif_length + 2) & 0xff));
+	g_string_append_len (out, (gchar *) exif, exif_length);
+	g_string_append_len (out, contents + insert_at, length - insert_at);
+
+	ok = g_file_set_contents (dest, out->str, out->len, error);
+
+	g_free (exif);
+	g_string_free (out, TRUE);
+	g_free (contents);
+
+	return ok;
+}
+
+/* Whether a header segment is one convert would carry over */
+static gboolean
+is_metadata_segment (guchar marker, const guchar *data, gsize length)
+{
+	if (marker == JPEG_APP1)
+		return (length >= sizeof (exif_header) && memcmp (data, exif_header, sizeof (exif_header)) == 0) ||
+		       (length >= sizeof (xmp_header) && memcmp (data, xmp_header, sizeof (xmp_header)) == 0);
+
+	return marker == JPEG_APP2 && length >= sizeof (icc_header) &&
+	       memcmp (data, icc_header, sizeof (icc_header)) == 0;
+}
+
+gboolean
+nemo_image_jpeg_copy_metadata (const gchar *src, const gchar *dest, GError **error)
+{
+	GString *segments, *out;
+	guchar header[4];
+	guchar *data;
+	gchar *contents;
+	gsize segment_length, length, insert_at, offset;
+	gboolean big_endian, ok;
+	FILE *f;
+
+	f = g_fopen (src, "rb");
+	if (f == NULL) {
+		int saved_errno = errno;
+		g_set_error_literal (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno), g_strerror (saved_errno));
+		return FALSE;
+	}
+
+	segments = g_string_new (NULL);
+
+	if (fread (header, 1, 2, f) != 2 || header[0] != 0xff || header[1] != JPEG_SOI)
+		goto read_done;
+
+	while (fread (header, 1, sizeof (header), f) == sizeof (header) && header[0] == 0xff) {
+		if (header[1] == JPEG_EOI || header[1] == JPEG_SOS)
+			break;
+
+		segment_length = header[2] << 8 | header[3];
+		if (segment_length < 2)
+			break;
+
+		if (header[1] != JPEG_APP1 && header[1] != JPEG_APP2) {
+			if (fseek (f, segment_length - 2, SEEK_CUR) != 0)
+				break;
+			continue;
+		}
+
+		data = g_malloc (segment_length - 2);
+		if (fread (data, 1, segment_length - 2, f) != segment_length - 2) {
+			g_free (data);
+			break;
+		}
+
+		if (is_metadata_segment (header[1], data, segment_length - 2)) {
+			/* The pixels we were given are upright or turned on purpose */
+			offset = exif_find_orientation (data, segment_length - 2, &big_endian);
+			if (offset != 0)
+				exif_write_orientation (data, offset, big_endian, 1);
+
+			g_string_append_len (segments, (gchar *) header, sizeof (header));
+			g_string_append_len (segments, (gchar *) data, segment_length - 2);
+		}
+
+		g_free (data);
+	}
+
+read_done:
+	fclose (f);
+
+	if (segments->len == 0) {
+		g_string_free (segments, TRUE);
+		return TRUE;
+	}
+
+	if (!g_file_get_contents (dest, &contents, &length, error)) {
+		g_string_free (segments, TRUE);
+		return FALSE;
+	}
+
+	if (length < 4 || (guchar) contents[0] != 0xff || (guchar) contents[1] != JPEG_SOI) {
+		g_free (contents);
+		g_string_free (segments, TRUE);
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, _("Not a JPEG image"));
+		return FALSE;
+	}
+
+	/* Right after SOI, or after the JFIF segment which has to come first */
+	insert_at = 2;
+	if (length >= 6 && (guchar) contents[2] == 0xff && (guchar) contents[3] == JPEG_APP0)
+		insert_at = MIN (length, 4 + (((guchar) contents[4] << 8) | (guchar) contents[5]));
+
+	out = g_string_sized_new (length + segments->len);
+	g_string_append_len (out, contents, insert_at);
+	g_string_append_len (out, segments->str, segments->len);
+	g_string_append_len (out, contents + insert_at, length - insert_at);
+
+	ok = g_file_set_contents (dest, out->str, out->len, error);
+
+	g_string_free (out, TRUE);
+	g_string_free (segments, TRUE);
+	g_free (contents);
+
+	return ok;
+}
+
+typedef struct {
+	struct jpeg_error_mgr pub;
+	jmp_buf setjmp_buffer;
+	gchar message[JMSG_LENGTH_MAX];
+} ErrorManager;
+
+static void
+error_exit (j_common_ptr cinfo)
+{
+	ErrorManager *err = (ErrorManager *) cinfo->err;
+
+	cinfo->err->format_message (cinfo, err->message);
+	longjmp (err->setjmp_buffer, 1);
+}
+
+static void
+output_message (j_common_ptr cinfo)
+{
+	/* libjpeg prints warnings to stderr by default, keep quiet */
+}
+
+/* Rotates the coefficients of one block.  Coefficients are stored row by
+ * row, rows being vertical frequency.  Swapping rows and columns
+ * transposes the block, negating the odd frequencies along an axis
+ * mirrors it. */
+static void
+rotate_block (JCOEFPTR src, JCOEFPTR dest, gint degrees)
+{
+	int i, j;
+
+	for (i = 0; i < DCTSIZE; i++) {
+		for (j = 0; j < DCTSIZE; j++) {
+			switch (degrees) {
+			case 90:
+				dest[i * DCTSIZE + j] = (j & 1) ? -src[j * DCTSIZE + i] : src[j * DCTSIZE + i];
+				break;
+			case 180:
+				dest[i * DCTSIZE + j] = ((i + j) & 1) ? -src[i * DCTSIZE + j] : src[i * DCTSIZE + j];
+				break;
+			case 270:
+				dest[i * DCTSIZE + j] = (i & 1) ? -src[j * DCTSIZE + i] : src[j * DCTSIZE + i];
+				break;
+			}
+		}
+	}
+}
+
+static void
+transpose_quant_table (JQUANT_TBL *table)
+{
+	int i, j;
+	UINT16 tmp;
+
+	for (i = 0; i < DCTSIZE; i++) {
+		for (j = i + 1; j < DCTSIZE; j++) {
+			tmp = table->quantval[i * DCTSIZE + j];
+			table->quantval[i * DCTSIZE + j] = table->quantval[j * DCTSIZE + i];
+			table->quantval[j * DCTSIZE + i] = tmp;
+		}
+	}
+}
+
+static JDIMENSION
+round_up (JDIMENSION value, int multiple)
+{
+	return (value + multiple - 1) / multiple * multiple;
+}
+
+static void
+copy_markers (j_decompress_ptr srcinfo, j_compress_ptr dstinfo)
+{
+	jpeg_saved_marker_ptr marker;
+	gsize offset;
+	gboolean big_endian;
+
+	for (marker = srcinfo->marker_list; marker != NULL; marker = marker->next) {
+		/* libjpeg writes its own JFIF and Adobe segments */
+		if (dstinfo->write_JFIF_header && marker->marker == JPEG_APP0 &&
+		    marker->data_length >= 5 && memcmp (marker->data, "JFIF", 5) == 0)
+			continue;
+		if (dstinfo->write_Adobe_marker && marker->marker == JPEG_APP0 + 14 &&
+		    marker->data_length >= 5 && memcmp (marker->data, "Adobe", 5) == 0)
+			continue;
+
+		if (marker->marker == JPEG_APP1) {
+			offset = exif_find_orientation (marker->data, marker->data_length, &big_endian);
+			if (offset != 0)
+				exif_write_orientation (marker->data, offset, big_endian, 1);
+		}
+
+		jpeg_write_marker (dstinfo, marker->marker, marker->data, marker->data_length);
+	}
+}
+
+gboolean
+nemo_image_jpeg_rotate (const gchar *src, const gchar *dest, gint degrees, GError **error)
+{
+	struct jpeg_decompress_struct srcinfo;
+	struct jpeg_compress_struct dstinfo;
+	ErrorManager src_err, dst_err;
+	jvirt_barray_ptr *src_coefs;
+	jvirt_barray_ptr *dst_coefs = NULL;
+	FILE *in;
+	FILE *volatile out = NULL;
+	gboolean transposed;
+	int ci, i, tmp;
+
+	g_return_val_if_fail (degrees == 90 || degrees == 180 || degrees == 270, FALSE);
+
+	transposed = degrees != 180;
+
+	in = g_fopen (src, "rb");
+	if (in == NULL) {
+		int saved_errno = errno;
+		g_set_error_literal (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno), g_strerror (saved_errno));
+		return FALSE;
+	}
+
+	srcinfo.err = jpeg_std_error (&src_err.pub);
+	src_err.pub.error_exit = error_exit;
+	src_err.pub.output_message = output_message;
+	dstinfo.err = jpeg_std_error (&dst_err.pub);
+	dst_err.pub.error_exit = error_exit;
+	dst_err.pub.output_message = output_message;
+
+	jpeg_create_decompress (&srcinfo);
+	jpeg_create_compress (&dstinfo);
+
+	if (setjmp (src_err.setjmp_buffer)) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "%s", src_err.message);
+		goto fail;
+	}
+	if (setjmp (dst_err.setjmp_buffer)) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "%s", dst_err.message);
+		goto fail;
+	}
+
+	jpeg_stdio_src (&srcinfo, in);
+	jpeg_save_markers (&srcinfo, JPEG_COM, 0xffff);
+	for (i = 0; i < 16; i++)
+		jpeg_save_markers (&srcinfo, JPEG_APP0 + i, 0xffff);
+	jpeg_read_header (&srcinfo, TRUE);
+
+	/* The edge that moves to the top or left must end on an MCU boundary,
+	 * a partial MCU there can only be dropped or re-encoded */
+	if (((degrees == 90 || degrees == 180) &&
+	     srcinfo.image_height % (srcinfo.max_v_samp_factor * DCTSIZE) != 0) ||
+	    ((degrees == 270 || degrees == 180) &&
+	     srcinfo.image_width % (srcinfo.max_h_samp_factor * DCTSIZE) != 0)) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+		             _("The image size doesn't allow lossless rotation"));
+		goto fail;
+	}
+
+	src_coefs = jpeg_read_coefficients (&srcinfo);
+	jpeg_copy_critical_parameters (&srcinfo, &dstinfo);
+
+	if (transposed) {
+		dstinfo.image_width = srcinfo.image_height;
+		dstinfo.image_height = srcinfo.image_width;
+
+		for (ci = 0; ci < dstinfo.num_components; ci++) {
+			tmp = dstinfo.comp_info[ci].h_samp_factor;
+			dstinfo.comp_info[ci].h_samp_factor = dstinfo.comp_info[ci].v_samp_factor;
+			dstinfo.comp_info[ci].v_samp_factor = tmp;
+		}
+
+		for (i = 0; i < NUM_QUANT_TBLS; i++) {
+			if (dstinfo.quant_tbl_ptrs[i] != NULL)
+				transpose_quant_table (dstinfo.quant_tbl_ptrs[i]);
+		}
+	}
+
+	dst_coefs = (jvirt_barray_ptr *) (*srcinfo.mem->alloc_small) ((j_common_ptr) &srcinfo, JPOOL_IMAGE,
+		sizeof (jvirt_barray_ptr) * srcinfo.num_components);
+
+	for (ci = 0; ci < srcinfo.num_components; ci++) {
+		jpeg_component_info *src_comp = srcinfo.comp_info + ci;
+		jpeg_component_info *dst_comp = dstinfo.comp_info + ci;
+		JDIMENSION width = transposed ? src_comp->height_in_blocks : src_comp->width_in_blocks;
+		JDIMENSION height = transposed ? src_comp->width_in_blocks : src_comp->height_in_blocks;
+
+		dst_coefs[ci] = (*srcinfo.mem->request_virt_barray) ((j_common_ptr) &srcinfo, JPOOL_IMAGE, TRUE,
+			round_up (width, dst_comp->h_samp_factor),
+			round_up (height, dst_comp->v_samp_factor),
+			dst_comp->v_samp_factor);
+	}
+	(*srcinfo.mem->realize_virt_arrays) ((j_common_ptr) &srcinfo);
+
+	for (ci = 0; ci < srcinfo.num_components; ci++) {
+		jpeg_component_info *src_comp = srcinfo.comp_info + ci;
+		JDIMENSION src_width = src_comp->width_in_blocks;
+		JDIMENSION src_height = src_comp->height_in_blocks;
+		JDIMENSION width = transposed ? src_height : src_width;
+		JDIMENSION height = transposed ? src_width : src_height;
+		JDIMENSION dx, dy, sx, sy;
+
+		for (dy = 0; dy < height; dy++) {
+			JBLOCKROW dst_row = (*srcinfo.mem->access_virt_barray) ((j_common_ptr) &srcinfo,
+				dst_coefs[ci], dy, 1, TRUE)[0];
+
+			for (dx = 0; dx < width; dx++) {
+				switch (degrees) {
+				case 90:
+					sx = dy;
+					sy = src_height - 1 - dx;
+					break;
+				case 180:
+					sx = src_width - 1 - dx;
+					sy = src_height - 1 - dy;
+					break;
+				default:
+					sx = src_width - 1 - dy;
+					sy = dx;
+					break;
+				}
+
+				JBLOCKROW src_row = (*srcinfo.mem->access_virt_barray) ((j_common_ptr) &srcinfo,
+					src_coefs[ci], sy, 1, FALSE)[0];
+				rotate_block (src_row[sx], dst_row[dx], degrees);
+			}
+		}
+	}
+
+	out = g_fopen (dest, "wb");
+	if (out == NULL) {
+		int saved_errno = errno;
+		g_set_error_literal (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno), g_strerror (saved_errno));
+		goto fail;
+	}
+
+	jpeg_stdio_dest (&dstinfo, out);
+	jpeg_write_coefficients (&dstinfo, dst_coefs);
+	copy_markers (&srcinfo, &dstinfo);
+	jpeg_finish_compress (&dstinfo);
+	jpeg_finish_decompress (&srcinfo);
+
+	jpeg_destroy_compress (&dstinfo);
+	jpeg_destroy_decompress (&srcinfo);
+	fclose (in);
+
+	if (fclose (out) != 0) {
+		int saved_errno = errno;
+		g_set_error_literal (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno), g_strerror (saved_errno));
+		g_unlink (dest);
+		return FALSE;
+	}
+
+	return TRUE;
+
+fail:
+	jpeg_destroy_compress (&dstinfo);
+	jpeg_destroy_decompress (&srcinfo);
+	fclose (in);
+	if (out != NULL) {
+		fclose (out);
+		g_unlink (dest);
+	}
+
+	return FALSE;
+}
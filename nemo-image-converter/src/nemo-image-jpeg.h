@@ -0,0 +1,77 @@
+/*
+ *  nemo-image-jpeg.h
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#ifndef NEMO_IMAGE_JPEG_H
+#define NEMO_IMAGE_JPEG_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+gboolean nemo_image_jpeg_is_jpeg            (const gchar  *filename);
+
+/* The EXIF orientation of the image, 1 (top-left) if it has none */
+guint    nemo_image_jpeg_get_orientation    (const gchar  *filename);
+
+/* The thumbnail embedded in the EXIF data, itself a JPEG, or NULL.  Like
+ * the image it is stored as shot, before the orientation is applied.
+ */
+GBytes  *nemo_image_jpeg_get_exif_thumbnail (const gchar  *filename);
+
+/* What the header segments say about the metadata convert would carry
+ * over: EXIF or XMP, an ICC profile, and the quality the image was
+ * saved with as best it can be told, or 0.
+ */
+void     nemo_image_jpeg_get_metadata       (const gchar  *filename,
+                                             gboolean     *has_exif,
+                                             gboolean     *has_icc_profile,
+                                             gint         *quality);
+
+/* Rotates by 90, 180 or 270 degrees clockwise without decoding, by
+ * rearranging the DCT blocks like jpegtran -perfect does.  The EXIF
+ * orientation is reset to top-left, matching convert -orient TopLeft.
+ * Fails with G_IO_ERROR_NOT_SUPPORTED if the edge of the image that
+ * would move isn't on an MCU boundary, since that can't be done
+ * losslessly.
+ */
+gboolean nemo_image_jpeg_rotate             (const gchar  *src,
+                                             const gchar  *dest,
+                                             gint          degrees,
+                                             GError      **error);
+
+/* Leaves the image data alone and only changes the EXIF orientation,
+ * so viewers show the image turned degrees clockwise from how they
+ * showed it before.
+ */
+gboolean nemo_image_jpeg_set_orientation    (const gchar  *src,
+                                             const gchar  *dest,
+                                             gint          degrees,
+                                             GError      **error);
+
+/* Copies the EXIF, XMP and ICC profile segments of src into dest, a JPEG
+ * written without any.  The EXIF orientation is reset to top-left, dest
+ * holding the pixels already turned.
+ */
+gboolean nemo_image_jpeg_copy_metadata      (const gchar  *src,
+                                             const gchar  *dest,
+                                             GError      **error);
+
+G_END_DECLS
+
+#endif /* NEMO_IMAGE_JPEG_H */
@@ -0,0 +1,355 @@
+/*
+ *  nemo-image-pipeline.c
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+ #include <config.h> /* for GETTEXT_PACKAGE */
+#endif
+
+#include "nemo-image-pipeline.h"
+#include "nemo-image-scaler.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <glib/gi18n.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+typedef enum {
+	STEP_RESIZE,
+	STEP_ROTATE
+} StepType;
+
+typedef struct {
+	StepType type;
+	gchar *value;               /* as given, for convert */
+	NemoImageGeometry geometry;
+	gint degrees;               /* clockwise, 0 to 359 */
+} Step;
+
+struct _NemoImagePipeline {
+	GArray *steps;
+	gboolean strip;
+	gint quality;               /* 0 for the default */
+
+	/* Whether GdkPixbuf can do every step */
+	gboolean in_process;
+};
+
+static void
+step_clear (Step *step)
+{
+	g_free (step->value);
+}
+
+static gboolean
+parse_rotate (Step *step, gboolean *in_process)
+{
+	gdouble degrees;
+	gchar *end;
+
+	degrees = g_ascii_strtod (step->value, &end);
+	if (end == step->value || *end != '\0' || !isfinite (degrees))
+		return FALSE;
+
+	degrees = fmod (degrees, 360);
+	if (degrees < 0)
+		degrees += 360;
+
+	/* GdkPixbuf only turns by quarters, convert does the rest */
+	if (fmod (degrees, 90) != 0)
+		*in_process = FALSE;
+	step->degrees = (gint) degrees;
+
+	return TRUE;
+}
+
+NemoImagePipeline *
+nemo_image_pipeline_new (const gchar *spec, GError **error)
+{
+	NemoImagePipeline *pipeline;
+	gchar **argv = NULL;
+	gchar *stripped;
+	gint argc = 0, i;
+	gboolean empty;
+
+	g_return_val_if_fail (spec != NULL, NULL);
+
+	/* Nothing but a change of format is fine too */
+	stripped = g_strstrip (g_strdup (spec));
+	empty = *stripped == '\0';
+	g_free (stripped);
+
+	if (!empty && !g_shell_parse_argv (spec, &argc, &argv, error))
+		return NULL;
+
+	pipeline = g_new0 (NemoImagePipeline, 1);
+	pipeline->steps = g_array_new (FALSE, TRUE, sizeof (Step));
+	g_array_set_clear_func (pipeline->steps, (GDestroyNotify) step_clear);
+	pipeline->in_process = TRUE;
+
+	for (i = 0; i < argc; i++) {
+		const gchar *option = argv[i];
+		const gchar *value = i + 1 < argc ? argv[i + 1] : NULL;
+		Step step = { 0, };
+
+		if (strcmp (option, "-strip") == 0) {
+			pipeline->strip = TRUE;
+			continue;
+		}
+
+		if (value == NULL) {
+			g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+			             _("Missing value for %s"), option);
+			goto fail;
+		}
+		i++;
+
+		if (strcmp (option, "-quality") == 0) {
+			guint64 quality;
+
+			if (!g_ascii_string_to_unsigned (value, 10, 1, 100, &quality, NULL)) {
+				g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+				             _("Invalid quality: %s"), value);
+				goto fail;
+			}
+			pipeline->quality = quality;
+		} else if (strcmp (option, "-resize") == 0) {
+			step.type = STEP_RESIZE;
+			step.value = g_strdup (value);
+			/* Sizes GdkPixbuf can't reproduce exactly are left to convert */
+			if (!nemo_image_geometry_parse (value, &step.geometry))
+				pipeline->in_process = FALSE;
+			g_array_append_val (pipeline->steps, step);
+		} else if (strcmp (option, "-rotate") == 0) {
+			step.type = STEP_ROTATE;
+			step.value = g_strdup (value);
+			if (!parse_rotate (&step, &pipeline->in_process)) {
+				g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+				             _("Invalid angle: %s"), value);
+				step_clear (&step);
+				goto fail;
+			}
+			g_array_append_val (pipeline->steps, step);
+		} else {
+			g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+			             _("Unknown option %s"), option);
+			goto fail;
+		}
+	}
+
+	g_strfreev (argv);
+
+	return pipeline;
+
+fail:
+	g_strfreev (argv);
+	nemo_image_pipeline_free (pipeline);
+
+	return NULL;
+}
+
+void
+nemo_image_pipeline_free (NemoImagePipeline *pipeline)
+{
+	g_array_free (pipeline->steps, TRUE);
+	g_free (pipeline);
+}
+
+static gboolean
+has_rotate (NemoImagePipeline *pipeline)
+{
+	guint i;
+
+	for (i = 0; i < pipeline->steps->len; i++) {
+		if (g_array_index (pipeline->steps, Step, i).type == STEP_ROTATE)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+gint
+nemo_image_pipeline_get_quarter_turn (NemoImagePipeline *pipeline)
+{
+	Step *step;
+
+	/* Turning JPEGs losslessly keeps the metadata and the quality */
+	if (pipeline->steps->len != 1 || pipeline->strip || pipeline->quality != 0)
+		return 0;
+
+	step = &g_array_index (pipeline->steps, Step, 0);
+	if (step->type != STEP_ROTATE || step->degrees % 90 != 0)
+		return 0;
+
+	return step->degrees;
+}
+
+static GdkPixbuf *
+run_step (Step *step, GdkPixbuf *pixbuf)
+{
+	gint width, height;
+
+	if (step->type == STEP_ROTATE) {
+		switch (step->degrees) {
+		case 90:
+			return gdk_pixbuf_rotate_simple (pixbuf, GDK_PIXBUF_ROTATE_CLOCKWISE);
+		case 180:
+			return gdk_pixbuf_rotate_simple (pixbuf, GDK_PIXBUF_ROTATE_UPSIDEDOWN);
+		case 270:
+			return gdk_pixbuf_rotate_simple (pixbuf, GDK_PIXBUF_ROTATE_COUNTERCLOCKWISE);
+		default:
+			return g_object_ref (pixbuf);
+		}
+	}
+
+	nemo_image_geometry_apply (&step->geometry,
+	                           gdk_pixbuf_get_width (pixbuf), gdk_pixbuf_get_height (pixbuf),
+	                           &width, &height);
+	if (width == gdk_pixbuf_get_width (pixbuf) && height == gdk_pixbuf_get_height (pixbuf))
+		return g_object_ref (pixbuf);
+
+	return gdk_pixbuf_scale_simple (pixbuf, width, height, GDK_INTERP_BILINEAR);
+}
+
+gboolean
+nemo_image_pipeline_run (NemoImagePipeline *pipeline,
+                         const gchar *src,
+                         const gchar *dest,
+                         volatile gint *progress,
+                         GCancellable *cancellable,
+                         GError **error)
+{
+	const NemoImageGeometry *geometry = NULL;
+	NemoImageMetadata metadata;
+	GdkPixbuf *pixbuf, *next;
+	gchar *icc_profile = NULL;
+	gboolean keep_metadata, upright, ok;
+	guint i = 0;
+
+	if (!pipeline->in_process || !nemo_image_scaler_can_save (dest)) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+		             _("Could not convert this image in-process"));
+		return FALSE;
+	}
+
+	/* convert keeps the camera data unless asked to strip it.  GdkPixbuf
+	 * can't write it, but between JPEGs the segments are copied as is. */
+	nemo_image_scaler_get_metadata (src, &metadata);
+	keep_metadata = !pipeline->strip && nemo_image_scaler_can_save_metadata (src, dest);
+	if (metadata.has_exif && !pipeline->strip && !keep_metadata) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+		             _("Could not keep the image's metadata in-process"));
+		return FALSE;
+	}
+
+	/* A leading resize is done while decoding */
+	if (pipeline->steps->len > 0 && g_array_index (pipeline->steps, Step, 0).type == STEP_RESIZE)
+		geometry = &g_array_index (pipeline->steps, Step, i++).geometry;
+
+	/* Rotating works on the pixels as stored and drops the orientation,
+	 * like convert -rotate -orient TopLeft.  Otherwise turn the pixels
+	 * upright: the output has no EXIF, or a copy reset to top-left. */
+	upright = !has_rotate (pipeline);
+
+	pixbuf = nemo_image_scaler_load (src, geometry, upright, !pipeline->strip && !keep_metadata,
+	                                 progress, cancellable, error);
+	if (pixbuf == NULL)
+		return FALSE;
+
+	/* The steps make new pixbufs without the options */
+	if (!pipeline->strip && !keep_metadata)
+		icc_profile = g_strdup (gdk_pixbuf_get_option (pixbuf, "icc-profile"));
+
+	for (; i < pipeline->steps->len; i++) {
+		if (g_cancellable_set_error_if_cancelled (cancellable, error)) {
+			g_object_unref (pixbuf);
+			g_free (icc_profile);
+			return FALSE;
+		}
+
+		next = run_step (&g_array_index (pipeline->steps, Step, i), pixbuf);
+		g_object_unref (pixbuf);
+		pixbuf = next;
+	}
+
+	if (g_cancellable_set_error_if_cancelled (cancellable, error)) {
+		g_object_unref (pixbuf);
+		g_free (icc_profile);
+		return FALSE;
+	}
+
+	/* Like convert, keep the quality of a JPEG unless told otherwise */
+	ok = nemo_image_scaler_save (pixbuf, dest,
+	                             pipeline->quality > 0 ? pipeline->quality : metadata.quality,
+	                             icc_profile, keep_metadata ? src : NULL, error);
+	if (ok)
+		g_atomic_int_set (progress, NEMO_IMAGE_SCALER_PROGRESS_DONE);
+
+	g_object_unref (pixbuf);
+	g_free (icc_profile);
+
+	return ok;
+}
+
+gboolean
+nemo_image_pipeline_run_convert (NemoImagePipeline *pipeline,
+                                 const gchar *src,
+                                 const gchar *dest,
+                                 GError **error)
+{
+	GPtrArray *argv;
+	gint status;
+	guint i;
+	gboolean ok;
+
+	argv = g_ptr_array_new_with_free_func (g_free);
+
+	g_ptr_array_add (argv, g_strdup ("/usr/bin/convert"));
+	g_ptr_array_add (argv, g_strdup (src));
+
+	for (i = 0; i < pipeline->steps->len; i++) {
+		Step *step = &g_array_index (pipeline->steps, Step, i);
+
+		g_ptr_array_add (argv, g_strdup (step->type == STEP_RESIZE ? "-resize" : "-rotate"));
+		g_ptr_array_add (argv, g_strdup (step->value));
+	}
+
+	if (has_rotate (pipeline)) {
+		g_ptr_array_add (argv, g_strdup ("-orient"));
+		g_ptr_array_add (argv, g_strdup ("TopLeft"));
+	}
+	if (pipeline->strip)
+		g_ptr_array_add (argv, g_strdup ("-strip"));
+	if (pipeline->quality > 0) {
+		g_ptr_array_add (argv, g_strdup ("-quality"));
+		g_ptr_array_add (argv, g_strdup_printf ("%d", pipeline->quality));
+	}
+
+	g_ptr_array_add (argv, g_strdup (dest));
+	g_ptr_array_add (argv, NULL);
+
+	ok = g_spawn_sync (NULL, (gchar **) argv->pdata, NULL,
+	                   G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL,
+	                   NULL, NULL, NULL, NULL, &status, error) &&
+	     g_spawn_check_exit_status (status, error);
+
+	g_ptr_array_free (argv, TRUE);
+
+	return ok;
+}
@@ -0,0 +1,67 @@
+/*
+ *  nemo-image-pipeline.h
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+#ifndef NEMO_IMAGE_PIPELINE_H
+#define NEMO_IMAGE_PIPELINE_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* A chain of operations applied to each image of a batch in a single
+ * decode and encode.  It is written as the subset of convert's options
+ * the dialogs produce, in the order they are applied:
+ *
+ *   -resize GEOMETRY   see NemoImageGeometry
+ *   -rotate DEGREES    clockwise
+ *   -strip             drop metadata
+ *   -quality N         JPEG quality
+ *
+ * The output format follows the extension of the output file.
+ */
+typedef struct _NemoImagePipeline NemoImagePipeline;
+
+NemoImagePipeline *nemo_image_pipeline_new              (const gchar        *spec,
+                                                          GError            **error);
+void               nemo_image_pipeline_free             (NemoImagePipeline  *pipeline);
+
+/* 90, 180 or 270 if the pipeline does nothing but turn the image by
+ * that many degrees, 0 otherwise */
+gint               nemo_image_pipeline_get_quarter_turn (NemoImagePipeline  *pipeline);
+
+/* Runs the pipeline in-process.  Fails with G_IO_ERROR_NOT_SUPPORTED if
+ * GdkPixbuf can't do it, in which case nemo_image_pipeline_run_convert()
+ * should be tried instead.  progress is updated atomically, so it can be
+ * polled from another thread.
+ */
+gboolean           nemo_image_pipeline_run              (NemoImagePipeline  *pipeline,
+                                                          const gchar        *src,
+                                                          const gchar        *dest,
+                                                          volatile gint      *progress,
+                                                          GCancellable       *cancellable,
+                                                          GError            **error);
+gboolean           nemo_image_pipeline_run_convert      (NemoImagePipeline  *pipeline,
+                                                          const gchar        *src,
+                                                          const gchar        *dest,
+                                                          GError            **error);
+
+G_END_DECLS
+
+#endif /* NEMO_IMAGE_PIPELINE_H */
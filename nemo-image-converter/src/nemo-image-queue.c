@@ -0,0 +1,435 @@
+/*
+ *  nemo-image-queue.c
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/* nemo-image-converter-queue JOURNAL
+ *
+ * Runs the conversions in a journal written by nemo-image-batch.c, outside
+ * of nemo so that they carry on if nemo is closed or crashes.  Items that
+ * are already done are skipped, which makes running it again on the same
+ * journal resume the batch.
+ *
+ * Progress goes to stdout, one tab separated line per event:
+ *
+ *   total	N_ITEMS	N_FINISHED
+ *   start	INDEX
+ *   progress	INDEX	THOUSANDTHS
+ *   done	INDEX
+ *   failed	INDEX	MESSAGE
+ *
+ * A "cancel" line on stdin abandons the batch.  Closing stdin doesn't.
+ */
+
+#ifdef HAVE_CONFIG_H
+ #include <config.h>
+#endif
+
+#include "nemo-image-journal.h"
+#include "nemo-image-jpeg.h"
+#include "nemo-image-pipeline.h"
+#include "nemo-image-scaler.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+#include <glib-unix.h>
+#include <gio/gio.h>
+#include <gio/gunixinputstream.h>
+
+#define PROGRESS_INTERVAL 200 /* ms */
+
+typedef struct {
+	guint index;
+	volatile gint progress;
+} Job;
+
+static NemoImageJournal *journal;
+static GMainLoop *loop;
+static GCancellable *cancellable;
+static GMutex output_lock;
+
+static gboolean in_place;
+static gboolean abandoned;
+static gint n_running;
+
+static NemoImagePipeline *pipeline;
+static gboolean orientation_only;
+
+/* Running jobs, only touched from the main thread */
+static GPtrArray *jobs;
+
+static void
+report (const gchar *format, ...)
+{
+	va_list args;
+
+	g_mutex_lock (&output_lock);
+	va_start (args, format);
+	vprintf (format, args);
+	va_end (args);
+	/* Nobody may be listening any more, which is fine */
+	fflush (stdout);
+	g_mutex_unlock (&output_lock);
+}
+
+static gboolean
+run_pipeline (Job *job, const gchar *input, const gchar *output, GError **error)
+{
+	gint degrees = nemo_image_pipeline_get_quarter_turn (pipeline);
+
+	/* Quarter turns of JPEGs don't need to be decoded at all */
+	if (degrees != 0 && nemo_image_jpeg_is_jpeg (input)) {
+		if (orientation_only) {
+			if (nemo_image_jpeg_set_orientation (input, output, degrees, error))
+				return TRUE;
+			if (!g_error_matches (*error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED))
+				return FALSE;
+			g_clear_error (error);
+		}
+
+		if (nemo_image_jpeg_rotate (input, output, degrees, error))
+			return TRUE;
+		if (!g_error_matches (*error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED))
+			return FALSE;
+		g_clear_error (error);
+	}
+
+	if (nemo_image_pipeline_run (pipeline, input, output, &job->progress, cancellable, error))
+		return TRUE;
+	if (!g_error_matches (*error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED))
+		return FALSE;
+
+	/* GdkPixbuf can't handle this one, but ImageMagick may */
+	g_clear_error (error);
+	return nemo_image_pipeline_run_convert (pipeline, input, output, error);
+}
+
+static void
+set_error_from_errno (GError **error)
+{
+	int saved_errno = errno;
+
+	g_set_error_literal (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno), g_strerror (saved_errno));
+}
+
+/* Works on directories too, to make a rename in them stick */
+static gboolean
+sync_path (const gchar *path, GError **error)
+{
+	int fd;
+
+	fd = g_open (path, O_RDONLY, 0);
+	if (fd < 0 || fsync (fd) != 0) {
+		set_error_from_errno (error);
+		if (fd >= 0)
+			close (fd);
+		return FALSE;
+	}
+
+	close (fd);
+
+	return TRUE;
+}
+
+static void
+sync_parent (const gchar *path)
+{
+	gchar *dirname = g_path_get_dirname (path);
+	GError *error = NULL;
+
+	if (!sync_path (dirname, &error)) {
+		g_warning ("Could not sync %s: %s", dirname, error->message);
+		g_error_free (error);
+	}
+
+	g_free (dirname);
+}
+
+/* Moves a converted image over its original.  The new data and the
+ * journal saying so have to be on disk before the rename is, or a power
+ * cut could leave an empty original that recover() takes for done. */
+static gboolean
+replace_original (guint index, NemoImageJournalItem *item, GError **error)
+{
+	if (!sync_path (item->output, error))
+		return FALSE;
+
+	nemo_image_journal_set_state (journal, index, NEMO_IMAGE_JOURNAL_CONVERTED);
+	if (!nemo_image_journal_sync (journal, error))
+		return FALSE;
+
+	if (g_rename (item->output, item->input) != 0) {
+		set_error_from_errno (error);
+		return FALSE;
+	}
+
+	sync_parent (item->input);
+
+	return TRUE;
+}
+
+static gboolean
+job_finished (gpointer data)
+{
+	Job *job = data;
+
+	g_ptr_array_remove (jobs, job);
+
+	if (--n_running == 0)
+		g_main_loop_quit (loop);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Runs in one of the pool's threads */
+static void
+run_job (gpointer data, gpointer user_data)
+{
+	Job *job = data;
+	NemoImageJournalItem *item = nemo_image_journal_get_item (journal, job->index);
+	GError *error = NULL;
+	gboolean ok, created;
+
+	if (g_cancellable_is_cancelled (cancellable))
+		goto out;
+
+	report ("start\t%u\n", job->index);
+
+	/* A file that was there already is the user's, and is never removed */
+	created = !g_file_test (item->output, G_FILE_TEST_EXISTS);
+	if (created)
+		nemo_image_journal_set_state (journal, job->index, NEMO_IMAGE_JOURNAL_WRITING);
+
+	ok = run_pipeline (job, item->input, item->output, &error);
+
+	if (ok && in_place)
+		ok = replace_original (job->index, item, &error);
+
+	if (ok) {
+		nemo_image_journal_set_state (journal, job->index, NEMO_IMAGE_JOURNAL_DONE);
+		report ("done\t%u\n", job->index);
+	} else {
+		if (created)
+			g_unlink (item->output);
+
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			gchar *message = g_strescape (error->message, NULL);
+
+			nemo_image_journal_set_state (journal, job->index, NEMO_IMAGE_JOURNAL_FAILED);
+			report ("failed\t%u\t%s\n", job->index, message);
+			g_free (message);
+		}
+		g_error_free (error);
+	}
+
+out:
+	g_atomic_int_set (&job->progress, NEMO_IMAGE_SCALER_PROGRESS_DONE);
+	g_idle_add_full (G_PRIORITY_DEFAULT, job_finished, job, g_free);
+}
+
+/* Finishes what a previous run left half done, and removes the output
+ * that items which didn't get that far had started writing */
+static guint
+recover (void)
+{
+	guint i, n_finished = 0;
+
+	for (i = 0; i < nemo_image_journal_get_n_items (journal); i++) {
+		NemoImageJournalItem *item = nemo_image_journal_get_item (journal, i);
+
+		switch (item->state) {
+		case NEMO_IMAGE_JOURNAL_CONVERTED:
+			/* Only the move over the original was missing, unless it
+			 * happened and the crash came before it was written down */
+			if (g_file_test (item->output, G_FILE_TEST_EXISTS) && g_rename (item->output, item->input) != 0) {
+				g_warning ("Could not move %s to %s: %s", item->output, item->input, g_strerror (errno));
+				nemo_image_journal_set_state (journal, i, NEMO_IMAGE_JOURNAL_FAILED);
+			} else {
+				sync_parent (item->input);
+				nemo_image_journal_set_state (journal, i, NEMO_IMAGE_JOURNAL_DONE);
+			}
+			n_finished++;
+			break;
+		case NEMO_IMAGE_JOURNAL_WRITING:
+			/* Run again from the start */
+			g_unlink (item->output);
+			nemo_image_journal_set_state (journal, i, NEMO_IMAGE_JOURNAL_PENDING);
+			break;
+		case NEMO_IMAGE_JOURNAL_PENDING:
+			break;
+		default:
+			n_finished++;
+			break;
+		}
+	}
+
+	return n_finished;
+}
+
+static gboolean
+report_progress (gpointer data)
+{
+	guint i;
+
+	for (i = 0; i < jobs->len; i++) {
+		Job *job = g_ptr_array_index (jobs, i);
+		gint progress = g_atomic_int_get (&job->progress);
+
+		if (progress > 0 && progress < NEMO_IMAGE_SCALER_PROGRESS_DONE)
+			report ("progress\t%u\t%d\n", job->index, progress);
+	}
+
+	return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+stop (gpointer data)
+{
+	/* Logging out and the like: stop where we are and leave the journal
+	 * to be resumed.  Running conversions are left to finish. */
+	g_cancellable_cancel (cancellable);
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void
+read_command (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+	GDataInputStream *input = G_DATA_INPUT_STREAM (source);
+	gchar *line;
+
+	line = g_data_input_stream_read_line_finish (input, result, NULL, NULL);
+	if (line == NULL)
+		return;
+
+	if (strcmp (line, "cancel") == 0) {
+		abandoned = TRUE;
+		g_cancellable_cancel (cancellable);
+	}
+	g_free (line);
+
+	g_data_input_stream_read_line_async (input, G_PRIORITY_DEFAULT, NULL, read_command, NULL);
+}
+
+int
+main (int argc, char *argv[])
+{
+	GThreadPool *pool;
+	GDataInputStream *input;
+	GError *error = NULL;
+	const gchar *spec;
+	guint i, n_finished;
+	gboolean complete;
+
+	if (argc != 2) {
+		g_printerr ("Usage: %s JOURNAL\n", argv[0]);
+		return 1;
+	}
+
+	/* The reader goes away with nemo, we carry on */
+	signal (SIGPIPE, SIG_IGN);
+
+	journal = nemo_image_journal_open (argv[1], &error);
+	if (journal == NULL) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		return 1;
+	}
+
+	if (!nemo_image_journal_lock (journal)) {
+		/* Somebody else is already running it */
+		nemo_image_journal_free (journal);
+		return 0;
+	}
+
+	in_place = g_strcmp0 (nemo_image_journal_get (journal, "in-place"), "true") == 0;
+	orientation_only = g_strcmp0 (nemo_image_journal_get (journal, "orientation-only"), "true") == 0;
+
+	spec = nemo_image_journal_get (journal, "pipeline");
+	if (spec == NULL) {
+		g_printerr ("%s: no pipeline\n", argv[1]);
+		return 1;
+	}
+
+	pipeline = nemo_image_pipeline_new (spec, &error);
+	if (pipeline == NULL) {
+		g_printerr ("%s: %s\n", argv[1], error->message);
+		g_error_free (error);
+		return 1;
+	}
+
+	n_finished = recover ();
+	report ("total\t%u\t%u\n", nemo_image_journal_get_n_items (journal), n_finished);
+
+	loop = g_main_loop_new (NULL, FALSE);
+	cancellable = g_cancellable_new ();
+	jobs = g_ptr_array_new ();
+
+	g_unix_signal_add (SIGTERM, stop, NULL);
+	g_unix_signal_add (SIGINT, stop, NULL);
+	g_unix_signal_add (SIGHUP, stop, NULL);
+
+	input = g_data_input_stream_new (g_unix_input_stream_new (STDIN_FILENO, FALSE));
+	g_data_input_stream_read_line_async (input, G_PRIORITY_DEFAULT, NULL, read_command, NULL);
+
+	/* One image per core; both GdkPixbuf and convert are mostly single threaded */
+	pool = g_thread_pool_new (run_job, NULL, g_get_num_processors (), FALSE, NULL);
+
+	for (i = 0; i < nemo_image_journal_get_n_items (journal); i++) {
+		NemoImageJournalItem *item = nemo_image_journal_get_item (journal, i);
+
+		if (item->state == NEMO_IMAGE_JOURNAL_PENDING) {
+			Job *job = g_new0 (Job, 1);
+
+			job->index = i;
+			g_ptr_array_add (jobs, job);
+			n_running++;
+			g_thread_pool_push (pool, job, NULL);
+		}
+	}
+
+	if (n_running > 0) {
+		g_timeout_add (PROGRESS_INTERVAL, report_progress, NULL);
+		g_main_loop_run (loop);
+	}
+
+	g_thread_pool_free (pool, FALSE, TRUE);
+
+	complete = TRUE;
+	for (i = 0; i < nemo_image_journal_get_n_items (journal); i++) {
+		NemoImageJournalState state = nemo_image_journal_get_item (journal, i)->state;
+
+		if (state == NEMO_IMAGE_JOURNAL_PENDING || state == NEMO_IMAGE_JOURNAL_WRITING)
+			complete = FALSE;
+	}
+
+	/* Stopped by a signal, keep the journal around for next time */
+	if (complete || abandoned)
+		nemo_image_journal_remove (journal);
+
+	nemo_image_journal_free (journal);
+	nemo_image_pipeline_free (pipeline);
+
+	return 0;
+}
@@ -26,6 +26,7 @@
 #endif
 
 #include "nemo-image-resizer.h"
+#include "nemo-image-batch.h"
 
 #include <string.h>
 
@@ -42,10 +43,6 @@ struct _NemoImageResizerPrivate {
 	
 	gchar *suffix;
 	
-	int images_resized;
-	int images_total;
-	gboolean cancelled;
-	
 	gchar *size;
 
 	GtkDialog *resize_dialog;
@@ -59,10 +56,6 @@ struct _NemoImageResizerPrivate {
 	GtkRadioButton *append_radiobutton;
 	GtkEntry *name_entry;
 	GtkRadioButton *inplace_radiobutton;
-
-	GtkWidget *progress_dialog;
-	GtkWidget *progress_bar;
-	GtkWidget *progress_label;
 };
 
 #define NEMO_IMAGE_RESIZER_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), NEMO_TYPE_IMAGE_RESIZER, NemoImageResizerPrivate))
@@ -86,6 +79,7 @@ nemo_image_resizer_finalize(GObject *object)
 	NemoImageResizerPrivate *priv = NEMO_IMAGE_RESIZER_GET_PRIVATE (dialog);
 	
 	g_free (priv->suffix);
+	g_free (priv->size);
 		
 	G_OBJECT_CLASS(nemo_image_resizer_parent_class)->finalize(object);
 }
@@ -102,7 +96,6 @@ nemo_image_resizer_set_property (GObject      *object,
 	switch (property_id) {
 	case PROP_FILES:
 		priv->files = g_value_get_pointer (value);
-		priv->images_total = g_list_length (priv->files);
 		break;
 	default:
 		/* We don't have any other property... */
@@ -153,8 +146,6 @@ nemo_image_resizer_class_init(NemoImageResizerClass *klass)
 	files_param_spec);
 }
 
-static void run_op (NemoImageResizer *resizer);
-
 static GFile *
 nemo_image_resizer_transform_filename (NemoImageResizer *resizer, GFile *orig_file)
 {
@@ -188,116 +179,51 @@ nemo_image_resizer_transform_filename (NemoImageResizer *resizer, GFile *orig_fi
 }
 
 static void
-op_finished (GPid pid, gint status, gpointer data)
+run_ops (NemoImageResizer *resizer)
 {
-	NemoImageResizer *resizer = NEMO_IMAGE_RESIZER (data);
 	NemoImageResizerPrivate *priv = NEMO_IMAGE_RESIZER_GET_PRIVATE (resizer);
-	
-	gboolean retry = TRUE;
-	
-	NemoFileInfo *file = NEMO_FILE_INFO (priv->files->data);
-	
-	if (status != 0) {
-		/* resizing failed */
-		char *name = nemo_file_info_get_name (file);
-
-		GtkWidget *msg_dialog = gtk_message_dialog_new (GTK_WINDOW (priv->progress_dialog),
-			GTK_DIALOG_DESTROY_WITH_PARENT, GTK_MESSAGE_ERROR,
-			GTK_BUTTONS_NONE,
-			"'%s' cannot be resized. Check whether you have permission to write to this folder.",
-			name);
-		g_free (name);
-		
-		gtk_dialog_add_button (GTK_DIALOG (msg_dialog), _("_Skip"), 1);
-		gtk_dialog_add_button (GTK_DIALOG (msg_dialog), GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL);
-		gtk_dialog_add_button (GTK_DIALOG (msg_dialog), _("_Retry"), 0);
-		gtk_dialog_set_default_response (GTK_DIALOG (msg_dialog), 0);
-		
-		int response_id = gtk_dialog_run (GTK_DIALOG (msg_dialog));
-		gtk_widget_destroy (msg_dialog);
-		if (response_id == 0) {
-			retry = TRUE;
-		} else if (response_id == GTK_RESPONSE_CANCEL) {
-			priv->cancelled = TRUE;
-		} else if (response_id == 1) {
-			retry = FALSE;
-		}
-		
-	} else if (priv->suffix == NULL) {
-		/* resize image in place */
-		GFile *orig_location = nemo_file_info_get_location (file);
-		GFile *new_location = nemo_image_resizer_transform_filename (resizer, orig_location);
-		g_file_move (new_location, orig_location, G_FILE_COPY_OVERWRITE, NULL, NULL, NULL, NULL);
-		g_object_unref (orig_location);
-		g_object_unref (new_location);
-	}
-
-	if (status == 0 || !retry) {
-		/* image has been successfully resized (or skipped) */
-		priv->images_resized++;
-		priv->files = priv->files->next;
-	}
-	
-	if (!priv->cancelled && priv->files != NULL) {
-		/* process next image */
-		run_op (resizer);
-	} else {
-		/* cancel/terminate operation */
-		gtk_widget_destroy (priv->progress_dialog);
-	}
-}
+	NemoImageJournal *journal;
+	GError *error = NULL;
+	gchar *quoted, *pipeline;
+	GList *l;
 
-static void
-run_op (NemoImageResizer *resizer)
-{
-	NemoImageResizerPrivate *priv = NEMO_IMAGE_RESIZER_GET_PRIVATE (resizer);
-	
 	g_return_if_fail (priv->files != NULL);
-	
-	NemoFileInfo *file = NEMO_FILE_INFO (priv->files->data);
 
-	GFile *orig_location = nemo_file_info_get_location (file);
-	char *filename = g_file_get_path (orig_location);
-	GFile *new_location = nemo_image_resizer_transform_filename (resizer, orig_location);
-	char *new_filename = g_file_get_path (new_location);
-	g_object_unref (orig_location);
-	g_object_unref (new_location);
+	journal = nemo_image_journal_new (&error);
+	if (journal == NULL) {
+		GtkWidget *msg_dialog = gtk_message_dialog_new (NULL, 0, GTK_MESSAGE_ERROR, GTK_BUTTONS_CLOSE,
+			"%s", error->message);
+		g_signal_connect (msg_dialog, "response", G_CALLBACK (gtk_widget_destroy), NULL);
+		gtk_widget_show (msg_dialog);
+		g_error_free (error);
+		return;
+	}
 
-	/* FIXME: check whether new_uri already exists and provide "Replace _All", "_Skip", and "_Replace" options */
-	
-	gchar *argv[6];
-	argv[0] = "/usr/bin/convert";
-	argv[1] = filename;
-	argv[2] = "-resize";
-	argv[3] = priv->size;
-	argv[4] = new_filename;
-	argv[5] = NULL;
-	
-	pid_t pid;
+	/* One step of the pipeline the queue runs */
+	quoted = g_shell_quote (priv->size);
+	pipeline = g_strdup_printf ("-resize %s", quoted);
+	nemo_image_journal_set (journal, "operation", "resize");
+	nemo_image_journal_set (journal, "pipeline", pipeline);
+	g_free (pipeline);
+	g_free (quoted);
+	nemo_image_journal_set (journal, "in-place", priv->suffix == NULL ? "true" : "false");
+
+	for (l = priv->files; l != NULL; l = l->next) {
+		GFile *orig_location = nemo_file_info_get_location (NEMO_FILE_INFO (l->data));
+		GFile *new_location = nemo_image_resizer_transform_filename (resizer, orig_location);
+		char *filename = g_file_get_path (orig_location);
+		char *new_filename = g_file_get_path (new_location);
 
-	if (!g_spawn_async (NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &pid, NULL)) {
-		// FIXME: error handling
-		return;
+		/* FIXME: check whether new_uri already exists and provide "Replace _All", "_Skip", and "_Replace" options */
+		nemo_image_journal_add_item (journal, filename, new_filename);
+
+		g_free (filename);
+		g_free (new_filename);
+		g_object_unref (orig_location);
+		g_object_unref (new_location);
 	}
-	
-	g_free (filename);
-	g_free (new_filename);
-	
-	g_child_watch_add (pid, op_finished, resizer);
-	
-	char *tmp;
 
-	gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (priv->progress_bar), (double) (priv->images_resized + 1) / priv->images_total);
-	tmp = g_strdup_printf (_("Resizing image: %d of %d"), priv->images_resized + 1, priv->images_total);
-	gtk_progress_bar_set_text (GTK_PROGRESS_BAR (priv->progress_bar), tmp);
-	g_free (tmp);
-	
-	char *name = nemo_file_info_get_name (file);
-	tmp = g_strdup_printf (_("<i>Resizing \"%s\"</i>"), name);
-	g_free (name);
-	gtk_label_set_markup (GTK_LABEL (priv->progress_label), tmp);
-	g_free (tmp);
-	
+	nemo_image_batch_run (journal);
 }
 
 static void
@@ -326,7 +252,7 @@ nemo_image_resizer_response_cb (GtkDialog *dialog, gint response_id, gpointer us
 			priv->size = g_strdup_printf ("%dx%d", (int) gtk_spin_button_get_value (priv->width_spinbutton), (int) gtk_spin_button_get_value (priv->height_spinbutton));
 		}
 		
-		run_op (resizer);
+		run_ops (resizer);
 	}
 
 	gtk_widget_destroy (GTK_WIDGET (dialog));
@@ -26,6 +26,7 @@
 #endif
 
 #include "nemo-image-rotator.h"
+#include "nemo-image-batch.h"
 
 #include <string.h>
 
@@ -42,24 +43,18 @@ struct _NemoImageRotatorPrivate {
 	
 	gchar *suffix;
 	
-	int images_rotated;
-	int images_total;
-	gboolean cancelled;
-	
 	gchar *angle;
+	gboolean orientation_only;
 
 	GtkDialog *rotate_dialog;
 	GtkRadioButton *default_angle_radiobutton;
 	GtkComboBox *angle_combobox;
 	GtkRadioButton *custom_angle_radiobutton;
 	GtkSpinButton *angle_spinbutton;
+	GtkCheckButton *orientation_only_checkbutton;
 	GtkRadioButton *append_radiobutton;
 	GtkEntry *name_entry;
 	GtkRadioButton *inplace_radiobutton;
-
-	GtkWidget *progress_dialog;
-	GtkWidget *progress_bar;
-	GtkWidget *progress_label;
 };
 
 #define NEMO_IMAGE_ROTATOR_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), NEMO_TYPE_IMAGE_ROTATOR, NemoImageRotatorPrivate))
@@ -83,6 +78,7 @@ nemo_image_rotator_finalize(GObject *object)
 	NemoImageRotatorPrivate *priv = NEMO_IMAGE_ROTATOR_GET_PRIVATE (dialog);
 	
 	g_free (priv->suffix);
+	g_free (priv->angle);
 		
 	G_OBJECT_CLASS(nemo_image_rotator_parent_class)->finalize(object);
 }
@@ -99,7 +95,6 @@ nemo_image_rotator_set_property (GObject      *object,
 	switch (property_id) {
 	case PROP_FILES:
 		priv->files = g_value_get_pointer (value);
-		priv->images_total = g_list_length (priv->files);
 		break;
 	default:
 		/* We don't have any other property... */
@@ -150,8 +145,6 @@ nemo_image_rotator_class_init(NemoImageRotatorClass *klass)
 	files_param_spec);
 }
 
-static void run_op (NemoImageRotator *rotator);
-
 static GFile *
 nemo_image_rotator_transform_filename (NemoImageRotator *rotator, GFile *orig_file)
 {
@@ -185,118 +178,52 @@ nemo_image_rotator_transform_filename (NemoImageRotator *rotator, GFile *orig_fi
 }
 
 static void
-op_finished (GPid pid, gint status, gpointer data)
+run_ops (NemoImageRotator *rotator)
 {
-	NemoImageRotator *rotator = NEMO_IMAGE_ROTATOR (data);
 	NemoImageRotatorPrivate *priv = NEMO_IMAGE_ROTATOR_GET_PRIVATE (rotator);
-	
-	gboolean retry = TRUE;
-	
-	NemoFileInfo *file = NEMO_FILE_INFO (priv->files->data);
-	
-	if (status != 0) {
-		/* rotating failed */
-		char *name = nemo_file_info_get_name (file);
-
-		GtkWidget *msg_dialog = gtk_message_dialog_new (GTK_WINDOW (priv->progress_dialog),
-			GTK_DIALOG_DESTROY_WITH_PARENT, GTK_MESSAGE_ERROR,
-			GTK_BUTTONS_NONE,
-			"'%s' cannot be rotated. Check whether you have permission to write to this folder.",
-			name);
-		g_free (name);
-		
-		gtk_dialog_add_button (GTK_DIALOG (msg_dialog), _("_Skip"), 1);
-		gtk_dialog_add_button (GTK_DIALOG (msg_dialog), GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL);
-		gtk_dialog_add_button (GTK_DIALOG (msg_dialog), _("_Retry"), 0);
-		gtk_dialog_set_default_response (GTK_DIALOG (msg_dialog), 0);
-		
-		int response_id = gtk_dialog_run (GTK_DIALOG (msg_dialog));
-		gtk_widget_destroy (msg_dialog);
-		if (response_id == 0) {
-			retry = TRUE;
-		} else if (response_id == GTK_RESPONSE_CANCEL) {
-			priv->cancelled = TRUE;
-		} else if (response_id == 1) {
-			retry = FALSE;
-		}
-		
-	} else if (priv->suffix == NULL) {
-		/* rotate image in place */
-		GFile *orig_location = nemo_file_info_get_location (file);
-		GFile *new_location = nemo_image_rotator_transform_filename (rotator, orig_location);
-		g_file_move (new_location, orig_location, G_FILE_COPY_OVERWRITE, NULL, NULL, NULL, NULL);
-		g_object_unref (orig_location);
-		g_object_unref (new_location);
-	}
-
-	if (status == 0 || !retry) {
-		/* image has been successfully rotated (or skipped) */
-		priv->images_rotated++;
-		priv->files = priv->files->next;
-	}
-	
-	if (!priv->cancelled && priv->files != NULL) {
-		/* process next image */
-		run_op (rotator);
-	} else {
-		/* cancel/terminate operation */
-		gtk_widget_destroy (priv->progress_dialog);
-	}
-}
+	NemoImageJournal *journal;
+	GError *error = NULL;
+	gchar *quoted, *pipeline;
+	GList *l;
 
-static void
-run_op (NemoImageRotator *rotator)
-{
-	NemoImageRotatorPrivate *priv = NEMO_IMAGE_ROTATOR_GET_PRIVATE (rotator);
-	
 	g_return_if_fail (priv->files != NULL);
-	
-	NemoFileInfo *file = NEMO_FILE_INFO (priv->files->data);
 
-	GFile *orig_location = nemo_file_info_get_location (file);
-	char *filename = g_file_get_path (orig_location);
-	GFile *new_location = nemo_image_rotator_transform_filename (rotator, orig_location);
-	char *new_filename = g_file_get_path (new_location);
-	g_object_unref (orig_location);
-	g_object_unref (new_location);
+	journal = nemo_image_journal_new (&error);
+	if (journal == NULL) {
+		GtkWidget *msg_dialog = gtk_message_dialog_new (NULL, 0, GTK_MESSAGE_ERROR, GTK_BUTTONS_CLOSE,
+			"%s", error->message);
+		g_signal_connect (msg_dialog, "response", G_CALLBACK (gtk_widget_destroy), NULL);
+		gtk_widget_show (msg_dialog);
+		g_error_free (error);
+		return;
+	}
 
-	/* FIXME: check whether new_uri already exists and provide "Replace _All", "_Skip", and "_Replace" options */
-	
-	gchar *argv[8];
-	argv[0] = "/usr/bin/convert";
-	argv[1] = filename;
-	argv[2] = "-rotate";
-	argv[3] = priv->angle;
-	argv[4] = "-orient";
-	argv[5] = "TopLeft";
-	argv[6] = new_filename;
-	argv[7] = NULL;
-	
-	pid_t pid;
+	/* One step of the pipeline the queue runs */
+	quoted = g_shell_quote (priv->angle);
+	pipeline = g_strdup_printf ("-rotate %s", quoted);
+	nemo_image_journal_set (journal, "operation", "rotate");
+	nemo_image_journal_set (journal, "pipeline", pipeline);
+	g_free (pipeline);
+	g_free (quoted);
+	nemo_image_journal_set (journal, "orientation-only", priv->orientation_only ? "true" : "false");
+	nemo_image_journal_set (journal, "in-place", priv->suffix == NULL ? "true" : "false");
+
+	for (l = priv->files; l != NULL; l = l->next) {
+		GFile *orig_location = nemo_file_info_get_location (NEMO_FILE_INFO (l->data));
+		GFile *new_location = nemo_image_rotator_transform_filename (rotator, orig_location);
+		char *filename = g_file_get_path (orig_location);
+		char *new_filename = g_file_get_path (new_location);
 
-	if (!g_spawn_async (NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &pid, NULL)) {
-		// FIXME: error handling
-		return;
+		/* FIXME: check whether new_uri already exists and provide "Replace _All", "_Skip", and "_Replace" options */
+		nemo_image_journal_add_item (journal, filename, new_filename);
+
+		g_free (filename);
+		g_free (new_filename);
+		g_object_unref (orig_location);
+		g_object_unref (new_location);
 	}
-	
-	g_free (filename);
-	g_free (new_filename);
-	
-	g_child_watch_add (pid, op_finished, rotator);
-	
-	char *tmp;
 
-	gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (priv->progress_bar), (double) (priv->images_rotated + 1) / priv->images_total);
-	tmp = g_strdup_printf (_("Rotating image: %d of %d"), priv->images_rotated + 1, priv->images_total);
-	gtk_progress_bar_set_text (GTK_PROGRESS_BAR (priv->progress_bar), tmp);
-	g_free (tmp);
-	
-	char *name = nemo_file_info_get_name (file);
-	tmp = g_strdup_printf (_("<i>Rotating \"%s\"</i>"), name);
-	g_free (name);
-	gtk_label_set_markup (GTK_LABEL (priv->progress_label), tmp);
-	g_free (tmp);
-	
+	nemo_image_batch_run (journal);
 }
 
 static void
@@ -337,7 +264,9 @@ nemo_image_rotator_response_cb (GtkDialog *dialog, gint response_id, gpointer us
 			g_assert_not_reached ();
 		}
 		
-		run_op (rotator);
+		priv->orientation_only = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (priv->orientation_only_checkbutton));
+
+		run_ops (rotator);
 	}
 
 	gtk_widget_destroy (GTK_WIDGET (dialog));
@@ -376,6 +305,8 @@ nemo_image_rotator_init(NemoImageRotator *rotator)
 		GTK_RADIO_BUTTON (gtk_builder_get_object (ui, "custom_angle_radiobutton"));
 	priv->angle_spinbutton =
 		GTK_SPIN_BUTTON (gtk_builder_get_object (ui, "angle_spinbutton"));
+	priv->orientation_only_checkbutton =
+		GTK_CHECK_BUTTON (gtk_builder_get_object (ui, "orientation_only_checkbutton"));
 	priv->append_radiobutton =
 		GTK_RADIO_BUTTON (gtk_builder_get_object (ui, "append_radiobutton"));
 	priv->name_entry = GTK_ENTRY (gtk_builder_get_object (ui, "name_entry"));
@@ -0,0 +1,708 @@
+/*
+ *  nemo-image-scaler.c
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+ #include <config.h> /* for GETTEXT_PACKAGE */
+#endif
+
+#include "nemo-image-scaler.h"
+#include "nemo-image-jpeg.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#define READ_CHUNK_SIZE 65536
+
+/* Decoding is most of the work, saving gets the rest */
+#define DECODE_PROGRESS 900
+
+/* What convert writes JPEGs with when it can't tell the source quality */
+#define JPEG_QUALITY 92
+
+static gboolean
+parse_dimension (const gchar **p, gint *value)
+{
+	gchar *end;
+	gint64 n;
+
+	n = g_ascii_strtoll (*p, &end, 10);
+	if (end == *p || n <= 0 || n > G_MAXINT)
+		return FALSE;
+
+	*value = n;
+	*p = end;
+	return TRUE;
+}
+
+gboolean
+nemo_image_geometry_parse (const gchar *spec, NemoImageGeometry *geometry)
+{
+	const gchar *p;
+
+	g_return_val_if_fail (spec != NULL, FALSE);
+
+	memset (geometry, 0, sizeof (NemoImageGeometry));
+	p = spec;
+
+	while (g_ascii_isspace (*p))
+		p++;
+
+	if (g_ascii_isdigit (*p) && strchr (p, '%') != NULL) {
+		gchar *end;
+
+		geometry->percent = g_ascii_strtod (p, &end);
+		if (end == p || *end != '%' || geometry->percent <= 0)
+			return FALSE;
+		p = end + 1;
+	} else {
+		if (*p != 'x' && !parse_dimension (&p, &geometry->width))
+			return FALSE;
+		if (*p == 'x') {
+			p++;
+			if (!parse_dimension (&p, &geometry->height))
+				return FALSE;
+		}
+	}
+
+	switch (*p) {
+	case '!':
+		geometry->mode = NEMO_IMAGE_GEOMETRY_EXACT;
+		p++;
+		break;
+	case '>':
+		geometry->mode = NEMO_IMAGE_GEOMETRY_SHRINK_ONLY;
+		p++;
+		break;
+	case '<':
+		geometry->mode = NEMO_IMAGE_GEOMETRY_ENLARGE_ONLY;
+		p++;
+		break;
+	default:
+		geometry->mode = NEMO_IMAGE_GEOMETRY_FIT;
+		break;
+	}
+
+	while (g_ascii_isspace (*p))
+		p++;
+
+	return *p == '\0';
+}
+
+void
+nemo_image_geometry_apply (const NemoImageGeometry *geometry,
+                           gint width, gint height,
+                           gint *new_width, gint *new_height)
+{
+	gdouble x_scale, y_scale;
+
+	*new_width = width;
+	*new_height = height;
+
+	if (geometry->percent > 0) {
+		x_scale = y_scale = geometry->percent / 100.0;
+	} else {
+		x_scale = geometry->width > 0 ? (gdouble) geometry->width / width : 0;
+		y_scale = geometry->height > 0 ? (gdouble) geometry->height / height : 0;
+
+		if (geometry->mode != NEMO_IMAGE_GEOMETRY_EXACT) {
+			/* keep the aspect ratio, going by the tighter side */
+			if (x_scale == 0)
+				x_scale = y_scale;
+			else if (y_scale == 0)
+				y_scale = x_scale;
+			else
+				x_scale = y_scale = MIN (x_scale, y_scale);
+		} else {
+			if (x_scale == 0)
+				x_scale = 1.0;
+			if (y_scale == 0)
+				y_scale = 1.0;
+		}
+
+		if (geometry->mode == NEMO_IMAGE_GEOMETRY_SHRINK_ONLY && x_scale >= 1.0 && y_scale >= 1.0)
+			return;
+		if (geometry->mode == NEMO_IMAGE_GEOMETRY_ENLARGE_ONLY && (x_scale <= 1.0 || y_scale <= 1.0))
+			return;
+	}
+
+	*new_width = MAX (1, (gint) floor (width * x_scale + 0.5));
+	*new_height = MAX (1, (gint) floor (height * y_scale + 0.5));
+}
+
+typedef struct {
+	const NemoImageGeometry *geometry;
+	gint width;
+	gint height;
+} TargetSize;
+
+static void
+size_prepared_cb (GdkPixbufLoader *loader, gint width, gint height, gpointer user_data)
+{
+	TargetSize *target = user_data;
+	GdkPixbufFormat *format;
+	gchar *type;
+	gint denom;
+
+	nemo_image_geometry_apply (target->geometry, width, height, &target->width, &target->height);
+	if (target->width == width && target->height == height)
+		return;
+
+	format = gdk_pixbuf_loader_get_format (loader);
+	type = format != NULL ? gdk_pixbuf_format_get_name (format) : NULL;
+
+	if (g_strcmp0 (type, "jpeg") == 0) {
+		/* libjpeg can decode at 1/2, 1/4 or 1/8 the size, skipping most
+		 * of the work.  Ask for exactly one of those: for any other size
+		 * the loader makes a scaled copy itself, and that copy loses the
+		 * orientation and the colour profile. */
+		for (denom = 8; denom > 1; denom /= 2) {
+			gint scaled_width = (width + denom - 1) / denom;
+			gint scaled_height = (height + denom - 1) / denom;
+
+			if (scaled_width >= target->width && scaled_height >= target->height) {
+				gdk_pixbuf_loader_set_size (loader, scaled_width, scaled_height);
+				break;
+			}
+		}
+	} else if (format != NULL && gdk_pixbuf_format_is_scalable (format)) {
+		/* Vector formats render at the size, the rest are scaled
+		 * afterwards, keeping the options */
+		gdk_pixbuf_loader_set_size (loader, target->width, target->height);
+	}
+
+	g_free (type);
+}
+
+static GdkPixbuf *
+load_scaled (const gchar *src,
+             const NemoImageGeometry *geometry,
+             gboolean upright,
+             volatile gint *progress,
+             GCancellable *cancellable,
+             GError **error)
+{
+	GFile *file;
+	GFileInputStream *stream;
+	GFileInfo *info;
+	GdkPixbufLoader *loader;
+	GdkPixbuf *pixbuf = NULL;
+	goffset size, done = 0;
+	guchar *buffer;
+	gssize n_read;
+	gboolean ok = TRUE;
+	TargetSize target = { geometry, 0, 0 };
+
+	file = g_file_new_for_path (src);
+	stream = g_file_read (file, cancellable, error);
+	g_object_unref (file);
+	if (stream == NULL)
+		return NULL;
+
+	info = g_file_input_stream_query_info (stream, G_FILE_ATTRIBUTE_STANDARD_SIZE, cancellable, NULL);
+	size = info != NULL ? g_file_info_get_size (info) : 0;
+	g_clear_object (&info);
+
+	loader = gdk_pixbuf_loader_new ();
+	if (geometry != NULL)
+		g_signal_connect (loader, "size-prepared", G_CALLBACK (size_prepared_cb), &target);
+
+	buffer = g_malloc (READ_CHUNK_SIZE);
+
+	while (ok) {
+		n_read = g_input_stream_read (G_INPUT_STREAM (stream), buffer, READ_CHUNK_SIZE, cancellable, error);
+		if (n_read < 0) {
+			ok = FALSE;
+		} else if (n_read == 0) {
+			break;
+		} else if (!gdk_pixbuf_loader_write (loader, buffer, n_read, NULL)) {
+			/* Most likely a format GdkPixbuf has no loader for */
+			g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+			             _("Could not decode the image"));
+			ok = FALSE;
+		} else {
+			done += n_read;
+			if (size > 0)
+				g_atomic_int_set (progress, MIN (done * DECODE_PROGRESS / size, DECODE_PROGRESS));
+		}
+	}
+
+	g_free (buffer);
+	g_object_unref (stream);
+
+	if (!gdk_pixbuf_loader_close (loader, ok ? error : NULL)) {
+		if (ok && error != NULL && *error != NULL && (*error)->domain == GDK_PIXBUF_ERROR) {
+			g_clear_error (error);
+			g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+			             _("Could not decode the image"));
+		}
+		ok = FALSE;
+	}
+
+	if (ok) {
+		GdkPixbuf *loaded = gdk_pixbuf_loader_get_pixbuf (loader);
+
+		/* Loaders without incremental scaling hand back the full image,
+		 * JPEGs come at the nearest size libjpeg can decode to */
+		if (geometry != NULL &&
+		    (gdk_pixbuf_get_width (loaded) != target.width || gdk_pixbuf_get_height (loaded) != target.height)) {
+			GdkPixbuf *scaled = gdk_pixbuf_scale_simple (loaded, target.width, target.height, GDK_INTERP_BILINEAR);
+			/* keep the options, orientation is among them */
+			gdk_pixbuf_copy_options (loaded, scaled);
+			loaded = scaled;
+		} else {
+			g_object_ref (loaded);
+		}
+
+		if (upright) {
+			const gchar *icc_profile = gdk_pixbuf_get_option (loaded, "icc-profile");
+
+			pixbuf = gdk_pixbuf_apply_embedded_orientation (loaded);
+			/* Turning the pixels only keeps the options some of the time */
+			if (icc_profile != NULL && gdk_pixbuf_get_option (pixbuf, "icc-profile") == NULL)
+				gdk_pixbuf_set_option (pixbuf, "icc-profile", icc_profile);
+			g_object_unref (loaded);
+		} else {
+			pixbuf = loaded;
+		}
+	}
+
+	g_object_unref (loader);
+
+	return pixbuf;
+}
+
+/* Whether a smaller copy of a width x height image has enough pixels for
+ * target_width x target_height, and the same shape up to rounding */
+static gboolean
+is_adequate (GdkPixbuf *pixbuf, gint width, gint height, gint target_width, gint target_height)
+{
+	gint64 pixbuf_width = gdk_pixbuf_get_width (pixbuf);
+	gint64 pixbuf_height = gdk_pixbuf_get_height (pixbuf);
+
+	if (pixbuf_width < target_width || pixbuf_height < target_height)
+		return FALSE;
+
+	/* Letterboxed EXIF thumbnails and the like are a different shape */
+	return ABS (pixbuf_width * height - pixbuf_height * width) <= (width + height) / 2;
+}
+
+/* A freedesktop.org thumbnail is only good while it carries the URI and
+ * modification time of the file it was made from */
+static gboolean
+is_thumbnail_current (GdkPixbuf *thumbnail, const gchar *thumbnail_path,
+                      const gchar *uri, GStatBuf *src_stat)
+{
+	const gchar *thumb_uri, *thumb_mtime;
+	GStatBuf thumbnail_stat;
+
+	thumb_uri = gdk_pixbuf_get_option (thumbnail, "tEXt::Thumb::URI");
+	thumb_mtime = gdk_pixbuf_get_option (thumbnail, "tEXt::Thumb::MTime");
+
+	if (g_strcmp0 (thumb_uri, uri) != 0 || thumb_mtime == NULL ||
+	    g_ascii_strtoll (thumb_mtime, NULL, 10) != (gint64) src_stat->st_mtime)
+		return FALSE;
+
+	return g_stat (thumbnail_path, &thumbnail_stat) == 0 && thumbnail_stat.st_mtime >= src_stat->st_mtime;
+}
+
+/* Looks through the thumbnail cache, biggest thumbnails first, for one
+ * that can stand in for the upright width x height image */
+static GdkPixbuf *
+load_cached_thumbnail (const gchar *src, gint width, gint height, gint target_width, gint target_height)
+{
+	static const gchar *sizes[] = { "xx-large", "x-large", "large", "normal" };
+	GStatBuf src_stat;
+	GdkPixbuf *found = NULL;
+	gchar *uri, *name;
+	guint i;
+
+	if (g_stat (src, &src_stat) != 0)
+		return NULL;
+
+	uri = g_filename_to_uri (src, NULL, NULL);
+	if (uri == NULL)
+		return NULL;
+
+	name = g_compute_checksum_for_string (G_CHECKSUM_MD5, uri, -1);
+
+	for (i = 0; i < G_N_ELEMENTS (sizes) && found == NULL; i++) {
+		gchar *basename = g_strconcat (name, ".png", NULL);
+		gchar *path = g_build_filename (g_get_user_cache_dir (), "thumbnails", sizes[i], basename, NULL);
+		GdkPixbuf *thumbnail = gdk_pixbuf_new_from_file (path, NULL);
+
+		if (thumbnail != NULL) {
+			if (is_thumbnail_current (thumbnail, path, uri, &src_stat) &&
+			    is_adequate (thumbnail, width, height, target_width, target_height))
+				found = thumbnail;
+			else
+				g_object_unref (thumbnail);
+		}
+
+		g_free (path);
+		g_free (basename);
+	}
+
+	g_free (name);
+	g_free (uri);
+
+	return found;
+}
+
+static GdkPixbuf *
+load_exif_thumbnail (const gchar *src, gint width, gint height, gint target_width, gint target_height)
+{
+	GdkPixbufLoader *loader;
+	GdkPixbuf *thumbnail = NULL;
+	GBytes *bytes;
+
+	bytes = nemo_image_jpeg_get_exif_thumbnail (src);
+	if (bytes == NULL)
+		return NULL;
+
+	loader = gdk_pixbuf_loader_new ();
+	if (gdk_pixbuf_loader_write_bytes (loader, bytes, NULL) && gdk_pixbuf_loader_close (loader, NULL)) {
+		thumbnail = gdk_pixbuf_loader_get_pixbuf (loader);
+		if (thumbnail != NULL && is_adequate (thumbnail, width, height, target_width, target_height))
+			g_object_ref (thumbnail);
+		else
+			thumbnail = NULL;
+	} else {
+		gdk_pixbuf_loader_close (loader, NULL);
+	}
+
+	g_object_unref (loader);
+	g_bytes_unref (bytes);
+
+	return thumbnail;
+}
+
+/* For small sizes a thumbnail someone already made is as good as the
+ * original and far quicker to load.  The output has the size the full
+ * image would have given, so thumbnails are only ever scaled down. */
+static GdkPixbuf *
+load_from_thumbnail (const gchar *src, const NemoImageGeometry *geometry, gboolean need_icc_profile)
+{
+	GdkPixbufFormat *format;
+	GdkPixbuf *thumbnail, *scaled, *pixbuf;
+	NemoImageMetadata metadata;
+	gint width, height, target_width, target_height;
+	guint orientation = 1;
+	gboolean is_jpeg, transposed;
+	gchar *type, *value;
+
+	format = gdk_pixbuf_get_file_info (src, &width, &height);
+	if (format == NULL)
+		return NULL;
+
+	/* The orientation has to be known to match the thumbnails, which are
+	 * stored upright, so leave formats that may carry it in other ways
+	 * to the full path */
+	type = gdk_pixbuf_format_get_name (format);
+	is_jpeg = strcmp (type, "jpeg") == 0;
+	if (is_jpeg)
+		orientation = nemo_image_jpeg_get_orientation (src);
+	else if (strcmp (type, "png") != 0 && strcmp (type, "gif") != 0 && strcmp (type, "bmp") != 0)
+		width = height = 0;
+	g_free (type);
+
+	if (width <= 0 || height <= 0)
+		return NULL;
+
+	/* Thumbnails have no colour profile of their own to pass on, which
+	 * only matters when it isn't copied from the file instead */
+	if (need_icc_profile) {
+		nemo_image_scaler_get_metadata (src, &metadata);
+		if (metadata.has_icc_profile)
+			return NULL;
+	}
+
+	nemo_image_geometry_apply (geometry, width, height, &target_width, &target_height);
+	if (target_width >= width || target_height >= height)
+		return NULL;
+
+	transposed = orientation >= 5;
+
+	thumbnail = transposed ? load_cached_thumbnail (src, height, width, target_height, target_width)
+	                       : load_cached_thumbnail (src, width, height, target_width, target_height);
+	if (thumbnail != NULL) {
+		pixbuf = gdk_pixbuf_scale_simple (thumbnail,
+		                                  transposed ? target_height : target_width,
+		                                  transposed ? target_width : target_height,
+		                                  GDK_INTERP_BILINEAR);
+		g_object_unref (thumbnail);
+		return pixbuf;
+	}
+
+	if (!is_jpeg)
+		return NULL;
+
+	thumbnail = load_exif_thumbnail (src, width, height, target_width, target_height);
+	if (thumbnail == NULL)
+		return NULL;
+
+	/* Like the image itself the EXIF thumbnail still has to be turned */
+	scaled = gdk_pixbuf_scale_simple (thumbnail, target_width, target_height, GDK_INTERP_BILINEAR);
+	g_object_unref (thumbnail);
+
+	value = g_strdup_printf ("%u", orientation);
+	gdk_pixbuf_set_option (scaled, "orientation", value);
+	g_free (value);
+
+	pixbuf = gdk_pixbuf_apply_embedded_orientation (scaled);
+	g_object_unref (scaled);
+
+	return pixbuf;
+}
+
+static gboolean
+png_has_keyword (const guchar *keyword, gsize length, const gchar *name)
+{
+	gsize name_length = strlen (name) + 1;
+
+	return length >= name_length && memcmp (keyword, name, name_length) == 0;
+}
+
+/* PNG keeps EXIF in an eXIf chunk or, as ImageMagick writes it, in a
+ * text chunk; XMP always goes in iTXt */
+static void
+png_get_metadata (const gchar *filename, NemoImageMetadata *metadata)
+{
+	static const guchar signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	guchar header[8], keyword[32];
+	gsize length, n;
+	FILE *f;
+
+	f = g_fopen (filename, "rb");
+	if (f == NULL)
+		return;
+
+	if (fread (header, 1, sizeof (signature), f) != sizeof (signature) ||
+	    memcmp (header, signature, sizeof (signature)) != 0)
+		goto out;
+
+	while (fread (header, 1, sizeof (header), f) == sizeof (header)) {
+		length = (gsize) header[0] << 24 | header[1] << 16 | header[2] << 8 | header[3];
+
+		if (memcmp (header + 4, "IEND", 4) == 0)
+			break;
+
+		if (memcmp (header + 4, "eXIf", 4) == 0) {
+			metadata->has_exif = TRUE;
+		} else if (memcmp (header + 4, "iCCP", 4) == 0) {
+			metadata->has_icc_profile = TRUE;
+		} else if (memcmp (header + 4, "iTXt", 4) == 0 ||
+		           memcmp (header + 4, "tEXt", 4) == 0 ||
+		           memcmp (header + 4, "zTXt", 4) == 0) {
+			n = MIN (length, sizeof (keyword));
+			if (fread (keyword, 1, n, f) != n)
+				break;
+			length -= n;
+
+			if (png_has_keyword (keyword, n, "XML:com.adobe.xmp") ||
+			    png_has_keyword (keyword, n, "Raw profile type exif") ||
+			    png_has_keyword (keyword, n, "Raw profile type APP1") ||
+			    png_has_keyword (keyword, n, "Raw profile type xmp"))
+				metadata->has_exif = TRUE;
+		}
+
+		/* The rest of the data, and the CRC */
+		if (fseek (f, (glong) length + 4, SEEK_CUR) != 0)
+			break;
+	}
+
+out:
+	fclose (f);
+}
+
+void
+nemo_image_scaler_get_metadata (const gchar *src, NemoImageMetadata *metadata)
+{
+	static const gchar *bare[] = { "gif", "bmp", "ico", "pnm", "tga", "xbm", "xpm" };
+	GdkPixbufFormat *format;
+	gboolean is_bare = FALSE;
+	gchar *type;
+	guint i;
+
+	memset (metadata, 0, sizeof (NemoImageMetadata));
+
+	format = gdk_pixbuf_get_file_info (src, NULL, NULL);
+	if (format == NULL)
+		return;
+
+	type = gdk_pixbuf_format_get_name (format);
+
+	if (strcmp (type, "jpeg") == 0) {
+		nemo_image_jpeg_get_metadata (src, &metadata->has_exif, &metadata->has_icc_profile,
+		                              &metadata->quality);
+	} else if (strcmp (type, "png") == 0) {
+		png_get_metadata (src, metadata);
+	} else {
+		for (i = 0; i < G_N_ELEMENTS (bare); i++)
+			is_bare |= strcmp (type, bare[i]) == 0;
+
+		/* TIFF, WebP and the like could carry anything */
+		if (!is_bare) {
+			metadata->has_exif = TRUE;
+			metadata->has_icc_profile = TRUE;
+		}
+	}
+
+	g_free (type);
+}
+
+static GdkPixbufFormat *
+find_writable_format (const gchar *dest)
+{
+	GSList *formats, *l;
+	GdkPixbufFormat *found = NULL;
+	const gchar *dot;
+	gchar **extensions;
+	int i;
+
+	dot = strrchr (dest, '.');
+	if (dot == NULL || strchr (dot, G_DIR_SEPARATOR) != NULL)
+		return NULL;
+
+	formats = gdk_pixbuf_get_formats ();
+
+	for (l = formats; l != NULL && found == NULL; l = l->next) {
+		GdkPixbufFormat *format = l->data;
+
+		if (!gdk_pixbuf_format_is_writable (format) || gdk_pixbuf_format_is_disabled (format))
+			continue;
+
+		extensions = gdk_pixbuf_format_get_extensions (format);
+		for (i = 0; extensions[i] != NULL; i++) {
+			if (g_ascii_strcasecmp (extensions[i], dot + 1) == 0) {
+				found = format;
+				break;
+			}
+		}
+		g_strfreev (extensions);
+	}
+
+	g_slist_free (formats);
+
+	return found;
+}
+
+GdkPixbuf *
+nemo_image_scaler_load (const gchar *src,
+                        const NemoImageGeometry *geometry,
+                        gboolean upright,
+                        gboolean need_icc_profile,
+                        volatile gint *progress,
+                        GCancellable *cancellable,
+                        GError **error)
+{
+	GdkPixbuf *pixbuf = NULL;
+
+	g_atomic_int_set (progress, 0);
+
+	/* Thumbnails are stored upright, so they can't stand in otherwise */
+	if (geometry != NULL && upright)
+		pixbuf = load_from_thumbnail (src, geometry, need_icc_profile);
+	if (pixbuf == NULL)
+		pixbuf = load_scaled (src, geometry, upright, progress, cancellable, error);
+
+	return pixbuf;
+}
+
+gboolean
+nemo_image_scaler_can_save (const gchar *dest)
+{
+	return find_writable_format (dest) != NULL;
+}
+
+gboolean
+nemo_image_scaler_can_save_metadata (const gchar *src, const gchar *dest)
+{
+	GdkPixbufFormat *format;
+	gchar *type;
+	gboolean is_jpeg;
+
+	format = find_writable_format (dest);
+	if (format == NULL)
+		return FALSE;
+
+	type = gdk_pixbuf_format_get_name (format);
+	is_jpeg = strcmp (type, "jpeg") == 0;
+	g_free (type);
+
+	return is_jpeg && nemo_image_jpeg_is_jpeg (src);
+}
+
+gboolean
+nemo_image_scaler_save (GdkPixbuf *pixbuf,
+                        const gchar *dest,
+                        gint quality,
+                        const gchar *icc_profile,
+                        const gchar *metadata_src,
+                        GError **error)
+{
+	GdkPixbufFormat *format;
+	gchar *type, *value = NULL;
+	gchar *keys[3] = { NULL, }, *values[3] = { NULL, };
+	gint n_options = 0;
+	gboolean ok;
+
+	format = find_writable_format (dest);
+	if (format == NULL) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+		             _("Could not write this image format"));
+		return FALSE;
+	}
+
+	type = gdk_pixbuf_format_get_name (format);
+
+	/* GdkPixbuf writes no EXIF or XMP, only the colour profile; from a
+	 * JPEG they are all copied over afterwards */
+	if (strcmp (type, "jpeg") == 0) {
+		if (metadata_src != NULL)
+			icc_profile = NULL;
+
+		value = g_strdup_printf ("%d", quality > 0 ? MIN (quality, 100) : JPEG_QUALITY);
+		keys[n_options] = "quality";
+		values[n_options++] = value;
+	}
+
+	if (icc_profile != NULL &&
+	    (strcmp (type, "jpeg") == 0 || strcmp (type, "png") == 0 || strcmp (type, "tiff") == 0)) {
+		keys[n_options] = "icc-profile";
+		values[n_options++] = (gchar *) icc_profile;
+	}
+
+	ok = gdk_pixbuf_savev (pixbuf, dest, type, keys, values, error);
+	g_free (value);
+
+	if (ok && metadata_src != NULL && strcmp (type, "jpeg") == 0)
+		ok = nemo_image_jpeg_copy_metadata (metadata_src, dest, error);
+
+	if (!ok)
+		g_unlink (dest);
+
+	g_free (type);
+
+	return ok;
+}
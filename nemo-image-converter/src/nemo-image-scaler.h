@@ -0,0 +1,108 @@
+/*
+ *  nemo-image-scaler.h
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#ifndef NEMO_IMAGE_SCALER_H
+#define NEMO_IMAGE_SCALER_H
+
+#include <gio/gio.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+G_BEGIN_DECLS
+
+/* Progress of a single image, in thousandths */
+#define NEMO_IMAGE_SCALER_PROGRESS_DONE 1000
+
+typedef enum {
+	NEMO_IMAGE_GEOMETRY_FIT,         /* WxH: fit inside the box, keeping the aspect ratio */
+	NEMO_IMAGE_GEOMETRY_EXACT,       /* WxH!: ignore the aspect ratio */
+	NEMO_IMAGE_GEOMETRY_SHRINK_ONLY, /* WxH>: only make larger images smaller */
+	NEMO_IMAGE_GEOMETRY_ENLARGE_ONLY /* WxH<: only make smaller images larger */
+} NemoImageGeometryMode;
+
+/* The subset of ImageMagick's -resize geometry the size dialog produces:
+ * "640x480", "640", "x480" and "50%", optionally followed by '!', '>'
+ * or '<'.  It gives the same output dimensions convert does.
+ */
+typedef struct {
+	gint width;      /* 0 if unconstrained */
+	gint height;     /* 0 if unconstrained */
+	gdouble percent; /* > 0 for a relative size, width and height are unused */
+	NemoImageGeometryMode mode;
+} NemoImageGeometry;
+
+gboolean nemo_image_geometry_parse (const gchar             *spec,
+                                    NemoImageGeometry       *geometry);
+void     nemo_image_geometry_apply (const NemoImageGeometry *geometry,
+                                    gint                     width,
+                                    gint                     height,
+                                    gint                    *new_width,
+                                    gint                    *new_height);
+
+typedef struct {
+	gboolean has_exif;        /* or XMP, which GdkPixbuf can't write back */
+	gboolean has_icc_profile;
+	gint quality;             /* of a JPEG, 0 if it can't be told */
+} NemoImageMetadata;
+
+/* What src carries that convert would keep.  Formats this can't look
+ * into are assumed to carry everything. */
+void       nemo_image_scaler_get_metadata (const gchar       *src,
+                                           NemoImageMetadata *metadata);
+
+/* Loads src, scaled down to geometry while decoding if it isn't NULL.
+ * With upright the EXIF orientation is applied, and small sizes may be
+ * made from the thumbnail cache or the EXIF thumbnail instead; otherwise
+ * the pixels are returned as stored.  With need_icc_profile the colour
+ * profile has to come as the "icc-profile" option, so images that have
+ * one are always decoded.  Fails with G_IO_ERROR_NOT_SUPPORTED
+ * if GdkPixbuf can't read src, in which case the caller should fall back
+ * to convert.  progress is updated atomically up to most of the way, so
+ * it can be polled from another thread.
+ */
+GdkPixbuf *nemo_image_scaler_load     (const gchar             *src,
+                                       const NemoImageGeometry *geometry,
+                                       gboolean                 upright,
+                                       gboolean                 need_icc_profile,
+                                       volatile gint           *progress,
+                                       GCancellable            *cancellable,
+                                       GError                 **error);
+
+/* Whether GdkPixbuf can write the format dest's extension asks for */
+gboolean   nemo_image_scaler_can_save (const gchar             *dest);
+
+/* Whether nemo_image_scaler_save() can carry the EXIF, XMP and colour
+ * profile of src over to dest, which it can only from JPEG to JPEG */
+gboolean   nemo_image_scaler_can_save_metadata (const gchar    *src,
+                                                const gchar    *dest);
+
+/* Saves in the format of dest's extension.  quality only applies to
+ * JPEG, 0 picks the same default convert uses.  icc_profile is the
+ * "icc-profile" option of a loaded pixbuf, or NULL.  metadata_src, if
+ * not NULL, is a JPEG whose metadata is copied to a JPEG dest instead,
+ * see nemo_image_scaler_can_save_metadata(). */
+gboolean   nemo_image_scaler_save     (GdkPixbuf               *pixbuf,
+                                       const gchar             *dest,
+                                       gint                     quality,
+                                       const gchar             *icc_profile,
+                                       const gchar             *metadata_src,
+                                       GError                 **error);
+
+G_END_DECLS
+
+#endif /* NEMO_IMAGE_SCALER_H */
@@ -28,7 +28,7 @@ setup( packages=[],
     #                     'pymediainfo'
     #                     'stopit'],
     data_files   = [
-        ('/usr/share/nemo-python/extensions', ['nemo-media-columns.py']),
+        ('/usr/share/nemo-python/extensions', ['nemo-media-columns.py', 'nemo-media-columns.nemo-python']),
         ('/usr/bin',                          ['nemo-media-columns-prefs']),
         ('/usr/share/glib-2.0/schemas',       ['org.nemo.extensions.nemo-media-columns.gschema.xml'])
     ]
@@ -34,7 +34,7 @@ data_files = [
     ('/usr/share/glib-2.0/schemas', ['data/nemo-pastebin.gschema.xml']),
     ('/usr/bin', ['src/nemo-pastebin-configurator']),
     ('/usr/share/nemo-pastebin', get_app_path_files()),
-    ('/usr/share/nemo-python/extensions', ['src/nemo-pastebin.py'])
+    ('/usr/share/nemo-python/extensions', ['src/nemo-pastebin.py', 'src/nemo-pastebin.nemo-python'])
 ]
 
 pkg_short_dsc = "Nemo extension to send files to a pastebin"
@@ -28,6 +28,7 @@
 imports.gi.versions.Gtk = '3.0';
 imports.gi.versions.GtkSource = '4';
 
+const Gdk = imports.gi.Gdk;
 const Gtk = imports.gi.Gtk;
 const GtkClutter = imports.gi.GtkClutter;
 const GLib = imports.gi.GLib;
@@ -35,10 +36,17 @@ const GtkSource = imports.gi.GtkSource;
 const Gio = imports.gi.Gio;
 const NemoPreview = imports.gi.NemoPreview;
 
+const Gettext = imports.gettext.domain('nemo-extensions');
+const _ = Gettext.gettext;
+
 const MimeHandler = imports.ui.mimeHandler;
 const Utils = imports.ui.utils;
 
 const Lang = imports.lang;
+const Mainloop = imports.mainloop;
+
+const MAPPED_SNIFF_BYTES = 64 * 1024;
+const MAPPED_SCROLL_LINES = 3;
 
 function TextRenderer(args) {
     this._init(args);
@@ -58,6 +66,27 @@ TextRenderer.prototype = {
         this._textLoader = new NemoPreview.TextLoader();
         this._textLoader.connect('loaded',
                                  Lang.bind(this, this._onBufferLoaded));
+        this._textLoader.connect('notify::truncated',
+                                 Lang.bind(this, this._updateTruncated));
+
+        // files too big to load are mapped in and shown a screenful
+        // at a time; the loader then only has to find the language
+        this._mapped = null;
+        if (file.is_native()) {
+            try {
+                let info = file.query_info(Gio.FILE_ATTRIBUTE_STANDARD_SIZE,
+                                           Gio.FileQueryInfoFlags.NONE, null);
+                if (info.get_size() > this._textLoader.max_bytes) {
+                    this._mapped = NemoPreview.MappedText.new(file.get_uri());
+                    this._textLoader.max_bytes = MAPPED_SNIFF_BYTES;
+                    // the mapped text shows invalid bytes itself
+                    this._textLoader.accept_invalid = true;
+                }
+            } catch (e) {
+                this._mapped = null;
+            }
+        }
+
         this._textLoader.uri = file.get_uri();
 
         this._geditScheme = 'tango';
@@ -76,7 +105,28 @@ TextRenderer.prototype = {
         return this._actor;
     },
 
+    clear : function() {
+        // stops a read or an index still going, rather than waiting
+        // for the loader or the mapping to be collected
+        if (this._textLoader) {
+            this._textLoader.run_dispose();
+            this._textLoader = null;
+        }
+
+        if (this._mapped) {
+            if (this._nLinesId) {
+                this._mapped.disconnect(this._nLinesId);
+                this._nLinesId = 0;
+            }
+            this._mapped.run_dispose();
+            this._mapped = null;
+        }
+    },
+
     _onBufferLoaded : function(loader, buffer) {
+        if (this._mapped)
+            buffer = new GtkSource.Buffer({ language: buffer.get_language() });
+
         this._buffer = buffer;
         this._buffer.highlight_syntax = true;
 
@@ -89,7 +139,9 @@ TextRenderer.prototype = {
                                           cursor_visible: false });
         this._view.set_can_focus(false);
 
-        if (this._buffer.get_language())
+        // the buffer only ever holds the visible lines when mapped,
+        // so its line numbers would be wrong
+        if (this._buffer.get_language() && !this._mapped)
             this._view.set_show_line_numbers(true);
 
         // FIXME: *very* ugly wokaround to the fact that we can't
@@ -102,13 +154,123 @@ TextRenderer.prototype = {
 
         this._scrolledWin = Gtk.ScrolledWindow.new(null, null);
         this._scrolledWin.add(this._view);
-        this._scrolledWin.show_all();
 
-        this._actor = new GtkClutter.Actor({ contents: this._scrolledWin });
+        let content = this._scrolledWin;
+        if (this._mapped)
+            content = this._createMappedView();
+
+        // only shown when the file was too big to load all of it
+        this._truncatedBar = new Gtk.InfoBar({ message_type: Gtk.MessageType.INFO });
+        this._truncatedBar.get_content_area().add(
+            new Gtk.Label({ label: _("Only the beginning of this file is shown.") }));
+
+        this._box = new Gtk.Box({ orientation: Gtk.Orientation.VERTICAL });
+        this._box.pack_start(this._truncatedBar, false, false, 0);
+        this._box.pack_start(content, true, true, 0);
+        this._box.show_all();
+        this._updateTruncated();
+
+        this._actor = new GtkClutter.Actor({ contents: this._box });
         this._actor.set_reactive(true);
         this._callback();
     },
 
+    _updateTruncated : function() {
+        if (this._truncatedBar && this._textLoader)
+            this._truncatedBar.set_visible(this._textLoader.truncated &&
+                                           !this._mapped);
+    },
+
+    _createMappedView : function() {
+        this._visibleLines = 1;
+        this._adjustment = new Gtk.Adjustment({ lower: 0,
+                                                upper: this._mapped.n_lines,
+                                                step_increment: 1,
+                                                page_increment: 1,
+                                                page_size: 1 });
+        this._adjustment.connect('value-changed',
+                                 Lang.bind(this, this._updateMappedLines));
+        this._nLinesId = this._mapped.connect('notify::n-lines',
+                                              Lang.bind(this, function() {
+                                                  this._adjustment.upper = this._mapped.n_lines;
+                                                  this._updateMappedLines();
+                                              }));
+
+        // the text view never scrolls vertically; this scrollbar moves
+        // through the whole file instead
+        this._scrolledWin.set_policy(Gtk.PolicyType.AUTOMATIC,
+                                     Gtk.PolicyType.NEVER);
+        this._scrolledWin.connect('size-allocate',
+                                  Lang.bind(this, this._onMappedSizeAllocate));
+        this._scrolledWin.connect('scroll-event',
+                                  Lang.bind(this, this._onMappedScroll));
+
+        let scrollbar = new Gtk.Scrollbar({ orientation: Gtk.Orientation.VERTICAL,
+                                            adjustment: this._adjustment });
+
+        let box = new Gtk.Box({ orientation: Gtk.Orientation.HORIZONTAL });
+        box.pack_start(this._scrolledWin, true, true, 0);
+        box.pack_start(scrollbar, false, false, 0);
+
+        this._updateMappedLines();
+
+        return box;
+    },
+
+    _onMappedSizeAllocate : function(widget, allocation) {
+        let layout = this._view.create_pango_layout('X');
+        let [, lineHeight] = layout.get_pixel_size();
+        let visibleLines = Math.max(1, Math.floor(allocation.height / Math.max(1, lineHeight)));
+
+        if (visibleLines == this._visibleLines)
+            return;
+
+        this._visibleLines = visibleLines;
+        this._adjustment.page_size = visibleLines;
+        this._adjustment.page_increment = visibleLines;
+
+        // setting the text from inside an allocation would queue another
+        Mainloop.idle_add(Lang.bind(this, function() {
+            this._updateMappedLines();
+            return false;
+        }));
+    },
+
+    _onMappedScroll : function(widget, event) {
+        let delta = 0;
+        let direction = event.get_scroll_direction()[1];
+
+        if (direction == Gdk.ScrollDirection.UP)
+            delta = -MAPPED_SCROLL_LINES;
+        else if (direction == Gdk.ScrollDirection.DOWN)
+            delta = MAPPED_SCROLL_LINES;
+        else if (direction == Gdk.ScrollDirection.SMOOTH)
+            delta = event.get_scroll_deltas()[2] * MAPPED_SCROLL_LINES;
+        else
+            return false;
+
+        let upper = this._adjustment.upper - this._adjustment.page_size;
+        this._adjustment.value = Math.max(0, Math.min(upper, this._adjustment.value + delta));
+
+        return true;
+    },
+
+    _updateMappedLines : function() {
+        // an idle from the last allocation can come after clear()
+        if (!this._mapped)
+            return;
+
+        let first = Math.floor(this._adjustment.value);
+        let text = this._mapped.get_lines(first, this._visibleLines);
+
+        if (first == this._mappedFirst && text == this._mappedText)
+            return;
+
+        this._mappedFirst = first;
+        this._mappedText = text;
+        this._buffer.set_text(text, -1);
+    },
+
     getSizeForAllocation : function(allocation) {
         return allocation;
     },
@@ -0,0 +1,492 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA.
+ *
+ * The NemoPreview project hereby grant permission for non-gpl compatible GStreamer
+ * plugins to be used and distributed together with GStreamer and NemoPreview. This
+ * permission is above and beyond the permissions granted by the GPL license
+ * NemoPreview is covered by.
+ *
+ */
+
+#include "nemo-preview-mapped-text.h"
+
+#include <gio/gio.h>
+
+#include <setjmp.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* A text file too big to load, mapped in and read a few lines at a time.
+ * A thread indexes where every INDEX_STEP-th line starts, so memory use
+ * stays small however big the file is.
+ *
+ * A file truncated in place, as logrotate does, leaves pages of the
+ * mapping that raise SIGBUS when read. Every read of the mapping sets a
+ * jump for the handler, and stops at what was read up to then. */
+
+#define INDEX_STEP      1024
+#define SCAN_BLOCK      (16 * 1024 * 1024)
+#define MAX_LINE_LENGTH 4096
+#define NOTIFY_INTERVAL (100 * 1000)    /* microseconds */
+
+G_DEFINE_TYPE (NemoPreviewMappedText, nemo_preview_mapped_text, G_TYPE_OBJECT);
+
+enum {
+  PROP_N_LINES = 1,
+  PROP_INDEXED,
+  NUM_PROPERTIES
+};
+
+static GParamSpec* properties[NUM_PROPERTIES] = { NULL, };
+
+/* Set by a thread while it reads the mapping */
+static GPrivate sigbus_jump;
+static struct sigaction old_sigbus;
+
+struct _NemoPreviewMappedTextPrivate {
+  GMappedFile *mapped;
+  const gchar *contents;
+  gsize length;
+
+  GThread *thread;
+  volatile gint stop;
+
+  /* Protects everything from here on */
+  GMutex lock;
+  GArray *index;          /* Offset of every INDEX_STEP-th line */
+  guint n_lines;          /* Lines indexed so far */
+  gboolean indexed;
+};
+
+static gboolean
+notify_idle_cb (gpointer user_data)
+{
+  NemoPreviewMappedText *self = user_data;
+  gboolean indexed;
+
+  g_mutex_lock (&self->priv->lock);
+  indexed = self->priv->indexed;
+  g_mutex_unlock (&self->priv->lock);
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_N_LINES]);
+  if (indexed)
+    g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_INDEXED]);
+
+  return FALSE;
+}
+
+static void
+schedule_notify (NemoPreviewMappedText *self)
+{
+  g_idle_add_full (G_PRIORITY_DEFAULT_IDLE, notify_idle_cb,
+                   g_object_ref (self), g_object_unref);
+}
+
+static void
+sigbus_handler (int sig)
+{
+  sigjmp_buf *jump = g_private_get (&sigbus_jump);
+
+  if (jump != NULL)
+    siglongjmp (*jump, 1);
+
+  /* Not a read of ours, so whatever was there before deals with it */
+  sigaction (SIGBUS, &old_sigbus, NULL);
+  raise (SIGBUS);
+}
+
+static void
+install_sigbus_handler (void)
+{
+  struct sigaction sa;
+
+  memset (&sa, 0, sizeof (sa));
+  sa.sa_handler = sigbus_handler;
+  sigemptyset (&sa.sa_mask);
+  sigaction (SIGBUS, &sa, &old_sigbus);
+}
+
+/* Counts the lines in a block, adding every INDEX_STEP-th to the index.
+ * Returns FALSE if the file was cut short under the mapping. */
+static gboolean
+index_block (NemoPreviewMappedTextPrivate *priv,
+             const gchar *block,
+             const gchar *block_end,
+             guint *n_lines)
+{
+  sigjmp_buf jump;
+  const gchar *p, *nl;
+  guint64 offset;
+  guint n = *n_lines;
+
+  if (sigsetjmp (jump, 1) != 0) {
+    g_private_set (&sigbus_jump, NULL);
+    return FALSE;
+  }
+
+  g_private_set (&sigbus_jump, &jump);
+
+  for (p = block; p < block_end; p = nl + 1) {
+    nl = memchr (p, '\n', block_end - p);
+    if (nl == NULL)
+      break;
+
+    if (++n % INDEX_STEP == 0) {
+      offset = nl + 1 - priv->contents;
+      g_mutex_lock (&priv->lock);
+      g_array_append_val (priv->index, offset);
+      g_mutex_unlock (&priv->lock);
+    }
+  }
+
+  g_private_set (&sigbus_jump, NULL);
+
+  *n_lines = n;
+  return TRUE;
+}
+
+static gboolean
+ends_in_newline (NemoPreviewMappedTextPrivate *priv)
+{
+  sigjmp_buf jump;
+  gboolean ret;
+
+  if (sigsetjmp (jump, 1) != 0) {
+    g_private_set (&sigbus_jump, NULL);
+    return TRUE;
+  }
+
+  g_private_set (&sigbus_jump, &jump);
+  ret = priv->contents[priv->length - 1] == '\n';
+  g_private_set (&sigbus_jump, NULL);
+
+  return ret;
+}
+
+static gpointer
+index_thread (gpointer user_data)
+{
+  NemoPreviewMappedText *self = user_data;
+  NemoPreviewMappedTextPrivate *priv = self->priv;
+  const gchar *p, *end, *block_end;
+  gint64 last_notify = 0;
+  guint n_lines = 0;
+  gboolean cut = FALSE;
+
+  p = priv->contents;
+  end = priv->contents + priv->length;
+
+  while (p < end && !g_atomic_int_get (&priv->stop)) {
+    block_end = MIN (p + SCAN_BLOCK, end);
+
+    /* What was indexed before the file shrank is still shown */
+    if (!index_block (priv, p, block_end, &n_lines)) {
+      cut = TRUE;
+      break;
+    }
+
+    g_mutex_lock (&priv->lock);
+    priv->n_lines = n_lines;
+    g_mutex_unlock (&priv->lock);
+
+#ifdef MADV_DONTNEED
+    /* Only what is looked at needs to stay in; the mapping is read only */
+    if (block_end < end) {
+      gsize start = (gsize) p & ~((gsize) sysconf (_SC_PAGESIZE) - 1);
+      madvise ((gpointer) start, (gsize) block_end - start, MADV_DONTNEED);
+    }
+#endif
+
+    p = block_end;
+
+    if (g_get_monotonic_time () - last_notify > NOTIFY_INTERVAL) {
+      last_notify = g_get_monotonic_time ();
+      schedule_notify (self);
+    }
+  }
+
+  if (g_atomic_int_get (&priv->stop))
+    return NULL;
+
+  /* The last line might not have a newline */
+  if (!cut && priv->length > 0 && !ends_in_newline (priv))
+    n_lines++;
+
+  g_mutex_lock (&priv->lock);
+  priv->n_lines = n_lines;
+  priv->indexed = TRUE;
+  g_mutex_unlock (&priv->lock);
+
+  schedule_notify (self);
+
+  return NULL;
+}
+
+/* Invalid bytes come out as U+FFFD, so any file can be shown */
+static void
+append_valid (GString *str,
+              const gchar *data,
+              gsize length)
+{
+  const gchar *end;
+
+  while (length > 0) {
+    if (g_utf8_validate (data, length, &end)) {
+      g_string_append_len (str, data, length);
+      break;
+    }
+
+    g_string_append_len (str, data, end - data);
+    g_string_append (str, "\xef\xbf\xbd");
+
+    length -= end - data + 1;
+    data = end + 1;
+  }
+}
+
+/**
+ * nemo_preview_mapped_text_get_lines:
+ * @self:
+ * @first: the first line, from 0
+ * @n_lines: how many lines
+ *
+ * Very long lines are cut short.
+ *
+ * Returns: (transfer full):
+ */
+gchar *
+nemo_preview_mapped_text_get_lines (NemoPreviewMappedText *self,
+                                    guint first,
+                                    guint n_lines)
+{
+  NemoPreviewMappedTextPrivate *priv = self->priv;
+  const gchar *p, *end, *nl;
+  sigjmp_buf jump;
+  GString *str;
+  guint line, entry;
+  gsize length;
+
+  g_mutex_lock (&priv->lock);
+  entry = MIN (first / INDEX_STEP, priv->index->len - 1);
+  p = priv->contents + g_array_index (priv->index, guint64, entry);
+  g_mutex_unlock (&priv->lock);
+
+  end = priv->contents + priv->length;
+  str = g_string_new (NULL);
+
+  /* The file was cut short, so there is only what was got before */
+  if (sigsetjmp (jump, 1) != 0) {
+    g_private_set (&sigbus_jump, NULL);
+    return g_string_free (str, FALSE);
+  }
+
+  g_private_set (&sigbus_jump, &jump);
+
+  /* From the nearest indexed line to the first one wanted */
+  for (line = entry * INDEX_STEP; line < first && p < end; line++) {
+    nl = memchr (p, '\n', end - p);
+    p = nl ? nl + 1 : end;
+  }
+
+  for (line = 0; line < n_lines && p < end; line++) {
+    nl = memchr (p, '\n', end - p);
+    length = (nl ? nl : end) - p;
+
+    if (length > MAX_LINE_LENGTH) {
+      length = MAX_LINE_LENGTH;
+      while (length > 0 && (p[length] & 0xc0) == 0x80)
+        length--;
+      append_valid (str, p, length);
+      g_string_append (str, "\xe2\x80\xa6");
+    } else {
+      append_valid (str, p, length);
+    }
+
+    if (nl == NULL)
+      break;
+
+    if (line + 1 < n_lines)
+      g_string_append_c (str, '\n');
+    p = nl + 1;
+  }
+
+  g_private_set (&sigbus_jump, NULL);
+
+  return g_string_free (str, FALSE);
+}
+
+guint
+nemo_preview_mapped_text_get_n_lines (NemoPreviewMappedText *self)
+{
+  guint n_lines;
+
+  g_mutex_lock (&self->priv->lock);
+  n_lines = self->priv->n_lines;
+  g_mutex_unlock (&self->priv->lock);
+
+  return n_lines;
+}
+
+gboolean
+nemo_preview_mapped_text_get_indexed (NemoPreviewMappedText *self)
+{
+  gboolean indexed;
+
+  g_mutex_lock (&self->priv->lock);
+  indexed = self->priv->indexed;
+  g_mutex_unlock (&self->priv->lock);
+
+  return indexed;
+}
+
+static void
+nemo_preview_mapped_text_dispose (GObject *object)
+{
+  NemoPreviewMappedText *self = NEMO_PREVIEW_MAPPED_TEXT (object);
+
+  if (self->priv->thread != NULL) {
+    g_atomic_int_set (&self->priv->stop, 1);
+    g_thread_join (self->priv->thread);
+    self->priv->thread = NULL;
+  }
+
+  G_OBJECT_CLASS (nemo_preview_mapped_text_parent_class)->dispose (object);
+}
+
+static void
+nemo_preview_mapped_text_finalize (GObject *object)
+{
+  NemoPreviewMappedText *self = NEMO_PREVIEW_MAPPED_TEXT (object);
+
+  if (self->priv->mapped != NULL)
+    g_mapped_file_unref (self->priv->mapped);
+
+  g_array_free (self->priv->index, TRUE);
+  g_mutex_clear (&self->priv->lock);
+
+  G_OBJECT_CLASS (nemo_preview_mapped_text_parent_class)->finalize (object);
+}
+
+static void
+nemo_preview_mapped_text_get_property (GObject *object,
+                                       guint       prop_id,
+                                       GValue     *value,
+                                       GParamSpec *pspec)
+{
+  NemoPreviewMappedText *self = NEMO_PREVIEW_MAPPED_TEXT (object);
+
+  switch (prop_id) {
+  case PROP_N_LINES:
+    g_value_set_uint (value, nemo_preview_mapped_text_get_n_lines (self));
+    break;
+  case PROP_INDEXED:
+    g_value_set_boolean (value, nemo_preview_mapped_text_get_indexed (self));
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    break;
+  }
+}
+
+static void
+nemo_preview_mapped_text_class_init (NemoPreviewMappedTextClass *klass)
+{
+  GObjectClass *oclass;
+
+  oclass = G_OBJECT_CLASS (klass);
+  oclass->dispose = nemo_preview_mapped_text_dispose;
+  oclass->finalize = nemo_preview_mapped_text_finalize;
+  oclass->get_property = nemo_preview_mapped_text_get_property;
+
+  properties[PROP_N_LINES] =
+    g_param_spec_uint ("n-lines",
+                       "Number of lines",
+                       "The number of lines indexed so far",
+                       0, G_MAXUINT, 0,
+                       G_PARAM_READABLE);
+
+  properties[PROP_INDEXED] =
+    g_param_spec_boolean ("indexed",
+                          "Indexed",
+                          "Whether all of the file has been indexed",
+                          FALSE,
+                          G_PARAM_READABLE);
+
+  g_object_class_install_properties (oclass, NUM_PROPERTIES, properties);
+
+  g_type_class_add_private (klass, sizeof (NemoPreviewMappedTextPrivate));
+
+  install_sigbus_handler ();
+}
+
+static void
+nemo_preview_mapped_text_init (NemoPreviewMappedText *self)
+{
+  guint64 start = 0;
+
+  self->priv =
+    G_TYPE_INSTANCE_GET_PRIVATE (self,
+                                 NEMO_PREVIEW_TYPE_MAPPED_TEXT,
+                                 NemoPreviewMappedTextPrivate);
+
+  g_mutex_init (&self->priv->lock);
+  self->priv->index = g_array_new (FALSE, FALSE, sizeof (guint64));
+  g_array_append_val (self->priv->index, start);
+}
+
+/**
+ * nemo_preview_mapped_text_new:
+ * @uri: a local file
+ * @error:
+ *
+ * Returns: (transfer full):
+ */
+NemoPreviewMappedText *
+nemo_preview_mapped_text_new (const gchar *uri,
+                              GError **error)
+{
+  NemoPreviewMappedText *self;
+  GFile *file;
+  gchar *path;
+
+  file = g_file_new_for_uri (uri);
+  path = g_file_get_path (file);
+  g_object_unref (file);
+
+  if (path == NULL) {
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                 "Only local files can be mapped");
+    return NULL;
+  }
+
+  self = g_object_new (NEMO_PREVIEW_TYPE_MAPPED_TEXT, NULL);
+  self->priv->mapped = g_mapped_file_new (path, FALSE, error);
+  g_free (path);
+
+  if (self->priv->mapped == NULL) {
+    g_object_unref (self);
+    return NULL;
+  }
+
+  self->priv->contents = g_mapped_file_get_contents (self->priv->mapped);
+  self->priv->length = g_mapped_file_get_length (self->priv->mapped);
+
+  self->priv->thread = g_thread_new ("nemo-preview-index", index_thread, self);
+
+  return self;
+}
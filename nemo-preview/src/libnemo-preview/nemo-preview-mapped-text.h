@@ -0,0 +1,67 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA.
+ *
+ * The NemoPreview project hereby grant permission for non-gpl compatible GStreamer
+ * plugins to be used and distributed together with GStreamer and NemoPreview. This
+ * permission is above and beyond the permissions granted by the GPL license
+ * NemoPreview is covered by.
+ *
+ */
+
+#ifndef __NEMO_PREVIEW_MAPPED_TEXT_H__
+#define __NEMO_PREVIEW_MAPPED_TEXT_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define NEMO_PREVIEW_TYPE_MAPPED_TEXT            (nemo_preview_mapped_text_get_type ())
+#define NEMO_PREVIEW_MAPPED_TEXT(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), NEMO_PREVIEW_TYPE_MAPPED_TEXT, NemoPreviewMappedText))
+#define NEMO_PREVIEW_IS_MAPPED_TEXT(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), NEMO_PREVIEW_TYPE_MAPPED_TEXT))
+#define NEMO_PREVIEW_MAPPED_TEXT_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  NEMO_PREVIEW_TYPE_MAPPED_TEXT, NemoPreviewMappedTextClass))
+#define NEMO_PREVIEW_IS_MAPPED_TEXT_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  NEMO_PREVIEW_TYPE_MAPPED_TEXT))
+#define NEMO_PREVIEW_MAPPED_TEXT_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  NEMO_PREVIEW_TYPE_MAPPED_TEXT, NemoPreviewMappedTextClass))
+
+typedef struct _NemoPreviewMappedText          NemoPreviewMappedText;
+typedef struct _NemoPreviewMappedTextPrivate   NemoPreviewMappedTextPrivate;
+typedef struct _NemoPreviewMappedTextClass     NemoPreviewMappedTextClass;
+
+struct _NemoPreviewMappedText
+{
+  GObject parent_instance;
+
+  NemoPreviewMappedTextPrivate *priv;
+};
+
+struct _NemoPreviewMappedTextClass
+{
+  GObjectClass parent_class;
+};
+
+GType    nemo_preview_mapped_text_get_type     (void) G_GNUC_CONST;
+
+NemoPreviewMappedText *nemo_preview_mapped_text_new (const gchar *uri,
+                                                     GError **error);
+
+guint    nemo_preview_mapped_text_get_n_lines  (NemoPreviewMappedText *self);
+gboolean nemo_preview_mapped_text_get_indexed  (NemoPreviewMappedText *self);
+gchar *  nemo_preview_mapped_text_get_lines    (NemoPreviewMappedText *self,
+                                                guint first,
+                                                guint n_lines);
+
+G_END_DECLS
+
+#endif /* __NEMO_PREVIEW_MAPPED_TEXT_H__ */
@@ -35,8 +35,18 @@
 
 G_DEFINE_TYPE (NemoPreviewTextLoader, nemo_preview_text_loader, G_TYPE_OBJECT);
 
+/* Small enough that the first screen shows straight away */
+#define READ_CHUNK_SIZE   (64 * 1024)
+
+#define DEFAULT_MAX_BYTES (8 * 1024 * 1024)
+#define DEFAULT_MAX_LINES 100000
+
 enum {
   PROP_URI = 1,
+  PROP_MAX_BYTES,
+  PROP_MAX_LINES,
+  PROP_ACCEPT_INVALID,
+  PROP_TRUNCATED,
   NUM_PROPERTIES
 };
 
@@ -52,8 +62,31 @@ struct _NemoPreviewTextLoaderPrivate {
   gchar *uri;
 
   GtkSourceBuffer *buffer;
+  GCancellable *cancellable;
+
+  guint64 max_bytes;
+  guint max_lines;
+  gboolean accept_invalid;
+  gboolean truncated;
 };
 
+/* One file being read into the buffer, a chunk at a time. The loader is
+ * only weakly referenced, so dropping it cancels the read. */
+typedef struct {
+  NemoPreviewTextLoader *self;
+  GCancellable *cancellable;
+  GInputStream *stream;
+  GFile *file;
+
+  /* A character split by the end of the last chunk */
+  gchar partial[4];
+  gsize n_partial;
+
+  guint64 n_bytes;
+  guint n_lines;
+  gboolean loaded;
+} LoadJob;
+
 /* code adapted from gtksourceview:tests/test-widget.c
  * License: LGPL v2.1+
  * Copyright (C) 2001 - Mikael Hermansson <tyan@linux.se>
@@ -155,60 +188,241 @@ text_loader_get_buffer_language (NemoPreviewTextLoader *self,
 }
 
 static void
-load_contents_async_ready_cb (GObject *source,
-                              GAsyncResult *res,
-                              gpointer user_data)
+load_job_free (LoadJob *job)
+{
+  g_clear_object (&job->stream);
+  g_object_unref (job->cancellable);
+  g_object_unref (job->file);
+  if (job->self != NULL)
+    g_object_remove_weak_pointer (G_OBJECT (job->self), (gpointer *) &job->self);
+  g_slice_free (LoadJob, job);
+}
+
+static void
+load_job_emit_loaded (LoadJob *job)
+{
+  NemoPreviewTextLoader *self = job->self;
+  GtkSourceLanguage *language;
+
+  job->loaded = TRUE;
+
+  language = text_loader_get_buffer_language (self, job->file);
+  gtk_source_buffer_set_language (self->priv->buffer, language);
+
+  g_signal_emit (self, signals[LOADED], 0, self->priv->buffer);
+}
+
+static void
+load_job_finish (LoadJob *job,
+                 gboolean truncated)
+{
+  NemoPreviewTextLoader *self = job->self;
+
+  /* An empty file is loaded too */
+  if (!job->loaded)
+    load_job_emit_loaded (job);
+
+  if (truncated != self->priv->truncated) {
+    self->priv->truncated = truncated;
+    g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_TRUNCATED]);
+  }
+
+  load_job_free (job);
+}
+
+/* Adds what is valid of a chunk to the buffer, up to the budget.
+ * Returns FALSE once nothing more should be read. */
+static gboolean
+load_job_append (LoadJob *job,
+                 const gchar *data,
+                 gsize length,
+                 gboolean *truncated)
 {
-  NemoPreviewTextLoader *self = user_data;
+  NemoPreviewTextLoaderPrivate *priv = job->self->priv;
+  GtkTextIter iter;
+  const gchar *end, *p;
+  gchar *joined = NULL;
+  gsize valid, limit;
+  gboolean invalid = FALSE;
+
+  if (job->n_partial > 0) {
+    joined = g_malloc (job->n_partial + length);
+    memcpy (joined, job->partial, job->n_partial);
+    memcpy (joined + job->n_partial, data, length);
+    data = joined;
+    length += job->n_partial;
+    job->n_partial = 0;
+  }
+
+  valid = length;
+  if (!g_utf8_validate (data, length, &end)) {
+    valid = end - data;
+
+    /* The start of a character that the next chunk finishes */
+    if (length - valid < sizeof (job->partial) &&
+        g_utf8_get_char_validated (end, length - valid) == (gunichar) -2) {
+      job->n_partial = length - valid;
+      memcpy (job->partial, end, job->n_partial);
+    } else {
+      invalid = TRUE;
+    }
+  }
+
+  if (invalid && !job->loaded && !priv->accept_invalid) {
+    /* FIXME: we need to report the error */
+    g_print ("Can't load the text file as it has invalid characters");
+    g_free (joined);
+    return FALSE;
+  }
+
+  limit = valid;
+
+  if (job->n_bytes + limit > priv->max_bytes) {
+    limit = priv->max_bytes - job->n_bytes;
+
+    /* Not in the middle of a character */
+    while (limit > 0 && (data[limit] & 0xc0) == 0x80)
+      limit--;
+    *truncated = TRUE;
+  }
+
+  for (p = data; p < data + limit; p++) {
+    p = memchr (p, '\n', data + limit - p);
+    if (p == NULL)
+      break;
+
+    if (++job->n_lines >= priv->max_lines) {
+      limit = p + 1 - data;
+      *truncated = TRUE;
+      break;
+    }
+  }
+
+  if (limit > 0) {
+    gtk_source_buffer_begin_not_undoable_action (priv->buffer);
+    gtk_text_buffer_get_end_iter (GTK_TEXT_BUFFER (priv->buffer), &iter);
+    gtk_text_buffer_insert (GTK_TEXT_BUFFER (priv->buffer), &iter, data, limit);
+    gtk_source_buffer_end_not_undoable_action (priv->buffer);
+
+    job->n_bytes += limit;
+  }
+
+  g_free (joined);
+
+  /* Shown as soon as there is something, the rest is added as it's read */
+  if (!job->loaded && (job->n_bytes > 0 || invalid))
+    load_job_emit_loaded (job);
+
+  if (invalid)
+    *truncated = TRUE;
+
+  return !*truncated;
+}
+
+static void load_job_read_next (LoadJob *job);
+
+static void
+read_bytes_async_ready_cb (GObject *source,
+                           GAsyncResult *res,
+                           gpointer user_data)
+{
+  LoadJob *job = user_data;
   GError *error = NULL;
-  gchar *contents;
-  GtkSourceLanguage *language = NULL;
+  gboolean truncated = FALSE;
+  GBytes *bytes;
+
+  bytes = g_input_stream_read_bytes_finish (G_INPUT_STREAM (source), res, &error);
 
-  g_file_load_contents_finish (G_FILE (source), res,
-                               &contents, NULL, NULL,
-                               &error);
+  /* Another file is being loaded now */
+  if (g_cancellable_is_cancelled (job->cancellable)) {
+    g_clear_error (&error);
+    if (bytes)
+      g_bytes_unref (bytes);
+    load_job_free (job);
+    return;
+  }
 
   if (error != NULL) {
     /* FIXME: we need to report the error */
     g_print ("Can't load the text file: %s\n", error->message);
     g_error_free (error);
 
+    /* What was shown stays, cut short, but nothing was there to show */
+    if (job->loaded)
+      load_job_finish (job, TRUE);
+    else
+      load_job_free (job);
     return;
   }
 
-  if (!g_utf8_validate (contents, -1, NULL)) {
-    /* FIXME: we need to report the error */
-    g_print ("Can't load the text file as it has invalid characters");
-    g_free (contents);
-
-    return;
+  if (g_bytes_get_size (bytes) == 0) {
+    /* A character cut off by the end of the file isn't shown */
+    load_job_finish (job, job->n_partial > 0);
+  } else if (load_job_append (job, g_bytes_get_data (bytes, NULL),
+                              g_bytes_get_size (bytes), &truncated)) {
+    load_job_read_next (job);
+  } else if (job->loaded) {
+    load_job_finish (job, truncated);
+  } else {
+    load_job_free (job);
   }
 
-  gtk_source_buffer_begin_not_undoable_action (self->priv->buffer);
-  gtk_text_buffer_set_text (GTK_TEXT_BUFFER (self->priv->buffer), contents, -1);
-  gtk_source_buffer_end_not_undoable_action (self->priv->buffer);
+  g_bytes_unref (bytes);
+}
 
-  language = text_loader_get_buffer_language (self, G_FILE (source));
-  gtk_source_buffer_set_language (self->priv->buffer, language);
+static void
+load_job_read_next (LoadJob *job)
+{
+  g_input_stream_read_bytes_async (job->stream, READ_CHUNK_SIZE,
+                                   G_PRIORITY_DEFAULT, job->cancellable,
+                                   read_bytes_async_ready_cb, job);
+}
 
-  g_signal_emit (self, signals[LOADED], 0, self->priv->buffer);
+static void
+read_async_ready_cb (GObject *source,
+                     GAsyncResult *res,
+                     gpointer user_data)
+{
+  LoadJob *job = user_data;
+  GError *error = NULL;
+
+  job->stream = G_INPUT_STREAM (g_file_read_finish (G_FILE (source), res, &error));
 
-  g_free (contents);
+  if (error != NULL) {
+    /* FIXME: we need to report the error */
+    if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+      g_print ("Can't load the text file: %s\n", error->message);
+    g_error_free (error);
+
+    load_job_free (job);
+    return;
+  }
+
+  load_job_read_next (job);
 }
 
 static void
 start_loading_buffer (NemoPreviewTextLoader *self)
 {
-  GFile *file;
+  LoadJob *job;
 
   self->priv->buffer = gtk_source_buffer_new (NULL);
 
-  file = g_file_new_for_uri (self->priv->uri);
-  g_file_load_contents_async (file, NULL,
-                              load_contents_async_ready_cb,
-                              self);
+  if (self->priv->cancellable != NULL) {
+    g_cancellable_cancel (self->priv->cancellable);
+    g_object_unref (self->priv->cancellable);
+  }
+  self->priv->cancellable = g_cancellable_new ();
+
+  job = g_slice_new0 (LoadJob);
+  job->self = self;
+  g_object_add_weak_pointer (G_OBJECT (self), (gpointer *) &job->self);
+  job->cancellable = g_object_ref (self->priv->cancellable);
+  job->file = g_file_new_for_uri (self->priv->uri);
 
-  g_object_unref (file);
+  g_file_read_async (job->file, G_PRIORITY_DEFAULT,
+                     job->cancellable,
+                     read_async_ready_cb, job);
 }
 
 static void
@@ -233,6 +447,12 @@ nemo_preview_text_loader_dispose (GObject *object)
   NemoPreviewTextLoader *self = NEMO_PREVIEW_TEXT_LOADER (object);
 
   g_free (self->priv->uri);
+  self->priv->uri = NULL;
+
+  if (self->priv->cancellable != NULL) {
+    g_cancellable_cancel (self->priv->cancellable);
+    g_clear_object (&self->priv->cancellable);
+  }
 
   G_OBJECT_CLASS (nemo_preview_text_loader_parent_class)->dispose (object);
 }
@@ -249,6 +469,18 @@ nemo_preview_text_loader_get_property (GObject *object,
   case PROP_URI:
     g_value_set_string (value, self->priv->uri);
     break;
+  case PROP_MAX_BYTES:
+    g_value_set_uint64 (value, self->priv->max_bytes);
+    break;
+  case PROP_MAX_LINES:
+    g_value_set_uint (value, self->priv->max_lines);
+    break;
+  case PROP_ACCEPT_INVALID:
+    g_value_set_boolean (value, self->priv->accept_invalid);
+    break;
+  case PROP_TRUNCATED:
+    g_value_set_boolean (value, self->priv->truncated);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
     break;
@@ -267,6 +499,15 @@ nemo_preview_text_loader_set_property (GObject *object,
   case PROP_URI:
     nemo_preview_text_loader_set_uri (self, g_value_get_string (value));
     break;
+  case PROP_MAX_BYTES:
+    self->priv->max_bytes = g_value_get_uint64 (value);
+    break;
+  case PROP_MAX_LINES:
+    self->priv->max_lines = g_value_get_uint (value);
+    break;
+  case PROP_ACCEPT_INVALID:
+    self->priv->accept_invalid = g_value_get_boolean (value);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
     break;
@@ -290,6 +531,34 @@ nemo_preview_text_loader_class_init (NemoPreviewTextLoaderClass *klass)
                          NULL,
                          G_PARAM_READWRITE);
 
+  properties[PROP_MAX_BYTES] =
+    g_param_spec_uint64 ("max-bytes",
+                         "Maximum bytes",
+                         "How much of the file to load at most",
+                         1, G_MAXUINT64, DEFAULT_MAX_BYTES,
+                         G_PARAM_READWRITE);
+
+  properties[PROP_MAX_LINES] =
+    g_param_spec_uint ("max-lines",
+                       "Maximum lines",
+                       "How many lines of the file to load at most",
+                       1, G_MAXUINT, DEFAULT_MAX_LINES,
+                       G_PARAM_READWRITE);
+
+  properties[PROP_ACCEPT_INVALID] =
+    g_param_spec_boolean ("accept-invalid",
+                          "Accept invalid",
+                          "Whether a file with invalid characters is loaded up to them",
+                          FALSE,
+                          G_PARAM_READWRITE);
+
+  properties[PROP_TRUNCATED] =
+    g_param_spec_boolean ("truncated",
+                          "Truncated",
+                          "Whether only the start of the file was loaded",
+                          FALSE,
+                          G_PARAM_READABLE);
+
   signals[LOADED] =
     g_signal_new ("loaded",
                   G_TYPE_FROM_CLASS (klass),
@@ -311,6 +580,9 @@ nemo_preview_text_loader_init (NemoPreviewTextLoader *self)
     G_TYPE_INSTANCE_GET_PRIVATE (self,
                                  NEMO_PREVIEW_TYPE_TEXT_LOADER,
                                  NemoPreviewTextLoaderPrivate);
+
+  self->priv->max_bytes = DEFAULT_MAX_BYTES;
+  self->priv->max_lines = DEFAULT_MAX_LINES;
 }
 
 NemoPreviewTextLoader *
@@ -0,0 +1,27 @@
+import time
+
+from gi.repository import Nemo, GObject
+
+# Burns CPU for every file it is asked about, standing in for something
+# like a PDF page counter.  Used with slow-info-provider.nemo-python to
+# see what isolating an extension does for the rest of nemo; compare the
+# update_file_info numbers from NEMO_PYTHON_PROFILE with Isolated set to
+# true and false.
+COST = 0.05
+
+class SlowInfoProvider(GObject.GObject, Nemo.InfoProvider, Nemo.ColumnProvider):
+    def __init__(self):
+        pass
+
+    def get_columns(self):
+        return Nemo.Column(name="SlowInfoProvider::slow_column",
+                           attribute="slow",
+                           label="Slow",
+                           description="Takes a while to compute"),
+
+    def update_file_info(self, file):
+        deadline = time.process_time() + COST
+        n = 0
+        while time.process_time() < deadline:
+            n += 1
+        file.add_string_attribute('slow', str(n))
@@ -0,0 +1,666 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Bridge side of the nemo-python-helper protocol.
+ *
+ * Each isolated extension class gets a helper process, started the first
+ * time it is used.  Requests are queued to a writer thread and replies are
+ * read by a reader thread, so the UI thread never waits on the extension:
+ * update_file_info always returns NEMO_OPERATION_IN_PROGRESS and the result
+ * is applied from an idle when it comes back.  Columns and names are sent
+ * once by the helper after it has loaded the extension.  Nemo asks for
+ * them while the helper may still be starting, and can't be told they
+ * changed later, so the last ones a helper sent are kept on disk and
+ * answered with straight away.  The first time an extension is run there
+ * is nothing on disk yet, and we wait a little for the helper instead.
+ *
+ * Messages are a native-endian guint32 length followed by a serialized
+ * GVariant of type (sua{sv}): kind, request id and payload.
+ */
+
+#include <config.h>
+
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+
+#include <gio/gio.h>
+
+#include <libnemo-extension/nemo-column.h>
+
+#include "nemo-python-helper.h"
+
+#define MESSAGE_TYPE G_VARIANT_TYPE ("(sua{sv})")
+#define MAX_MESSAGE_SIZE (16 * 1024 * 1024)
+
+/* How long to wait for a helper that has never said hello before */
+#define HELLO_TIMEOUT (2 * G_TIME_SPAN_SECOND)
+
+typedef struct {
+	guint id;
+} HelperHandle;
+
+typedef struct {
+	guint id;
+	NemoInfoProvider *provider;
+	NemoFileInfo *file;
+	GClosure *update_complete;
+	NemoOperationHandle *handle;
+	gboolean cancelled;
+} PendingUpdate;
+
+struct _NemoPythonHelper {
+	gchar *name;
+	GSubprocess *process;
+	GAsyncQueue *outgoing;
+
+	/* Set by the reader thread */
+	GMutex lock;
+	GCond ready;		/* Signalled on hello, error or exit */
+	gboolean failed;
+	GVariant *hello;	/* From this run, or else the last one */
+
+	/* Main thread only */
+	GHashTable *pending;			/* id -> PendingUpdate */
+	GHashTable *pending_by_handle;	/* NemoOperationHandle -> PendingUpdate */
+	guint next_id;
+};
+
+typedef struct {
+	NemoPythonHelper *helper;
+	GVariant *message;	/* NULL once the helper has gone away */
+} HelperReply;
+
+/* "module.class" -> NemoPythonHelper */
+static GHashTable *helpers = NULL;
+
+static void
+pending_update_free (PendingUpdate *pending)
+{
+	g_object_unref (pending->provider);
+	g_object_unref (pending->file);
+	g_closure_unref (pending->update_complete);
+	g_free (pending->handle);
+	g_free (pending);
+}
+
+static void
+nemo_python_helper_send (NemoPythonHelper *helper,
+						 const gchar      *kind,
+						 guint             id,
+						 GVariant         *payload)
+{
+	GVariant *message;
+	GByteArray *frame;
+	guint32 length;
+
+	message = g_variant_ref_sink (g_variant_new ("(su@a{sv})", kind, id, payload));
+	length = g_variant_get_size (message);
+
+	frame = g_byte_array_sized_new (sizeof (length) + length);
+	g_byte_array_append (frame, (const guint8 *) &length, sizeof (length));
+	g_byte_array_set_size (frame, sizeof (length) + length);
+	g_variant_store (message, frame->data + sizeof (length));
+
+	g_async_queue_push (helper->outgoing, g_byte_array_free_to_bytes (frame));
+
+	g_variant_unref (message);
+}
+
+static GVariant *
+read_message (GInputStream *stream)
+{
+	guint32 length;
+	gsize bytes_read;
+	gpointer data;
+
+	if (!g_input_stream_read_all (stream, &length, sizeof (length),
+								  &bytes_read, NULL, NULL) ||
+		bytes_read != sizeof (length) ||
+		length > MAX_MESSAGE_SIZE)
+		return NULL;
+
+	data = g_malloc (length);
+	if (!g_input_stream_read_all (stream, data, length, &bytes_read, NULL, NULL) ||
+		bytes_read != length)
+	{
+		g_free (data);
+		return NULL;
+	}
+
+	return g_variant_ref_sink (g_variant_new_from_data (MESSAGE_TYPE, data, length,
+														FALSE, g_free, data));
+}
+
+static void
+pending_update_complete (PendingUpdate       *pending,
+						 NemoOperationResult  result)
+{
+	if (pending->cancelled)
+		return;
+
+	nemo_info_provider_update_complete_invoke (pending->update_complete,
+											   pending->provider,
+											   pending->handle,
+											   result);
+}
+
+static void
+nemo_python_helper_handle_update (NemoPythonHelper *helper,
+								  GVariant         *message)
+{
+	PendingUpdate *pending;
+	GVariantIter *iter;
+	GVariant *payload;
+	const gchar *kind, *key, *value;
+	guint id, result;
+
+	g_variant_get (message, "(&su@a{sv})", &kind, &id, &payload);
+
+	pending = g_hash_table_lookup (helper->pending, GUINT_TO_POINTER (id));
+	if (strcmp (kind, "update") != 0 || pending == NULL)
+	{
+		g_variant_unref (payload);
+		return;
+	}
+
+	g_hash_table_steal (helper->pending, GUINT_TO_POINTER (id));
+	if (!pending->cancelled)
+		g_hash_table_remove (helper->pending_by_handle, pending->handle);
+
+	if (!pending->cancelled)
+	{
+		if (g_variant_lookup (payload, "attributes", "a{ss}", &iter))
+		{
+			while (g_variant_iter_loop (iter, "{&s&s}", &key, &value))
+				nemo_file_info_add_string_attribute (pending->file, key, value);
+			g_variant_iter_free (iter);
+		}
+
+		if (g_variant_lookup (payload, "emblems", "as", &iter))
+		{
+			while (g_variant_iter_loop (iter, "&s", &value))
+				nemo_file_info_add_emblem (pending->file, value);
+			g_variant_iter_free (iter);
+		}
+	}
+
+	if (!g_variant_lookup (payload, "result", "u", &result))
+		result = NEMO_OPERATION_COMPLETE;
+
+	pending_update_complete (pending, result);
+	pending_update_free (pending);
+
+	g_variant_unref (payload);
+}
+
+static void
+nemo_python_helper_fail_pending (NemoPythonHelper *helper)
+{
+	GList *pending, *l;
+
+	/* Steal everything first, completing an update can re-enter us */
+	pending = g_hash_table_get_values (helper->pending);
+	g_hash_table_steal_all (helper->pending);
+	g_hash_table_remove_all (helper->pending_by_handle);
+
+	for (l = pending; l != NULL; l = l->next)
+	{
+		pending_update_complete (l->data, NEMO_OPERATION_FAILED);
+		pending_update_free (l->data);
+	}
+
+	g_list_free (pending);
+}
+
+static gboolean
+nemo_python_helper_dispatch (gpointer user_data)
+{
+	HelperReply *reply = user_data;
+
+	if (reply->message != NULL)
+	{
+		nemo_python_helper_handle_update (reply->helper, reply->message);
+		g_variant_unref (reply->message);
+	}
+	else
+	{
+		nemo_python_helper_fail_pending (reply->helper);
+	}
+
+	g_free (reply);
+
+	return G_SOURCE_REMOVE;
+}
+
+static gchar *
+hello_cache_path (const gchar *name)
+{
+	gchar *basename, *path;
+
+	basename = g_strconcat (name, ".hello", NULL);
+	path = g_build_filename (g_get_user_cache_dir (), "nemo-python", "helpers",
+							 basename, NULL);
+	g_free (basename);
+
+	return path;
+}
+
+static GVariant *
+hello_cache_load (const gchar *name)
+{
+	GVariant *hello;
+	gchar *path, *contents;
+	gsize length;
+
+	path = hello_cache_path (name);
+
+	if (!g_file_get_contents (path, &contents, &length, NULL))
+	{
+		g_free (path);
+		return NULL;
+	}
+
+	g_free (path);
+
+	hello = g_variant_new_from_data (G_VARIANT_TYPE_VARDICT, contents, length,
+									 FALSE, g_free, contents);
+
+	return g_variant_ref_sink (hello);
+}
+
+static void
+hello_cache_save (const gchar *name,
+				  GVariant    *hello)
+{
+	GError *error = NULL;
+	gchar *path, *dirname;
+
+	path = hello_cache_path (name);
+
+	dirname = g_path_get_dirname (path);
+	g_mkdir_with_parents (dirname, 0700);
+	g_free (dirname);
+
+	if (!g_file_set_contents (path, g_variant_get_data (hello),
+							  g_variant_get_size (hello), &error))
+	{
+		g_warning ("Could not write %s: %s", path, error->message);
+		g_error_free (error);
+	}
+
+	g_free (path);
+}
+
+static void
+nemo_python_helper_set_ready (NemoPythonHelper *helper,
+							  GVariant         *message)
+{
+	GVariant *payload;
+	const gchar *kind, *error;
+
+	g_variant_get (message, "(&su@a{sv})", &kind, NULL, &payload);
+
+	if (strcmp (kind, "hello") == 0)
+	{
+		hello_cache_save (helper->name, payload);
+
+		g_mutex_lock (&helper->lock);
+		if (helper->hello != NULL)
+			g_variant_unref (helper->hello);
+		helper->hello = g_variant_ref (payload);
+		g_cond_broadcast (&helper->ready);
+		g_mutex_unlock (&helper->lock);
+	}
+	else
+	{
+		if (g_variant_lookup (payload, "message", "&s", &error))
+			g_warning ("nemo-python-helper %s: %s", helper->name, error);
+
+		g_mutex_lock (&helper->lock);
+		helper->failed = TRUE;
+		g_cond_broadcast (&helper->ready);
+		g_mutex_unlock (&helper->lock);
+	}
+
+	g_variant_unref (payload);
+}
+
+static gpointer
+nemo_python_helper_reader (gpointer user_data)
+{
+	NemoPythonHelper *helper = user_data;
+	GInputStream *stream;
+	GVariant *message;
+	HelperReply *reply;
+	const gchar *kind;
+
+	stream = g_subprocess_get_stdout_pipe (helper->process);
+
+	while ((message = read_message (stream)) != NULL)
+	{
+		g_variant_get (message, "(&su@a{sv})", &kind, NULL, NULL);
+
+		if (strcmp (kind, "hello") == 0 || strcmp (kind, "error") == 0)
+		{
+			nemo_python_helper_set_ready (helper, message);
+			g_variant_unref (message);
+			continue;
+		}
+
+		reply = g_new0 (HelperReply, 1);
+		reply->helper = helper;
+		reply->message = message;
+		g_idle_add (nemo_python_helper_dispatch, reply);
+	}
+
+	g_mutex_lock (&helper->lock);
+	helper->failed = TRUE;
+	g_cond_broadcast (&helper->ready);
+	g_mutex_unlock (&helper->lock);
+
+	reply = g_new0 (HelperReply, 1);
+	reply->helper = helper;
+	g_idle_add (nemo_python_helper_dispatch, reply);
+
+	return NULL;
+}
+
+static gpointer
+nemo_python_helper_writer (gpointer user_data)
+{
+	NemoPythonHelper *helper = user_data;
+	GOutputStream *stream;
+	GBytes *frame;
+	sigset_t set;
+	gboolean ok;
+
+	/* Writing to a helper that has died must fail, not kill nemo */
+	sigemptyset (&set);
+	sigaddset (&set, SIGPIPE);
+	pthread_sigmask (SIG_BLOCK, &set, NULL);
+
+	stream = g_subprocess_get_stdin_pipe (helper->process);
+
+	/* An empty frame asks us to stop */
+	while ((frame = g_async_queue_pop (helper->outgoing)) != NULL &&
+		   g_bytes_get_size (frame) > 0)
+	{
+		ok = g_output_stream_write_all (stream,
+										g_bytes_get_data (frame, NULL),
+										g_bytes_get_size (frame),
+										NULL, NULL, NULL);
+		g_bytes_unref (frame);
+
+		if (!ok)
+			return NULL;
+	}
+
+	g_bytes_unref (frame);
+
+	return NULL;
+}
+
+static gboolean
+nemo_python_helper_is_failed (NemoPythonHelper *helper)
+{
+	gboolean failed;
+
+	g_mutex_lock (&helper->lock);
+	failed = helper->failed;
+	g_mutex_unlock (&helper->lock);
+
+	return failed;
+}
+
+/* What the helper sent last time will do until it has said hello.  If
+ * it never has, waits up to HELLO_TIMEOUT for it rather than leaving the
+ * extension out of the first window. */
+static GVariant *
+nemo_python_helper_lookup_hello (NemoPythonHelper   *helper,
+								 const gchar        *key,
+								 const GVariantType *type)
+{
+	GVariant *value = NULL;
+	gint64 end_time;
+
+	end_time = g_get_monotonic_time () + HELLO_TIMEOUT;
+
+	g_mutex_lock (&helper->lock);
+	while (helper->hello == NULL && !helper->failed)
+	{
+		if (!g_cond_wait_until (&helper->ready, &helper->lock, end_time))
+			break;
+	}
+
+	if (helper->hello != NULL && !helper->failed)
+		value = g_variant_lookup_value (helper->hello, key, type);
+	g_mutex_unlock (&helper->lock);
+
+	return value;
+}
+
+NemoPythonHelper *
+nemo_python_helper_get (const gchar *dirname,
+						const gchar *module_name,
+						const gchar *class_name)
+{
+	NemoPythonHelper *helper;
+	GError *error = NULL;
+	gchar *name;
+	const gchar *argv[] = { NEMO_PYTHON_HELPER, dirname, module_name, class_name, NULL };
+
+	if (helpers == NULL)
+		helpers = g_hash_table_new (g_str_hash, g_str_equal);
+
+	name = g_strdup_printf ("%s.%s", module_name, class_name);
+
+	helper = g_hash_table_lookup (helpers, name);
+	if (helper != NULL)
+	{
+		g_free (name);
+		return helper;
+	}
+
+	helper = g_new0 (NemoPythonHelper, 1);
+	helper->name = name;
+	helper->outgoing = g_async_queue_new_full ((GDestroyNotify) g_bytes_unref);
+	helper->pending = g_hash_table_new_full (NULL, NULL, NULL,
+											 (GDestroyNotify) pending_update_free);
+	helper->pending_by_handle = g_hash_table_new (NULL, NULL);
+	g_mutex_init (&helper->lock);
+	g_cond_init (&helper->ready);
+	helper->hello = hello_cache_load (name);
+
+	g_hash_table_insert (helpers, helper->name, helper);
+
+	helper->process = g_subprocess_newv (argv,
+										 G_SUBPROCESS_FLAGS_STDIN_PIPE |
+										 G_SUBPROCESS_FLAGS_STDOUT_PIPE,
+										 &error);
+	if (helper->process == NULL)
+	{
+		g_warning ("Could not start nemo-python-helper for %s: %s", name, error->message);
+		g_error_free (error);
+		helper->failed = TRUE;
+		return helper;
+	}
+
+	g_thread_unref (g_thread_new ("nemo-python-reader", nemo_python_helper_reader, helper));
+	g_thread_unref (g_thread_new ("nemo-python-writer", nemo_python_helper_writer, helper));
+
+	return helper;
+}
+
+void
+nemo_python_helper_shutdown_all (void)
+{
+	GHashTableIter iter;
+	gpointer value;
+
+	if (helpers == NULL)
+		return;
+
+	/* The helpers exit when their stdin closes, the threads and the
+	 * structs go away with nemo itself. */
+	g_hash_table_iter_init (&iter, helpers);
+	while (g_hash_table_iter_next (&iter, NULL, &value))
+	{
+		NemoPythonHelper *helper = value;
+
+		if (helper->process == NULL)
+			continue;
+
+		g_async_queue_push (helper->outgoing, g_bytes_new (NULL, 0));
+		g_subprocess_force_exit (helper->process);
+	}
+}
+
+GList *
+nemo_python_helper_get_columns (NemoPythonHelper *helper)
+{
+	GVariantIter iter;
+	GVariant *columns, *column;
+	GList *ret = NULL;
+
+	columns = nemo_python_helper_lookup_hello (helper, "columns",
+											   G_VARIANT_TYPE ("aa{ss}"));
+	if (columns == NULL)
+		return NULL;
+
+	g_variant_iter_init (&iter, columns);
+	while ((column = g_variant_iter_next_value (&iter)) != NULL)
+	{
+		const gchar *name = NULL, *attribute = NULL;
+		const gchar *label = "", *description = "";
+
+		g_variant_lookup (column, "name", "&s", &name);
+		g_variant_lookup (column, "attribute", "&s", &attribute);
+		g_variant_lookup (column, "label", "&s", &label);
+		g_variant_lookup (column, "description", "&s", &description);
+
+		if (name != NULL && attribute != NULL)
+			ret = g_list_prepend (ret, nemo_column_new (name, attribute, label, description));
+
+		g_variant_unref (column);
+	}
+
+	g_variant_unref (columns);
+
+	return g_list_reverse (ret);
+}
+
+GList *
+nemo_python_helper_get_name_and_desc (NemoPythonHelper *helper)
+{
+	GVariantIter iter;
+	GVariant *name_and_desc;
+	const gchar *str;
+	GList *ret = NULL;
+
+	name_and_desc = nemo_python_helper_lookup_hello (helper, "name_and_desc",
+													 G_VARIANT_TYPE_STRING_ARRAY);
+	if (name_and_desc == NULL)
+		return NULL;
+
+	g_variant_iter_init (&iter, name_and_desc);
+	while (g_variant_iter_next (&iter, "&s", &str))
+		ret = g_list_prepend (ret, g_strdup (str));
+
+	g_variant_unref (name_and_desc);
+
+	return g_list_reverse (ret);
+}
+
+static void
+add_string (GVariantBuilder *builder,
+			const gchar     *key,
+			gchar           *value)
+{
+	if (value == NULL)
+		return;
+
+	g_variant_builder_add (builder, "{sv}", key, g_variant_new_string (value));
+	g_free (value);
+}
+
+NemoOperationResult
+nemo_python_helper_update_file_info (NemoPythonHelper     *helper,
+									 NemoInfoProvider     *provider,
+									 NemoFileInfo         *file,
+									 GClosure             *update_complete,
+									 NemoOperationHandle **handle)
+{
+	GVariantBuilder builder;
+	PendingUpdate *pending;
+	HelperHandle *helper_handle;
+
+	if (nemo_python_helper_is_failed (helper))
+		return NEMO_OPERATION_FAILED;
+
+	helper_handle = g_new0 (HelperHandle, 1);
+	helper_handle->id = ++helper->next_id;
+
+	pending = g_new0 (PendingUpdate, 1);
+	pending->id = helper_handle->id;
+	pending->provider = g_object_ref (provider);
+	pending->file = g_object_ref (file);
+	pending->update_complete = g_closure_ref (update_complete);
+	pending->handle = (NemoOperationHandle *) helper_handle;
+
+	g_hash_table_insert (helper->pending, GUINT_TO_POINTER (pending->id), pending);
+	g_hash_table_insert (helper->pending_by_handle, pending->handle, pending);
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+	add_string (&builder, "uri", nemo_file_info_get_uri (file));
+	add_string (&builder, "activation_uri", nemo_file_info_get_activation_uri (file));
+	add_string (&builder, "parent_uri", nemo_file_info_get_parent_uri (file));
+	add_string (&builder, "uri_scheme", nemo_file_info_get_uri_scheme (file));
+	add_string (&builder, "name", nemo_file_info_get_name (file));
+	add_string (&builder, "mime_type", nemo_file_info_get_mime_type (file));
+	g_variant_builder_add (&builder, "{sv}", "is_directory",
+						   g_variant_new_boolean (nemo_file_info_is_directory (file)));
+	g_variant_builder_add (&builder, "{sv}", "can_write",
+						   g_variant_new_boolean (nemo_file_info_can_write (file)));
+	g_variant_builder_add (&builder, "{sv}", "file_type",
+						   g_variant_new_uint32 (nemo_file_info_get_file_type (file)));
+
+	nemo_python_helper_send (helper, "update", pending->id, g_variant_builder_end (&builder));
+
+	*handle = pending->handle;
+
+	return NEMO_OPERATION_IN_PROGRESS;
+}
+
+void
+nemo_python_helper_cancel_update (NemoPythonHelper    *helper,
+								  NemoOperationHandle *handle)
+{
+	PendingUpdate *pending;
+
+	pending = g_hash_table_lookup (helper->pending_by_handle, handle);
+	if (pending == NULL)
+		return;
+
+	/* Keep it around until the helper answers, so the id isn't reused
+	 * and the late reply can be told apart from a live one. */
+	pending->cancelled = TRUE;
+	g_hash_table_remove (helper->pending_by_handle, handle);
+
+	nemo_python_helper_send (helper, "cancel", pending->id,
+							 g_variant_new ("a{sv}", NULL));
+}
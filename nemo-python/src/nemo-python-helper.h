@@ -0,0 +1,51 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef NEMO_PYTHON_HELPER_H
+#define NEMO_PYTHON_HELPER_H
+
+#include <glib-object.h>
+
+#include <libnemo-extension/nemo-file-info.h>
+#include <libnemo-extension/nemo-info-provider.h>
+
+G_BEGIN_DECLS
+
+/* An extension class running in its own nemo-python-helper process.
+ * Only column, info and name-and-desc providers can be isolated, since
+ * everything they exchange with nemo can be copied across a pipe.
+ */
+typedef struct _NemoPythonHelper NemoPythonHelper;
+
+NemoPythonHelper    *nemo_python_helper_get               (const gchar          *dirname,
+                                                           const gchar          *module_name,
+                                                           const gchar          *class_name);
+void                 nemo_python_helper_shutdown_all      (void);
+
+GList               *nemo_python_helper_get_columns       (NemoPythonHelper     *helper);
+GList               *nemo_python_helper_get_name_and_desc (NemoPythonHelper     *helper);
+NemoOperationResult  nemo_python_helper_update_file_info  (NemoPythonHelper     *helper,
+                                                           NemoInfoProvider     *provider,
+                                                           NemoFileInfo         *file,
+                                                           GClosure             *update_complete,
+                                                           NemoOperationHandle **handle);
+void                 nemo_python_helper_cancel_update     (NemoPythonHelper     *helper,
+                                                           NemoOperationHandle  *handle);
+
+G_END_DECLS
+
+#endif /* NEMO_PYTHON_HELPER_H */
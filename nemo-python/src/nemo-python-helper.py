@@ -0,0 +1,259 @@
+#!/usr/bin/python3
+#
+#  This program is free software; you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation; either version 2, or (at your option)
+#  any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program; if not, write to the Free Software
+#  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+
+# Runs one nemo-python extension class outside of nemo, for extensions that
+# are marked Isolated in their manifest.  nemo-python-helper.c is the other
+# end of the pipe.
+#
+# Usage: nemo-python-helper DIRNAME MODULE CLASS
+#
+# Messages in both directions are a native-endian 32 bit length followed by
+# a serialized GVariant of type (sua{sv}): kind, request id and payload.
+
+import importlib
+import os
+import struct
+import sys
+import traceback
+
+import gi
+gi.require_version('Nemo', '3.0')
+from gi.repository import GLib, Gio, Nemo
+
+HEADER = struct.Struct('=I')
+
+COMPLETE = int(Nemo.OperationResult.COMPLETE)
+FAILED = int(Nemo.OperationResult.FAILED)
+IN_PROGRESS = int(Nemo.OperationResult.IN_PROGRESS)
+
+# Keep the protocol pipe to ourselves, extensions print() to stdout.
+protocol_in = sys.stdin.fileno()
+protocol_out = os.dup(sys.stdout.fileno())
+os.dup2(sys.stderr.fileno(), sys.stdout.fileno())
+
+
+def send(kind, ident, payload):
+    data = GLib.Variant('(sua{sv})', (kind, ident, payload)).get_data_as_bytes().get_data()
+    buf = HEADER.pack(len(data)) + data
+    while buf:
+        buf = buf[os.write(protocol_out, buf):]
+
+
+def read_exact(size):
+    buf = b''
+    while len(buf) < size:
+        chunk = os.read(protocol_in, size - len(buf))
+        if not chunk:
+            return None
+        buf += chunk
+    return buf
+
+
+def receive():
+    header = read_exact(HEADER.size)
+    if header is None:
+        return None
+    data = read_exact(HEADER.unpack(header)[0])
+    if data is None:
+        return None
+    return GLib.Variant.new_from_bytes(GLib.VariantType.new('(sua{sv})'),
+                                       GLib.Bytes.new(data), False).unpack()
+
+
+class FileInfo(object):
+    """Stands in for the Nemo.FileInfo the extension would get in-process."""
+
+    def __init__(self, props):
+        self._props = props
+        self.attributes = {}
+        self.emblems = []
+
+    def get_uri(self):
+        return self._props.get('uri')
+
+    def get_activation_uri(self):
+        return self._props.get('activation_uri', self.get_uri())
+
+    def get_parent_uri(self):
+        return self._props.get('parent_uri')
+
+    def get_uri_scheme(self):
+        return self._props.get('uri_scheme')
+
+    def get_name(self):
+        return self._props.get('name')
+
+    def get_mime_type(self):
+        return self._props.get('mime_type')
+
+    def is_mime_type(self, mime_type):
+        return Gio.content_type_is_a(self.get_mime_type() or '', mime_type)
+
+    def is_directory(self):
+        return self._props.get('is_directory', False)
+
+    def can_write(self):
+        return self._props.get('can_write', False)
+
+    def is_gone(self):
+        return False
+
+    def get_file_type(self):
+        return Gio.FileType(self._props.get('file_type', 0))
+
+    def get_location(self):
+        return Gio.File.new_for_uri(self.get_uri())
+
+    def get_parent_location(self):
+        return self.get_location().get_parent()
+
+    def get_string_attribute(self, name):
+        return self.attributes.get(name)
+
+    def add_string_attribute(self, name, value):
+        self.attributes[name] = value
+
+    def add_emblem(self, name):
+        self.emblems.append(name)
+
+    def invalidate_extension_info(self):
+        pass
+
+
+class Update(object):
+    """Used as both the handle and the closure of an update_file_info call."""
+
+    pending = {}
+
+    def __init__(self, ident, file):
+        self.ident = ident
+        self.file = file
+        self.done = False
+        Update.pending[ident] = self
+
+    def finish(self, result):
+        if self.done:
+            return
+        self.done = True
+        Update.pending.pop(self.ident, None)
+        send('update', self.ident, {
+            'result': GLib.Variant('u', COMPLETE if result is None else int(result)),
+            'attributes': GLib.Variant('a{ss}', self.file.attributes),
+            'emblems': GLib.Variant('as', self.file.emblems),
+        })
+
+
+def update_complete_invoke(closure, provider, handle, result):
+    closure.finish(result)
+
+# Extensions complete asynchronous updates through this, with the closure
+# we gave them.
+Nemo.info_provider_update_complete_invoke = update_complete_invoke
+
+
+def update_file_info(extension, ident, props):
+    update = Update(ident, FileInfo(props))
+
+    try:
+        if hasattr(extension, 'update_file_info_full'):
+            result = extension.update_file_info_full(extension, update, update, update.file)
+        elif hasattr(extension, 'update_file_info'):
+            result = extension.update_file_info(update.file)
+        else:
+            result = COMPLETE
+    except Exception:
+        traceback.print_exc()
+        result = FAILED
+
+    if result is None or int(result) != IN_PROGRESS:
+        update.finish(result)
+
+
+def cancel_update(extension, ident):
+    update = Update.pending.pop(ident, None)
+    if update is None:
+        return
+
+    if hasattr(extension, 'cancel_update'):
+        try:
+            extension.cancel_update(extension, update)
+        except Exception:
+            traceback.print_exc()
+
+    # The bridge holds on to the request until it hears back
+    update.finish(FAILED)
+
+
+def hello(extension):
+    columns = []
+    name_and_desc = []
+
+    if hasattr(extension, 'get_columns'):
+        for column in extension.get_columns() or []:
+            columns.append({
+                'name': column.props.name or '',
+                'attribute': column.props.attribute or '',
+                'label': column.props.label or '',
+                'description': column.props.description or '',
+            })
+
+    if hasattr(extension, 'get_name_and_desc'):
+        name_and_desc = list(extension.get_name_and_desc() or [])
+
+    send('hello', 0, {
+        'columns': GLib.Variant('aa{ss}', columns),
+        'name_and_desc': GLib.Variant('as', name_and_desc),
+    })
+
+
+def main():
+    dirname, module_name, class_name = sys.argv[1:4]
+    sys.path.insert(0, dirname)
+
+    try:
+        module = importlib.import_module(module_name)
+        extension = getattr(module, class_name)()
+        hello(extension)
+    except Exception:
+        traceback.print_exc()
+        send('error', 0, {'message': GLib.Variant('s', traceback.format_exc(limit=1))})
+        return 1
+
+    loop = GLib.MainLoop()
+
+    def on_input(fd, condition):
+        message = receive()
+        if message is None:
+            loop.quit()
+            return False
+
+        kind, ident, payload = message
+        if kind == 'update':
+            update_file_info(extension, ident, payload)
+        elif kind == 'cancel':
+            cancel_update(extension, ident)
+
+        return True
+
+    GLib.io_add_watch(protocol_in, GLib.PRIORITY_DEFAULT,
+                      GLib.IOCondition.IN | GLib.IOCondition.HUP, on_input)
+    loop.run()
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
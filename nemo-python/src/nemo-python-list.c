@@ -0,0 +1,522 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include "nemo-python-list.h"
+#include "nemo-python.h"
+
+#define NO_IMPORT_PYGOBJECT
+#include <pygobject.h>
+
+typedef struct {
+	PyObject_HEAD
+	GList *list;
+	gboolean owned;		/* list is a copy holding its own references */
+	Py_ssize_t length;
+	PyObject **items;	/* wrappers created so far, by index */
+
+	/* A real python list of the same items, made the first time an
+	 * extension uses the sequence as more than a read-only list (calls
+	 * a list method, compares or concatenates it, assigns to it...).
+	 * From then on it's the one that counts. */
+	PyObject *materialized;
+
+	/* Last node looked up, so walking the sequence in order is O(n) */
+	GList *cursor;
+	Py_ssize_t cursor_index;
+} NemoPythonList;
+
+static GList *
+nemo_python_list_nth (NemoPythonList *self,
+					  Py_ssize_t      index)
+{
+	if (self->cursor == NULL || index < self->cursor_index - index)
+	{
+		self->cursor = self->list;
+		self->cursor_index = 0;
+	}
+
+	while (self->cursor_index < index)
+	{
+		self->cursor = self->cursor->next;
+		self->cursor_index++;
+	}
+
+	while (self->cursor_index > index)
+	{
+		self->cursor = self->cursor->prev;
+		self->cursor_index--;
+	}
+
+	return self->cursor;
+}
+
+static Py_ssize_t
+nemo_python_list_length (PyObject *object)
+{
+	NemoPythonList *self = (NemoPythonList *) object;
+
+	if (self->materialized != NULL)
+		return PyList_GET_SIZE(self->materialized);
+
+	return self->length;
+}
+
+static PyObject *
+nemo_python_list_item (PyObject   *object,
+					   Py_ssize_t  index)
+{
+	NemoPythonList *self = (NemoPythonList *) object;
+
+	if (self->materialized != NULL)
+		return PySequence_GetItem(self->materialized, index);
+
+	if (index < 0 || index >= self->length)
+	{
+		PyErr_SetString(PyExc_IndexError, "list index out of range");
+		return NULL;
+	}
+
+	if (self->items == NULL)
+		self->items = g_new0 (PyObject *, self->length);
+
+	if (self->items[index] == NULL)
+	{
+		GList *node = nemo_python_list_nth (self, index);
+
+		self->items[index] = pygobject_new ((GObject *) node->data);
+		if (self->items[index] == NULL)
+			return NULL;
+	}
+
+	Py_INCREF(self->items[index]);
+	return self->items[index];
+}
+
+static PyObject *
+nemo_python_list_materialize (NemoPythonList *self)
+{
+	PyObject *list;
+	Py_ssize_t i;
+
+	if (self->materialized != NULL)
+		return self->materialized;
+
+	list = PyList_New(self->length);
+	if (list == NULL)
+		return NULL;
+
+	for (i = 0; i < self->length; i++)
+	{
+		PyObject *item = nemo_python_list_item ((PyObject *) self, i);
+
+		if (item == NULL)
+		{
+			Py_DECREF(list);
+			return NULL;
+		}
+
+		PyList_SET_ITEM(list, i, item);
+	}
+
+	self->materialized = list;
+	return list;
+}
+
+static PyObject *
+nemo_python_list_subscript (PyObject *object,
+							PyObject *key)
+{
+	NemoPythonList *self = (NemoPythonList *) object;
+	Py_ssize_t start, stop, step, length, i;
+	PyObject *ret;
+
+	if (self->materialized != NULL)
+		return PyObject_GetItem(self->materialized, key);
+
+	if (PyIndex_Check(key))
+	{
+		Py_ssize_t index = PyNumber_AsSsize_t(key, PyExc_IndexError);
+
+		if (index == -1 && PyErr_Occurred())
+			return NULL;
+		if (index < 0)
+			index += self->length;
+
+		return nemo_python_list_item (object, index);
+	}
+
+	if (!PySlice_Check(key))
+	{
+		PyErr_Format(PyExc_TypeError, "indices must be integers or slices, not %.200s",
+					 Py_TYPE(key)->tp_name);
+		return NULL;
+	}
+
+	if (PySlice_Unpack(key, &start, &stop, &step) < 0)
+		return NULL;
+
+	length = PySlice_AdjustIndices(self->length, &start, &stop, step);
+
+	ret = PyList_New(length);
+	if (ret == NULL)
+		return NULL;
+
+	for (i = 0; i < length; i++)
+	{
+		PyObject *item = nemo_python_list_item (object, start + i * step);
+
+		if (item == NULL)
+		{
+			Py_DECREF(ret);
+			return NULL;
+		}
+
+		PyList_SET_ITEM(ret, i, item);
+	}
+
+	return ret;
+}
+
+static int
+nemo_python_list_ass_subscript (PyObject *object,
+								PyObject *key,
+								PyObject *value)
+{
+	PyObject *list = nemo_python_list_materialize ((NemoPythonList *) object);
+
+	if (list == NULL)
+		return -1;
+
+	if (value == NULL)
+		return PyObject_DelItem(list, key);
+
+	return PyObject_SetItem(list, key, value);
+}
+
+static int
+nemo_python_list_contains (PyObject *object,
+						   PyObject *value)
+{
+	PyObject *list = nemo_python_list_materialize ((NemoPythonList *) object);
+
+	if (list == NULL)
+		return -1;
+
+	return PySequence_Contains(list, value);
+}
+
+static PyObject *
+nemo_python_list_concat (PyObject *object,
+						 PyObject *other)
+{
+	PyObject *list = nemo_python_list_materialize ((NemoPythonList *) object);
+
+	if (list == NULL)
+		return NULL;
+
+	return PySequence_Concat(list, other);
+}
+
+static PyObject *
+nemo_python_list_repeat (PyObject   *object,
+						 Py_ssize_t  count)
+{
+	PyObject *list = nemo_python_list_materialize ((NemoPythonList *) object);
+
+	if (list == NULL)
+		return NULL;
+
+	return PySequence_Repeat(list, count);
+}
+
+static PyObject *
+nemo_python_list_inplace_concat (PyObject *object,
+								 PyObject *other)
+{
+	PyObject *list = nemo_python_list_materialize ((NemoPythonList *) object);
+	PyObject *ret;
+
+	if (list == NULL)
+		return NULL;
+
+	ret = PySequence_InPlaceConcat(list, other);
+	if (ret == NULL)
+		return NULL;
+	Py_DECREF(ret);
+
+	Py_INCREF(object);
+	return object;
+}
+
+static PyObject *
+nemo_python_list_richcompare (PyObject *object,
+							  PyObject *other,
+							  int       op)
+{
+	PyObject *list = nemo_python_list_materialize ((NemoPythonList *) object);
+
+	if (list == NULL)
+		return NULL;
+
+	if (Py_TYPE(other) == Py_TYPE(object))
+	{
+		other = nemo_python_list_materialize ((NemoPythonList *) other);
+		if (other == NULL)
+			return NULL;
+	}
+
+	return PyObject_RichCompare(list, other, op);
+}
+
+static PyObject *
+nemo_python_list_repr (PyObject *object)
+{
+	PyObject *list = nemo_python_list_materialize ((NemoPythonList *) object);
+
+	if (list == NULL)
+		return NULL;
+
+	return PyObject_Repr(list);
+}
+
+/* Anything a list has that we don't, like sort() or index() */
+static PyObject *
+nemo_python_list_getattro (PyObject *object,
+						   PyObject *name)
+{
+	PyObject *ret, *list;
+
+	ret = PyObject_GenericGetAttr(object, name);
+	if (ret != NULL || !PyErr_ExceptionMatches(PyExc_AttributeError))
+		return ret;
+
+	PyErr_Clear();
+
+	list = nemo_python_list_materialize ((NemoPythonList *) object);
+	if (list == NULL)
+		return NULL;
+
+	return PyObject_GetAttr(list, name);
+}
+
+/* Drops the wrappers and the real list.  Used to break cycles too, as an
+ * extension can keep the sequence on one of its own items. */
+static int
+nemo_python_list_clear (PyObject *object)
+{
+	NemoPythonList *self = (NemoPythonList *) object;
+	GList *l;
+	Py_ssize_t i;
+
+	Py_CLEAR(self->materialized);
+
+	if (self->items != NULL)
+	{
+		for (i = 0, l = self->list; i < self->length; i++)
+		{
+			if (self->items[i] != NULL)
+			{
+				Py_CLEAR(self->items[i]);
+
+				/* Wrapped after nemo_python_list_release(), so that
+				 * couldn't drop the data PyGObject attached */
+				if (self->owned)
+					g_object_set_data ((GObject *) l->data, "PyGObject::instance-data", NULL);
+			}
+
+			if (self->owned)
+				l = l->next;
+		}
+	}
+
+	return 0;
+}
+
+static int
+nemo_python_list_traverse (PyObject  *object,
+						   visitproc  visit,
+						   void      *arg)
+{
+	NemoPythonList *self = (NemoPythonList *) object;
+	Py_ssize_t i;
+
+	Py_VISIT(self->materialized);
+
+	if (self->items != NULL)
+	{
+		for (i = 0; i < self->length; i++)
+			Py_VISIT(self->items[i]);
+	}
+
+	return 0;
+}
+
+static void
+nemo_python_list_dealloc (PyObject *object)
+{
+	NemoPythonList *self = (NemoPythonList *) object;
+
+	PyObject_GC_UnTrack(object);
+
+	nemo_python_list_clear (object);
+	g_free (self->items);
+
+	if (self->owned)
+		g_list_free_full (self->list, g_object_unref);
+
+	Py_TYPE(object)->tp_free(object);
+}
+
+static PySequenceMethods nemo_python_list_as_sequence = {
+	.sq_length = nemo_python_list_length,
+	.sq_concat = nemo_python_list_concat,
+	.sq_repeat = nemo_python_list_repeat,
+	.sq_item = nemo_python_list_item,
+	.sq_contains = nemo_python_list_contains,
+	.sq_inplace_concat = nemo_python_list_inplace_concat,
+};
+
+static PyMappingMethods nemo_python_list_as_mapping = {
+	.mp_length = nemo_python_list_length,
+	.mp_subscript = nemo_python_list_subscript,
+	.mp_ass_subscript = nemo_python_list_ass_subscript,
+};
+
+#ifndef Py_TPFLAGS_SEQUENCE
+#define Py_TPFLAGS_SEQUENCE 0
+#endif
+
+static PyTypeObject NemoPythonList_Type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "nemo_python.FileList",
+	.tp_basicsize = sizeof (NemoPythonList),
+	.tp_dealloc = nemo_python_list_dealloc,
+	.tp_repr = nemo_python_list_repr,
+	.tp_as_sequence = &nemo_python_list_as_sequence,
+	.tp_as_mapping = &nemo_python_list_as_mapping,
+	.tp_getattro = nemo_python_list_getattro,
+	.tp_richcompare = nemo_python_list_richcompare,
+	.tp_iter = PySeqIter_New,
+	.tp_traverse = nemo_python_list_traverse,
+	.tp_clear = nemo_python_list_clear,
+	.tp_free = PyObject_GC_Del,
+	.tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC | Py_TPFLAGS_SEQUENCE,
+	.tp_doc = "Sequence of the files passed to an extension",
+};
+
+gboolean
+nemo_python_list_init_type (void)
+{
+	PyObject *abc, *sequence, *ret = NULL;
+
+	if (PyType_Ready(&NemoPythonList_Type) < 0)
+	{
+		PyErr_Print();
+		return FALSE;
+	}
+
+	/* isinstance(files, list) can't hold without a real list behind it,
+	 * so at least let extensions check against the abstract type. */
+	abc = PyImport_ImportModule("collections.abc");
+	if (abc == NULL)
+	{
+		PyErr_Print();
+		return TRUE;
+	}
+
+	sequence = PyObject_GetAttrString(abc, "MutableSequence");
+	if (sequence != NULL)
+	{
+		ret = PyObject_CallMethod(sequence, "register", "O", &NemoPythonList_Type);
+		Py_DECREF(sequence);
+	}
+	Py_DECREF(abc);
+
+	if (ret == NULL)
+		PyErr_Print();
+	Py_XDECREF(ret);
+
+	return TRUE;
+}
+
+PyObject *
+nemo_python_list_new (GList *list)
+{
+	NemoPythonList *self;
+
+	self = PyObject_GC_New(NemoPythonList, &NemoPythonList_Type);
+	if (self == NULL)
+		return NULL;
+
+	self->list = list;
+	self->owned = FALSE;
+	self->length = g_list_length (list);
+	self->items = NULL;
+	self->materialized = NULL;
+	self->cursor = NULL;
+	self->cursor_index = 0;
+
+	PyObject_GC_Track((PyObject *) self);
+
+	return (PyObject *) self;
+}
+
+void
+nemo_python_list_release (PyObject *object)
+{
+	NemoPythonList *self = (NemoPythonList *) object;
+	GList *wrapped = NULL, *l;
+	Py_ssize_t i;
+
+	if (self->owned)
+		return;
+
+	if (self->items != NULL)
+	{
+		l = self->list;
+
+		for (i = 0; i < self->length; i++, l = l->next)
+		{
+			if (self->items[i] != NULL)
+				wrapped = g_list_prepend (wrapped, l->data);
+		}
+	}
+
+	if (Py_REFCNT(object) > 1)
+	{
+		/* The extension kept the sequence (e.g. as a signal callback
+		 * argument), so it can no longer borrow the caller's list. */
+		self->list = g_list_copy_deep (self->list, (GCopyFunc) g_object_ref, NULL);
+		self->owned = TRUE;
+		self->cursor = NULL;
+	}
+	else if (self->items != NULL)
+	{
+		for (i = 0; i < self->length; i++)
+			Py_CLEAR(self->items[i]);
+	}
+
+	/* Some NemoFile objects are cached and not freed until nemo itself is
+	 * closed, so drop the data PyGObject attached to the ones we wrapped
+	 * while the interpreter is still around to free it. */
+	for (l = wrapped; l != NULL; l = l->next)
+		g_object_set_data ((GObject *) l->data, "PyGObject::instance-data", NULL);
+
+	g_list_free (wrapped);
+}
@@ -0,0 +1,42 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef NEMO_PYTHON_LIST_H
+#define NEMO_PYTHON_LIST_H
+
+#include <Python.h>
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+/* A python sequence backed by a GList of GObjects.  Wrappers are only
+ * created for the items python actually looks at.  Anything else a list
+ * can do (methods, comparing, assigning to items...) works on a real
+ * list made from it on first use.
+ *
+ * The list is borrowed from the caller, who must call
+ * nemo_python_list_release() before it goes away.  If python is still
+ * holding on to the sequence at that point, it takes its own copy.
+ */
+gboolean  nemo_python_list_init_type (void);
+
+PyObject *nemo_python_list_new       (GList    *list);
+void      nemo_python_list_release   (PyObject *self);
+
+G_END_DECLS
+
+#endif /* NEMO_PYTHON_LIST_H */
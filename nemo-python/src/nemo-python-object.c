@@ -20,6 +20,8 @@
 #include <config.h>
 
 #include "nemo-python-object.h"
+#include "nemo-python-list.h"
+#include "nemo-python-profile.h"
 #include "nemo-python.h"
 
 #include <libnemo-extension/nemo-extension-types.h>
@@ -43,6 +45,9 @@
 
 static GObjectClass *parent_class;
 
+static gboolean nemo_python_object_ensure_instance (NemoPythonObject *object);
+static NemoPythonHelper *nemo_python_object_get_helper (NemoPythonObject *object);
+
 /* These macros assumes the following things:
  *   a METHOD_NAME is defined with is a string
  *   a goto label called beach
@@ -54,24 +59,26 @@ static GObjectClass *parent_class;
 		goto beach;
 
 #define CHECK_OBJECT(object)										   \
-  	if (object->instance == NULL)									   \
-  	{																   \
-  		g_object_unref (object);									   \
+  	if (!nemo_python_object_ensure_instance (object))				   \
   		goto beach;													   \
-  	}																   \
 
 #define CONVERT_LIST(py_files, files)                                  \
 	{                                                                  \
-		GList *l;                                                      \
-        py_files = PyList_New(0);                                      \
-		for (l = files; l; l = l->next)                                \
+		py_files = nemo_python_list_new (files);                       \
+		if (!py_files)                                                 \
 		{                                                              \
-            PyObject *item = pygobject_new ((GObject *)l->data);       \
-            PyList_Append(py_files, item);                             \
-            Py_DECREF (item);                                          \
+			PyErr_Print();                                             \
+			goto beach;                                                \
 		}                                                              \
 	}
 
+#define RELEASE_LIST(py_files)                                         \
+	if (py_files)                                                      \
+	{                                                                  \
+		nemo_python_list_release (py_files);                           \
+		Py_DECREF(py_files);                                           \
+	}
+
 #define HANDLE_RETVAL(py_ret)                                          \
     if (!py_ret)                                                       \
     {                                                                  \
@@ -85,28 +92,39 @@ static GObjectClass *parent_class;
 
 #define HANDLE_LIST(py_ret, type, type_name)                           \
     {                                                                  \
-        Py_ssize_t i = 0;                                              \
+        PyObject *py_seq;                                              \
+        Py_ssize_t i;                                                  \
+        if ((PyList_CheckExact(py_ret) || PyTuple_CheckExact(py_ret)) && \
+            Py_SIZE(py_ret) == 0)                                      \
+            goto beach;                                                \
     	if (!PySequence_Check(py_ret) || PyUnicode_Check(py_ret))       \
     	{                                                              \
     		PyErr_SetString(PyExc_TypeError,                           \
     						METHOD_NAME " must return a sequence");    \
     		goto beach;                                                \
     	}                                                              \
-    	for (i = 0; i < PySequence_Size (py_ret); i++)                 \
+    	py_seq = PySequence_Fast(py_ret, METHOD_NAME                   \
+    							 " must return a sequence");           \
+    	if (!py_seq)                                                   \
+    		goto beach;                                                \
+    	for (i = PySequence_Fast_GET_SIZE(py_seq) - 1; i >= 0; i--)    \
     	{                                                              \
     		PyGObject *py_item;                                        \
-    		py_item = (PyGObject*)PySequence_GetItem (py_ret, i);      \
+    		py_item = (PyGObject*)PySequence_Fast_GET_ITEM(py_seq, i); \
     		if (!pygobject_check(py_item, &Py##type##_Type))           \
     		{                                                          \
     			PyErr_SetString(PyExc_TypeError,                       \
     							METHOD_NAME                            \
     							" must return a sequence of "          \
     							type_name);                            \
+    			g_list_free_full (ret, g_object_unref);                \
+    			ret = NULL;                                            \
+    			Py_DECREF(py_seq);                                     \
     			goto beach;                                            \
     		}                                                          \
-    		ret = g_list_append (ret, (type*) g_object_ref(py_item->obj));  \
-            Py_DECREF(py_item);                                        \
+    		ret = g_list_prepend (ret, (type*) g_object_ref(py_item->obj)); \
     	}                                                              \
+    	Py_DECREF(py_seq);                                             \
     }
 
 
@@ -120,15 +138,6 @@ free_pygobject_data(gpointer data, gpointer user_data)
 	g_object_set_data((GObject *)data, "PyGObject::instance-data", NULL);
 }
 
-static void
-free_pygobject_data_list(GList *list)
-{
-	if (list == NULL)
-		return;
-		
-	g_list_foreach(list, (GFunc)free_pygobject_data, NULL);
-}
-
 static PyObject *
 nemo_python_boxed_new (PyTypeObject *type, gpointer boxed, gboolean free_on_dealloc)
 {
@@ -145,9 +154,25 @@ static GList *
 nemo_python_object_get_name_and_desc (NemoNameAndDescProvider *provider)
 {
     NemoPythonObject *object = (NemoPythonObject*)provider;
+    NemoPythonHelper *helper;
     PyObject *py_ret = NULL;
     GList *ret = NULL;
-    PyGILState_STATE state = pyg_gil_state_ensure();
+    PyGILState_STATE state;
+    NemoPythonProfileCall call;
+
+    if ((helper = nemo_python_object_get_helper(object)) != NULL)
+    {
+        nemo_python_profile_acquired (&call);
+        ret = nemo_python_helper_get_name_and_desc (helper);
+        nemo_python_profile_end (provider, METHOD_NAME, &call);
+        return ret;
+    }
+
+    if (!nemo_python_ensure_initialized())
+        return ret;
+
+    state = pyg_gil_state_ensure();
+    nemo_python_profile_acquired (&call);
     
     debug_enter();
 
@@ -174,6 +199,7 @@ nemo_python_object_get_name_and_desc (NemoNameAndDescProvider *provider)
         }
  beach:
     Py_XDECREF(py_ret);
+    nemo_python_profile_end (provider, METHOD_NAME, &call);
     pyg_gil_state_release(state);
     return ret;
 }
@@ -191,9 +217,16 @@ nemo_python_object_get_property_pages (NemoPropertyPageProvider *provider,
 										   GList 						*files)
 {
 	NemoPythonObject *object = (NemoPythonObject*)provider;
-    PyObject *py_files, *py_ret = NULL;
+    PyObject *py_files = NULL, *py_ret = NULL;
     GList *ret = NULL;
-	PyGILState_STATE state = pyg_gil_state_ensure();
+	PyGILState_STATE state;
+	NemoPythonProfileCall call;
+
+	if (!nemo_python_ensure_initialized())
+		return ret;
+
+	state = pyg_gil_state_ensure();
+	nemo_python_profile_acquired (&call);
 	
   	debug_enter();
 
@@ -203,14 +236,15 @@ nemo_python_object_get_property_pages (NemoPropertyPageProvider *provider,
 	CONVERT_LIST(py_files, files);
 	
     py_ret = PyObject_CallMethod(object->instance, METHOD_PREFIX METHOD_NAME,
-								 "(N)", py_files);
+								 "(O)", py_files);
 	HANDLE_RETVAL(py_ret);
 
 	HANDLE_LIST(py_ret, NemoPropertyPage, "Nemo.PropertyPage");
 	
  beach:
-    free_pygobject_data_list (files);
+    RELEASE_LIST(py_files);
 	Py_XDECREF(py_ret);
+	nemo_python_profile_end (provider, METHOD_NAME, &call);
 	pyg_gil_state_release(state);
     return ret;
 }
@@ -234,7 +268,14 @@ nemo_python_object_get_widget (NemoLocationWidgetProvider *provider,
 	PyObject *py_ret = NULL;
 	PyGObject *py_ret_gobj;
 	PyObject *py_uri = NULL;
-	PyGILState_STATE state = pyg_gil_state_ensure();
+	PyGILState_STATE state;
+	NemoPythonProfileCall call;
+
+	if (!nemo_python_ensure_initialized())
+		return ret;
+
+	state = pyg_gil_state_ensure();
+	nemo_python_profile_acquired (&call);
 
 	debug_enter();
 
@@ -259,6 +300,7 @@ nemo_python_object_get_widget (NemoLocationWidgetProvider *provider,
 
  beach:
 	Py_XDECREF(py_ret);
+	nemo_python_profile_end (provider, METHOD_NAME, &call);
 	pyg_gil_state_release(state);
 	return ret;
 }
@@ -278,8 +320,15 @@ nemo_python_object_get_file_items (NemoMenuProvider *provider,
 {
 	NemoPythonObject *object = (NemoPythonObject*)provider;
     GList *ret = NULL;
-    PyObject *py_ret = NULL, *py_files;
-	PyGILState_STATE state = pyg_gil_state_ensure();
+    PyObject *py_ret = NULL, *py_files = NULL;
+	PyGILState_STATE state;
+	NemoPythonProfileCall call;
+
+	if (!nemo_python_ensure_initialized())
+		return ret;
+
+	state = pyg_gil_state_ensure();
+	nemo_python_profile_acquired (&call);
 	
   	debug_enter();
 
@@ -289,7 +338,7 @@ nemo_python_object_get_file_items (NemoMenuProvider *provider,
 	{
 		CONVERT_LIST(py_files, files);
 		py_ret = PyObject_CallMethod(object->instance, METHOD_PREFIX "get_file_items_full",
-									 "(NNN)",
+									 "(NNO)",
 									 pygobject_new((GObject *)provider), 
 									 pygobject_new((GObject *)window), 
 									 py_files);
@@ -298,7 +347,7 @@ nemo_python_object_get_file_items (NemoMenuProvider *provider,
 	{
 		CONVERT_LIST(py_files, files);
 		py_ret = PyObject_CallMethod(object->instance, METHOD_PREFIX METHOD_NAME,
-									 "(NN)", 
+									 "(NO)", 
 									 pygobject_new((GObject *)window), 
 									 py_files);
 	}
@@ -312,8 +361,9 @@ nemo_python_object_get_file_items (NemoMenuProvider *provider,
 	HANDLE_LIST(py_ret, NemoMenuItem, "Nemo.MenuItem");
 
  beach:
- 	free_pygobject_data_list(files);
+ 	RELEASE_LIST(py_files);
 	Py_XDECREF(py_ret);
+	nemo_python_profile_end (provider, METHOD_NAME, &call);
 	pyg_gil_state_release(state);
     return ret;
 }
@@ -328,7 +378,14 @@ nemo_python_object_get_background_items (NemoMenuProvider *provider,
 	NemoPythonObject *object = (NemoPythonObject*)provider;
     GList *ret = NULL;
     PyObject *py_ret = NULL;
-	PyGILState_STATE state = pyg_gil_state_ensure();
+	PyGILState_STATE state;
+	NemoPythonProfileCall call;
+
+	if (!nemo_python_ensure_initialized())
+		return ret;
+
+	state = pyg_gil_state_ensure();
+	nemo_python_profile_acquired (&call);
 	
   	debug_enter();
 
@@ -361,6 +418,7 @@ nemo_python_object_get_background_items (NemoMenuProvider *provider,
  beach:
 	free_pygobject_data(file, NULL);
 	Py_XDECREF(py_ret);
+	nemo_python_profile_end (provider, METHOD_NAME, &call);
 	pyg_gil_state_release(state);
     return ret;
 }
@@ -378,9 +436,25 @@ static GList *
 nemo_python_object_get_columns (NemoColumnProvider *provider)
 {
 	NemoPythonObject *object = (NemoPythonObject*)provider;
+	NemoPythonHelper *helper;
     GList *ret = NULL;
     PyObject *py_ret = NULL;
-	PyGILState_STATE state = pyg_gil_state_ensure();                                    \
+	PyGILState_STATE state;
+	NemoPythonProfileCall call;
+
+	if ((helper = nemo_python_object_get_helper(object)) != NULL)
+	{
+		nemo_python_profile_acquired (&call);
+		ret = nemo_python_helper_get_columns (helper);
+		nemo_python_profile_end (provider, METHOD_NAME, &call);
+		return ret;
+	}
+
+	if (!nemo_python_ensure_initialized())
+		return ret;
+
+	state = pyg_gil_state_ensure();
+	nemo_python_profile_acquired (&call);
 
 	debug_enter();
 		
@@ -397,6 +471,7 @@ nemo_python_object_get_columns (NemoColumnProvider *provider)
  beach:
 	if (py_ret != NULL)
 		Py_XDECREF(py_ret);
+	nemo_python_profile_end (provider, METHOD_NAME, &call);
 	pyg_gil_state_release(state);
     return ret;
 }
@@ -415,10 +490,24 @@ nemo_python_object_cancel_update (NemoInfoProvider 		*provider,
 									  NemoOperationHandle 	*handle)
 {
 	NemoPythonObject *object = (NemoPythonObject*)provider;
+	NemoPythonHelper *helper;
     PyObject *py_ret = NULL;
+	PyGILState_STATE state;
+	NemoPythonProfileCall call;
+	PyObject *py_handle;
 
-	PyGILState_STATE state = pyg_gil_state_ensure();
-	PyObject *py_handle = nemo_python_boxed_new (_PyNemoOperationHandle_Type, handle, FALSE);
+	if ((helper = nemo_python_object_get_helper(object)) != NULL)
+	{
+		nemo_python_helper_cancel_update (helper, handle);
+		return;
+	}
+
+	if (!nemo_python_ensure_initialized())
+		return;
+
+	state = pyg_gil_state_ensure();
+	nemo_python_profile_acquired (&call);
+	py_handle = nemo_python_boxed_new (_PyNemoOperationHandle_Type, handle, FALSE);
 
   	debug_enter();
 
@@ -434,6 +523,7 @@ nemo_python_object_cancel_update (NemoInfoProvider 		*provider,
 
  beach:
     Py_XDECREF(py_ret);
+	nemo_python_profile_end (provider, METHOD_NAME, &call);
 	pyg_gil_state_release(state);
 }
 #undef METHOD_NAME
@@ -450,9 +540,22 @@ nemo_python_object_update_file_info (NemoInfoProvider 		*provider,
 										 NemoOperationHandle   **handle)
 {
 	NemoPythonObject *object = (NemoPythonObject*)provider;
+	NemoPythonHelper *helper;
     NemoOperationResult ret = NEMO_OPERATION_COMPLETE;
     PyObject *py_ret = NULL;
-	PyGILState_STATE state = pyg_gil_state_ensure();
+	PyGILState_STATE state;
+	NemoPythonProfileCall call;
+	PyObject *py_handle;
+
+	/* Isolated extensions always answer asynchronously */
+	if ((helper = nemo_python_object_get_helper(object)) != NULL)
+	{
+		nemo_python_profile_acquired (&call);
+		ret = nemo_python_helper_update_file_info (helper, provider, file,
+												   update_complete, handle);
+		nemo_python_profile_end (provider, METHOD_NAME, &call);
+		return ret;
+	}
 
     /* For python extensions, we can't do assignment on the handle within python itself,
      * so we make a dummy struct to fill it.  Nemo relies on the handle pointer for
@@ -461,9 +564,15 @@ nemo_python_object_update_file_info (NemoInfoProvider 		*provider,
      * ids, and handle cancel_upate calls correctly.
      */
 
+	if (!nemo_python_ensure_initialized())
+		return ret;
+
     *handle = (NemoOperationHandle *) g_new0(DummyStruct, 1);
 
-    PyObject *py_handle = nemo_python_boxed_new (_PyNemoOperationHandle_Type, *handle, TRUE);
+	state = pyg_gil_state_ensure();
+	nemo_python_profile_acquired (&call);
+
+    py_handle = nemo_python_boxed_new (_PyNemoOperationHandle_Type, *handle, TRUE);
 
     debug_enter();
 
@@ -503,6 +612,7 @@ nemo_python_object_update_file_info (NemoInfoProvider 		*provider,
  beach:
  	free_pygobject_data(file, NULL);
 	Py_XDECREF(py_ret);
+	nemo_python_profile_end (provider, METHOD_NAME, &call);
 	pyg_gil_state_release(state);
     return ret;
 }
@@ -523,11 +633,102 @@ nemo_python_object_instance_init (NemoPythonObject *object)
 
 	class = (NemoPythonObjectClass*)(((GTypeInstance*)object)->g_class);
 
+	/* Types declared by a manifest are instantiated on first use */
+	if (class->module_name != NULL)
+		return;
+
+	object->loaded = TRUE;
 	object->instance = PyObject_CallObject(class->type, NULL);
 	if (object->instance == NULL)
 		PyErr_Print();
 }
 
+static NemoPythonProviders
+nemo_python_object_get_providers (PyObject *type)
+{
+	NemoPythonProviders providers = 0;
+
+	if (PyObject_IsSubclass(type, (PyObject*)&PyNemoPropertyPageProvider_Type))
+		providers |= NEMO_PYTHON_PROVIDER_PROPERTY_PAGE;
+	if (PyObject_IsSubclass(type, (PyObject*)&PyNemoLocationWidgetProvider_Type))
+		providers |= NEMO_PYTHON_PROVIDER_LOCATION_WIDGET;
+	if (PyObject_IsSubclass(type, (PyObject*)&PyNemoMenuProvider_Type))
+		providers |= NEMO_PYTHON_PROVIDER_MENU;
+	if (PyObject_IsSubclass(type, (PyObject*)&PyNemoColumnProvider_Type))
+		providers |= NEMO_PYTHON_PROVIDER_COLUMN;
+	if (PyObject_IsSubclass(type, (PyObject*)&PyNemoInfoProvider_Type))
+		providers |= NEMO_PYTHON_PROVIDER_INFO;
+	if (PyObject_IsSubclass(type, (PyObject*)&PyNemoNameAndDescProvider_Type))
+		providers |= NEMO_PYTHON_PROVIDER_NAME_AND_DESC;
+
+	return providers;
+}
+
+/* Makes sure object->instance exists, importing the extension module
+ * first if the type was registered from a manifest.  The GIL must be held.
+ */
+static gboolean
+nemo_python_object_ensure_instance (NemoPythonObject *object)
+{
+	NemoPythonObjectClass *class;
+
+	if (object->loaded)
+		return object->instance != NULL;
+
+	object->loaded = TRUE;
+
+	class = (NemoPythonObjectClass*)(((GTypeInstance*)object)->g_class);
+
+	if (class->type == NULL)
+	{
+		if (class->load_failed)
+			return FALSE;
+
+		class->type = nemo_python_import_type(class->module_name, class->class_name);
+		if (class->type == NULL)
+		{
+			class->load_failed = TRUE;
+			return FALSE;
+		}
+
+		if ((nemo_python_object_get_providers(class->type) & class->providers) != class->providers)
+		{
+			g_warning("%s.%s does not implement all the interfaces listed in its manifest",
+					  class->module_name, class->class_name);
+		}
+	}
+
+	object->instance = PyObject_CallObject(class->type, NULL);
+	if (object->instance == NULL)
+	{
+		PyErr_Print();
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Returns the helper process running an isolated type, starting it if
+ * needed, or NULL if the type runs in-process.
+ */
+static NemoPythonHelper *
+nemo_python_object_get_helper (NemoPythonObject *object)
+{
+	NemoPythonObjectClass *class;
+
+	class = (NemoPythonObjectClass*)(((GTypeInstance*)object)->g_class);
+
+	if (!class->isolated)
+		return NULL;
+
+	if (class->helper == NULL)
+		class->helper = nemo_python_helper_get (class->dirname,
+												class->module_name,
+												class->class_name);
+
+	return class->helper;
+}
+
 static void
 nemo_python_object_finalize (GObject *object)
 {
@@ -537,24 +738,40 @@ nemo_python_object_finalize (GObject *object)
 		Py_DECREF(((NemoPythonObject *)object)->instance);
 }
 
+typedef struct {
+	PyObject *type;
+	gchar *dirname;
+	gchar *module_name;
+	gchar *class_name;
+	NemoPythonProviders providers;
+	gboolean isolated;
+} NemoPythonClassData;
+
 static void
 nemo_python_object_class_init (NemoPythonObjectClass *class,
 								   gpointer 				  class_data)
 {
+	NemoPythonClassData *data = class_data;
+
 	debug_enter();
 
 	parent_class = g_type_class_peek_parent (class);
 	
-	class->type = (PyObject*)class_data;
+	class->type = data->type;
+	class->dirname = data->dirname;
+	class->module_name = data->module_name;
+	class->class_name = data->class_name;
+	class->providers = data->providers;
+	class->isolated = data->isolated;
 	
 	G_OBJECT_CLASS (class)->finalize = nemo_python_object_finalize;
 }
 
-GType 
-nemo_python_object_get_type (GTypeModule *module, 
-								 PyObject 	*type)
+static GType
+nemo_python_object_register_type (GTypeModule         *module,
+								  const gchar         *name,
+								  NemoPythonClassData *class_data)
 {
-    PyObject *name_str = NULL;
 	GTypeInfo *info;
 	gchar *type_name;
 	GType gtype;
@@ -595,9 +812,7 @@ nemo_python_object_get_type (GTypeModule *module,
         NULL
     };
 
-    name_str = PyObject_GetAttrString(type, "__name__");
-
-	debug_enter_args("type=%s", PyUnicode_AsUTF8(name_str));
+	debug_enter_args("type=%s", name);
 	info = g_new0 (GTypeInfo, 1);
 	
 	info->class_size = sizeof (NemoPythonObjectClass);
@@ -605,13 +820,9 @@ nemo_python_object_get_type (GTypeModule *module,
 	info->instance_size = sizeof (NemoPythonObject);
 	info->instance_init = (GInstanceInitFunc)nemo_python_object_instance_init;
 
-	info->class_data = type;
-	Py_INCREF(type);
-
-	type_name = g_strdup_printf("%s+NemoPython",
-								PyUnicode_AsUTF8(name_str));
+	info->class_data = class_data;
 
-    Py_XDECREF(name_str);
+	type_name = g_strdup_printf("%s+NemoPython", name);
 		
 	gtype = g_type_module_register_type (module, 
 										 G_TYPE_OBJECT,
@@ -621,42 +832,42 @@ nemo_python_object_get_type (GTypeModule *module,
     g_free (info);
     g_free (type_name);
 
-	if (PyObject_IsSubclass(type, (PyObject*)&PyNemoPropertyPageProvider_Type))
+	if (class_data->providers & NEMO_PYTHON_PROVIDER_PROPERTY_PAGE)
 	{
 		g_type_module_add_interface (module, gtype, 
 									 NEMO_TYPE_PROPERTY_PAGE_PROVIDER,
 									 &property_page_provider_iface_info);
 	}
 
-	if (PyObject_IsSubclass(type, (PyObject*)&PyNemoLocationWidgetProvider_Type))
+	if (class_data->providers & NEMO_PYTHON_PROVIDER_LOCATION_WIDGET)
 	{
 		g_type_module_add_interface (module, gtype,
 									 NEMO_TYPE_LOCATION_WIDGET_PROVIDER,
 									 &location_widget_provider_iface_info);
 	}
 	
-	if (PyObject_IsSubclass(type, (PyObject*)&PyNemoMenuProvider_Type))
+	if (class_data->providers & NEMO_PYTHON_PROVIDER_MENU)
 	{
 		g_type_module_add_interface (module, gtype, 
 									 NEMO_TYPE_MENU_PROVIDER,
 									 &menu_provider_iface_info);
 	}
 
-	if (PyObject_IsSubclass(type, (PyObject*)&PyNemoColumnProvider_Type))
+	if (class_data->providers & NEMO_PYTHON_PROVIDER_COLUMN)
 	{
 		g_type_module_add_interface (module, gtype, 
 									 NEMO_TYPE_COLUMN_PROVIDER,
 									 &column_provider_iface_info);
 	}
 
-	if (PyObject_IsSubclass(type, (PyObject*)&PyNemoInfoProvider_Type))
+	if (class_data->providers & NEMO_PYTHON_PROVIDER_INFO)
 	{
 		g_type_module_add_interface (module, gtype, 
 									 NEMO_TYPE_INFO_PROVIDER,
 									 &info_provider_iface_info);
 	}
 
-    if (PyObject_IsSubclass(type, (PyObject*)&PyNemoNameAndDescProvider_Type))
+    if (class_data->providers & NEMO_PYTHON_PROVIDER_NAME_AND_DESC)
     {
         g_type_module_add_interface (module, gtype, 
                                      NEMO_TYPE_NAME_AND_DESC_PROVIDER,
@@ -665,3 +876,47 @@ nemo_python_object_get_type (GTypeModule *module,
 
     return gtype;
 }
+
+GType 
+nemo_python_object_get_type (GTypeModule *module, 
+								 PyObject 	*type)
+{
+    PyObject *name_str = NULL;
+	NemoPythonClassData *class_data;
+	GType gtype;
+
+    name_str = PyObject_GetAttrString(type, "__name__");
+
+	class_data = g_new0 (NemoPythonClassData, 1);
+	class_data->type = type;
+	class_data->providers = nemo_python_object_get_providers (type);
+	Py_INCREF(type);
+
+	gtype = nemo_python_object_register_type (module,
+											  PyUnicode_AsUTF8(name_str),
+											  class_data);
+
+    Py_XDECREF(name_str);
+
+    return gtype;
+}
+
+GType
+nemo_python_object_get_lazy_type (GTypeModule         *module,
+								  const gchar         *dirname,
+								  const gchar         *module_name,
+								  const gchar         *class_name,
+								  NemoPythonProviders  providers,
+								  gboolean             isolated)
+{
+	NemoPythonClassData *class_data;
+
+	class_data = g_new0 (NemoPythonClassData, 1);
+	class_data->dirname = g_strdup (dirname);
+	class_data->module_name = g_strdup (module_name);
+	class_data->class_name = g_strdup (class_name);
+	class_data->providers = providers;
+	class_data->isolated = isolated;
+
+	return nemo_python_object_register_type (module, class_name, class_data);
+}
@@ -23,22 +23,53 @@
 #include <Python.h>
 #include <glib-object.h>
 
+#include "nemo-python-helper.h"
+
 G_BEGIN_DECLS
 
 typedef struct _NemoPythonObject       NemoPythonObject;
 typedef struct _NemoPythonObjectClass  NemoPythonObjectClass;
 
+typedef enum {
+    NEMO_PYTHON_PROVIDER_COLUMN          = 1 << 0,
+    NEMO_PYTHON_PROVIDER_INFO            = 1 << 1,
+    NEMO_PYTHON_PROVIDER_LOCATION_WIDGET = 1 << 2,
+    NEMO_PYTHON_PROVIDER_MENU            = 1 << 3,
+    NEMO_PYTHON_PROVIDER_PROPERTY_PAGE   = 1 << 4,
+    NEMO_PYTHON_PROVIDER_NAME_AND_DESC   = 1 << 5,
+} NemoPythonProviders;
+
 struct _NemoPythonObject {
   GObject parent_slot;
   PyObject *instance;
+  gboolean loaded;
 };
 
 struct _NemoPythonObjectClass {
     GObjectClass parent_slot;
     PyObject *type;
+
+    /* Only set for types declared by a manifest; the python class
+     * is imported from module_name the first time it is needed. */
+    gchar *dirname;
+    gchar *module_name;
+    gchar *class_name;
+    NemoPythonProviders providers;
+    gboolean load_failed;
+
+    /* Isolated types never load python in nemo, all calls go to a
+     * nemo-python-helper process instead. */
+    gboolean isolated;
+    NemoPythonHelper *helper;
 };
 
 GType nemo_python_object_get_type (GTypeModule *module, PyObject *type);
+GType nemo_python_object_get_lazy_type (GTypeModule         *module,
+                                        const gchar         *dirname,
+                                        const gchar         *module_name,
+                                        const gchar         *class_name,
+                                        NemoPythonProviders  providers,
+                                        gboolean             isolated);
 
 G_END_DECLS
 
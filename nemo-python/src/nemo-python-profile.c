@@ -0,0 +1,335 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Profiling of the python bridge, enabled by setting NEMO_PYTHON_PROFILE.
+ *
+ * If the variable holds a path, the report is written there; otherwise it
+ * goes to $XDG_CACHE_HOME/nemo-python/profile-<pid>.json.  The report is
+ * written when the module is shut down, and whenever nemo receives SIGUSR1.
+ */
+
+#include <config.h>
+
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib-unix.h>
+#include <glib/gstdio.h>
+
+#include "nemo-python-profile.h"
+
+/* Latency samples kept per method for the percentile; beyond this,
+ * samples are replaced at random (reservoir sampling). */
+#define MAX_SAMPLES 4096
+
+typedef struct {
+	guint64 calls;
+	gint64 total;
+	gint64 max;
+	GArray *samples;
+} MethodStats;
+
+gboolean nemo_python_profile_enabled = FALSE;
+
+static GMutex profile_lock;
+static gchar *profile_path = NULL;
+static guint signal_id = 0;
+
+/* module name -> gint64 *, in microseconds */
+static GHashTable *imports = NULL;
+/* type name -> (method name -> MethodStats *) */
+static GHashTable *providers = NULL;
+
+static void
+method_stats_free (MethodStats *stats)
+{
+	g_array_free (stats->samples, TRUE);
+	g_free (stats);
+}
+
+void
+nemo_python_profile_record_import (const gchar *module_name,
+								   gint64       usec)
+{
+	gint64 *total;
+
+	if (!nemo_python_profile_enabled)
+		return;
+
+	g_mutex_lock (&profile_lock);
+
+	total = g_hash_table_lookup (imports, module_name);
+	if (total == NULL)
+	{
+		total = g_new0 (gint64, 1);
+		g_hash_table_insert (imports, g_strdup (module_name), total);
+	}
+	*total += usec;
+
+	g_mutex_unlock (&profile_lock);
+}
+
+void
+nemo_python_profile_record_call (GObject               *provider,
+								 const gchar           *method,
+								 NemoPythonProfileCall *call)
+{
+	GHashTable *methods;
+	MethodStats *stats;
+	const gchar *type_name;
+	gint64 now, elapsed;
+
+	now = g_get_monotonic_time ();
+	elapsed = now - call->acquired;
+	type_name = G_OBJECT_TYPE_NAME (provider);
+
+	g_mutex_lock (&profile_lock);
+
+	methods = g_hash_table_lookup (providers, type_name);
+	if (methods == NULL)
+	{
+		methods = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+										 (GDestroyNotify) method_stats_free);
+		g_hash_table_insert (providers, g_strdup (type_name), methods);
+	}
+
+	stats = g_hash_table_lookup (methods, method);
+	if (stats == NULL)
+	{
+		stats = g_new0 (MethodStats, 1);
+		stats->samples = g_array_sized_new (FALSE, FALSE, sizeof (gint64), 64);
+		g_hash_table_insert (methods, (gpointer) method, stats);
+	}
+
+	stats->calls++;
+	stats->total += elapsed;
+	stats->max = MAX (stats->max, elapsed);
+
+	if (stats->samples->len < MAX_SAMPLES)
+	{
+		g_array_append_val (stats->samples, elapsed);
+	}
+	else
+	{
+		guint64 slot = (guint64) (g_random_double () * stats->calls);
+
+		if (slot < MAX_SAMPLES)
+			g_array_index (stats->samples, gint64, slot) = elapsed;
+	}
+
+	g_mutex_unlock (&profile_lock);
+}
+
+static gint
+compare_samples (gconstpointer a,
+				 gconstpointer b)
+{
+	gint64 x = *(const gint64 *) a;
+	gint64 y = *(const gint64 *) b;
+
+	return (x > y) - (x < y);
+}
+
+static gint64
+method_stats_percentile (MethodStats *stats,
+						 gdouble      percentile)
+{
+	gint64 *sorted;
+	gint64 value;
+	guint index;
+
+	if (stats->samples->len == 0)
+		return 0;
+
+	sorted = g_new (gint64, stats->samples->len);
+	memcpy (sorted, stats->samples->data, stats->samples->len * sizeof (gint64));
+	qsort (sorted, stats->samples->len, sizeof (gint64), compare_samples);
+
+	index = (guint) (percentile * (stats->samples->len - 1) + 0.5);
+	value = sorted[index];
+
+	g_free (sorted);
+	return value;
+}
+
+static void
+append_json_string (GString     *json,
+					const gchar *str)
+{
+	const gchar *p;
+
+	g_string_append_c (json, '"');
+
+	for (p = str; *p; p++)
+	{
+		if (*p == '"' || *p == '\\')
+			g_string_append_printf (json, "\\%c", *p);
+		else if ((guchar) *p < 0x20)
+			g_string_append_printf (json, "\\u%04x", *p);
+		else
+			g_string_append_c (json, *p);
+	}
+
+	g_string_append_c (json, '"');
+}
+
+static gchar *
+nemo_python_profile_to_json (void)
+{
+	GHashTableIter iter, method_iter;
+	gpointer key, value, method_key, method_value;
+	gboolean first = TRUE, first_method;
+	GString *json;
+
+	json = g_string_new ("{\n  \"imports\": {");
+
+	g_hash_table_iter_init (&iter, imports);
+	while (g_hash_table_iter_next (&iter, &key, &value))
+	{
+		g_string_append (json, first ? "\n    " : ",\n    ");
+		append_json_string (json, key);
+		g_string_append_printf (json, ": { \"usec\": %" G_GINT64_FORMAT " }",
+								*(gint64 *) value);
+		first = FALSE;
+	}
+
+	g_string_append (json, "\n  },\n  \"providers\": {");
+
+	first = TRUE;
+	g_hash_table_iter_init (&iter, providers);
+	while (g_hash_table_iter_next (&iter, &key, &value))
+	{
+		g_string_append (json, first ? "\n    " : ",\n    ");
+		append_json_string (json, key);
+		g_string_append (json, ": {");
+
+		first_method = TRUE;
+		g_hash_table_iter_init (&method_iter, value);
+		while (g_hash_table_iter_next (&method_iter, &method_key, &method_value))
+		{
+			MethodStats *stats = method_value;
+
+			g_string_append (json, first_method ? "\n      " : ",\n      ");
+			append_json_string (json, method_key);
+			g_string_append_printf (json,
+									": { \"calls\": %" G_GUINT64_FORMAT
+									", \"total_usec\": %" G_GINT64_FORMAT
+									", \"p99_usec\": %" G_GINT64_FORMAT
+									", \"max_usec\": %" G_GINT64_FORMAT " }",
+									stats->calls,
+									stats->total,
+									method_stats_percentile (stats, 0.99),
+									stats->max);
+			first_method = FALSE;
+		}
+
+		g_string_append (json, "\n    }");
+		first = FALSE;
+	}
+
+	g_string_append (json, "\n  }\n}\n");
+
+	return g_string_free (json, FALSE);
+}
+
+static void
+nemo_python_profile_dump (void)
+{
+	GError *error = NULL;
+	gchar *dirname;
+	gchar *json;
+
+	g_mutex_lock (&profile_lock);
+	json = nemo_python_profile_to_json ();
+	g_mutex_unlock (&profile_lock);
+
+	dirname = g_path_get_dirname (profile_path);
+	g_mkdir_with_parents (dirname, 0700);
+	g_free (dirname);
+
+	if (!g_file_set_contents (profile_path, json, -1, &error))
+	{
+		g_warning ("Could not write profile to %s: %s", profile_path, error->message);
+		g_error_free (error);
+	}
+	else
+	{
+		g_message ("nemo-python: profile written to %s", profile_path);
+	}
+
+	g_free (json);
+}
+
+static gboolean
+on_dump_signal (gpointer user_data)
+{
+	nemo_python_profile_dump ();
+
+	return G_SOURCE_CONTINUE;
+}
+
+void
+nemo_python_profile_init (void)
+{
+	const gchar *env_string;
+
+	env_string = g_getenv ("NEMO_PYTHON_PROFILE");
+	if (env_string == NULL)
+		return;
+
+	if (g_path_is_absolute (env_string))
+	{
+		profile_path = g_strdup (env_string);
+	}
+	else
+	{
+		gchar *basename = g_strdup_printf ("profile-%d.json", (int) getpid ());
+
+		profile_path = g_build_filename (g_get_user_cache_dir (),
+										 "nemo-python", basename, NULL);
+		g_free (basename);
+	}
+
+	imports = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	providers = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+									   (GDestroyNotify) g_hash_table_destroy);
+
+	signal_id = g_unix_signal_add (SIGUSR1, on_dump_signal, NULL);
+
+	nemo_python_profile_enabled = TRUE;
+}
+
+void
+nemo_python_profile_shutdown (void)
+{
+	if (!nemo_python_profile_enabled)
+		return;
+
+	nemo_python_profile_dump ();
+
+	nemo_python_profile_enabled = FALSE;
+
+	if (signal_id != 0)
+		g_source_remove (signal_id);
+
+	g_clear_pointer (&imports, g_hash_table_destroy);
+	g_clear_pointer (&providers, g_hash_table_destroy);
+	g_clear_pointer (&profile_path, g_free);
+}
@@ -0,0 +1,60 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef NEMO_PYTHON_PROFILE_H
+#define NEMO_PYTHON_PROFILE_H
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+/* Timings for one call into a python provider.  All fields are zero
+ * when profiling is disabled.
+ */
+typedef struct {
+    gint64 acquired;
+} NemoPythonProfileCall;
+
+extern gboolean nemo_python_profile_enabled;
+
+void nemo_python_profile_init     (void);
+void nemo_python_profile_shutdown (void);
+
+void nemo_python_profile_record_import (const gchar *module_name,
+                                        gint64       usec);
+
+void nemo_python_profile_record_call   (GObject               *provider,
+                                        const gchar           *method,
+                                        NemoPythonProfileCall *call);
+
+#define nemo_python_profile_now() \
+    (nemo_python_profile_enabled ? g_get_monotonic_time () : 0)
+
+/* Call after pyg_gil_state_ensure(), so only time spent in python
+ * counts.  Providers are called on the main thread, which already
+ * holds the GIL, so waiting for it isn't measured. */
+#define nemo_python_profile_acquired(call) \
+    ((call)->acquired = nemo_python_profile_now ())
+#define nemo_python_profile_end(provider, method, call) \
+    G_STMT_START { \
+        if (nemo_python_profile_enabled) \
+            nemo_python_profile_record_call ((GObject *) (provider), method, call); \
+    } G_STMT_END
+
+G_END_DECLS
+
+#endif /* NEMO_PYTHON_PROFILE_H */
@@ -25,7 +25,10 @@
 #include <gtk/gtk.h>
 
 #include "nemo-python.h"
+#include "nemo-python-helper.h"
 #include "nemo-python-object.h"
+#include "nemo-python-list.h"
+#include "nemo-python-profile.h"
 
 #include <libnemo-extension/nemo-extension-types.h>
 
@@ -48,9 +51,24 @@ static const GDebugKey nemo_python_debug_keys[] = {
 static const guint nemo_python_ndebug_keys = sizeof (nemo_python_debug_keys) / sizeof (GDebugKey);
 NemoPythonDebug nemo_python_debug;
 
+static const GDebugKey nemo_python_provider_keys[] = {
+	{"ColumnProvider", NEMO_PYTHON_PROVIDER_COLUMN},
+	{"InfoProvider", NEMO_PYTHON_PROVIDER_INFO},
+	{"LocationWidgetProvider", NEMO_PYTHON_PROVIDER_LOCATION_WIDGET},
+	{"MenuProvider", NEMO_PYTHON_PROVIDER_MENU},
+	{"PropertyPageProvider", NEMO_PYTHON_PROVIDER_PROPERTY_PAGE},
+	{"NameAndDescProvider", NEMO_PYTHON_PROVIDER_NAME_AND_DESC},
+};
+static const guint nemo_python_nprovider_keys = G_N_ELEMENTS (nemo_python_provider_keys);
+
+#define NEMO_PYTHON_ISOLATABLE_PROVIDERS (NEMO_PYTHON_PROVIDER_COLUMN | \
+										  NEMO_PYTHON_PROVIDER_INFO | \
+										  NEMO_PYTHON_PROVIDER_NAME_AND_DESC)
+
 static gboolean nemo_python_init_python(void);
 
 static GArray *all_types = NULL;
+static GPtrArray *search_paths = NULL;
 
 
 static inline gboolean 
@@ -66,31 +84,49 @@ np_init_pygobject(void)
 	return TRUE;
 }
 
-static void
-nemo_python_load_file(GTypeModule *type_module, 
-						  const gchar *filename)
+static PyObject *
+nemo_python_import_module(const gchar *module_name)
 {
-	PyObject *main_module, *main_locals, *locals, *key, *value;
+	PyObject *main_module, *main_locals;
 	PyObject *module;
-	GType gtype;
-	Py_ssize_t pos = 0;
-	
-	debug_enter_args("filename=%s", filename);
-	
+	gint64 start;
+
 	main_module = PyImport_AddModule("__main__");
 	if (main_module == NULL)
 	{
 		g_warning("Could not get __main__.");
-		return;
+		return NULL;
 	}
-	
+
 	main_locals = PyModule_GetDict(main_module);
-	module = PyImport_ImportModuleEx((char *) filename, main_locals, main_locals, NULL);
+	start = nemo_python_profile_now();
+	module = PyImport_ImportModuleEx((char *) module_name, main_locals, main_locals, NULL);
 	if (!module)
 	{
 		PyErr_Print();
-		return;
+		return NULL;
 	}
+
+	if (nemo_python_profile_enabled)
+		nemo_python_profile_record_import(module_name, g_get_monotonic_time() - start);
+
+	return module;
+}
+
+static void
+nemo_python_load_file(GTypeModule *type_module, 
+						  const gchar *filename)
+{
+	PyObject *locals, *key, *value;
+	PyObject *module;
+	GType gtype;
+	Py_ssize_t pos = 0;
+	
+	debug_enter_args("filename=%s", filename);
+	
+	module = nemo_python_import_module(filename);
+	if (!module)
+		return;
 	
 	locals = PyModule_GetDict(module);
 	
@@ -113,13 +149,186 @@ nemo_python_load_file(GTypeModule *type_module,
 	debug("Loaded python modules");
 }
 
+/* Imports module_name and returns a new reference to its class_name
+ * attribute.  Used to resolve types registered from a manifest the first
+ * time one of their providers is called.  The GIL must be held.
+ */
+PyObject *
+nemo_python_import_type(const gchar *module_name,
+						const gchar *class_name)
+{
+	PyObject *module, *type;
+
+	debug_enter_args("module=%s", module_name);
+
+	module = nemo_python_import_module(module_name);
+	if (!module)
+		return NULL;
+
+	type = PyObject_GetAttrString(module, class_name);
+	Py_DECREF(module);
+
+	if (!type)
+	{
+		PyErr_Print();
+		return NULL;
+	}
+
+	if (!PyType_Check(type))
+	{
+		g_warning("%s.%s is not a class", module_name, class_name);
+		Py_DECREF(type);
+		return NULL;
+	}
+
+	return type;
+}
+
+static void
+nemo_python_add_search_path(const char *dirname)
+{
+	PyObject *sys_path, *py_path;
+	guint i;
+
+	for (i = 0; i < search_paths->len; i++)
+	{
+		if (g_strcmp0(g_ptr_array_index(search_paths, i), dirname) == 0)
+			return;
+	}
+
+	g_ptr_array_add(search_paths, g_strdup(dirname));
+
+	/* If python isn't running yet, the path is added by
+	 * nemo_python_init_python along with the others. */
+	if (!Py_IsInitialized())
+		return;
+
+	/* sys.path.insert(0, dirname) */
+	sys_path = PySys_GetObject("path");
+	py_path = PyUnicode_FromString(dirname);
+	PyList_Insert(sys_path, 0, py_path);
+	Py_DECREF(py_path);
+}
+
+/* A manifest is a key file named after the extension module (foo.py ->
+ * foo.nemo-python) with a group for each extension class, listing the
+ * provider interfaces it implements:
+ *
+ *   [FooExtension]
+ *   Interfaces=MenuProvider;NameAndDescProvider;
+ *
+ * The types are registered right away, but the module itself (and python,
+ * if nothing else needs it) is only loaded when one of them is first used.
+ *
+ * Classes with Isolated=true, or listed in $NEMO_PYTHON_ISOLATE, are run in
+ * a nemo-python-helper process instead of being imported into nemo.
+ */
+static gboolean
+nemo_python_load_manifest(GTypeModule *type_module,
+						  const char  *dirname,
+						  const char  *modulename)
+{
+	GKeyFile *keyfile;
+	GError *error = NULL;
+	gchar *basename, *path;
+	gchar **classes, **interfaces, **isolate_list = NULL;
+	const gchar *env_string;
+	gboolean loaded = FALSE;
+	guint i, j, k;
+
+	basename = g_strconcat(modulename, ".nemo-python", NULL);
+	path = g_build_filename(dirname, basename, NULL);
+	g_free(basename);
+
+	if (!g_file_test(path, G_FILE_TEST_IS_REGULAR))
+	{
+		g_free(path);
+		return FALSE;
+	}
+
+	debug_enter_args("manifest=%s", path);
+
+	keyfile = g_key_file_new();
+	if (!g_key_file_load_from_file(keyfile, path, G_KEY_FILE_NONE, &error))
+	{
+		g_warning("Could not read extension manifest %s: %s", path, error->message);
+		g_error_free(error);
+		g_key_file_free(keyfile);
+		g_free(path);
+		return FALSE;
+	}
+
+	classes = g_key_file_get_groups(keyfile, NULL);
+
+	env_string = g_getenv("NEMO_PYTHON_ISOLATE");
+	if (env_string != NULL)
+		isolate_list = g_strsplit_set(env_string, ",; ", -1);
+
+	for (i = 0; classes[i] != NULL; i++)
+	{
+		NemoPythonProviders providers = 0;
+		gboolean isolated;
+		GType gtype;
+
+		interfaces = g_key_file_get_string_list(keyfile, classes[i],
+												"Interfaces", NULL, NULL);
+		if (interfaces == NULL)
+			continue;
+
+		for (j = 0; interfaces[j] != NULL; j++)
+		{
+			for (k = 0; k < nemo_python_nprovider_keys; k++)
+			{
+				if (g_strcmp0(interfaces[j], nemo_python_provider_keys[k].key) == 0)
+				{
+					providers |= nemo_python_provider_keys[k].value;
+					break;
+				}
+			}
+
+			if (k == nemo_python_nprovider_keys)
+				g_warning("%s: unknown interface '%s'", path, interfaces[j]);
+		}
+
+		g_strfreev(interfaces);
+
+		if (providers == 0)
+			continue;
+
+		isolated = g_key_file_get_boolean(keyfile, classes[i], "Isolated", NULL) ||
+				   (isolate_list != NULL &&
+					g_strv_contains((const gchar * const *) isolate_list, classes[i]));
+
+		if (isolated && (providers & ~NEMO_PYTHON_ISOLATABLE_PROVIDERS) != 0)
+		{
+			g_warning("%s: %s can't be isolated, only column, info and "
+					  "name-and-description providers can", path, classes[i]);
+			isolated = FALSE;
+		}
+
+		gtype = nemo_python_object_get_lazy_type(type_module, dirname, modulename,
+												 classes[i], providers, isolated);
+		g_array_append_val(all_types, gtype);
+		loaded = TRUE;
+	}
+
+	if (!loaded)
+		g_warning("%s does not declare any extension classes, importing module instead", path);
+
+	g_strfreev(isolate_list);
+	g_strfreev(classes);
+	g_key_file_free(keyfile);
+	g_free(path);
+
+	return loaded;
+}
+
 static void
 nemo_python_load_dir (GTypeModule *module, 
 						  const char  *dirname)
 {
 	GDir *dir;
 	const char *name;
-	gboolean initialized = FALSE;
 
 	debug_enter_args("dirname=%s", dirname);
 	
@@ -138,24 +347,22 @@ nemo_python_load_dir (GTypeModule *module,
 			modulename = g_new0(char, len + 1 );
 			strncpy(modulename, name, len);
 
-			if (!initialized)
+			nemo_python_add_search_path(dirname);
+
+			if (nemo_python_load_manifest(module, dirname, modulename))
 			{
-				PyObject *sys_path, *py_path;
-				
-				/* n-p python part is initialized on demand (or not
-				* at all if no extensions are found) */
-				if (!nemo_python_init_python())
-				{
-					g_warning("nemo_python_init_python failed");
-					break;
-				}
-				
-				/* sys.path.insert(0, dirname) */
-				sys_path = PySys_GetObject("path");
-				py_path = PyUnicode_FromString(dirname);
-				PyList_Insert(sys_path, 0, py_path);
-				Py_DECREF(py_path);
+				g_free (modulename);
+				continue;
+			}
+
+			/* n-p python part is initialized on demand (or not
+			* at all if no extensions need it) */
+			if (!nemo_python_ensure_initialized())
+			{
+				g_free (modulename);
+				break;
 			}
+
 			nemo_python_load_file(module, modulename);
 
             g_free (modulename);
@@ -165,11 +372,33 @@ nemo_python_load_dir (GTypeModule *module,
     g_dir_close (dir);
 }
 
+gboolean
+nemo_python_ensure_initialized (void)
+{
+	static gboolean tried = FALSE;
+	static gboolean initialized = FALSE;
+	gint64 start;
+
+	if (tried)
+		return initialized;
+
+	tried = TRUE;
+	start = nemo_python_profile_now();
+	initialized = nemo_python_init_python();
+	if (!initialized)
+		g_warning("nemo_python_init_python failed");
+	else if (nemo_python_profile_enabled)
+		nemo_python_profile_record_import("(interpreter)", g_get_monotonic_time() - start);
+
+	return initialized;
+}
+
 static gboolean
 nemo_python_init_python (void)
 {
-	PyObject *nemo;
+	PyObject *nemo, *sys_path, *py_path;
 	GModule *libpython;
+	guint i;
     wchar_t *argv[] = { L"nemo", NULL };
 
 	if (Py_IsInitialized())
@@ -211,6 +440,9 @@ nemo_python_init_python (void)
 		g_warning("pygobject initialization failed");
 		return FALSE;
 	}
+
+	if (!nemo_python_list_init_type())
+		return FALSE;
 	
 	/* import nemo */
 	g_setenv("INSIDE_NEMO_PYTHON", "", FALSE);
@@ -246,6 +478,15 @@ nemo_python_init_python (void)
 	IMPORT(OperationHandle, "OperationHandle");
 
 #undef IMPORT
+
+	/* Extension dirs seen before python was started */
+	sys_path = PySys_GetObject("path");
+	for (i = 0; i < search_paths->len; i++)
+	{
+		py_path = PyUnicode_FromString(g_ptr_array_index(search_paths, i));
+		PyList_Insert(sys_path, 0, py_path);
+		Py_DECREF(py_path);
+	}
 	
 	return TRUE;
 }
@@ -264,10 +505,13 @@ nemo_module_initialize(GTypeModule *module)
 													 nemo_python_ndebug_keys);
 		env_string = NULL;
     }
+
+	nemo_python_profile_init();
 	
 	debug_enter();
 
 	all_types = g_array_new(FALSE, FALSE, sizeof(GType));
+	search_paths = g_ptr_array_new_with_free_func(g_free);
 
 	// Look in the new global path, $DATADIR/nemo-python/extensions
 	nemo_python_load_dir(module, PYTHON_EXTENSION_DIR);
@@ -285,10 +529,14 @@ nemo_module_shutdown(void)
 {
 	debug_enter();
 
+	nemo_python_profile_shutdown();
+	nemo_python_helper_shutdown_all();
+
 	if (Py_IsInitialized())
 		Py_Finalize();
 
 	g_array_free(all_types, TRUE);
+	g_ptr_array_free(search_paths, TRUE);
 }
 
 void 
@@ -37,6 +37,10 @@ extern NemoPythonDebug nemo_python_debug;
 #define debug_enter_args(x, y) { if (nemo_python_debug & NEMO_PYTHON_DEBUG_MISC) \
                                      g_printf("%s: entered " x "\n", __FUNCTION__, y); }
 
+gboolean  nemo_python_ensure_initialized (void);
+PyObject *nemo_python_import_type        (const gchar *module_name,
+                                          const gchar *class_name);
+
 extern PyTypeObject *_PyGtkWidget_Type;
 #define PyGtkWidget_Type (*_PyGtkWidget_Type)
 
@@ -90,6 +90,7 @@ sign_callback (NemoMenuItem *item, gpointer user_data)
 static char *pgp_encrypted_types[] = {
     "application/pgp",
     "application/pgp-encrypted",
+    "application/x-nemo-seahorse-chunked",
     NULL
 };
 
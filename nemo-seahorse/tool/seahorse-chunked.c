@@ -0,0 +1,694 @@
+/*
+ * Seahorse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib/gi18n.h>
+#include <gio/gio.h>
+
+#include <gcrypt.h>
+
+#include "seahorse-chunked.h"
+#include "seahorse-tool.h"
+#include "seahorse-vfs-data.h"
+
+/*
+ * The container is laid out as:
+ *
+ *   header     "SHCHUNK1", chunk size, flags (none yet) and a random
+ *              file id, 32 bytes. It's authenticated with every chunk.
+ *   chunks     Each chunk of the file encrypted, followed by its tag.
+ *              Only the last chunk is short, so chunk i is at a known
+ *              offset. The nonce is the chunk number.
+ *   key        The chunk key, as an OpenPGP message from gpg.
+ *   index      The size of the file, the number of chunks and the
+ *              chunk size, encrypted like a chunk with a nonce of its
+ *              own. It's what shows a missing last chunk.
+ *   footer     Offsets of the key and index, then "SHCHKEND", 32 bytes.
+ *
+ * Numbers are big endian.
+ */
+
+#define CHUNK_MAGIC         "SHCHUNK1"
+#define CHUNK_END_MAGIC     "SHCHKEND"
+#define MAGIC_SIZE          8
+#define HEADER_SIZE         32
+#define FOOTER_SIZE         32
+#define INDEX_SIZE          20
+#define ID_SIZE             16
+#define KEY_SIZE            32
+#define TAG_SIZE            16
+#define NONCE_SIZE          12
+
+#define CHUNK_SIZE          (4 * 1024 * 1024)
+#define MIN_CHUNK_SIZE      (4 * 1024)
+#define MAX_CHUNK_SIZE      (64 * 1024 * 1024)
+#define MAX_WRAPPED_KEY     (64 * 1024)
+#define MAX_WINDOW          16              /* Chunks in memory per file */
+#define WAIT_SLICE          (100 * 1000)    /* microseconds */
+
+/* The first four bytes of the nonce */
+#define KIND_CHUNK          0
+#define KIND_INDEX          G_MAXUINT32
+
+struct _SeahorseChunked {
+    gboolean decrypt;
+    GFile *output_file;
+    GInputStream *input;
+    GOutputStream *output;
+    GCancellable *cancellable;
+    GThread *thread;                /* Reads, hands out and writes the chunks */
+    gboolean complete;              /* All written, nothing to clean up */
+
+    guchar header[HEADER_SIZE];
+    guchar key[KEY_SIZE];
+    guint32 chunk_size;
+    guint64 n_chunks;
+    guint64 size;                   /* Of the file in the clear */
+
+    gchar *wrapped;                 /* The key as gpg encrypted it */
+    gsize n_wrapped;
+    guint64 wrapped_offset;
+    guint64 index_offset;
+
+    GMutex lock;                    /* Protects everything from here on */
+    GCond cond;                     /* Signalled as chunks get done */
+    gboolean finished;              /* The thread is done */
+    GError *error;                  /* What stopped the thread */
+    goffset position;               /* Bytes of the input dealt with */
+    guint failed;                   /* Chunks that didn't authenticate */
+};
+
+typedef struct _Chunk {
+    SeahorseChunked *chunked;
+    guint64 index;
+    guchar *data;                   /* length bytes, then the tag */
+    gsize length;
+    gboolean done;
+    gboolean ok;
+} Chunk;
+
+/* Shared by all the files, so files in parallel don't add up to more
+ * threads than there are processors */
+static GThreadPool *chunk_pool = NULL;
+
+static void
+put_uint32 (guchar *buf, guint32 val)
+{
+    val = GUINT32_TO_BE (val);
+    memcpy (buf, &val, sizeof (val));
+}
+
+static void
+put_uint64 (guchar *buf, guint64 val)
+{
+    val = GUINT64_TO_BE (val);
+    memcpy (buf, &val, sizeof (val));
+}
+
+static guint32
+get_uint32 (const guchar *buf)
+{
+    guint32 val;
+    memcpy (&val, buf, sizeof (val));
+    return GUINT32_FROM_BE (val);
+}
+
+static guint64
+get_uint64 (const guchar *buf)
+{
+    guint64 val;
+    memcpy (&val, buf, sizeof (val));
+    return GUINT64_FROM_BE (val);
+}
+
+/* memset() of something never read again can be left out */
+static void
+wipe (gpointer data, gsize length)
+{
+    volatile guchar *p = data;
+    while (length--)
+        *p++ = 0;
+}
+
+static void
+set_invalid (GError **err)
+{
+    g_set_error_literal (err, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                         _("The encrypted file has been changed or is damaged."));
+}
+
+/* Encrypts or decrypts one chunk in place, and makes or checks its tag */
+static gboolean
+chunk_crypt (const guchar *key, const guchar *header, guint32 kind,
+             guint64 index, gboolean decrypt, guchar *data, gsize length)
+{
+    gcry_cipher_hd_t hd;
+    guchar nonce[NONCE_SIZE];
+    gcry_error_t gerr;
+
+    gerr = gcry_cipher_open (&hd, GCRY_CIPHER_AES256, GCRY_CIPHER_MODE_GCM, 0);
+    if (gerr != 0)
+        return FALSE;
+
+    put_uint32 (nonce, kind);
+    put_uint64 (nonce + 4, index);
+
+    gerr = gcry_cipher_setkey (hd, key, KEY_SIZE);
+    if (gerr == 0)
+        gerr = gcry_cipher_setiv (hd, nonce, NONCE_SIZE);
+    if (gerr == 0)
+        gerr = gcry_cipher_authenticate (hd, header, HEADER_SIZE);
+
+    if (decrypt) {
+        if (gerr == 0)
+            gerr = gcry_cipher_decrypt (hd, data, length, NULL, 0);
+        if (gerr == 0)
+            gerr = gcry_cipher_checktag (hd, data + length, TAG_SIZE);
+    } else {
+        if (gerr == 0)
+            gerr = gcry_cipher_encrypt (hd, data, length, NULL, 0);
+        if (gerr == 0)
+            gerr = gcry_cipher_gettag (hd, data + length, TAG_SIZE);
+    }
+
+    gcry_cipher_close (hd);
+    return gerr == 0;
+}
+
+/* Runs in the pool */
+static void
+chunk_func (gpointer data, gpointer unused)
+{
+    Chunk *chunk = data;
+    SeahorseChunked *chunked = chunk->chunked;
+
+    chunk->ok = chunk_crypt (chunked->key, chunked->header, KIND_CHUNK, chunk->index,
+                             chunked->decrypt, chunk->data, chunk->length);
+
+    g_mutex_lock (&chunked->lock);
+    chunk->done = TRUE;
+    g_cond_broadcast (&chunked->cond);
+    g_mutex_unlock (&chunked->lock);
+}
+
+static gpointer
+chunked_init (gpointer unused)
+{
+    /* Whoever got here first might have set libgcrypt up already */
+    if (!gcry_control (GCRYCTL_INITIALIZATION_FINISHED_P)) {
+        gcry_check_version (NULL);
+        gcry_control (GCRYCTL_INITIALIZATION_FINISHED, 0);
+    }
+
+    chunk_pool = g_thread_pool_new (chunk_func, NULL, g_get_num_processors (),
+                                    FALSE, NULL);
+    return NULL;
+}
+
+static void
+free_chunk (Chunk *chunk)
+{
+    if (chunk->chunked->decrypt)
+        wipe (chunk->data, chunk->length);
+    g_free (chunk->data);
+    g_free (chunk);
+}
+
+/* Called on the thread. Returns NULL at the end of the chunks, or on error. */
+static Chunk*
+read_chunk (SeahorseChunked *chunked, guint64 index, gboolean *eof, GError **err)
+{
+    Chunk *chunk;
+    gsize length, n;
+
+    if (chunked->decrypt) {
+        if (index >= chunked->n_chunks) {
+            *eof = TRUE;
+            return NULL;
+        }
+        length = MIN (chunked->chunk_size, chunked->size - index * chunked->chunk_size);
+    } else {
+        length = chunked->chunk_size;
+    }
+
+    chunk = g_new0 (Chunk, 1);
+    chunk->chunked = chunked;
+    chunk->index = index;
+    chunk->data = g_malloc (length + TAG_SIZE);
+
+    if (chunked->decrypt) {
+        if (!g_input_stream_read_all (chunked->input, chunk->data, length + TAG_SIZE,
+                                      &n, chunked->cancellable, err)) {
+            free_chunk (chunk);
+            return NULL;
+        }
+        if (n < length + TAG_SIZE) {
+            set_invalid (err);
+            free_chunk (chunk);
+            return NULL;
+        }
+    } else {
+        if (!g_input_stream_read_all (chunked->input, chunk->data, length,
+                                      &n, chunked->cancellable, err)) {
+            free_chunk (chunk);
+            return NULL;
+        }
+        if (n < length)
+            *eof = TRUE;
+        if (n == 0) {
+            free_chunk (chunk);
+            return NULL;
+        }
+        length = n;
+    }
+
+    chunk->length = length;
+    return chunk;
+}
+
+/* Called on the thread, once the chunk is done */
+static gboolean
+write_chunk (SeahorseChunked *chunked, Chunk *chunk, GError **err)
+{
+    gsize length, consumed;
+
+    if (chunked->decrypt) {
+        /* What can be decrypted still is, for a partial restore */
+        if (!chunk->ok) {
+            memset (chunk->data, 0, chunk->length);
+            chunked->failed++;
+        }
+        length = chunk->length;
+        consumed = chunk->length + TAG_SIZE;
+    } else {
+        if (!chunk->ok) {
+            g_set_error_literal (err, G_IO_ERROR, G_IO_ERROR_FAILED,
+                                 _("Couldn't encrypt the file."));
+            return FALSE;
+        }
+        length = chunk->length + TAG_SIZE;
+        consumed = chunk->length;
+        chunked->size += chunk->length;
+    }
+
+    if (!g_output_stream_write_all (chunked->output, chunk->data, length, NULL,
+                                    chunked->cancellable, err))
+        return FALSE;
+
+    g_mutex_lock (&chunked->lock);
+    chunked->position += consumed;
+    g_mutex_unlock (&chunked->lock);
+    return TRUE;
+}
+
+/* Keeps up to MAX_WINDOW chunks in the pool, and writes them out in order */
+static gpointer
+chunked_thread (gpointer data)
+{
+    SeahorseChunked *chunked = data;
+    GQueue window = G_QUEUE_INIT;
+    guint max_window = MIN (2 * g_get_num_processors (), MAX_WINDOW);
+    GError *error = NULL;
+    gboolean eof = FALSE;
+    guint64 next = 0;
+    Chunk *chunk;
+
+    for (;;) {
+
+        while (!error && !eof && window.length < max_window) {
+            chunk = read_chunk (chunked, next, &eof, &error);
+            if (!chunk)
+                break;
+            next++;
+            g_queue_push_tail (&window, chunk);
+            g_thread_pool_push (chunk_pool, chunk, NULL);
+        }
+
+        /* Even after an error, what's in the pool has to finish */
+        chunk = g_queue_pop_head (&window);
+        if (!chunk)
+            break;
+
+        g_mutex_lock (&chunked->lock);
+        while (!chunk->done)
+            g_cond_wait (&chunked->cond, &chunked->lock);
+        g_mutex_unlock (&chunked->lock);
+
+        if (!error)
+            write_chunk (chunked, chunk, &error);
+        free_chunk (chunk);
+    }
+
+    g_mutex_lock (&chunked->lock);
+    if (!chunked->decrypt)
+        chunked->n_chunks = next;
+    chunked->error = error;
+    chunked->finished = TRUE;
+    g_cond_broadcast (&chunked->cond);
+    g_mutex_unlock (&chunked->lock);
+
+    return NULL;
+}
+
+/* Runs the main loop until the thread is done, for the progress window */
+static gboolean
+wait_chunks (SeahorseChunked *chunked, gpgme_data_t progress, GError **err)
+{
+    gboolean finished;
+    goffset position;
+
+    for (;;) {
+        g_mutex_lock (&chunked->lock);
+        if (!chunked->finished)
+            g_cond_wait_until (&chunked->cond, &chunked->lock,
+                               g_get_monotonic_time () + WAIT_SLICE);
+        finished = chunked->finished;
+        position = chunked->position;
+        g_mutex_unlock (&chunked->lock);
+
+        if (progress)
+            seahorse_vfs_data_progress (progress, position);
+
+        if (finished)
+            break;
+
+        /* Cancelled, the thread is stopped when freed */
+        if (!seahorse_tool_progress_check ())
+            return FALSE;
+    }
+
+    g_thread_join (chunked->thread);
+    chunked->thread = NULL;
+
+    if (chunked->error) {
+        g_propagate_error (err, chunked->error);
+        chunked->error = NULL;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static gboolean
+read_at (SeahorseChunked *chunked, goffset offset, GSeekType type,
+         guchar *buffer, gsize length, GError **err)
+{
+    gsize n;
+
+    if (!g_seekable_seek (G_SEEKABLE (chunked->input), offset, type,
+                          chunked->cancellable, err) ||
+        !g_input_stream_read_all (chunked->input, buffer, length, &n,
+                                  chunked->cancellable, err))
+        return FALSE;
+
+    if (n < length) {
+        set_invalid (err);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static SeahorseChunked*
+chunked_new (gboolean decrypt, GFile *input, GFile *output, GError **err)
+{
+    static GOnce once = G_ONCE_INIT;
+    SeahorseChunked *chunked;
+
+    g_once (&once, chunked_init, NULL);
+
+    chunked = g_new0 (SeahorseChunked, 1);
+    chunked->decrypt = decrypt;
+    chunked->output_file = g_object_ref (output);
+    chunked->cancellable = g_cancellable_new ();
+    g_mutex_init (&chunked->lock);
+    g_cond_init (&chunked->cond);
+
+    chunked->input = G_INPUT_STREAM (g_file_read (input, chunked->cancellable, err));
+    if (!chunked->input) {
+        seahorse_chunked_free (chunked);
+        return NULL;
+    }
+
+    return chunked;
+}
+
+static gboolean
+open_output (SeahorseChunked *chunked, GError **err)
+{
+    chunked->output = G_OUTPUT_STREAM (g_file_replace (chunked->output_file, NULL, FALSE,
+                                                       G_FILE_CREATE_NONE,
+                                                       chunked->cancellable, err));
+    return chunked->output != NULL;
+}
+
+/* -----------------------------------------------------------------------------
+ * ENCRYPT
+ */
+
+SeahorseChunked*
+seahorse_chunked_encrypt_new (GFile *input, GFile *output, GError **err)
+{
+    SeahorseChunked *chunked;
+
+    g_return_val_if_fail (!err || !*err, NULL);
+
+    chunked = chunked_new (FALSE, input, output, err);
+    if (!chunked)
+        return NULL;
+
+    chunked->chunk_size = CHUNK_SIZE;
+    gcry_randomize (chunked->key, KEY_SIZE, GCRY_STRONG_RANDOM);
+
+    memcpy (chunked->header, CHUNK_MAGIC, MAGIC_SIZE);
+    put_uint32 (chunked->header + 8, chunked->chunk_size);
+    put_uint32 (chunked->header + 12, 0);
+    gcry_create_nonce (chunked->header + 16, ID_SIZE);
+
+    if (!open_output (chunked, err) ||
+        !g_output_stream_write_all (chunked->output, chunked->header, HEADER_SIZE,
+                                    NULL, chunked->cancellable, err)) {
+        seahorse_chunked_free (chunked);
+        return NULL;
+    }
+
+    /* Gets going while gpg encrypts the key */
+    chunked->thread = g_thread_new ("seahorse-chunked", chunked_thread, chunked);
+    return chunked;
+}
+
+const guchar*
+seahorse_chunked_get_key (SeahorseChunked *chunked, gsize *n_key)
+{
+    g_return_val_if_fail (chunked && !chunked->decrypt, NULL);
+    *n_key = KEY_SIZE;
+    return chunked->key;
+}
+
+gboolean
+seahorse_chunked_finish_encrypt (SeahorseChunked *chunked, const gchar *wrapped_key,
+                                 gsize n_wrapped_key, gpgme_data_t progress,
+                                 GError **err)
+{
+    guchar index[INDEX_SIZE + TAG_SIZE];
+    guchar footer[FOOTER_SIZE];
+
+    g_return_val_if_fail (chunked && !chunked->decrypt, FALSE);
+    g_return_val_if_fail (!err || !*err, FALSE);
+
+    if (!wait_chunks (chunked, progress, err))
+        return FALSE;
+
+    chunked->wrapped_offset = HEADER_SIZE + chunked->size + chunked->n_chunks * TAG_SIZE;
+    chunked->index_offset = chunked->wrapped_offset + n_wrapped_key;
+
+    put_uint64 (index, chunked->size);
+    put_uint64 (index + 8, chunked->n_chunks);
+    put_uint32 (index + 16, chunked->chunk_size);
+    if (!chunk_crypt (chunked->key, chunked->header, KIND_INDEX, 0, FALSE, index, INDEX_SIZE)) {
+        g_set_error_literal (err, G_IO_ERROR, G_IO_ERROR_FAILED,
+                             _("Couldn't encrypt the file."));
+        return FALSE;
+    }
+
+    put_uint64 (footer, chunked->wrapped_offset);
+    put_uint64 (footer + 8, n_wrapped_key);
+    put_uint64 (footer + 16, chunked->index_offset);
+    memcpy (footer + 24, CHUNK_END_MAGIC, MAGIC_SIZE);
+
+    if (!g_output_stream_write_all (chunked->output, wrapped_key, n_wrapped_key, NULL,
+                                    chunked->cancellable, err) ||
+        !g_output_stream_write_all (chunked->output, index, sizeof (index), NULL,
+                                    chunked->cancellable, err) ||
+        !g_output_stream_write_all (chunked->output, footer, sizeof (footer), NULL,
+                                    chunked->cancellable, err) ||
+        !g_output_stream_close (chunked->output, chunked->cancellable, err))
+        return FALSE;
+
+    chunked->complete = TRUE;
+    return TRUE;
+}
+
+/* -----------------------------------------------------------------------------
+ * DECRYPT
+ */
+
+SeahorseChunked*
+seahorse_chunked_decrypt_new (GFile *input, GFile *output, GError **err)
+{
+    SeahorseChunked *chunked;
+    guchar footer[FOOTER_SIZE];
+    goffset end;
+
+    g_return_val_if_fail (!err || !*err, NULL);
+
+    chunked = chunked_new (TRUE, input, output, err);
+    if (!chunked)
+        return NULL;
+
+    if (!read_at (chunked, 0, G_SEEK_SET, chunked->header, HEADER_SIZE, err) ||
+        !read_at (chunked, -FOOTER_SIZE, G_SEEK_END, footer, FOOTER_SIZE, err)) {
+        seahorse_chunked_free (chunked);
+        return NULL;
+    }
+
+    end = g_seekable_tell (G_SEEKABLE (chunked->input));
+    chunked->chunk_size = get_uint32 (chunked->header + 8);
+    chunked->wrapped_offset = get_uint64 (footer);
+    chunked->n_wrapped = get_uint64 (footer + 8);
+    chunked->index_offset = get_uint64 (footer + 16);
+
+    if (memcmp (chunked->header, CHUNK_MAGIC, MAGIC_SIZE) != 0 ||
+        memcmp (footer + 24, CHUNK_END_MAGIC, MAGIC_SIZE) != 0 ||
+        chunked->chunk_size < MIN_CHUNK_SIZE || chunked->chunk_size > MAX_CHUNK_SIZE ||
+        chunked->n_wrapped == 0 || chunked->n_wrapped > MAX_WRAPPED_KEY ||
+        chunked->wrapped_offset < HEADER_SIZE ||
+        chunked->wrapped_offset + chunked->n_wrapped != chunked->index_offset ||
+        chunked->index_offset + INDEX_SIZE + TAG_SIZE + FOOTER_SIZE != (guint64)end) {
+        g_set_error_literal (err, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                             _("The file is not a chunked encrypted file."));
+        seahorse_chunked_free (chunked);
+        return NULL;
+    }
+
+    chunked->wrapped = g_malloc (chunked->n_wrapped);
+    if (!read_at (chunked, chunked->wrapped_offset, G_SEEK_SET,
+                  (guchar*)chunked->wrapped, chunked->n_wrapped, err)) {
+        seahorse_chunked_free (chunked);
+        return NULL;
+    }
+
+    return chunked;
+}
+
+const gchar*
+seahorse_chunked_get_wrapped_key (SeahorseChunked *chunked, gsize *n_wrapped_key)
+{
+    g_return_val_if_fail (chunked && chunked->decrypt, NULL);
+    *n_wrapped_key = chunked->n_wrapped;
+    return chunked->wrapped;
+}
+
+gboolean
+seahorse_chunked_finish_decrypt (SeahorseChunked *chunked, const gchar *key,
+                                 gsize n_key, gpgme_data_t progress, GError **err)
+{
+    guchar index[INDEX_SIZE + TAG_SIZE];
+
+    g_return_val_if_fail (chunked && chunked->decrypt, FALSE);
+    g_return_val_if_fail (!err || !*err, FALSE);
+
+    if (n_key != KEY_SIZE) {
+        set_invalid (err);
+        return FALSE;
+    }
+    memcpy (chunked->key, key, KEY_SIZE);
+
+    /* The index is checked before anything is written out */
+    if (!read_at (chunked, chunked->index_offset, G_SEEK_SET, index, sizeof (index), err))
+        return FALSE;
+    if (!chunk_crypt (chunked->key, chunked->header, KIND_INDEX, 0, TRUE, index, INDEX_SIZE)) {
+        set_invalid (err);
+        return FALSE;
+    }
+
+    chunked->size = get_uint64 (index);
+    chunked->n_chunks = get_uint64 (index + 8);
+
+    if (get_uint32 (index + 16) != chunked->chunk_size ||
+        chunked->n_chunks != (chunked->size + chunked->chunk_size - 1) / chunked->chunk_size ||
+        HEADER_SIZE + chunked->size + chunked->n_chunks * TAG_SIZE != chunked->wrapped_offset) {
+        set_invalid (err);
+        return FALSE;
+    }
+
+    if (!g_seekable_seek (G_SEEKABLE (chunked->input), HEADER_SIZE, G_SEEK_SET,
+                          chunked->cancellable, err) ||
+        !open_output (chunked, err))
+        return FALSE;
+
+    chunked->position = HEADER_SIZE;
+    chunked->thread = g_thread_new ("seahorse-chunked", chunked_thread, chunked);
+
+    if (!wait_chunks (chunked, progress, err) ||
+        !g_output_stream_close (chunked->output, chunked->cancellable, err))
+        return FALSE;
+
+    chunked->complete = TRUE;
+
+    if (chunked->failed) {
+        g_set_error (err, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                     ngettext ("%u part of the file has been changed or is damaged, and was left empty.",
+                               "%u parts of the file have been changed or are damaged, and were left empty.",
+                               chunked->failed), chunked->failed);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+void
+seahorse_chunked_free (SeahorseChunked *chunked)
+{
+    if (!chunked)
+        return;
+
+    g_cancellable_cancel (chunked->cancellable);
+    if (chunked->thread)
+        g_thread_join (chunked->thread);
+
+    if (chunked->output) {
+        g_output_stream_close (chunked->output, NULL, NULL);
+        g_object_unref (chunked->output);
+
+        /* A partly decrypted file is still worth having */
+        if (!chunked->decrypt && !chunked->complete)
+            g_file_delete (chunked->output_file, NULL, NULL);
+    }
+
+    g_clear_object (&chunked->input);
+    g_object_unref (chunked->output_file);
+    g_object_unref (chunked->cancellable);
+    g_clear_error (&chunked->error);
+    g_mutex_clear (&chunked->lock);
+    g_cond_clear (&chunked->cond);
+    wipe (chunked->key, KEY_SIZE);
+    g_free (chunked->wrapped);
+    g_free (chunked);
+}
@@ -0,0 +1,76 @@
+/*
+ * Seahorse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gio/gio.h>
+
+#include <gpgme.h>
+
+/**
+ * A container of chunks of a file, each encrypted and authenticated on
+ * its own with AES-256-GCM under one random key. Only that key goes
+ * through gpg, encrypted to the recipients like any other message, and
+ * is kept at the end of the container with an index of the chunks.
+ *
+ * Chunks are done in parallel, and any chunk can be decrypted without
+ * the ones before it.
+ */
+
+#ifndef __SEAHORSE_CHUNKED__
+#define __SEAHORSE_CHUNKED__
+
+typedef struct _SeahorseChunked SeahorseChunked;
+
+/* Starts encrypting @input into @output. The key from
+ * seahorse_chunked_get_key() has to be encrypted for the recipients
+ * and given to seahorse_chunked_finish_encrypt(). */
+SeahorseChunked*    seahorse_chunked_encrypt_new        (GFile *input, GFile *output,
+                                                         GError **err);
+
+const guchar*       seahorse_chunked_get_key            (SeahorseChunked *chunked,
+                                                         gsize *n_key);
+
+/* Waits for the chunks, then adds the encrypted key and the index.
+ * Progress is reported through @progress, a vfs data of the input, as
+ * the chunks are written. Nothing is read from it, so it can be one
+ * opened with SEAHORSE_VFS_DELAY. */
+gboolean            seahorse_chunked_finish_encrypt     (SeahorseChunked *chunked,
+                                                         const gchar *wrapped_key,
+                                                         gsize n_wrapped_key,
+                                                         gpgme_data_t progress,
+                                                         GError **err);
+
+/* Opens a container in @input, for decrypting into @output. The key
+ * from seahorse_chunked_get_wrapped_key() has to be decrypted by gpg
+ * and given to seahorse_chunked_finish_decrypt(). */
+SeahorseChunked*    seahorse_chunked_decrypt_new        (GFile *input, GFile *output,
+                                                         GError **err);
+
+const gchar*        seahorse_chunked_get_wrapped_key    (SeahorseChunked *chunked,
+                                                         gsize *n_wrapped_key);
+
+/* Decrypts all the chunks. A chunk that fails to authenticate is left
+ * as zeros in @output, and the rest are still decrypted, but it's an
+ * error. @progress is as for seahorse_chunked_finish_encrypt(). */
+gboolean            seahorse_chunked_finish_decrypt     (SeahorseChunked *chunked,
+                                                         const gchar *key,
+                                                         gsize n_key,
+                                                         gpgme_data_t progress,
+                                                         GError **err);
+
+/* Stops anything still going */
+void                seahorse_chunked_free               (SeahorseChunked *chunked);
+
+#endif /* __SEAHORSE_CHUNKED__ */
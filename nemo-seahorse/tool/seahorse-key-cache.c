@@ -0,0 +1,422 @@
+/*
+ * Seahorse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <gpgme.h>
+
+#include "seahorse-key-cache.h"
+
+/*
+ * The cache file is a GVariant, mapped straight in:
+ *   version
+ *   a(sxx)     path, mtime and size of each keyring file when listed
+ *   a(sasasux) fingerprint, key ids of the key and its subkeys,
+ *              user ids, flags and expiry of each key
+ */
+#define CACHE_VERSION       1
+#define CACHE_TYPE          "(ua(sxx)a(sasasux))"
+#define CACHE_FILE          "keys.cache"
+
+#define KEYID_LENGTH        16
+
+/* What gpg keeps keys and trust in, new and old style */
+static const gchar *keyring_files[] = {
+    "pubring.kbx",
+    "pubring.gpg",
+    "secring.gpg",
+    "private-keys-v1.d",
+    "trustdb.gpg",
+};
+
+static GVariant *cache_data = NULL;         /* All the strings point in here */
+static SeahorseKeyInfo *cache_infos = NULL;
+static guint cache_n_infos = 0;
+static GHashTable *cache_keys = NULL;       /* Key id to SeahorseKeyInfo */
+static gboolean cache_checked = FALSE;
+
+static gchar*
+gpg_homedir (void)
+{
+    gpgme_engine_info_t engine;
+    const gchar *env;
+
+    if (gpgme_get_engine_info (&engine) == 0) {
+        for (; engine; engine = engine->next) {
+            if (engine->protocol == GPGME_PROTOCOL_OpenPGP && engine->home_dir)
+                return g_strdup (engine->home_dir);
+        }
+    }
+
+    env = g_getenv ("GNUPGHOME");
+    if (env && env[0])
+        return g_strdup (env);
+
+    return g_build_filename (g_get_home_dir (), ".gnupg", NULL);
+}
+
+static gchar*
+cache_path (void)
+{
+    return g_build_filename (g_get_user_cache_dir (), "nemo-seahorse", CACHE_FILE, NULL);
+}
+
+/* Size as well as mtime, as a keyring can change twice in a second */
+static GVariant*
+keyring_stamps (void)
+{
+    GVariantBuilder builder;
+    GStatBuf sb;
+    gchar *homedir, *path;
+    guint i;
+
+    homedir = gpg_homedir ();
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sxx)"));
+
+    for (i = 0; i < G_N_ELEMENTS (keyring_files); i++) {
+        path = g_build_filename (homedir, keyring_files[i], NULL);
+        if (g_stat (path, &sb) == 0)
+            g_variant_builder_add (&builder, "(sxx)", path, (gint64)sb.st_mtime,
+                                   (gint64)sb.st_size);
+        else
+            g_variant_builder_add (&builder, "(sxx)", path, (gint64)-1, (gint64)-1);
+        g_free (path);
+    }
+
+    g_free (homedir);
+    return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
+
+/* Runs through a keylist, calling func with each key */
+static gpgme_error_t
+keylist (gpgme_ctx_t ctx, gboolean secret, void (*func) (gpgme_key_t, gpointer),
+         gpointer user_data)
+{
+    gpgme_error_t gerr;
+    gpgme_key_t key;
+
+    gerr = gpgme_op_keylist_start (ctx, NULL, secret);
+    if (gerr != 0)
+        return gerr;
+
+    while ((gerr = gpgme_op_keylist_next (ctx, &key)) == 0) {
+        (func) (key, user_data);
+        gpgme_key_unref (key);
+    }
+
+    gpgme_op_keylist_end (ctx);
+
+    if (gpgme_err_code (gerr) == GPG_ERR_EOF)
+        gerr = 0;
+    return gerr;
+}
+
+static void
+add_secret (gpgme_key_t key, gpointer user_data)
+{
+    if (key->subkeys && key->subkeys->fpr)
+        g_hash_table_add (user_data, g_strdup (key->subkeys->fpr));
+}
+
+typedef struct {
+    GVariantBuilder builder;
+    GHashTable *secret;
+} ListCtx;
+
+static void
+add_key (gpgme_key_t key, gpointer user_data)
+{
+    ListCtx *lctx = user_data;
+    GVariantBuilder ids, uids;
+    gpgme_subkey_t subkey;
+    gpgme_user_id_t uid;
+    guint flags = 0;
+
+    if (!key->subkeys || !key->subkeys->fpr)
+        return;
+
+    g_variant_builder_init (&ids, G_VARIANT_TYPE_STRING_ARRAY);
+    for (subkey = key->subkeys; subkey; subkey = subkey->next) {
+        if (subkey->keyid)
+            g_variant_builder_add (&ids, "s", subkey->keyid);
+    }
+
+    g_variant_builder_init (&uids, G_VARIANT_TYPE_STRING_ARRAY);
+    for (uid = key->uids; uid; uid = uid->next) {
+        if (uid->uid)
+            g_variant_builder_add (&uids, "s", uid->uid);
+    }
+
+    if (key->can_encrypt)
+        flags |= SEAHORSE_KEY_CAN_ENCRYPT;
+    if (key->can_sign)
+        flags |= SEAHORSE_KEY_CAN_SIGN;
+    if (g_hash_table_contains (lctx->secret, key->subkeys->fpr))
+        flags |= SEAHORSE_KEY_SECRET;
+    if (key->revoked)
+        flags |= SEAHORSE_KEY_REVOKED;
+    if (key->expired)
+        flags |= SEAHORSE_KEY_EXPIRED;
+    if (key->disabled)
+        flags |= SEAHORSE_KEY_DISABLED;
+
+    g_variant_builder_add (&lctx->builder, "(sasasux)", key->subkeys->fpr, &ids, &uids,
+                           flags, (gint64)key->subkeys->expires);
+}
+
+/* All the keys in two keylists, one for which have secret keys */
+static GVariant*
+list_keys (GVariant *stamps)
+{
+    gpgme_error_t gerr;
+    gpgme_ctx_t ctx;
+    ListCtx lctx;
+    GVariant *data;
+
+    gerr = gpgme_new (&ctx);
+    if (gerr != 0)
+        return NULL;
+
+    gpgme_set_protocol (ctx, GPGME_PROTOCOL_OpenPGP);
+    gpgme_set_keylist_mode (ctx, GPGME_KEYLIST_MODE_LOCAL);
+
+    lctx.secret = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    g_variant_builder_init (&lctx.builder, G_VARIANT_TYPE ("a(sasasux)"));
+
+    gerr = keylist (ctx, TRUE, add_secret, lctx.secret);
+    if (gerr == 0)
+        gerr = keylist (ctx, FALSE, add_key, &lctx);
+
+    gpgme_release (ctx);
+    g_hash_table_destroy (lctx.secret);
+
+    if (gerr != 0) {
+        g_variant_builder_clear (&lctx.builder);
+        g_message ("couldn't list keys: %s", gpgme_strerror (gerr));
+        return NULL;
+    }
+
+    data = g_variant_new ("(u@a(sxx)a(sasasux))", CACHE_VERSION, stamps, &lctx.builder);
+    return g_variant_ref_sink (data);
+}
+
+static GVariant*
+load_cache (void)
+{
+    GMappedFile *mapped;
+    GVariant *data;
+    GBytes *bytes;
+    gchar *path;
+    guint32 version;
+
+    path = cache_path ();
+    mapped = g_mapped_file_new (path, FALSE, NULL);
+    g_free (path);
+    if (!mapped)
+        return NULL;
+
+    bytes = g_mapped_file_get_bytes (mapped);
+    g_mapped_file_unref (mapped);
+
+    /* GVariant copes with a damaged file, giving defaults */
+    data = g_variant_new_from_bytes (G_VARIANT_TYPE (CACHE_TYPE), bytes, FALSE);
+    g_variant_ref_sink (data);
+    g_bytes_unref (bytes);
+
+    g_variant_get_child (data, 0, "u", &version);
+    if (version != CACHE_VERSION) {
+        g_variant_unref (data);
+        return NULL;
+    }
+
+    return data;
+}
+
+static void
+save_cache (GVariant *data)
+{
+    GError *err = NULL;
+    gchar *path, *dir;
+
+    path = cache_path ();
+    dir = g_path_get_dirname (path);
+
+    /* It has the user ids in it, so like the keyring, only for the user */
+    if (g_mkdir_with_parents (dir, 0700) < 0 ||
+        !g_file_set_contents (path, g_variant_get_data (data),
+                              g_variant_get_size (data), &err)) {
+        g_message ("couldn't save key cache: %s", err ? err->message : g_strerror (errno));
+        g_clear_error (&err);
+    }
+
+    g_free (dir);
+    g_free (path);
+}
+
+static void
+clear_index (void)
+{
+    guint i;
+
+    if (cache_keys)
+        g_hash_table_destroy (cache_keys);
+    cache_keys = NULL;
+
+    for (i = 0; i < cache_n_infos; i++)
+        g_free (cache_infos[i].uids);
+    g_free (cache_infos);
+    cache_infos = NULL;
+    cache_n_infos = 0;
+
+    if (cache_data)
+        g_variant_unref (cache_data);
+    cache_data = NULL;
+}
+
+static void
+build_index (GVariant *data)
+{
+    SeahorseKeyInfo *info;
+    GVariant *keys, *key;
+    const gchar **ids;
+    gsize len;
+    guint i, j;
+
+    cache_data = data;
+    keys = g_variant_get_child_value (data, 2);
+    cache_n_infos = g_variant_n_children (keys);
+    cache_infos = g_new0 (SeahorseKeyInfo, cache_n_infos);
+    cache_keys = g_hash_table_new (g_str_hash, g_str_equal);
+
+    for (i = 0; i < cache_n_infos; i++) {
+        info = &cache_infos[i];
+        key = g_variant_get_child_value (keys, i);
+        g_variant_get (key, "(&s^a&s^a&sux)", &info->fingerprint, &ids,
+                       &info->uids, &info->flags, &info->expires);
+
+        len = strlen (info->fingerprint);
+        info->keyid = len > KEYID_LENGTH ? info->fingerprint + len - KEYID_LENGTH : info->fingerprint;
+
+        for (j = 0; ids[j]; j++)
+            g_hash_table_insert (cache_keys, (gpointer)ids[j], info);
+
+        g_free (ids);
+        g_variant_unref (key);
+    }
+
+    g_variant_unref (keys);
+}
+
+static void
+cache_check (void)
+{
+    GVariant *stamps, *cached, *data;
+
+    if (cache_checked)
+        return;
+    cache_checked = TRUE;
+
+    gpgme_check_version (NULL);
+    stamps = keyring_stamps ();
+
+    if (!cache_data) {
+        data = load_cache ();
+        if (data)
+            build_index (data);
+    }
+
+    if (cache_data) {
+        cached = g_variant_get_child_value (cache_data, 1);
+        if (g_variant_equal (cached, stamps)) {
+            g_variant_unref (cached);
+            g_variant_unref (stamps);
+            return;
+        }
+        g_variant_unref (cached);
+        clear_index ();
+    }
+
+    /* Stamped from before listing, so a change while listing shows next time */
+    data = list_keys (stamps);
+    if (data) {
+        save_cache (data);
+        build_index (data);
+    }
+
+    g_variant_unref (stamps);
+}
+
+const SeahorseKeyInfo*
+seahorse_key_cache_lookup (const gchar *id)
+{
+    gchar keyid[KEYID_LENGTH + 1];
+    gsize len;
+    guint i;
+
+    g_return_val_if_fail (id != NULL, NULL);
+
+    cache_check ();
+    if (!cache_keys)
+        return NULL;
+
+    if (g_str_has_prefix (id, "openpgp:"))
+        id += strlen ("openpgp:");
+
+    /* A fingerprint ends with the key id */
+    len = strlen (id);
+    if (len < KEYID_LENGTH)
+        return NULL;
+    for (i = 0; i < KEYID_LENGTH; i++)
+        keyid[i] = g_ascii_toupper (id[len - KEYID_LENGTH + i]);
+    keyid[KEYID_LENGTH] = 0;
+
+    return g_hash_table_lookup (cache_keys, keyid);
+}
+
+gboolean
+seahorse_key_cache_usable (const SeahorseKeyInfo *info, guint flags)
+{
+    g_return_val_if_fail (info != NULL, FALSE);
+
+    if (info->flags & (SEAHORSE_KEY_REVOKED | SEAHORSE_KEY_EXPIRED | SEAHORSE_KEY_DISABLED))
+        return FALSE;
+
+    /* It might have expired since it was listed */
+    if (info->expires > 0 && info->expires <= time (NULL))
+        return FALSE;
+
+    return (info->flags & flags) == flags;
+}
+
+void
+seahorse_key_cache_invalidate (void)
+{
+    cache_checked = FALSE;
+}
+
+void
+seahorse_key_cache_cleanup (void)
+{
+    clear_index ();
+    cache_checked = FALSE;
+}
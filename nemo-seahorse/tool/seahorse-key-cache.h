@@ -0,0 +1,60 @@
+/*
+ * Seahorse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+/**
+ * What the tool needs to know about the keys in the keyring, kept in
+ * the user's cache directory between runs. It's filled by listing all
+ * the keys from gpg in one go, and only again once the keyring files
+ * have changed, so nothing has to ask about keys one at a time.
+ */
+
+#ifndef __SEAHORSE_KEY_CACHE__
+#define __SEAHORSE_KEY_CACHE__
+
+typedef enum {
+    SEAHORSE_KEY_CAN_ENCRYPT    = 1 << 0,
+    SEAHORSE_KEY_CAN_SIGN       = 1 << 1,
+    SEAHORSE_KEY_SECRET         = 1 << 2,
+    SEAHORSE_KEY_REVOKED        = 1 << 3,
+    SEAHORSE_KEY_EXPIRED        = 1 << 4,
+    SEAHORSE_KEY_DISABLED       = 1 << 5
+} SeahorseKeyFlags;
+
+typedef struct _SeahorseKeyInfo {
+    const gchar *fingerprint;
+    const gchar *keyid;             /* The last 16 digits of the fingerprint */
+    const gchar **uids;             /* The primary one first */
+    guint flags;                    /* SeahorseKeyFlags */
+    gint64 expires;                 /* Or 0 for never */
+} SeahorseKeyInfo;
+
+/* Looks up a key by fingerprint or long key id, of the key or any of
+ * its subkeys, with or without the "openpgp:" that libcryptui puts on.
+ * NULL if gpg doesn't have the key, or the keys couldn't be listed. */
+const SeahorseKeyInfo*  seahorse_key_cache_lookup       (const gchar *id);
+
+/* Whether the key is there to sign with, or encrypt to */
+gboolean                seahorse_key_cache_usable       (const SeahorseKeyInfo *info,
+                                                         guint flags);
+
+/* Looks at the keyring files again on the next lookup */
+void                    seahorse_key_cache_invalidate   (void);
+
+void                    seahorse_key_cache_cleanup      (void);
+
+#endif /* __SEAHORSE_KEY_CACHE__ */
@@ -34,6 +34,18 @@ void            seahorse_notify_signatures          (const gchar* data,
 
 void            seahorse_notify_import              (guint keynum, gchar **keys);
 
+/* Adds up the signatures of many files, for one notification about them all */
+typedef struct _SeahorseVerifySummary SeahorseVerifySummary;
+
+SeahorseVerifySummary*  seahorse_verify_summary_new (void);
+
+void            seahorse_verify_summary_add         (SeahorseVerifySummary *summary,
+                                                     const gchar *uri,
+                                                     gpgme_verify_result_t status);
+
+/* Displays the summary, if there's anything in it, and frees it */
+void            seahorse_notify_verify_summary      (SeahorseVerifySummary *summary);
+
 void            seahorse_notification_display       (const gchar *summary,
                                                      const gchar* body,
                                                      gboolean urgent,
@@ -25,6 +25,7 @@
 
 #include <cryptui.h>
 
+#include "seahorse-key-cache.h"
 #include "seahorse-libdialogs.h"
 #include "seahorse-util.h"
 
@@ -77,6 +78,7 @@ static CryptUIKeyset *keyset = NULL;
 static void
 insert_key_field (GString *res, const gchar *key, const gchar *field)
 {
+    const SeahorseKeyInfo *info;
     gchar *str, *esc;
 
 
@@ -84,7 +86,14 @@ insert_key_field (GString *res, const gchar *key, const gchar *field)
     if (!field)
         field = "display-name";
 
-    str = cryptui_keyset_key_get_string (keyset, key, field);
+    /* The usual fields come from the key cache, anything else is asked for */
+    info = seahorse_key_cache_lookup (key);
+    if (info && info->uids[0] && strcmp (field, "display-name") == 0)
+        str = g_strdup (info->uids[0]);
+    else if (info && strcmp (field, "display-id") == 0)
+        str = g_strdup (info->keyid + strlen (info->keyid) - 8);
+    else
+        str = cryptui_keyset_key_get_string (keyset, key, field);
     if (str) {
         esc = g_markup_escape_text (str, -1);
         g_string_append (res, esc);
@@ -360,6 +369,9 @@ key_changed (CryptUIKeyset *keyset, const gchar *key, SeahorseNotification *snot
     GList *l;
     gboolean matched = FALSE;
 
+    /* The keyring changed, so the key cache has to be looked at again */
+    seahorse_key_cache_invalidate ();
+
     if (!snotif->widget)
         return;
 
@@ -681,6 +693,123 @@ seahorse_notify_signatures (const gchar* data, gpgme_verify_result_t status)
     g_free (body);
 }
 
+/* Files with a problem listed by name, before just counting them */
+#define SUMMARY_PROBLEMS 8
+
+struct _SeahorseVerifySummary {
+    guint n_files;
+    guint n_good;
+    guint n_untrusted;
+    guint n_problems;
+    GString *problems;
+};
+
+SeahorseVerifySummary*
+seahorse_verify_summary_new (void)
+{
+    SeahorseVerifySummary *summary = g_new0 (SeahorseVerifySummary, 1);
+    summary->problems = g_string_new ("");
+    return summary;
+}
+
+void
+seahorse_verify_summary_add (SeahorseVerifySummary *summary, const gchar *uri,
+                             gpgme_verify_result_t status)
+{
+    const gchar *problem;
+    gchar *unesc_uri, *line;
+
+    summary->n_files++;
+
+    if (!status || !status->signatures) {
+        problem = _("No valid signatures found");
+    } else {
+        switch (gpgme_err_code (status->signatures->status)) {
+        case GPG_ERR_NO_ERROR:
+            if (status->signatures->validity >= GPGME_VALIDITY_FULL)
+                summary->n_good++;
+            else
+                summary->n_untrusted++;
+            return;
+        case GPG_ERR_KEY_EXPIRED:
+            problem = _("Signing key expired");
+            break;
+        case GPG_ERR_SIG_EXPIRED:
+            problem = _("Expired signature");
+            break;
+        case GPG_ERR_CERT_REVOKED:
+            problem = _("Signing key revoked");
+            break;
+        case GPG_ERR_NO_PUBKEY:
+            problem = _("Signing key not in keyring");
+            break;
+        case GPG_ERR_BAD_SIGNATURE:
+            problem = _("Bad or forged signature");
+            break;
+        case GPG_ERR_NO_DATA:
+            problem = _("No valid signatures found");
+            break;
+        default:
+            problem = gpgme_strerror (status->signatures->status);
+            break;
+        };
+    }
+
+    if (++summary->n_problems > SUMMARY_PROBLEMS)
+        return;
+
+    unesc_uri = g_uri_unescape_string (seahorse_util_uri_get_last (uri), NULL);
+    line = g_markup_printf_escaped ("\n<b>%s</b>: %s", unesc_uri, problem);
+    g_string_append (summary->problems, line);
+    g_free (line);
+    g_free (unesc_uri);
+}
+
+void
+seahorse_notify_verify_summary (SeahorseVerifySummary *summary)
+{
+    const gchar *title, *icon;
+    GString *body;
+
+    if (summary->n_files > 0) {
+        body = g_string_new ("");
+        g_string_append_printf (body, ngettext ("%u of %u file has a good signature.",
+                                                "%u of %u files have good signatures.",
+                                                summary->n_files),
+                                summary->n_good, summary->n_files);
+
+        if (summary->n_untrusted)
+            g_string_append_printf (body, ngettext ("\n%u is valid but <b>untrusted</b>.",
+                                                    "\n%u are valid but <b>untrusted</b>.",
+                                                    summary->n_untrusted),
+                                    summary->n_untrusted);
+
+        g_string_append (body, summary->problems->str);
+        if (summary->n_problems > SUMMARY_PROBLEMS)
+            g_string_append_printf (body, ngettext ("\nand %u more file",
+                                                    "\nand %u more files",
+                                                    summary->n_problems - SUMMARY_PROBLEMS),
+                                    summary->n_problems - SUMMARY_PROBLEMS);
+
+        if (summary->n_problems) {
+            title = _("Signature Problems");
+            icon = ICON_PREFIX "seahorse-sign-bad.png";
+        } else if (summary->n_untrusted) {
+            title = _("Untrusted Valid Signatures");
+            icon = ICON_PREFIX "seahorse-sign-ok.png";
+        } else {
+            title = _("Good Signatures");
+            icon = ICON_PREFIX "seahorse-sign-ok.png";
+        }
+
+        seahorse_notification_display (title, body->str, summary->n_problems > 0, icon, NULL);
+        g_string_free (body, TRUE);
+    }
+
+    g_string_free (summary->problems, TRUE);
+    g_free (summary);
+}
+
 void
 seahorse_notification_cleanup (void)
 {
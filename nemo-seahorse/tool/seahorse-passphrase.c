@@ -59,6 +59,25 @@ typedef struct {
 	GMainLoop *loop;
 } SyncClosure;
 
+/* While operations run side by side, one prompt answers them all */
+static gboolean sharing = FALSE;
+static gboolean prompting = FALSE;
+static gchar *shared_hint = NULL;
+static gchar *shared_pass = NULL;
+
+void
+seahorse_passphrase_share (gboolean share)
+{
+	sharing = share;
+
+	if (!share) {
+		gcr_secure_memory_strfree (shared_pass);
+		shared_pass = NULL;
+		g_free (shared_hint);
+		shared_hint = NULL;
+	}
+}
+
 static void
 on_sync_complete (GObject *source,
                   GAsyncResult *result,
@@ -82,9 +101,20 @@ seahorse_passphrase_get (gconstpointer dummy, const gchar *passphrase_hint,
 	GError *error = NULL;
 	gchar *msg;
 
+	/* The others wait for the prompt that is already up */
+	while (prompting)
+		g_main_context_iteration (NULL, TRUE);
+
+	if (sharing && shared_pass && !(flags & SEAHORSE_PASS_BAD) &&
+	    g_strcmp0 (passphrase_hint, shared_hint) == 0) {
+		seahorse_util_printf_fd (fd, "%s\n", shared_pass);
+		return 0;
+	}
+
 	sync.result = NULL;
 	sync.loop = g_main_loop_new (NULL, FALSE);
 
+	prompting = TRUE;
 	gcr_system_prompt_open_async (-1, NULL, on_sync_complete, &sync);
 
 	g_main_loop_run (sync.loop);
@@ -96,6 +126,7 @@ seahorse_passphrase_get (gconstpointer dummy, const gchar *passphrase_hint,
 	g_object_unref (sync.result);
 
 	if (error != NULL) {
+		prompting = FALSE;
 		g_message ("Couldn't open system prompt: %s", error->message);
 		g_error_free (error);
 		return gpgme_error (GPG_ERR_CANCELED);
@@ -142,6 +173,14 @@ seahorse_passphrase_get (gconstpointer dummy, const gchar *passphrase_hint,
 	if (pass != NULL)
 		seahorse_util_printf_fd (fd, "%s\n", pass);
 
+	if (sharing && pass != NULL) {
+		gcr_secure_memory_strfree (shared_pass);
+		shared_pass = gcr_secure_memory_strdup (pass);
+		g_free (shared_hint);
+		shared_hint = g_strdup (passphrase_hint);
+	}
+	prompting = FALSE;
+
 	gcr_system_prompt_close_async (GCR_SYSTEM_PROMPT (prompt), NULL, NULL, NULL);
 	g_object_unref (prompt);
 
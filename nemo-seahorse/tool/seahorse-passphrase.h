@@ -36,4 +36,8 @@ gpgme_error_t   seahorse_passphrase_get             (gconstpointer dummy,
                                                      const char* passphrase_info,
                                                      int prev_bad, int fd);
 
+/* While TRUE, a passphrase entered once is given to every operation
+ * asking with the same hint. Setting it back to FALSE forgets it. */
+void            seahorse_passphrase_share           (gboolean share);
+
 #endif /* __SEAHORSE_PASSPHRASE__ */
@@ -0,0 +1,643 @@
+/*
+ * Seahorse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <string.h>
+
+#include <glib/gi18n.h>
+#include <gio/gio.h>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "seahorse-tar-data.h"
+#include "seahorse-util.h"
+
+#include <gpgme.h>
+
+#define BLOCK_SIZE      512
+#define RING_SIZE       (4 * 1024 * 1024)
+#define IO_BLOCK        (64 * 1024)
+#define PROGRESS_BLOCK  (16 * 1024)
+#define WAIT_SLICE      (100 * 1000)    /* microseconds */
+
+/* The largest size that fits in a ustar header, bigger ones go in a
+ * pax header */
+#define USTAR_MAX_SIZE  G_GUINT64_CONSTANT (077777777777)
+#define USTAR_MAX_ID    07777777
+
+#define USTAR_MAX_NAME  100
+
+/* A ustar header block */
+typedef struct _TarHeader {
+    gchar name[100];
+    gchar mode[8];
+    gchar uid[8];
+    gchar gid[8];
+    gchar size[12];
+    gchar mtime[12];
+    gchar chksum[8];
+    gchar typeflag;
+    gchar linkname[100];
+    gchar magic[6];
+    gchar version[2];
+    gchar uname[32];
+    gchar gname[32];
+    gchar devmajor[8];
+    gchar devminor[8];
+    gchar prefix[155];
+    gchar padding[12];
+} TarHeader;
+
+G_STATIC_ASSERT (sizeof (TarHeader) == BLOCK_SIZE);
+
+/*
+ * A thread walks the members, reading the files with blocking GIO
+ * calls, and puts the tar into the ring, compressed if need be. gpgme
+ * reads it from there as gpg takes it.
+ */
+typedef struct _TarHandle {
+
+    gpgme_data_t gdata;             /* A pointer to the outside gpgme_data_t handle */
+
+    SeahorseTarMember *members;     /* What goes in the tar */
+    guint n_members;
+    SeahorseTarCompression compression;
+    GCancellable *cancellable;      /* For stopping a blocked read on release */
+    GThread *thread;                /* Makes the tar, once gpgme first reads */
+
+    GConverter *gzip;               /* Compressors, used on the thread only */
+#ifdef HAVE_ZSTD
+    ZSTD_CCtx *zstd;
+#endif
+    guchar *zbuf;                   /* Compressed output */
+
+    GMutex lock;                    /* Protects everything from here on */
+    GCond cond;                     /* Signalled whenever any of it changes */
+
+    guchar *ring;                   /* The tar, made ahead of gpgme */
+    gsize head;                     /* Where the data starts in the ring */
+    gsize fill;                     /* Number of bytes of data in the ring */
+
+    gboolean eof;                   /* The whole tar is in the ring */
+    gboolean closing;               /* The thread should stop */
+    GError *error;                  /* What stopped the thread */
+
+    goffset position;               /* Bytes of the files read so far */
+    goffset last;                   /* Last update sent about position */
+
+    SeahorseVfsProgressCb progcb;   /* Progress callback */
+    gpointer userdata;              /* User data for progress callback */
+} TarHandle;
+
+/* Called with the lock held to wait for the thread, like the vfs data */
+static void
+tar_data_wait (TarHandle *th)
+{
+    gint64 end_time = g_get_monotonic_time () + WAIT_SLICE;
+
+    if (!g_cond_wait_until (&th->cond, &th->lock, end_time)) {
+        g_mutex_unlock (&th->lock);
+        while (g_main_context_pending (NULL))
+            g_main_context_iteration (NULL, FALSE);
+        g_mutex_lock (&th->lock);
+    }
+}
+
+/* Puts made data into the ring, waiting while gpgme catches up */
+static gboolean
+tar_data_push (TarHandle *th, const guchar *data, gsize length, GError **error)
+{
+    g_mutex_lock (&th->lock);
+
+    while (length > 0) {
+        gsize start, count;
+
+        while (th->fill == RING_SIZE && !th->closing)
+            g_cond_wait (&th->cond, &th->lock);
+
+        if (th->closing) {
+            g_mutex_unlock (&th->lock);
+            g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                                 _("Operation was cancelled"));
+            return FALSE;
+        }
+
+        start = (th->head + th->fill) % RING_SIZE;
+        count = MIN (RING_SIZE - start, RING_SIZE - th->fill);
+        count = MIN (count, length);
+
+        memcpy (th->ring + start, data, count);
+        th->fill += count;
+        data += count;
+        length -= count;
+        g_cond_broadcast (&th->cond);
+    }
+
+    g_mutex_unlock (&th->lock);
+    return TRUE;
+}
+
+/* Compresses the tar as it goes out. With finish set, what the
+ * compressor holds back is let out too. */
+static gboolean
+tar_data_output (TarHandle *th, const guchar *data, gsize length,
+                 gboolean finish, GError **error)
+{
+    gsize bytes_read, bytes_written;
+    GConverterResult res;
+
+    if (length == 0 && !finish)
+        return TRUE;
+
+    switch (th->compression) {
+    case SEAHORSE_TAR_PLAIN:
+        return tar_data_push (th, data, length, error);
+
+    case SEAHORSE_TAR_GZIP:
+        do {
+            res = g_converter_convert (th->gzip, data, length, th->zbuf, IO_BLOCK,
+                                       finish ? G_CONVERTER_INPUT_AT_END : G_CONVERTER_NO_FLAGS,
+                                       &bytes_read, &bytes_written, error);
+            if (res == G_CONVERTER_ERROR)
+                return FALSE;
+            if (!tar_data_push (th, th->zbuf, bytes_written, error))
+                return FALSE;
+            data += bytes_read;
+            length -= bytes_read;
+        } while (length > 0 || (finish && res != G_CONVERTER_FINISHED));
+        return TRUE;
+
+#ifdef HAVE_ZSTD
+    case SEAHORSE_TAR_ZSTD: {
+        ZSTD_inBuffer in = { data, length, 0 };
+        size_t remaining;
+
+        do {
+            ZSTD_outBuffer out = { th->zbuf, IO_BLOCK, 0 };
+
+            remaining = ZSTD_compressStream2 (th->zstd, &out, &in,
+                                              finish ? ZSTD_e_end : ZSTD_e_continue);
+            if (ZSTD_isError (remaining)) {
+                g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                                     ZSTD_getErrorName (remaining));
+                return FALSE;
+            }
+            if (!tar_data_push (th, th->zbuf, out.pos, error))
+                return FALSE;
+        } while (in.pos < in.size || (finish && remaining > 0));
+        return TRUE;
+    }
+#endif
+
+    default:
+        g_assert_not_reached ();
+        return FALSE;
+    }
+}
+
+static void
+tar_header_number (gchar *field, gsize size, guint64 value)
+{
+    /* Octal, ending in a NUL */
+    g_snprintf (field, size, "%0*" G_GINT64_MODIFIER "o", (gint)size - 1, value);
+}
+
+static gsize
+count_digits (gsize value)
+{
+    gsize digits = 1;
+
+    while (value >= 10) {
+        value /= 10;
+        digits++;
+    }
+
+    return digits;
+}
+
+/* Appends a pax record, which starts with its own length in decimal */
+static void
+tar_pax_record (GString *pax, const gchar *key, const gchar *value)
+{
+    gsize length, total;
+
+    length = strlen (key) + strlen (value) + 3;
+    total = length + count_digits (length);
+
+    /* Counting the digits can take another one */
+    if (count_digits (total) > count_digits (length))
+        total++;
+
+    g_string_append_printf (pax, "%" G_GSIZE_FORMAT " %s=%s\n", total, key, value);
+}
+
+static gboolean
+tar_write_header (TarHandle *th, const gchar *name, const gchar *linkname,
+                  gchar typeflag, guint32 mode, guint32 uid, guint32 gid,
+                  guint64 size, guint64 mtime, GError **error)
+{
+    TarHeader header;
+    guint checksum;
+    const guchar *p;
+    guint i;
+
+    memset (&header, 0, sizeof (header));
+
+    strncpy (header.name, name, sizeof (header.name));
+    if (linkname)
+        strncpy (header.linkname, linkname, sizeof (header.linkname));
+
+    tar_header_number (header.mode, sizeof (header.mode), mode & 07777);
+    tar_header_number (header.uid, sizeof (header.uid), MIN (uid, USTAR_MAX_ID));
+    tar_header_number (header.gid, sizeof (header.gid), MIN (gid, USTAR_MAX_ID));
+    tar_header_number (header.size, sizeof (header.size), MIN (size, USTAR_MAX_SIZE));
+    tar_header_number (header.mtime, sizeof (header.mtime), MIN (mtime, USTAR_MAX_SIZE));
+    header.typeflag = typeflag;
+    memcpy (header.magic, "ustar", 6);
+    memcpy (header.version, "00", 2);
+
+    /* The checksum is worked out with its own field as spaces */
+    memset (header.chksum, ' ', sizeof (header.chksum));
+    for (i = 0, checksum = 0, p = (const guchar*)&header; i < sizeof (header); i++)
+        checksum += p[i];
+    g_snprintf (header.chksum, sizeof (header.chksum), "%06o", checksum);
+
+    return tar_data_output (th, (const guchar*)&header, sizeof (header), FALSE, error);
+}
+
+/* Pads the data of an entry out to a whole block */
+static gboolean
+tar_write_padding (TarHandle *th, guint64 size, GError **error)
+{
+    static const guchar zeros[BLOCK_SIZE] = { 0, };
+    gsize pad = (BLOCK_SIZE - size % BLOCK_SIZE) % BLOCK_SIZE;
+
+    return pad == 0 || tar_data_output (th, zeros, pad, FALSE, error);
+}
+
+static gboolean
+tar_write_contents (TarHandle *th, SeahorseTarMember *member, guint64 size,
+                    GError **error)
+{
+    GInputStream *istream;
+    guint64 done = 0;
+    gssize count;
+    guchar *buffer;
+    gboolean ret = TRUE;
+
+    istream = G_INPUT_STREAM (g_file_read (member->file, th->cancellable, error));
+    if (!istream)
+        return FALSE;
+
+    buffer = g_malloc (IO_BLOCK);
+
+    for (;;) {
+        count = g_input_stream_read (istream, buffer, IO_BLOCK, th->cancellable, error);
+        if (count <= 0) {
+            ret = count == 0;
+            break;
+        }
+
+        /* The header has the size already, so a file that grew is cut off */
+        if (done + count > size)
+            count = size - done;
+        if (count > 0 && !tar_data_output (th, buffer, count, FALSE, error)) {
+            ret = FALSE;
+            break;
+        }
+        done += count;
+
+        g_mutex_lock (&th->lock);
+        th->position += count;
+        g_mutex_unlock (&th->lock);
+
+        if (done == size)
+            break;
+    }
+
+    /* Less than the header said would leave the tar unreadable */
+    if (ret && done < size) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     _("'%s' changed while it was being packaged"),
+                     g_file_info_get_display_name (member->info));
+        ret = FALSE;
+    }
+
+    g_input_stream_close (istream, NULL, NULL);
+    g_object_unref (istream);
+    g_free (buffer);
+
+    return ret && tar_write_padding (th, size, error);
+}
+
+static gboolean
+tar_write_member (TarHandle *th, SeahorseTarMember *member, GError **error)
+{
+    const gchar *linkname = NULL;
+    GString *pax = NULL;
+    gchar *name, *value;
+    guint64 size = 0;
+    guint32 uid, gid;
+    gchar typeflag;
+    gboolean ret = TRUE;
+
+    switch (g_file_info_get_file_type (member->info)) {
+    case G_FILE_TYPE_REGULAR:
+        typeflag = '0';
+        size = g_file_info_get_size (member->info);
+        name = g_strdup (member->name);
+        break;
+    case G_FILE_TYPE_DIRECTORY:
+        typeflag = '5';
+        name = g_strconcat (member->name, "/", NULL);
+        break;
+    case G_FILE_TYPE_SYMBOLIC_LINK:
+        typeflag = '2';
+        linkname = g_file_info_get_symlink_target (member->info);
+        name = g_strdup (member->name);
+        break;
+    default:
+        /* Devices, sockets and such aren't packaged */
+        return TRUE;
+    }
+
+    uid = g_file_info_get_attribute_uint32 (member->info, G_FILE_ATTRIBUTE_UNIX_UID);
+    gid = g_file_info_get_attribute_uint32 (member->info, G_FILE_ATTRIBUTE_UNIX_GID);
+
+    /* What doesn't fit the ustar header goes in a pax header first */
+    if (strlen (name) >= USTAR_MAX_NAME) {
+        pax = g_string_new (NULL);
+        tar_pax_record (pax, "path", name);
+    }
+    if (linkname && strlen (linkname) >= USTAR_MAX_NAME) {
+        pax = pax ? pax : g_string_new (NULL);
+        tar_pax_record (pax, "linkpath", linkname);
+    }
+    if (size > USTAR_MAX_SIZE) {
+        pax = pax ? pax : g_string_new (NULL);
+        value = g_strdup_printf ("%" G_GUINT64_FORMAT, size);
+        tar_pax_record (pax, "size", value);
+        g_free (value);
+    }
+    /* Such as the ids of systemd-homed and LDAP users */
+    if (uid > USTAR_MAX_ID) {
+        pax = pax ? pax : g_string_new (NULL);
+        value = g_strdup_printf ("%u", uid);
+        tar_pax_record (pax, "uid", value);
+        g_free (value);
+    }
+    if (gid > USTAR_MAX_ID) {
+        pax = pax ? pax : g_string_new (NULL);
+        value = g_strdup_printf ("%u", gid);
+        tar_pax_record (pax, "gid", value);
+        g_free (value);
+    }
+
+    if (pax) {
+        ret = tar_write_header (th, "././@PaxHeader", NULL, 'x', 0644, 0, 0,
+                                pax->len, 0, error) &&
+              tar_data_output (th, (const guchar*)pax->str, pax->len, FALSE, error) &&
+              tar_write_padding (th, pax->len, error);
+        g_string_free (pax, TRUE);
+    }
+
+    if (ret)
+        ret = tar_write_header (th, name, linkname, typeflag,
+                                g_file_info_get_attribute_uint32 (member->info, G_FILE_ATTRIBUTE_UNIX_MODE),
+                                uid, gid, size,
+                                g_file_info_get_attribute_uint64 (member->info, G_FILE_ATTRIBUTE_TIME_MODIFIED),
+                                error);
+
+    if (ret && typeflag == '0')
+        ret = tar_write_contents (th, member, size, error);
+
+    g_free (name);
+    return ret;
+}
+
+static gpointer
+tar_data_thread (gpointer data)
+{
+    static const guchar trailer[2 * BLOCK_SIZE] = { 0, };
+    TarHandle *th = (TarHandle*)data;
+    GError *error = NULL;
+    gboolean ok = TRUE;
+    guint i;
+
+    for (i = 0; ok && i < th->n_members; i++)
+        ok = tar_write_member (th, &th->members[i], &error);
+
+    /* Two empty blocks end the tar */
+    if (ok)
+        ok = tar_data_output (th, trailer, sizeof (trailer), TRUE, &error);
+
+    g_mutex_lock (&th->lock);
+    if (ok)
+        th->eof = TRUE;
+    else
+        th->error = error;
+    g_cond_broadcast (&th->cond);
+    g_mutex_unlock (&th->lock);
+
+    return NULL;
+}
+
+/* Called by gpgme to read data */
+static ssize_t
+tar_data_read (void *handle, void *buffer, size_t size)
+{
+    TarHandle *th = (TarHandle*)handle;
+    goffset position;
+    ssize_t sz;
+
+    if (!th->thread) {
+        th->ring = g_malloc (RING_SIZE);
+        th->thread = g_thread_new ("tar-data", tar_data_thread, th);
+    }
+
+    g_mutex_lock (&th->lock);
+
+    while (th->fill == 0 && !th->eof && !th->error)
+        tar_data_wait (th);
+
+    if (th->fill == 0 && th->error) {
+        seahorse_util_set_errno (th->error);
+        g_mutex_unlock (&th->lock);
+        return -1;
+    }
+
+    sz = MIN (size, MIN (th->fill, RING_SIZE - th->head));
+    memcpy (buffer, th->ring + th->head, sz);
+    th->head = (th->head + sz) % RING_SIZE;
+    th->fill -= sz;
+    position = th->position;
+
+    g_cond_broadcast (&th->cond);
+    g_mutex_unlock (&th->lock);
+
+    if (th->progcb && position >= th->last + PROGRESS_BLOCK) {
+        th->last = position;
+        (th->progcb) (th->gdata, position, th->userdata);
+    }
+
+    return sz;
+}
+
+/* The tar is made as it is read, it can't be written or seeked */
+static ssize_t
+tar_data_write (void *handle, const void *buffer, size_t size)
+{
+    errno = EBADF;
+    return -1;
+}
+
+static off_t
+tar_data_seek (void *handle, off_t offset, int whence)
+{
+    errno = ESPIPE;
+    return (off_t)-1;
+}
+
+/* Called by gpgme to close the data */
+static void
+tar_data_release (void *handle)
+{
+    TarHandle *th = (TarHandle*)handle;
+    guint i;
+
+    if (th->thread) {
+        g_mutex_lock (&th->lock);
+        th->closing = TRUE;
+        g_cancellable_cancel (th->cancellable);
+        g_cond_broadcast (&th->cond);
+        g_mutex_unlock (&th->lock);
+
+        g_thread_join (th->thread);
+    }
+
+    for (i = 0; i < th->n_members; i++) {
+        g_object_unref (th->members[i].file);
+        g_object_unref (th->members[i].info);
+        g_free ((gchar*)th->members[i].name);
+    }
+    g_free (th->members);
+
+    if (th->gzip)
+        g_object_unref (th->gzip);
+#ifdef HAVE_ZSTD
+    if (th->zstd)
+        ZSTD_freeCCtx (th->zstd);
+#endif
+    g_free (th->zbuf);
+
+    g_object_unref (th->cancellable);
+    g_mutex_clear (&th->lock);
+    g_cond_clear (&th->cond);
+    g_clear_error (&th->error);
+    g_free (th->ring);
+
+    g_free (th);
+}
+
+/* GPGME tar operations */
+static struct gpgme_data_cbs tar_data_cbs = {
+    tar_data_read,
+    tar_data_write,
+    tar_data_seek,
+    tar_data_release
+};
+
+/* -----------------------------------------------------------------------------
+ */
+
+gboolean
+seahorse_tar_data_supports (const gchar *name, SeahorseTarCompression *compression)
+{
+    SeahorseTarCompression comp;
+
+    if (g_str_has_suffix (name, ".tar"))
+        comp = SEAHORSE_TAR_PLAIN;
+    else if (g_str_has_suffix (name, ".tar.gz") || g_str_has_suffix (name, ".tgz"))
+        comp = SEAHORSE_TAR_GZIP;
+#ifdef HAVE_ZSTD
+    else if (g_str_has_suffix (name, ".tar.zst"))
+        comp = SEAHORSE_TAR_ZSTD;
+#endif
+    else
+        return FALSE;
+
+    if (compression)
+        *compression = comp;
+    return TRUE;
+}
+
+gpgme_data_t
+seahorse_tar_data_create (const SeahorseTarMember *members, guint n_members,
+                          SeahorseTarCompression compression,
+                          SeahorseVfsProgressCb progcb, gpointer userdata,
+                          GError **err)
+{
+    gpgme_data_t data = NULL;
+    gpgme_error_t gerr;
+    TarHandle *th;
+    guint i;
+
+    g_return_val_if_fail (!err || !*err, NULL);
+
+    th = g_new0 (TarHandle, 1);
+    th->compression = compression;
+    th->cancellable = g_cancellable_new ();
+    th->progcb = progcb;
+    th->userdata = userdata;
+    g_mutex_init (&th->lock);
+    g_cond_init (&th->cond);
+
+    th->n_members = n_members;
+    th->members = g_new0 (SeahorseTarMember, n_members);
+    for (i = 0; i < n_members; i++) {
+        th->members[i].file = g_object_ref (members[i].file);
+        th->members[i].info = g_object_ref (members[i].info);
+        th->members[i].name = g_strdup (members[i].name);
+    }
+
+    if (compression == SEAHORSE_TAR_GZIP)
+        th->gzip = G_CONVERTER (g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1));
+#ifdef HAVE_ZSTD
+    if (compression == SEAHORSE_TAR_ZSTD) {
+        th->zstd = ZSTD_createCCtx ();
+        /* Only takes if libzstd was built with threads */
+        ZSTD_CCtx_setParameter (th->zstd, ZSTD_c_nbWorkers, g_get_num_processors ());
+    }
+#endif
+    if (compression != SEAHORSE_TAR_PLAIN)
+        th->zbuf = g_malloc (IO_BLOCK);
+
+    gerr = gpgme_data_new_from_cbs (&data, &tar_data_cbs, th);
+    if (gerr != 0) {
+        tar_data_release (th);
+        seahorse_util_gpgme_to_error (gerr, err);
+        return NULL;
+    }
+
+    th->gdata = data;
+    return data;
+}
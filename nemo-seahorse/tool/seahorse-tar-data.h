@@ -0,0 +1,57 @@
+/*
+ * Seahorse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gio/gio.h>
+
+#include <gpgme.h>
+
+#include "seahorse-vfs-data.h"
+
+/**
+ * A gpgme_data_t which reads as a tar of a set of files, optionally
+ * compressed. The tar is made as gpgme reads it, so a package is
+ * encrypted without ever being written out in the clear.
+ */
+
+#ifndef __SEAHORSE_TAR_DATA__
+#define __SEAHORSE_TAR_DATA__
+
+typedef enum {
+    SEAHORSE_TAR_PLAIN,
+    SEAHORSE_TAR_GZIP,
+    SEAHORSE_TAR_ZSTD
+} SeahorseTarCompression;
+
+typedef struct _SeahorseTarMember {
+    GFile *file;
+    GFileInfo *info;        /* With standard::*, unix::* and time::modified */
+    const gchar *name;      /* The path in the tar */
+} SeahorseTarMember;
+
+/* Whether a package called @name can be made as a tar, and how */
+gboolean            seahorse_tar_data_supports      (const gchar *name,
+                                                     SeahorseTarCompression *compression);
+
+/* Directories in @members are put in as they are, not with what is in
+ * them. The progress callback gets the number of bytes of the files
+ * read so far. */
+gpgme_data_t        seahorse_tar_data_create        (const SeahorseTarMember *members,
+                                                     guint n_members,
+                                                     SeahorseTarCompression compression,
+                                                     SeahorseVfsProgressCb progcb,
+                                                     gpointer userdata, GError **err);
+
+#endif /* __SEAHORSE_TAR_DATA__ */
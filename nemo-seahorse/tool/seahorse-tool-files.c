@@ -28,37 +28,60 @@
 #include <glib/gi18n.h>
 #include <gio/gio.h>
 
+#include "seahorse-passphrase.h"
 #include "seahorse-tool.h"
 #include "seahorse-util.h"
 #include "seahorse-widget.h"
+#include "seahorse-tar-data.h"
 #include "seahorse-vfs-data.h"
 
 #define ONE_GIGABYTE 1024 * 1024 * 1024
-#define FILE_ATTRIBUTES "standard::*"
+#define FILE_ATTRIBUTES "standard::*,unix::mode,unix::uid,unix::gid,time::modified"
+
+/* Files processed at once, each by a gpg process of its own */
+#define MAX_JOBS 8
 
 typedef struct _FileInfo {
     GFile *file;
     GFileInfo *info;
     gchar *uri;
+    gchar *name;            /* The path within a package */
 } FileInfo;
 
 typedef struct _FilesCtx {
     GSList *uris;
-    GList *finfos;
+    GPtrArray *finfos;
     FileInfo *cur;
     gboolean remote;
 
     guint64 total;
     guint64 done;
+    guint files_done;
+    GPtrArray *jobs;
+
+    /* Set when the files are encrypted as one tar */
+    GFile *package;
+    SeahorseTarCompression compression;
+    GPtrArray *members;
 } FilesCtx;
 
+/* A file being processed */
+typedef struct _FileJob {
+    FilesCtx *ctx;
+    FileInfo *finfo;
+    SeahorsePGPOperation *pop;
+    gpgme_data_t data;
+    goffset pos;
+} FileJob;
+
 static void
-free_file_info (FileInfo *finfo, gpointer unused)
+free_file_info (FileInfo *finfo)
 {
     if (finfo) {
         g_object_unref (finfo->file);
         g_object_unref (finfo->info);
         g_free (finfo->uri);
+        g_free (finfo->name);
     }
     g_free (finfo);
 }
@@ -94,6 +117,7 @@ typedef enum {
 	FR_FILE_TYPE_ZIP,
 	FR_FILE_TYPE_ZOO,
 	FR_FILE_TYPE_7ZIP,
+	FR_FILE_TYPE_TAR_ZSTD,
 	FR_FILE_TYPE_NULL
 } FRFileType;
 
@@ -140,7 +164,8 @@ FRFileTypeDescription file_type_desc[] = {
 	{ FR_FILE_TYPE_WAR,          ".war",     "application/zip", N_("War (.war)") },
 	{ FR_FILE_TYPE_ZIP,          ".zip",     "application/zip", N_("Zip (.zip)") },
 	{ FR_FILE_TYPE_ZOO,          ".zoo",     "application/x-zoo", N_("Zoo (.zoo)") },
-	{ FR_FILE_TYPE_7ZIP,         ".7z",      "application/x-7z-compressed", N_("7-Zip (.7z)") }
+	{ FR_FILE_TYPE_7ZIP,         ".7z",      "application/x-7z-compressed", N_("7-Zip (.7z)") },
+	{ FR_FILE_TYPE_TAR_ZSTD,     ".tar.zst", "application/x-zstd-compressed-tar", N_("Tar compressed with zstd (.tar.zst)") }
 };
 
 FRCommandDescription command_desc[] = {
@@ -197,12 +222,30 @@ is_program_in_path (const char *filename)
 	return result;
 }
 
+static void
+add_save_type (int *s_i, FRFileType type)
+{
+	int i;
+
+	for (i = 0; i < *s_i; i++)
+		if (save_type[i] == type)
+			return;
+
+	if (*s_i < G_N_ELEMENTS (save_type) - 1)
+		save_type[(*s_i)++] = type;
+}
+
 static void
 compute_supported_archive_types (void)
 {
 	int i, j;
 	int s_i = 0;
 
+	/* Tars are made as they are encrypted, without file-roller */
+	for (i = 0; i < G_N_ELEMENTS (file_type_desc); i++)
+		if (seahorse_tar_data_supports (file_type_desc[i].ext, NULL))
+			add_save_type (&s_i, file_type_desc[i].id);
+
 	for (i = 0; i < G_N_ELEMENTS (command_desc); i++) {
 		FRCommandDescription com = command_desc[i];
 
@@ -215,11 +258,11 @@ compute_supported_archive_types (void)
 
 				if (!is_program_in_path (com2.command))
 					continue;
-				save_type[s_i++] = com2.file_type;
+				add_save_type (&s_i, com2.file_type);
 			}
 
 		if (com.can_save && com.support_many_files)
-			save_type[s_i++] = com.file_type;
+			add_save_type (&s_i, com.file_type);
 	}
 
 	save_type[s_i++] = FR_FILE_TYPE_NULL;
@@ -290,9 +333,10 @@ step_check_uris (FilesCtx *ctx,
             finfo->info = info;
             g_object_ref (info);
             finfo->uri = g_file_get_uri (file);
+            finfo->name = g_file_get_basename (file);
 
             ctx->total += g_file_info_get_size (info);
-            ctx->finfos = g_list_prepend (ctx->finfos, finfo);
+            g_ptr_array_add (ctx->finfos, finfo);
         }
 
         g_object_unref (file);
@@ -301,7 +345,6 @@ step_check_uris (FilesCtx *ctx,
 
     g_object_unref (base);
 
-    ctx->finfos = g_list_reverse (ctx->finfos);
     return ret;
 }
 
@@ -508,12 +551,12 @@ step_process_multiple (FilesCtx *ctx,
     guint nfolders, nfiles;
     gchar *uris[2];
     gchar *uri;
-    GList *l;
+    guint i;
 
     g_assert (err && !*err);
 
-    for (l = ctx->finfos, nfolders = nfiles = 0; l; l = g_list_next (l)) {
-        FileInfo *finfo = (FileInfo*)l->data;
+    for (i = 0, nfolders = nfiles = 0; i < ctx->finfos->len; i++) {
+        FileInfo *finfo = g_ptr_array_index (ctx->finfos, i);
         if (g_file_info_get_file_type (finfo->info) == G_FILE_TYPE_DIRECTORY)
             ++nfolders;
         else
@@ -529,12 +572,7 @@ step_process_multiple (FilesCtx *ctx,
         ext = g_strdup (".zip"); /* Yes this happens when the schema isn't installed */
 
     /* Figure out a good URI for our package */
-    for (l = ctx->finfos; l; l = g_list_next (l)) {
-        if (l->data) {
-            pkg_info = (FileInfo*)(l->data);
-            break;
-        }
-    }
+    pkg_info = g_ptr_array_index (ctx->finfos, 0);
 
     /* This sets up but doesn't run the dialog */
     swidget = prepare_dialog (ctx, nfolders, nfiles, pkg_info->info, ext);
@@ -587,6 +625,13 @@ step_process_multiple (FilesCtx *ctx,
     if (!file)
 	    return FALSE;
 
+    /* A tar is made as it's encrypted, once the files are listed */
+    if (seahorse_tar_data_supports (package, &ctx->compression)) {
+        ctx->package = file;
+        g_free (package);
+        return TRUE;
+    }
+
     uri = g_file_get_uri (file);
     g_return_val_if_fail (uri, FALSE);
     g_object_unref (file);
@@ -597,9 +642,7 @@ step_process_multiple (FilesCtx *ctx,
     }
 
     /* Free all file info */
-    g_list_foreach (ctx->finfos, (GFunc)free_file_info, NULL);
-    g_list_free (ctx->finfos);
-    ctx->finfos = NULL;
+    g_ptr_array_set_size (ctx->finfos, 0);
 
     /* Reload up the new file, as what to encrypt */
     uris[0] = uri;
@@ -614,136 +657,436 @@ step_process_multiple (FilesCtx *ctx,
  * EXPAND STEP
  */
 
-static gboolean
-visit_enumerator (FilesCtx *ctx, GFile *parent, GFileEnumerator *enumerator, GError **err)
+/*
+ * Directories are listed from the main loop with GIO's async calls,
+ * several at once, and a large batch of entries at a time. For local
+ * files GIO does the listing in its worker threads. Found directories
+ * go on a queue for whichever listing finishes next to pick up.
+ */
+
+/* Directories listed at once, and entries asked for at a time */
+#define EXPAND_DIRS     8
+#define EXPAND_BATCH    1000
+
+/* How often to tell the progress window how far the listing got */
+#define EXPAND_UPDATE   (100 * 1000)    /* microseconds */
+
+typedef struct _ExpandCtx {
+    FilesCtx *ctx;
+    GPtrArray *files;               /* What was found, what to process */
+    GPtrArray *dirs;                /* Directories that aren't processed */
+    GQueue pending;                 /* Directories waiting to be listed */
+    guint running;                  /* Directories being listed */
+    GCancellable *cancellable;
+    GError *error;                  /* The first error, which stops it all */
+} ExpandCtx;
+
+/* A directory being listed */
+typedef struct _ExpandDir {
+    ExpandCtx *ectx;
+    FileInfo *finfo;
+    GFileEnumerator *enumerator;
+} ExpandDir;
+
+static FileInfo*
+new_file_info (FileInfo *parent, GFile *file, GFileInfo *info)
 {
-    GFileEnumerator *children;
-    gboolean ret = TRUE;
-    GFileInfo *info;
     FileInfo *finfo;
-    GFile *file;
 
-    for (;;) {
-	if (!seahorse_tool_progress_check ()) {
-            ret = FALSE;
-            break;
-	}
+    finfo = g_new0 (FileInfo, 1);
+    finfo->info = info;
+    finfo->file = file;
+    finfo->uri = g_file_get_uri (file);
+    finfo->name = g_build_filename (parent->name, g_file_info_get_name (info), NULL);
+    g_object_ref (info);
+    g_object_ref (file);
 
-	info = g_file_enumerator_next_file (enumerator, NULL, err);
-        if (!info) {
-            if (err && *err)
-                ret = FALSE;
-            break;
-        }
+    return finfo;
+}
 
-        file = g_file_resolve_relative_path (parent, g_file_info_get_name (info));
-        g_return_val_if_fail (file, FALSE);
+static void expand_next (ExpandCtx *ectx);
 
-        /* Enumerate child directories */
-        if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY) {
-                children = g_file_enumerate_children (file, FILE_ATTRIBUTES,
-                                                      G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
-                                                      NULL, err);
-                if (!enumerator) {
-                    ret = FALSE;
-                    break;
-                }
+/* Queues a directory to be listed */
+static void
+expand_add_dir (ExpandCtx *ectx, FileInfo *finfo)
+{
+    /* A package has the directories in it too */
+    g_ptr_array_add (ectx->ctx->package ? ectx->files : ectx->dirs, finfo);
+    g_queue_push_tail (&ectx->pending, finfo);
+}
 
-                ret = visit_enumerator (ctx, file, children, err);
-                if (!ret)
-                    break;
+static void
+expand_fail (ExpandCtx *ectx, GError *error)
+{
+    /* What fails after the first error is most likely cancelled */
+    if (ectx->error) {
+        g_error_free (error);
+        return;
+    }
 
-        /* A file, add it */
-        } else {
+    ectx->error = error;
+    g_cancellable_cancel (ectx->cancellable);
+}
 
-            finfo = g_new0 (FileInfo, 1);
-            finfo->info = info;
-            finfo->file = file;
-            finfo->uri = g_file_get_uri (file);
-            g_object_ref (info);
-            g_object_ref (file);
+static void
+expand_dir_done (ExpandDir *edir)
+{
+    ExpandCtx *ectx = edir->ectx;
 
-            ctx->total += g_file_info_get_size (info);
-            ctx->finfos = g_list_append (ctx->finfos, finfo);
-        }
+    if (edir->enumerator)
+        g_object_unref (edir->enumerator);
+    g_free (edir);
 
-        g_object_unref (file);
-        file = NULL;
+    ectx->running--;
+    expand_next (ectx);
+}
+
+static void
+next_files_ready (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    ExpandDir *edir = user_data;
+    ExpandCtx *ectx = edir->ectx;
+    GError *error = NULL;
+    GList *infos, *l;
+
+    infos = g_file_enumerator_next_files_finish (edir->enumerator, result, &error);
+
+    if (error) {
+        expand_fail (ectx, error);
+        expand_dir_done (edir);
+        return;
+    }
+
+    /* The end of the directory */
+    if (!infos) {
+        expand_dir_done (edir);
+        return;
     }
 
-    if (file != NULL)
+    for (l = infos; l; l = g_list_next (l)) {
+        GFileInfo *info = l->data;
+        FileInfo *finfo;
+        GFile *file;
+
+        file = g_file_get_child (edir->finfo->file, g_file_info_get_name (info));
+        finfo = new_file_info (edir->finfo, file, info);
         g_object_unref (file);
+        g_object_unref (info);
 
-    g_object_unref (enumerator);
-    return ret;
+        if (g_file_info_get_file_type (finfo->info) == G_FILE_TYPE_DIRECTORY) {
+            expand_add_dir (ectx, finfo);
+        } else {
+            ectx->ctx->total += g_file_info_get_size (finfo->info);
+            g_ptr_array_add (ectx->files, finfo);
+        }
+    }
+
+    g_list_free (infos);
+
+    /* Newly found directories start while this one goes on */
+    expand_next (ectx);
+
+    g_file_enumerator_next_files_async (edir->enumerator, EXPAND_BATCH, G_PRIORITY_DEFAULT,
+                                        ectx->cancellable, next_files_ready, edir);
+}
+
+static void
+enumerate_ready (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    ExpandDir *edir = user_data;
+    GError *error = NULL;
+
+    edir->enumerator = g_file_enumerate_children_finish (G_FILE (source), result, &error);
+
+    if (!edir->enumerator) {
+        expand_fail (edir->ectx, error);
+        expand_dir_done (edir);
+        return;
+    }
+
+    g_file_enumerator_next_files_async (edir->enumerator, EXPAND_BATCH, G_PRIORITY_DEFAULT,
+                                        edir->ectx->cancellable, next_files_ready, edir);
+}
+
+/* Starts listing as many of the pending directories as can go at once */
+static void
+expand_next (ExpandCtx *ectx)
+{
+    ExpandDir *edir;
+
+    while (!ectx->error && ectx->running < EXPAND_DIRS &&
+           !g_queue_is_empty (&ectx->pending)) {
+
+        edir = g_new0 (ExpandDir, 1);
+        edir->ectx = ectx;
+        edir->finfo = g_queue_pop_head (&ectx->pending);
+        ectx->running++;
+
+        g_file_enumerate_children_async (edir->finfo->file, FILE_ATTRIBUTES,
+                                         G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                         G_PRIORITY_DEFAULT, ectx->cancellable,
+                                         enumerate_ready, edir);
+    }
 }
 
 static gboolean
 step_expand_uris (FilesCtx *ctx,
                   GError **err)
 {
-    GFileEnumerator *enumerator;
-    gboolean ret = TRUE;
+    ExpandCtx ectx;
     FileInfo *finfo;
-    GList *l;
+    gboolean ret = TRUE;
+    gint64 next_update = 0;
+    gchar *msg;
+    guint i;
 
     g_assert (err && !*err);
 
-    for (l = ctx->finfos; l; l = g_list_next (l)) {
-
-        if (!seahorse_tool_progress_check ()) {
-            ret = FALSE;
-            break;
-        }
+    memset (&ectx, 0, sizeof (ectx));
+    ectx.ctx = ctx;
+    ectx.files = g_ptr_array_new_with_free_func ((GDestroyNotify)free_file_info);
+    ectx.dirs = g_ptr_array_new_with_free_func ((GDestroyNotify)free_file_info);
+    ectx.cancellable = g_cancellable_new ();
+    g_queue_init (&ectx.pending);
+
+    /* The files given move over as they are, and the directories are
+     * listed. We don't actually do operations on the dirs. */
+    for (i = 0; i < ctx->finfos->len; i++) {
+        finfo = g_ptr_array_index (ctx->finfos, i);
+        if (g_file_info_get_file_type (finfo->info) == G_FILE_TYPE_DIRECTORY)
+            expand_add_dir (&ectx, finfo);
+        else
+            g_ptr_array_add (ectx.files, finfo);
+    }
 
-        finfo = (FileInfo*)(l->data);
-        if (!finfo || !finfo->uri)
-            continue;
+    g_ptr_array_set_free_func (ctx->finfos, NULL);
+    g_ptr_array_unref (ctx->finfos);
+    ctx->finfos = ectx.files;
 
-        if (g_file_info_get_file_type (finfo->info) == G_FILE_TYPE_DIRECTORY) {
+    expand_next (&ectx);
 
-            enumerator = g_file_enumerate_children (finfo->file, FILE_ATTRIBUTES,
-                                                    G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
-                                                    NULL, err);
-            if (!enumerator)
-                return FALSE;
+    while (ectx.running > 0) {
+        g_main_context_iteration (NULL, TRUE);
 
-            if (!visit_enumerator (ctx, finfo->file, enumerator, err))
-                return FALSE;
+        if (g_get_monotonic_time () < next_update)
+            continue;
+        next_update = g_get_monotonic_time () + EXPAND_UPDATE;
 
-            /* We don't actually do operations on the dirs */
-            free_file_info (finfo, NULL);
-            l->data = NULL;
+        msg = g_strdup_printf (ngettext ("Found %u file", "Found %u files", ctx->finfos->len),
+                               ctx->finfos->len);
+        if (!seahorse_tool_progress_update (-1, msg) && !g_cancellable_is_cancelled (ectx.cancellable)) {
+            /* Let what is running finish being cancelled */
+            g_cancellable_cancel (ectx.cancellable);
+            ret = FALSE;
         }
+        g_free (msg);
+    }
+
+    if (ectx.error && ret) {
+        g_propagate_error (err, ectx.error);
+        ectx.error = NULL;
+        ret = FALSE;
     }
 
+    g_clear_error (&ectx.error);
+    g_queue_clear (&ectx.pending);
+    g_ptr_array_unref (ectx.dirs);
+    g_object_unref (ectx.cancellable);
+
     return ret;
 }
 
+/* -----------------------------------------------------------------------------
+ * PACKAGE CONTENTS STEP
+ */
+
+/* The listed files become what goes in the package, and the package
+ * is the one file to encrypt */
+static void
+step_package (FilesCtx *ctx)
+{
+    FileInfo *finfo;
+    gchar *name;
+
+    ctx->members = ctx->finfos;
+
+    finfo = g_new0 (FileInfo, 1);
+    finfo->file = g_object_ref (ctx->package);
+    finfo->uri = g_file_get_uri (ctx->package);
+    finfo->name = g_file_get_basename (ctx->package);
+
+    name = g_filename_display_basename (finfo->name);
+    finfo->info = g_file_info_new ();
+    g_file_info_set_display_name (finfo->info, name);
+    g_file_info_set_size (finfo->info, ctx->total);
+    g_free (name);
+
+    ctx->finfos = g_ptr_array_new_with_free_func ((GDestroyNotify)free_file_info);
+    g_ptr_array_add (ctx->finfos, finfo);
+}
+
 /* -----------------------------------------------------------------------------
  * ACTUAL OPERATION STEP
  */
 
 static void
-progress_cb (gpgme_data_t data, goffset pos, FilesCtx *ctx)
+progress_cb (gpgme_data_t data, goffset pos, FileJob *job)
 {
-    gdouble total, done, size, portion;
-    goffset fsize;
+    FilesCtx *ctx = job->ctx;
+    gdouble total, done;
+    guint64 running;
+    guint i;
 
-    g_assert (ctx && ctx->cur);
+    job->pos = pos;
+
+    /* Files that are done, plus how far along the others are */
+    running = 0;
+    for (i = 0; i < ctx->jobs->len; i++)
+        running += ((FileJob*)g_ptr_array_index (ctx->jobs, i))->pos;
 
     total = ctx->total > ONE_GIGABYTE ? ctx->total / 1000 : ctx->total;
-    done = ctx->total > ONE_GIGABYTE ? ctx->done / 1000 : ctx->done;
-    fsize = g_file_info_get_size (ctx->cur->info);
-    size = ctx->total > ONE_GIGABYTE ? fsize / 1000 : fsize;
-    portion = ctx->total > ONE_GIGABYTE ? pos / 1000 : pos;
+    done = ctx->total > ONE_GIGABYTE ? (ctx->done + running) / 1000 : (ctx->done + running);
 
     total = total <= 0 ? 1 : total;
-    size = size <= 0 ? 1 : size;
 
     /* The cancel check is done elsewhere */
-    seahorse_tool_progress_update ((done / total) + ((size / total) * (portion / size)),
-                                   seahorse_util_uri_get_last (g_file_info_get_display_name (ctx->cur->info)));
+    seahorse_tool_progress_update_files (MIN (done / total, 1.0),
+                                         seahorse_util_uri_get_last (g_file_info_get_display_name (job->finfo->info)),
+                                         ctx->done + running, ctx->files_done + 1, ctx->finfos->len);
+}
+
+/* Closes whichever output file the start callback attached to pop */
+static gboolean
+close_output (SeahorsePGPOperation *pop, GError **err)
+{
+    static const gchar *keys[] = { "cipher-data", "plain-data" };
+    gpgme_data_t output;
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (keys); i++) {
+        output = g_object_get_data (G_OBJECT (pop), keys[i]);
+        if (output && !seahorse_vfs_data_close (output, err))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void
+free_job (FileJob *job)
+{
+    if (job->pop) {
+        /* Cancelling reaches every file still going */
+        if (seahorse_operation_is_running (SEAHORSE_OPERATION (job->pop)))
+            seahorse_operation_cancel (SEAHORSE_OPERATION (job->pop));
+        g_object_unref (job->pop);
+    }
+    if (job->data)
+        gpgme_data_release (job->data);
+    g_free (job);
+}
+
+static gpgme_data_t
+create_package_data (FilesCtx *ctx, FileJob *job, GError **err)
+{
+    SeahorseTarMember *members;
+    gpgme_data_t data;
+    guint i;
+
+    members = g_new0 (SeahorseTarMember, ctx->members->len);
+
+    for (i = 0; i < ctx->members->len; i++) {
+        FileInfo *finfo = g_ptr_array_index (ctx->members, i);
+        members[i].file = finfo->file;
+        members[i].info = finfo->info;
+        members[i].name = finfo->name;
+    }
+
+    data = seahorse_tar_data_create (members, ctx->members->len, ctx->compression,
+                                     (SeahorseVfsProgressCb)progress_cb, job, err);
+    g_free (members);
+
+    return data;
+}
+
+static gboolean
+start_job (FilesCtx *ctx, SeahorseToolMode *mode, FileJob *job, GError **err)
+{
+    gchar *filename;
+    gboolean ret;
+
+    /* A new operation, and so a new gpgme context, for each file */
+    job->pop = seahorse_pgp_operation_new (NULL);
+
+    /* Not read until gpgme wants it, so a chunked file, which is read
+     * by the chunk workers, is only read once. It still takes progress. */
+    if (ctx->package)
+        job->data = create_package_data (ctx, job, err);
+    else
+        job->data = seahorse_vfs_data_create_full (job->finfo->file,
+                                                   SEAHORSE_VFS_READ | SEAHORSE_VFS_DELAY,
+                                                   (SeahorseVfsProgressCb)progress_cb,
+                                                   job, err);
+    if (!job->data)
+        return FALSE;
+
+    /* Inhibit popping up of progress dialog */
+    seahorse_tool_progress_block (TRUE);
+
+    /* Embed filename during encryption */
+    if (mode_encrypt)
+    {
+        filename = g_file_get_basename (job->finfo->file);
+        gpgme_data_set_file_name (job->data, filename);
+        g_free (filename);
+    }
+
+    /* The start callback */
+    ret = !mode->startcb || (mode->startcb) (mode, job->finfo->uri, job->data, job->pop, err);
+
+    /* Let progress dialog pop up */
+    seahorse_tool_progress_block (FALSE);
+
+    return ret;
+}
+
+static gboolean
+finish_job (FilesCtx *ctx, SeahorseToolMode *mode, FileJob *job, GError **err)
+{
+    SeahorseOperation *op = SEAHORSE_OPERATION (job->pop);
+
+    if (!seahorse_operation_is_successful (op)) {
+        seahorse_operation_copy_error (op, err);
+        return FALSE;
+    }
+
+    /* Output is written behind, so only now is it known to be on disk */
+    if (!close_output (job->pop, err))
+        return FALSE;
+
+    /* The done callback */
+    if (mode->donecb) {
+        if (!(mode->donecb) (mode, job->finfo->uri, job->data, job->pop, err))
+            return FALSE;
+    }
+
+    ctx->done += g_file_info_get_size (job->finfo->info);
+    ctx->files_done++;
+    return TRUE;
+}
+
+static gboolean
+any_job_done (FilesCtx *ctx)
+{
+    guint i;
+
+    for (i = 0; i < ctx->jobs->len; i++) {
+        FileJob *job = g_ptr_array_index (ctx->jobs, i);
+        if (!seahorse_operation_is_running (SEAHORSE_OPERATION (job->pop)))
+            return TRUE;
+    }
+
+    return FALSE;
 }
 
 static gboolean
@@ -751,95 +1094,74 @@ step_operation (FilesCtx *ctx,
                 SeahorseToolMode *mode,
                 GError **err)
 {
-    SeahorsePGPOperation *pop = NULL;
-    gpgme_data_t data = NULL;
+    FileJob *job;
+    guint max_jobs, next, i;
     gboolean ret = FALSE;
 
-    SeahorseOperation *op;
-    FileInfo *finfo;
-    GList *l;
-    gchar *filename;
+    /* Imports change the keyring, so they go one at a time */
+    max_jobs = mode_import ? 1 : CLAMP (g_get_num_processors (), 1, MAX_JOBS);
 
     /* Reset our done counter */
     ctx->done = 0;
+    ctx->files_done = 0;
+    ctx->jobs = g_ptr_array_new ();
+    next = 0;
 
-    for (l = ctx->finfos; l; l = g_list_next (l)) {
-
-        finfo = (FileInfo*)l->data;
-        if (!finfo || !finfo->file)
-            continue;
-
-        ctx->cur = finfo;
+    seahorse_passphrase_share (max_jobs > 1);
 
-        /* A new operation for each context */
-        pop = seahorse_pgp_operation_new (NULL);
-        op = SEAHORSE_OPERATION (pop);
-
-        data = seahorse_vfs_data_create_full (finfo->file, SEAHORSE_VFS_READ,
-                                              (SeahorseVfsProgressCb)progress_cb,
-                                              ctx, err);
-        if (!data)
-            goto finally;
+    for (;;) {
 
-        /* Inhibit popping up of progress dialog */
-        seahorse_tool_progress_block (TRUE);
+        /* Keep max_jobs files going */
+        while (ctx->jobs->len < max_jobs && next < ctx->finfos->len) {
+            FileInfo *finfo = g_ptr_array_index (ctx->finfos, next++);
 
-        /* Embed filename during encryption */
-        if (mode_encrypt)
-        {
-            filename = g_file_get_basename (finfo->file);
-            gpgme_data_set_file_name (data, filename);
-            g_free (filename);
-        }
+            job = g_new0 (FileJob, 1);
+            job->ctx = ctx;
+            job->finfo = finfo;
 
-        /* The start callback */
-        if (mode->startcb) {
-            if (!(mode->startcb) (mode, finfo->uri, data, pop, err))
+            if (!start_job (ctx, mode, job, err)) {
+                ctx->cur = finfo;
+                free_job (job);
                 goto finally;
+            }
+
+            g_ptr_array_add (ctx->jobs, job);
         }
 
-        /* Let progress dialog pop up */
-        seahorse_tool_progress_block (FALSE);
+        if (ctx->jobs->len == 0)
+            break;
 
-        /* Run until the operation completes */
-        seahorse_util_wait_until ((!seahorse_operation_is_running (op) ||
-                                   !seahorse_tool_progress_check ()));
+        /* Run until one of them completes */
+        seahorse_util_wait_until (any_job_done (ctx) || seahorse_tool_progress_cancelled ());
 
         /* If cancel then reflect that */
-        if (seahorse_operation_is_running (op)) {
-            seahorse_operation_cancel (op);
+        if (!any_job_done (ctx))
             goto finally;
-        }
 
-        if (!seahorse_operation_is_successful (op)) {
-            seahorse_operation_copy_error (op, err);
-            goto finally;
-        }
+        for (i = ctx->jobs->len; i > 0; i--) {
+            job = g_ptr_array_index (ctx->jobs, i - 1);
+            if (seahorse_operation_is_running (SEAHORSE_OPERATION (job->pop)))
+                continue;
 
-        /* The done callback */
-        if (mode->donecb) {
-            if (!(mode->donecb) (mode, finfo->uri, data, pop, err))
+            g_ptr_array_remove_index (ctx->jobs, i - 1);
+            if (!finish_job (ctx, mode, job, err)) {
+                ctx->cur = job->finfo;
+                free_job (job);
                 goto finally;
+            }
+            free_job (job);
         }
-
-        ctx->done += g_file_info_get_size (finfo->info);
-        ctx->cur = NULL;
-
-        g_object_unref (pop);
-        pop = NULL;
-
-        gpgme_data_release (data);
-        data = NULL;
     }
 
     seahorse_tool_progress_update (1.0, "");
     ret = TRUE;
 
 finally:
-    if (pop)
-        g_object_unref (pop);
-    if (data)
-        gpgme_data_release (data);
+    g_ptr_array_foreach (ctx->jobs, (GFunc)free_job, NULL);
+    g_ptr_array_free (ctx->jobs, TRUE);
+    ctx->jobs = NULL;
+
+    seahorse_passphrase_share (FALSE);
 
     return ret;
 }
@@ -857,6 +1179,7 @@ seahorse_tool_files_process (SeahorseToolMode *mode, const gchar **uris)
     int ret = 1;
 
     memset (&ctx, 0, sizeof (ctx));
+    ctx.finfos = g_ptr_array_new_with_free_func ((GDestroyNotify)free_file_info);
 
     /* Start progress bar */
     seahorse_tool_progress_start (mode->title);
@@ -896,11 +1219,23 @@ seahorse_tool_files_process (SeahorseToolMode *mode, const gchar **uris)
         goto finally;
     }
 
+    mode->batch = ctx.finfos->len > 1;
+
     if (!seahorse_tool_progress_update (0.0, NULL))
         goto finally;
 
     /*
-     * 3. Now execute enc operation on every file
+     * 3. Files going in a package are encrypted as one tar
+     */
+    if (ctx.package) {
+        step_package (&ctx);
+
+        /* The tar is only ever streamed, there's no file to chunk */
+        mode->chunked = FALSE;
+    }
+
+    /*
+     * 4. Now execute enc operation on every file
      */
     if (!step_operation (&ctx, mode, &err)) {
         errdesc = mode->errmsg;
@@ -919,10 +1254,13 @@ finally:
                                     g_file_info_get_display_name (ctx.cur->info) : "");
     }
 
-    if (ctx.finfos) {
-        g_list_foreach (ctx.finfos, (GFunc)free_file_info, NULL);
-        g_list_free (ctx.finfos);
-    }
+    g_ptr_array_unref (ctx.finfos);
+
+    if (ctx.members)
+        g_ptr_array_unref (ctx.members);
+
+    if (ctx.package)
+        g_object_unref (ctx.package);
 
     return ret;
 }
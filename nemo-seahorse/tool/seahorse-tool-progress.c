@@ -19,8 +19,15 @@
 #include "config.h"
 
 #include <sys/types.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <signal.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
 
 #include "seahorse-tool.h"
 #include "seahorse-util.h"
@@ -34,6 +41,27 @@
 #define CMD_PROGRESS "PROGRESS"
 #define STDOUT 1
 
+/* How often the progress window looks at the progress record */
+#define PROGRESS_POLL 100
+
+/*
+ * The progress record is a small file in the runtime directory that
+ * both processes map. An update is just a write to memory, however
+ * often it comes, and the progress window reads it at display rate.
+ * The sequence is odd while the record is being written; a reader
+ * that sees it change during a read tries again at the next poll.
+ * Commands, and updates if the record can't be made, are still
+ * written to the pipe.
+ */
+typedef struct _ProgressRecord {
+    gint sequence;
+    gdouble fract;
+    guint64 bytes;                  /* Bytes processed so far */
+    guint file_index;               /* The file being processed, from 1 */
+    guint n_files;
+    gchar message[256];
+} ProgressRecord;
+
 /* -----------------------------------------------------------------------------
  * RUNS IN PROGRESS PROCESS
  */
@@ -65,6 +93,71 @@ done_handler (SeahorseOperation *op, gpointer userdata)
     gtk_main_quit ();
 }
 
+/* The last record that was shown */
+static ProgressRecord progress_shown;
+
+static gboolean
+progress_poll (SeahorseOperation *op)
+{
+    ProgressRecord *record = g_object_get_data (G_OBJECT (op), "progress-record");
+    ProgressRecord current;
+    gchar *message, *size;
+    gint sequence;
+
+    sequence = g_atomic_int_get (&record->sequence);
+    if (sequence == progress_shown.sequence || (sequence & 1))
+        return TRUE;
+
+    memcpy (&current, record, sizeof (current));
+
+    /* The copy has to be done before the sequence is looked at again */
+    __atomic_thread_fence (__ATOMIC_ACQUIRE);
+    if (g_atomic_int_get (&record->sequence) != sequence)
+        return TRUE;
+
+    current.sequence = sequence;
+    current.message[sizeof (current.message) - 1] = 0;
+
+    if (current.n_files > 1 && current.file_index > 0) {
+        size = g_format_size (current.bytes);
+        /* TRANSLATORS: "name (file 3 of 10, 1.2 MB done)" */
+        message = g_strdup_printf (_("%s (file %u of %u, %s done)"), current.message,
+                                   MIN (current.file_index, current.n_files),
+                                   current.n_files, size);
+        g_free (size);
+    } else {
+        message = g_strdup (current.message);
+    }
+
+    seahorse_operation_mark_progress (op, message[0] ? message : NULL, current.fract);
+
+    g_free (message);
+    progress_shown = current;
+    return TRUE;
+}
+
+/* Maps the record the tool made, which goes as soon as it is mapped */
+static gboolean
+progress_map (SeahorseOperation *op, const gchar *path)
+{
+    ProgressRecord *record;
+    int fd;
+
+    fd = g_open (path, O_RDONLY, 0);
+    g_unlink (path);
+    if (fd < 0)
+        return FALSE;
+
+    record = mmap (NULL, sizeof (ProgressRecord), PROT_READ, MAP_SHARED, fd, 0);
+    close (fd);
+    if (record == MAP_FAILED)
+        return FALSE;
+
+    g_object_set_data (G_OBJECT (op), "progress-record", record);
+    g_timeout_add (PROGRESS_POLL, (GSourceFunc)progress_poll, op);
+    return TRUE;
+}
+
 static void
 process_line (SeahorseOperation *op, const gchar *line)
 {
@@ -169,6 +262,10 @@ progress_main (int argc, char* argv[])
 
     progress_visible = FALSE;
     progress_title = argc > 2 ? argv[2] : NULL;
+
+    if (argc > 3)
+        progress_map (op, argv[3]);
+
     g_timeout_add (PROGRESS_DELAY, (GSourceFunc)progress_show, op);
 
     gtk_main ();
@@ -195,6 +292,54 @@ static int progress_fd = -1;
 /* Whether child has cancelled or not */
 static gboolean cancelled = FALSE;
 
+/* The record the progress process reads, NULL to use the pipe */
+static ProgressRecord *progress_record = NULL;
+static gchar *progress_record_path = NULL;
+
+static void
+progress_record_create (void)
+{
+    int fd;
+
+    progress_record_path = g_build_filename (g_get_user_runtime_dir (),
+                                             "seahorse-progress-XXXXXX", NULL);
+    fd = g_mkstemp_full (progress_record_path, O_RDWR, 0600);
+    if (fd < 0)
+        goto failed;
+
+    if (ftruncate (fd, sizeof (ProgressRecord)) == 0)
+        progress_record = mmap (NULL, sizeof (ProgressRecord), PROT_READ | PROT_WRITE,
+                                MAP_SHARED, fd, 0);
+    close (fd);
+
+    if (progress_record != NULL && progress_record != MAP_FAILED)
+        return;
+
+    g_unlink (progress_record_path);
+    progress_record = NULL;
+
+failed:
+    g_warning ("couldn't make progress record, using the pipe");
+    g_free (progress_record_path);
+    progress_record_path = NULL;
+}
+
+static void
+progress_record_free (void)
+{
+    if (progress_record) {
+        munmap (progress_record, sizeof (ProgressRecord));
+        progress_record = NULL;
+    }
+
+    /* The progress process removes it when it starts */
+    if (progress_record_path) {
+        g_unlink (progress_record_path);
+        g_free (progress_record_path);
+        progress_record_path = NULL;
+    }
+}
+
 static void
 progress_cancel (GPid pid, gint status, gpointer data)
 {
@@ -207,12 +352,15 @@ seahorse_tool_progress_start (const gchar *title)
 {
     GError *err = NULL;
     gboolean ret;
-    gchar* argv[4];
+    gchar* argv[5];
+
+    progress_record_create ();
 
     argv[0] = (gchar *)progress_binary;
     argv[1] = PROGRESS_ARG;
     argv[2] = (gchar *)title;
-    argv[3] = NULL;
+    argv[3] = progress_record_path;
+    argv[4] = NULL;
 
     ret = g_spawn_async_with_pipes (NULL, argv, NULL, G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD,
                                     NULL, NULL, &progress_pid, &progress_fd, NULL, NULL, &err);
@@ -221,6 +369,7 @@ seahorse_tool_progress_start (const gchar *title)
         g_warning ("couldn't start progress process: %s", err ? err->message : "");
         progress_pid = -1;
         progress_fd = -1;
+        progress_record_free ();
         return;
     }
 
@@ -250,6 +399,12 @@ seahorse_tool_progress_check (void)
     return !cancelled;
 }
 
+gboolean
+seahorse_tool_progress_cancelled (void)
+{
+    return cancelled;
+}
+
 void
 seahorse_tool_progress_block (gboolean block)
 {
@@ -257,10 +412,46 @@ seahorse_tool_progress_block (gboolean block)
         seahorse_util_printf_fd (progress_fd, "%s \n", block ? CMD_BLOCK : CMD_UNBLOCK);
 }
 
-gboolean
-seahorse_tool_progress_update (gdouble fract, const gchar *message)
+/* A long message is cut short between characters */
+static void
+set_record_message (ProgressRecord *record, const gchar *message)
+{
+    gsize length = strlen (message);
+    const gchar *end;
+
+    /* The character the last byte that fits is part of is left out */
+    if (length >= sizeof (record->message)) {
+        end = g_utf8_find_prev_char (message, message + sizeof (record->message));
+        length = end ? end - message : 0;
+    }
+
+    memcpy (record->message, message, length);
+    record->message[length] = 0;
+}
+
+static gboolean
+progress_update (gdouble fract, const gchar *message, gboolean files,
+                 guint64 bytes, guint file_index, guint n_files)
 {
-    if (progress_fd != -1) {
+    ProgressRecord *record = progress_record;
+
+    if (record) {
+        g_atomic_int_inc (&record->sequence);
+
+        record->fract = fract;
+        if (files) {
+            record->bytes = bytes;
+            record->file_index = file_index;
+            record->n_files = n_files;
+        }
+
+        /* As with the pipe, no message leaves the last one up */
+        if (message && message[0])
+            set_record_message (record, message);
+
+        g_atomic_int_inc (&record->sequence);
+
+    } else if (progress_fd != -1) {
         if (!seahorse_util_printf_fd (progress_fd, "%s %0.2f %s\n", CMD_PROGRESS,
                                       fract, message ? message : "")) {
             cancelled = TRUE;
@@ -269,7 +460,21 @@ seahorse_tool_progress_update (gdouble fract, const gchar *message)
         }
     }
 
-    return seahorse_tool_progress_check ();
+    /* Events are processed by whoever waits on the operation */
+    return !cancelled;
+}
+
+gboolean
+seahorse_tool_progress_update (gdouble fract, const gchar *message)
+{
+    return progress_update (fract, message, FALSE, 0, 0, 0);
+}
+
+gboolean
+seahorse_tool_progress_update_files (gdouble fract, const gchar *message,
+                                     guint64 bytes, guint file_index, guint n_files)
+{
+    return progress_update (fract, message, TRUE, bytes, file_index, n_files);
 }
 
 void
@@ -280,5 +485,7 @@ seahorse_tool_progress_stop ()
         g_spawn_close_pid (progress_pid);
         progress_pid = -1;
     }
+
+    progress_record_free ();
 }
 
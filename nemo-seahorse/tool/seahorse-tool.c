@@ -19,6 +19,8 @@
 #include "config.h"
 
 #include <errno.h>
+#include <setjmp.h>
+#include <signal.h>
 #include <string.h>
 
 #include <glib.h>
@@ -30,6 +32,8 @@
 #include "cryptui.h"
 #include "cryptui-key-store.h"
 
+#include "seahorse-chunked.h"
+#include "seahorse-key-cache.h"
 #include "seahorse-tool.h"
 #include "seahorse-util.h"
 #include "seahorse-vfs-data.h"
@@ -141,6 +145,18 @@ init_crypt ()
     return TRUE;
 }
 
+/* The fingerprint from the key cache, or else the key id from libcryptui */
+static gchar*
+key_raw_keyid (CryptUIKeyset *keyset, const gchar *key)
+{
+    const SeahorseKeyInfo *info;
+
+    info = seahorse_key_cache_lookup (key);
+    if (info)
+        return g_strdup (info->fingerprint);
+    return cryptui_keyset_key_raw_keyid (keyset, key);
+}
+
 /* -----------------------------------------------------------------------------
  * ENCRYPT SIGN
  */
@@ -177,7 +193,7 @@ prompt_recipients (gpgme_key_t *signkey, gboolean *symmetric)
 
             if (signer) {
                 /* Load up the GPGME secret key */
-                gchar *id = cryptui_keyset_key_raw_keyid (keyset, signer);
+                gchar *id = key_raw_keyid (keyset, signer);
                 gerr = gpgme_get_key (ctx, id, signkey, 1);
                 g_free (id);
                 g_free (signer);
@@ -189,14 +205,16 @@ prompt_recipients (gpgme_key_t *signkey, gboolean *symmetric)
 
             if (gerr == 0 && !*symmetric) {
                 gchar **ids;
-                guint num;
+                guint num, i;
 
-                /* Load up the GPGME keys */
-                ids = cryptui_keyset_keys_raw_keyids (keyset, (const gchar**)recips);
-                num = g_strv_length (ids);
+                /* Load up the GPGME keys, all in one keylist */
+                num = g_strv_length (recips);
+                ids = g_new0 (gchar*, num + 1);
+                for (i = 0; i < num; i++)
+                    ids[i] = key_raw_keyid (keyset, recips[i]);
                 keys = g_array_new (TRUE, TRUE, sizeof (gpgme_key_t));
                 gerr = gpgme_op_keylist_ext_start (ctx, (const gchar**)ids, 0, 0);
-                g_free (ids);
+                g_strfreev (ids);
 
                 if (gerr == 0) {
                     while ((gerr = gpgme_op_keylist_next (ctx, &key)) == 0)
@@ -235,6 +253,61 @@ prompt_recipients (gpgme_key_t *signkey, gboolean *symmetric)
     return NULL;
 }
 
+/* The file is encrypted in chunks, and only the key for them goes to gpg */
+static gboolean
+encrypt_chunked_start (SeahorseToolMode *mode, const gchar *uri,
+                       SeahorsePGPOperation *pop, GError **err)
+{
+    SeahorseChunked *chunked;
+    gpgme_data_t keydata, wrapped;
+    gpgme_error_t gerr;
+    GFile *input, *output;
+    const guchar *key;
+    gsize n_key;
+    gchar *touri;
+
+    touri = seahorse_util_add_suffix (uri, SEAHORSE_CHUNKED_SUFFIX,
+                                      _("Choose Encrypted File Name for '%s'"));
+    if (!touri)
+        return FALSE;
+
+    input = g_file_new_for_uri (uri);
+    output = g_file_new_for_uri (touri);
+    chunked = seahorse_chunked_encrypt_new (input, output, err);
+    g_object_unref (input);
+    g_object_unref (output);
+    g_free (touri);
+    if (!chunked)
+        return FALSE;
+    g_object_set_data_full (G_OBJECT (pop), "chunked", chunked,
+                            (GDestroyNotify)seahorse_chunked_free);
+
+    key = seahorse_chunked_get_key (chunked, &n_key);
+    gerr = gpgme_data_new_from_mem (&keydata, (const gchar*)key, n_key, 0);
+    if (gerr == 0) {
+        g_object_set_data_full (G_OBJECT (pop), "chunked-key", keydata,
+                                (GDestroyNotify)gpgme_data_release);
+        gerr = gpgme_data_new (&wrapped);
+    }
+    if (gerr == 0) {
+        g_object_set_data_full (G_OBJECT (pop), "chunked-wrapped", wrapped,
+                                (GDestroyNotify)gpgme_data_release);
+
+        /* It's inside a binary container either way */
+        gpgme_set_armor (pop->gctx, FALSE);
+        gpgme_signers_clear (pop->gctx);
+        gerr = gpgme_op_encrypt_start (pop->gctx, mode->recipients,
+                                       GPGME_ENCRYPT_ALWAYS_TRUST, keydata, wrapped);
+    }
+
+    if (gerr != 0) {
+        seahorse_util_gpgme_to_error (gerr, err);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 static gboolean
 encrypt_sign_start (SeahorseToolMode *mode, const gchar *uri, gpgme_data_t uridata,
                     SeahorsePGPOperation *pop, GError **err)
@@ -245,6 +318,10 @@ encrypt_sign_start (SeahorseToolMode *mode, const gchar *uri, gpgme_data_t urida
 
     g_assert (mode->symmetric || (mode->recipients && mode->recipients[0]));
 
+    /* A signature would have to cover the whole file, so that's done by gpg */
+    if (mode->chunked && !mode->signer)
+        return encrypt_chunked_start (mode, uri, pop, err);
+
     /* File to encrypt to */
     touri = seahorse_util_add_suffix (uri, SEAHORSE_CRYPT_SUFFIX,
                                       _("Choose Encrypted File Name for '%s'"));
@@ -284,6 +361,28 @@ encrypt_sign_start (SeahorseToolMode *mode, const gchar *uri, gpgme_data_t urida
     return TRUE;
 }
 
+static gboolean
+encrypt_sign_done (SeahorseToolMode *mode, const gchar *uri, gpgme_data_t uridata,
+                   SeahorsePGPOperation *pop, GError **err)
+{
+    SeahorseChunked *chunked;
+    gpgme_data_t wrapped;
+    gboolean ret;
+    gchar *buf;
+    size_t len;
+
+    chunked = g_object_get_data (G_OBJECT (pop), "chunked");
+    if (!chunked)
+        return TRUE;
+
+    wrapped = g_object_steal_data (G_OBJECT (pop), "chunked-wrapped");
+    buf = gpgme_data_release_and_get_mem (wrapped, &len);
+    ret = seahorse_chunked_finish_encrypt (chunked, buf, len, uridata, err);
+    gpgme_free (buf);
+
+    return ret;
+}
+
 /* -----------------------------------------------------------------------------
  * SIGN
  */
@@ -291,8 +390,14 @@ encrypt_sign_start (SeahorseToolMode *mode, const gchar *uri, gpgme_data_t urida
 static gboolean
 signer_filter (CryptUIKeyset *ckset, const gchar *key, gpointer user_data)
 {
-    guint flags = cryptui_keyset_key_flags (ckset, key);
-    return flags & CRYPTUI_FLAG_CAN_SIGN;
+    const SeahorseKeyInfo *info;
+
+    /* Only keys gpg doesn't know about yet need asking about */
+    info = seahorse_key_cache_lookup (key);
+    if (info)
+        return seahorse_key_cache_usable (info, SEAHORSE_KEY_CAN_SIGN | SEAHORSE_KEY_SECRET);
+
+    return cryptui_keyset_key_flags (ckset, key) & CRYPTUI_FLAG_CAN_SIGN;
 }
 
 static gpgme_key_t
@@ -327,7 +432,7 @@ prompt_signer ()
 
     if (signer) {
 
-        id = cryptui_keyset_key_raw_keyid (keyset, signer);
+        id = key_raw_keyid (keyset, signer);
         g_free (signer);
 
         gpgme_check_version (NULL);
@@ -506,6 +611,49 @@ import_show (SeahorseToolMode *mode)
  * DECRYPT
  */
 
+/* gpg only decrypts the key, the chunks are decrypted when it's done */
+static gboolean
+decrypt_chunked_start (const gchar *uri, const gchar *touri,
+                       SeahorsePGPOperation *pop, GError **err)
+{
+    SeahorseChunked *chunked;
+    gpgme_data_t wrapped, keydata;
+    gpgme_error_t gerr;
+    GFile *input, *output;
+    const gchar *buf;
+    gsize len;
+
+    input = g_file_new_for_uri (uri);
+    output = g_file_new_for_uri (touri);
+    chunked = seahorse_chunked_decrypt_new (input, output, err);
+    g_object_unref (input);
+    g_object_unref (output);
+    if (!chunked)
+        return FALSE;
+    g_object_set_data_full (G_OBJECT (pop), "chunked", chunked,
+                            (GDestroyNotify)seahorse_chunked_free);
+
+    buf = seahorse_chunked_get_wrapped_key (chunked, &len);
+    gerr = gpgme_data_new_from_mem (&wrapped, buf, len, 0);
+    if (gerr == 0) {
+        g_object_set_data_full (G_OBJECT (pop), "chunked-wrapped", wrapped,
+                                (GDestroyNotify)gpgme_data_release);
+        gerr = gpgme_data_new (&keydata);
+    }
+    if (gerr == 0) {
+        g_object_set_data_full (G_OBJECT (pop), "chunked-key", keydata,
+                                (GDestroyNotify)gpgme_data_release);
+        gerr = gpgme_op_decrypt_start (pop->gctx, wrapped, keydata);
+    }
+
+    if (gerr != 0) {
+        seahorse_util_gpgme_to_error (gerr, err);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 static gboolean
 decrypt_start (SeahorseToolMode *mode, const gchar *uri, gpgme_data_t uridata,
                SeahorsePGPOperation *pop, GError **err)
@@ -513,12 +661,19 @@ decrypt_start (SeahorseToolMode *mode, const gchar *uri, gpgme_data_t uridata,
     gpgme_data_t plain;
     gpgme_error_t gerr;
     gchar *touri;
+    gboolean ret;
 
     /* File to decrypt to */
     touri = seahorse_util_remove_suffix (uri, _("Choose Decrypted File Name for '%s'"));
     if (!touri)
         return FALSE;
 
+    if (g_str_has_suffix (uri, SEAHORSE_EXT_CHUNKED)) {
+        ret = decrypt_chunked_start (uri, touri, pop, err);
+        g_free (touri);
+        return ret;
+    }
+
     /* Open necessary files, release these with the operation */
     plain = seahorse_vfs_data_create (touri, SEAHORSE_VFS_WRITE | SEAHORSE_VFS_DELAY, err);
     g_free (touri);
@@ -542,6 +697,22 @@ decrypt_done (SeahorseToolMode *mode, const gchar *uri, gpgme_data_t uridata,
               SeahorsePGPOperation *pop, GError **err)
 {
     gpgme_verify_result_t status;
+    SeahorseChunked *chunked;
+    gpgme_data_t keydata;
+    gboolean ret;
+    gchar *key;
+    size_t len;
+
+    chunked = g_object_get_data (G_OBJECT (pop), "chunked");
+    if (chunked) {
+        keydata = g_object_steal_data (G_OBJECT (pop), "chunked-key");
+        key = gpgme_data_release_and_get_mem (keydata, &len);
+        ret = seahorse_chunked_finish_decrypt (chunked, key, len, uridata, err);
+        if (key)
+            memset (key, 0, len);
+        gpgme_free (key);
+        return ret;
+    }
 
     status = gpgme_op_verify_result (pop->gctx);
     if (status && status->signatures)
@@ -554,6 +725,153 @@ decrypt_done (SeahorseToolMode *mode, const gchar *uri, gpgme_data_t uridata,
  * VERIFY
  */
 
+/* A local file mapped in, so gpg reads it straight from memory */
+typedef struct _MappedData {
+    GMappedFile *mapped;
+    const gchar *contents;
+    gsize length;
+    gsize position;
+} MappedData;
+
+/* Set by a thread only while it copies out of a map, as the worker
+ * threads of other files run alongside */
+static GPrivate mapped_jump;
+static struct sigaction old_sigbus;
+
+/* The file was cut short under the map */
+static void
+mapped_data_sigbus (int sig)
+{
+    sigjmp_buf *jump = g_private_get (&mapped_jump);
+
+    if (jump)
+        siglongjmp (*jump, 1);
+
+    /* Not a read of ours, so whatever was there before deals with it */
+    sigaction (SIGBUS, &old_sigbus, NULL);
+    raise (SIGBUS);
+}
+
+static ssize_t
+mapped_data_read (void *handle, void *buffer, size_t size)
+{
+    MappedData *md = handle;
+    sigjmp_buf jump;
+
+    size = MIN (size, md->length - md->position);
+    if (size == 0)
+        return 0;
+
+    if (sigsetjmp (jump, 1) != 0) {
+        g_private_set (&mapped_jump, NULL);
+        errno = EIO;
+        return -1;
+    }
+
+    g_private_set (&mapped_jump, &jump);
+    memcpy (buffer, md->contents + md->position, size);
+    g_private_set (&mapped_jump, NULL);
+
+    md->position += size;
+    return size;
+}
+
+static off_t
+mapped_data_seek (void *handle, off_t offset, int whence)
+{
+    MappedData *md = handle;
+    off_t position;
+
+    switch (whence) {
+    case SEEK_SET:
+        position = offset;
+        break;
+    case SEEK_CUR:
+        position = md->position + offset;
+        break;
+    case SEEK_END:
+        position = md->length + offset;
+        break;
+    default:
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (position < 0 || (gsize)position > md->length) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    md->position = position;
+    return position;
+}
+
+static void
+mapped_data_release (void *handle)
+{
+    MappedData *md = handle;
+
+    g_mapped_file_unref (md->mapped);
+    g_free (md);
+}
+
+static struct gpgme_data_cbs mapped_data_cbs = {
+    mapped_data_read,
+    NULL,
+    mapped_data_seek,
+    mapped_data_release
+};
+
+/* Maps a local file in, so gpg reads it without a thread in between.
+ * Reads are copied out under a SIGBUS handler, as the file can be
+ * truncated while gpg is reading it. */
+static gpgme_data_t
+create_mapped_data (const gchar *uri)
+{
+    static gboolean handler = FALSE;
+    struct sigaction sa;
+    GMappedFile *mapped;
+    gpgme_data_t data;
+    MappedData *md;
+    GFile *file;
+    gchar *path;
+
+    file = g_file_new_for_uri (uri);
+    path = g_file_get_path (file);
+    g_object_unref (file);
+    if (!path)
+        return NULL;
+
+    mapped = g_mapped_file_new (path, FALSE, NULL);
+    g_free (path);
+    if (!mapped)
+        return NULL;
+
+    if (!handler) {
+        memset (&sa, 0, sizeof (sa));
+        sa.sa_handler = mapped_data_sigbus;
+        sigemptyset (&sa.sa_mask);
+        sigaction (SIGBUS, &sa, &old_sigbus);
+        handler = TRUE;
+    }
+
+    md = g_new0 (MappedData, 1);
+    md->mapped = mapped;
+    md->length = g_mapped_file_get_length (mapped);
+
+    /* An empty file has no contents */
+    md->contents = g_mapped_file_get_contents (mapped);
+    if (!md->contents)
+        md->contents = "";
+
+    if (gpgme_data_new_from_cbs (&data, &mapped_data_cbs, md) != 0) {
+        mapped_data_release (md);
+        return NULL;
+    }
+
+    return data;
+}
+
 static gboolean
 verify_start (SeahorseToolMode *mode, const gchar *uri, gpgme_data_t uridata,
               SeahorsePGPOperation *pop, GError **err)
@@ -606,7 +924,9 @@ verify_start (SeahorseToolMode *mode, const gchar *uri, gpgme_data_t uridata,
     g_object_set_data_full (G_OBJECT (pop), "original-file", original, g_free);
 
     /* Open necessary files, release with operation */
-    plain = seahorse_vfs_data_create (original, SEAHORSE_VFS_READ, err);
+    plain = create_mapped_data (original);
+    if (!plain)
+        plain = seahorse_vfs_data_create (original, SEAHORSE_VFS_READ, err);
     if (!plain)
         return FALSE;
     g_object_set_data_full (G_OBJECT (pop), "plain-data", plain,
@@ -630,11 +950,22 @@ verify_done (SeahorseToolMode *mode, const gchar *uri, gpgme_data_t uridata,
     gpgme_verify_result_t status;
 
     status = gpgme_op_verify_result (pop->gctx);
+
+    orig = g_object_get_data (G_OBJECT (pop), "original-file");
+    if (!orig)
+        orig = uri;
+
+    /* Many files are summed up in one notification, rather than one
+     * for each, and a bad one doesn't stop the rest */
+    if (mode->batch) {
+        if (!mode->userdata)
+            mode->userdata = seahorse_verify_summary_new ();
+        seahorse_verify_summary_add (mode->userdata, orig, status);
+        return TRUE;
+    }
+
     if (status && status->signatures) {
 
-        orig = g_object_get_data (G_OBJECT (pop), "original-file");
-        if (!orig)
-            orig = uri;
         seahorse_notify_signatures (orig, status);
 
     } else {
@@ -713,7 +1044,9 @@ main (int argc, char **argv)
             mode.title = _("Encrypting");
             mode.errmsg = _("Couldn't encrypt file: %s");
             mode.startcb = encrypt_sign_start;
+            mode.donecb = encrypt_sign_done;
             mode.package = TRUE;
+            mode.chunked = g_settings_get_boolean (seahorse_tool_settings, "chunked-mode");
         }
 
     } else if (mode_sign) {
@@ -758,6 +1091,10 @@ main (int argc, char **argv)
             if (mode_import)
                 import_show (&mode);
         }
+
+        /* Whatever was verified, even if the rest failed */
+        if (mode_verify && mode.userdata)
+            seahorse_notify_verify_summary (mode.userdata);
     }
 
     /* TODO: This is temporary code. The actual display of these things should
@@ -774,6 +1111,7 @@ main (int argc, char **argv)
     seahorse_tool_settings = NULL;
 
     seahorse_notification_cleanup ();
+    seahorse_key_cache_cleanup ();
 
     g_strfreev (uris);
 
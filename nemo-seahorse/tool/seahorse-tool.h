@@ -45,10 +45,14 @@ typedef struct _SeahorseToolMode {
     gboolean symmetric;
     gpgme_key_t *recipients;
     gpgme_key_t signer;
+    gboolean chunked;       /* Into a container, see seahorse-chunked.h */
 
     /* Used for import */
     guint imports;
 
+    /* More than one file, once folders are listed */
+    gboolean batch;
+
     /* Callbacks for various functions */
     SeahorseToolCallback startcb;
     SeahorseToolCallback donecb;
@@ -68,10 +72,19 @@ void        seahorse_tool_progress_start   (const gchar *title);
 
 gboolean    seahorse_tool_progress_check   (void);
 
+/* Like seahorse_tool_progress_check() without running the main loop,
+ * for use in seahorse_util_wait_until() */
+gboolean    seahorse_tool_progress_cancelled (void);
+
 void        seahorse_tool_progress_block   (gboolean block);
 
 gboolean    seahorse_tool_progress_update  (gdouble fract, const gchar *message);
 
+/* Also says how far along the files are, for when there are many */
+gboolean    seahorse_tool_progress_update_files (gdouble fract, const gchar *message,
+                                                 guint64 bytes, guint file_index,
+                                                 guint n_files);
+
 void        seahorse_tool_progress_stop    (void);
 
 #endif /* __SEAHORSE_TOOL_H__ */
@@ -174,6 +174,61 @@ seahorse_util_gpgme_to_error (gpgme_error_t gerr, GError** err)
     }
 }
 
+/**
+ * seahorse_util_set_errno
+ * @error: A GIO error
+ *
+ * Sets errno from a GIO error, for returning from gpgme data callbacks.
+ **/
+void
+seahorse_util_set_errno (GError *error)
+{
+    gint code = -1;
+
+    if (error->domain == G_IO_ERROR)
+        code = error->code;
+
+    switch(code) {
+    #define GIO_TO_SYS_ERR(v, s)    \
+        case v: errno = s; break;
+    GIO_TO_SYS_ERR (G_IO_ERROR_FAILED, EIO);
+    GIO_TO_SYS_ERR (G_IO_ERROR_NOT_FOUND, ENOENT);
+    GIO_TO_SYS_ERR (G_IO_ERROR_EXISTS, EEXIST);
+    GIO_TO_SYS_ERR (G_IO_ERROR_IS_DIRECTORY, EISDIR);
+    GIO_TO_SYS_ERR (G_IO_ERROR_NOT_DIRECTORY, ENOTDIR);
+    GIO_TO_SYS_ERR (G_IO_ERROR_NOT_EMPTY, ENOTEMPTY);
+    GIO_TO_SYS_ERR (G_IO_ERROR_NOT_REGULAR_FILE, EINVAL);
+    GIO_TO_SYS_ERR (G_IO_ERROR_NOT_SYMBOLIC_LINK, EINVAL);
+    GIO_TO_SYS_ERR (G_IO_ERROR_NOT_MOUNTABLE_FILE, EINVAL);
+    GIO_TO_SYS_ERR (G_IO_ERROR_FILENAME_TOO_LONG, ENAMETOOLONG);
+    GIO_TO_SYS_ERR (G_IO_ERROR_INVALID_FILENAME, EINVAL);
+    GIO_TO_SYS_ERR (G_IO_ERROR_TOO_MANY_LINKS, EMLINK);
+    GIO_TO_SYS_ERR (G_IO_ERROR_NO_SPACE, ENOSPC);
+    GIO_TO_SYS_ERR (G_IO_ERROR_INVALID_ARGUMENT, EINVAL);
+    GIO_TO_SYS_ERR (G_IO_ERROR_PERMISSION_DENIED, EACCES);
+    GIO_TO_SYS_ERR (G_IO_ERROR_NOT_SUPPORTED, EOPNOTSUPP);
+    GIO_TO_SYS_ERR (G_IO_ERROR_NOT_MOUNTED, EIO);
+    GIO_TO_SYS_ERR (G_IO_ERROR_ALREADY_MOUNTED, EIO);
+    GIO_TO_SYS_ERR (G_IO_ERROR_CLOSED, EINVAL);
+    /* Cancelling looks like an error to our caller */
+    GIO_TO_SYS_ERR (G_IO_ERROR_CANCELLED, 0);
+    GIO_TO_SYS_ERR (G_IO_ERROR_PENDING, EAGAIN);
+    GIO_TO_SYS_ERR (G_IO_ERROR_READ_ONLY, EPERM);
+    GIO_TO_SYS_ERR (G_IO_ERROR_CANT_CREATE_BACKUP, EIO);
+    GIO_TO_SYS_ERR (G_IO_ERROR_WRONG_ETAG, EIO);
+    GIO_TO_SYS_ERR (G_IO_ERROR_TIMED_OUT, EIO);
+    GIO_TO_SYS_ERR (G_IO_ERROR_WOULD_RECURSE, EIO);
+    GIO_TO_SYS_ERR (G_IO_ERROR_BUSY, EBUSY);
+    GIO_TO_SYS_ERR (G_IO_ERROR_WOULD_BLOCK, EWOULDBLOCK);
+    GIO_TO_SYS_ERR (G_IO_ERROR_HOST_NOT_FOUND, ENOENT);
+    GIO_TO_SYS_ERR (G_IO_ERROR_WOULD_MERGE, EIO);
+    GIO_TO_SYS_ERR (G_IO_ERROR_FAILED_HANDLED, EIO);
+    default:
+        errno = EIO;
+        break;
+    };
+}
+
 /**
  * seahorse_util_get_display_date_string:
  * @time: Time value to parse
@@ -531,8 +586,9 @@ seahorse_util_chooser_save_prompt (GtkWidget *dialog)
  *
  * Constructs a new path for a file based on @path plus a suffix determined by
  * @suffix. If ASCII Armor is enabled, the suffix will be '.asc'. Otherwise the
- * suffix will be '.pgp' if @suffix is %SEAHORSE_CRYPT_SUFFIX or '.sig' if
- * @suffix is %SEAHORSE_SIG_SUFFIX.
+ * suffix will be '.pgp' if @suffix is %SEAHORSE_CRYPT_SUFFIX, '.pgpc' if
+ * @suffix is %SEAHORSE_CHUNKED_SUFFIX or '.sig' if @suffix is
+ * %SEAHORSE_SIG_SUFFIX.
  *
  * Returns: A new path with the suffix appended to @path. NULL if prompt cancelled
  **/
@@ -546,6 +602,8 @@ seahorse_util_add_suffix (const gchar *path, SeahorseSuffix suffix, const gchar
 
     if (suffix == SEAHORSE_CRYPT_SUFFIX)
         ext = SEAHORSE_EXT_PGP;
+    else if (suffix == SEAHORSE_CHUNKED_SUFFIX)
+        ext = SEAHORSE_EXT_CHUNKED;
     else
         ext = SEAHORSE_EXT_SIG;
 
@@ -574,7 +632,8 @@ seahorse_util_add_suffix (const gchar *path, SeahorseSuffix suffix, const gchar
  * @path: Path with a suffix
  * @prompt:Overwrite prompt text
  *
- * Removes a suffix from @path. Does not check if @path actually has a suffix.
+ * Removes a suffix from @path. Does not check if @path actually has a suffix,
+ * other than the five characters of %SEAHORSE_EXT_CHUNKED.
  *
  * Returns: @path without a suffix. NULL if prompt cancelled
  **/
@@ -586,7 +645,10 @@ seahorse_util_remove_suffix (const gchar *path, const gchar *prompt)
     gchar *t;
 
     g_return_val_if_fail (path != NULL, NULL);
-    uri =  g_strndup (path, strlen (path) - 4);
+    if (g_str_has_suffix (path, SEAHORSE_EXT_CHUNKED))
+        uri = g_strndup (path, strlen (path) - strlen (SEAHORSE_EXT_CHUNKED));
+    else
+        uri =  g_strndup (path, strlen (path) - 4);
 
     if (prompt && uri && seahorse_util_uri_exists (uri)) {
 
@@ -33,10 +33,12 @@
 typedef enum {
     SEAHORSE_CRYPT_SUFFIX,
     SEAHORSE_SIG_SUFFIX,
+    SEAHORSE_CHUNKED_SUFFIX,
 } SeahorseSuffix;
 
 #define SEAHORSE_EXT_SIG ".sig"
 #define SEAHORSE_EXT_PGP ".pgp"
+#define SEAHORSE_EXT_CHUNKED ".pgpc"
 
 gchar*		seahorse_util_get_display_date_string   (const time_t		time);
 
@@ -52,6 +54,8 @@ GQuark      seahorse_util_error_domain (void) G_GNUC_CONST;
 void        seahorse_util_gpgme_to_error        (gpgme_error_t gerr,
                                                  GError** err);
 
+void        seahorse_util_set_errno             (GError *error);
+
 void        seahorse_util_show_error            (GtkWindow          *parent,
                                                  const gchar        *heading,
                                                  const gchar        *message);
@@ -94,11 +98,12 @@ void         seahorse_util_free_keys          (gpgme_key_t* keys);
 
 gboolean    seahorse_util_string_equals       (const gchar *s1, const gchar *s2);
 
+/* Runs the main loop until expr is true. It sleeps while nothing is
+ * pending, so expr has to be changed from the main loop, and must not
+ * run the main loop itself: whatever it dispatched would be missed and
+ * the wait could sleep forever. */
 #define     seahorse_util_wait_until(expr)                \
-    while (!(expr)) {                                     \
-        while (g_main_context_pending(NULL) && !(expr))   \
-            g_main_context_iteration (NULL, FALSE);       \
-        g_thread_yield ();                                \
-    }
+    while (!(expr))                                       \
+        g_main_context_iteration (NULL, TRUE);
 
 #endif /* __SEAHORSE_UTIL_H__ */
@@ -23,8 +23,10 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <gio/gio.h>
+#include <gio/gfiledescriptorbased.h>
 #include <gtk/gtk.h>
 
 #include "seahorse-vfs-data.h"
@@ -33,46 +35,46 @@
 #include <gpgme.h>
 
 #define PROGRESS_BLOCK  16 * 1024
+#define RING_SIZE       (4 * WRITE_CHUNK)
+#define WRITE_CHUNK     (1024 * 1024)
+#define IO_BLOCK        (64 * 1024)
+#define WAIT_SLICE      (100 * 1000)    /* microseconds */
 
-/* The current/last VFS operation */
-typedef enum _VfsAsyncOp
-{
-    VFS_OP_NONE,
-    VFS_OP_OPENING,
-    VFS_OP_READING,
-    VFS_OP_WRITING,
-    VFS_OP_FLUSHING,
-    VFS_OP_SEEKING
-}
-VfsAsyncOp;
-
-/* The state of the VFS system */
-typedef enum _VfsAsyncState
-{
-    VFS_ASYNC_PROCESSING,
-    VFS_ASYNC_CANCELLED,
-    VFS_ASYNC_READY
-}
-VfsAsyncState;
-
-/* A handle for VFS work */
+/*
+ * Each handle has a thread of its own doing all the I/O with blocking
+ * GIO calls, so gpgme's callbacks never have to drive async operations
+ * from the main loop. A reader keeps the ring filled ahead of gpgme.
+ * A writer is written behind: gpgme's writes go into the ring, and the
+ * thread writes it out a whole WRITE_CHUNK at a time, so errors only
+ * show on a later write or in seahorse_vfs_data_close().
+ */
 typedef struct _VfsAsyncHandle {
 
     gpgme_data_t gdata;             /* A pointer to the outside gpgme_data_t handle */
 
     GFile *file;                    /* The file we're operating on */
-    GCancellable *cancellable;      /* For cancelling any concurrent operation */
+    GCancellable *cancellable;      /* For cancelling a blocked read on release */
     gboolean writer;                /* Whether a writer or a reader */
-    GInputStream *istream;          /* Stream for reading from */
-    GOutputStream *ostream;         /* Stream for writing to */
-
-    VfsAsyncOp    operation;        /* The last/current operation */
-    VfsAsyncState state;            /* State of the last/current operation */
-
-    GError *error;                  /* Result of the current operation */
-    gpointer buffer;                /* Current operation's buffer */
-    goffset processed;              /* Number of bytes processed in current op */
-
+    GThread *thread;                /* The I/O thread, once the file is opened */
+
+    GMutex lock;                    /* Protects everything from here on */
+    GCond cond;                     /* Signalled whenever any of it changes */
+
+    guchar *ring;                   /* Data read ahead, or waiting to be written */
+    gsize head;                     /* Where the data starts in the ring */
+    gsize fill;                     /* Number of bytes of data in the ring */
+
+    gboolean eof;                   /* The reader got to the end of the file */
+    gboolean seeking;               /* A seek is waiting for the thread */
+    goffset seek_offset;            /* Where to seek to */
+    GSeekType seek_type;            /* What seek_offset is relative to */
+    GError *seek_error;             /* Result of the seek */
+    gboolean closing;               /* The thread should close the file and exit */
+    gboolean sync;                  /* Get written data onto the disk when closing */
+    gboolean finished;              /* The thread has closed the file */
+    GError *error;                  /* The I/O error that stopped the thread */
+
+    goffset position;               /* The position in the file gpgme sees */
     goffset last;                   /* Last update sent about number of bytes */
     goffset total;                  /* Total number of bytes read or written */
 
@@ -80,132 +82,212 @@ typedef struct _VfsAsyncHandle {
     gpointer userdata;              /* User data for progress callback */
 } VfsAsyncHandle;
 
-static void vfs_data_cancel(VfsAsyncHandle *ah);
+/* gpgme_data_t to VfsAsyncHandle, for seahorse_vfs_data_close() */
+static GHashTable *vfs_handles = NULL;
 
-/* Waits for a given VFS operation to complete without halting the UI */
-static gboolean
-vfs_data_wait_results(VfsAsyncHandle* ah, gboolean errors)
+/* Called with the lock held to wait for the I/O thread. Nothing spins:
+ * this sleeps until the thread signals, and only if the file is slow,
+ * as on a network mount, does it run what's pending in the main loop
+ * so the UI keeps up. */
+static void
+vfs_data_wait (VfsAsyncHandle *ah)
 {
-    VfsAsyncOp op;
-    gint code;
-
-    seahorse_util_wait_until (ah->state != VFS_ASYNC_PROCESSING);
-
-    op = ah->operation;
-    ah->operation = VFS_OP_NONE;
+    gint64 end_time = g_get_monotonic_time () + WAIT_SLICE;
 
-    /* Cancelling looks like an error to our caller */
-    if (ah->state == VFS_ASYNC_CANCELLED) {
-        errno = 0;
-        return FALSE;
+    if (!g_cond_wait_until (&ah->cond, &ah->lock, end_time)) {
+        g_mutex_unlock (&ah->lock);
+        while (g_main_context_pending (NULL))
+            g_main_context_iteration (NULL, FALSE);
+        g_mutex_lock (&ah->lock);
     }
+}
 
-    g_assert (ah->state == VFS_ASYNC_READY);
+/* Called with the lock held to seek the stream */
+static void
+vfs_data_thread_seek (VfsAsyncHandle *ah, GSeekable *seekable)
+{
+    goffset offset = ah->seek_offset;
+    GSeekType type = ah->seek_type;
+    GError *error = NULL;
 
-    /* There was no operation going on, result codes are not relevant */
-    if (op == VFS_OP_NONE)
-        return TRUE;
+    g_mutex_unlock (&ah->lock);
 
-    /* No error result */
-    if (!ah->error) {
-	    return TRUE;
+    if (!seekable || !g_seekable_can_seek (seekable)) {
+        g_set_error_literal (&error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                             "Seeking is not supported");
+    } else if (g_seekable_seek (seekable, offset, type, ah->cancellable, &error)) {
+        offset = g_seekable_tell (seekable);
     }
 
-    code = -1;
-    if (ah->error->domain == G_IO_ERROR)
-        code = ah->error->code;
+    g_mutex_lock (&ah->lock);
 
-    if (code == G_IO_ERROR_CANCELLED) {
-        vfs_data_cancel (ah);
-        errno = 0;
-        return FALSE;
+    if (!error) {
+        /* Whatever was read ahead is from the old position */
+        ah->head = 0;
+        ah->fill = 0;
+        ah->eof = FALSE;
+        ah->position = offset;
     }
 
-    /* Check for error codes */
-    if(errors) {
-        switch(code) {
-        #define GIO_TO_SYS_ERR(v, s)    \
-            case v: errno = s; break;
-        GIO_TO_SYS_ERR (G_IO_ERROR_FAILED, EIO);
-        GIO_TO_SYS_ERR (G_IO_ERROR_NOT_FOUND, ENOENT);
-        GIO_TO_SYS_ERR (G_IO_ERROR_EXISTS, EEXIST);
-        GIO_TO_SYS_ERR (G_IO_ERROR_IS_DIRECTORY, EISDIR);
-        GIO_TO_SYS_ERR (G_IO_ERROR_NOT_DIRECTORY, ENOTDIR);
-        GIO_TO_SYS_ERR (G_IO_ERROR_NOT_EMPTY, ENOTEMPTY);
-        GIO_TO_SYS_ERR (G_IO_ERROR_NOT_REGULAR_FILE, EINVAL);
-        GIO_TO_SYS_ERR (G_IO_ERROR_NOT_SYMBOLIC_LINK, EINVAL);
-        GIO_TO_SYS_ERR (G_IO_ERROR_NOT_MOUNTABLE_FILE, EINVAL);
-        GIO_TO_SYS_ERR (G_IO_ERROR_FILENAME_TOO_LONG, ENAMETOOLONG);
-        GIO_TO_SYS_ERR (G_IO_ERROR_INVALID_FILENAME, EINVAL);
-        GIO_TO_SYS_ERR (G_IO_ERROR_TOO_MANY_LINKS, EMLINK);
-        GIO_TO_SYS_ERR (G_IO_ERROR_NO_SPACE, ENOSPC);
-        GIO_TO_SYS_ERR (G_IO_ERROR_INVALID_ARGUMENT, EINVAL);
-        GIO_TO_SYS_ERR (G_IO_ERROR_PERMISSION_DENIED, EACCES);
-        GIO_TO_SYS_ERR (G_IO_ERROR_NOT_SUPPORTED, EOPNOTSUPP);
-        GIO_TO_SYS_ERR (G_IO_ERROR_NOT_MOUNTED, EIO);
-        GIO_TO_SYS_ERR (G_IO_ERROR_ALREADY_MOUNTED, EIO);
-        GIO_TO_SYS_ERR (G_IO_ERROR_CLOSED, EINVAL);
-        GIO_TO_SYS_ERR (G_IO_ERROR_CANCELLED, EIO);
-        GIO_TO_SYS_ERR (G_IO_ERROR_PENDING, EAGAIN);
-        GIO_TO_SYS_ERR (G_IO_ERROR_READ_ONLY, EPERM);
-        GIO_TO_SYS_ERR (G_IO_ERROR_CANT_CREATE_BACKUP, EIO);
-        GIO_TO_SYS_ERR (G_IO_ERROR_WRONG_ETAG, EIO);
-        GIO_TO_SYS_ERR (G_IO_ERROR_TIMED_OUT, EIO);
-        GIO_TO_SYS_ERR (G_IO_ERROR_WOULD_RECURSE, EIO);
-        GIO_TO_SYS_ERR (G_IO_ERROR_BUSY, EBUSY);
-        GIO_TO_SYS_ERR (G_IO_ERROR_WOULD_BLOCK, EWOULDBLOCK);
-        GIO_TO_SYS_ERR (G_IO_ERROR_HOST_NOT_FOUND, ENOENT);
-        GIO_TO_SYS_ERR (G_IO_ERROR_WOULD_MERGE, EIO);
-        GIO_TO_SYS_ERR (G_IO_ERROR_FAILED_HANDLED, EIO);
-        default:
-            errno = EIO;
-            break;
-        };
-    }
-
-    /* When errors on open we look cancelled */
-    if(op == VFS_OP_OPENING)
-        ah->state = VFS_ASYNC_CANCELLED;
+    ah->seek_error = error;
+    ah->seeking = FALSE;
+}
 
-    return FALSE;
+/* Called with the lock held to read more into the ring */
+static void
+vfs_data_thread_read (VfsAsyncHandle *ah, GInputStream *istream)
+{
+    gsize start, length;
+    gssize done;
+    GError *error = NULL;
+
+    /* Reads go into the free space up to the end of the ring, and
+     * nothing else touches that until fill says it's there */
+    start = (ah->head + ah->fill) % RING_SIZE;
+    length = MIN (RING_SIZE - start, RING_SIZE - ah->fill);
+    length = MIN (length, IO_BLOCK);
+
+    g_mutex_unlock (&ah->lock);
+    done = g_input_stream_read (istream, ah->ring + start, length, ah->cancellable, &error);
+    g_mutex_lock (&ah->lock);
+
+    if (done < 0)
+        ah->error = error;
+    else if (done == 0)
+        ah->eof = TRUE;
+    else
+        ah->fill += done;
 }
 
-/* Called when a file open completes */
+/* Called with the lock held to write out what is in the ring */
 static void
-vfs_data_open_done (GObject *source, GAsyncResult *res, gpointer callback_data)
+vfs_data_thread_write (VfsAsyncHandle *ah, GOutputStream *ostream)
 {
-    VfsAsyncHandle* ah = (VfsAsyncHandle*)callback_data;
+    gsize length;
+    gboolean ok;
+    GError *error = NULL;
+
+    /* The ring is a whole number of chunks, so apart from the end of
+     * the file, writes are of a whole chunk at a chunk boundary */
+    length = MIN (ah->fill, RING_SIZE - ah->head);
+    length = MIN (length, WRITE_CHUNK);
+
+    g_mutex_unlock (&ah->lock);
+    ok = g_output_stream_write_all (ostream, ah->ring + ah->head, length, NULL, ah->cancellable, &error);
+    g_mutex_lock (&ah->lock);
+
+    if (!ok) {
+        ah->error = error;
+    } else {
+        ah->head = (ah->head + length) % RING_SIZE;
+        ah->fill -= length;
+    }
+}
 
-    if(ah->state == VFS_ASYNC_PROCESSING) {
-        g_assert (ah->operation == VFS_OP_OPENING);
-	g_clear_error (&ah->error);
+/* Gets what was written to a local file onto the disk */
+static gboolean
+vfs_data_fsync (GOutputStream *ostream, GError **error)
+{
+    int fd;
 
-        if (ah->writer)
-            ah->ostream = G_OUTPUT_STREAM (g_file_replace_finish (ah->file, res, &ah->error));
-        else
-            ah->istream = G_INPUT_STREAM (g_file_read_finish (ah->file, res, &ah->error));
+    /* Remote files are as safe as their backend makes them on close */
+    if (!G_IS_FILE_DESCRIPTOR_BASED (ostream))
+        return TRUE;
 
-        ah->state = VFS_ASYNC_READY;
-        ah->total = 0;
-        ah->last = 0;
+    fd = g_file_descriptor_based_get_fd (G_FILE_DESCRIPTOR_BASED (ostream));
+    if (fsync (fd) != 0) {
+        int saved_errno = errno;
+        g_set_error_literal (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                             g_strerror (saved_errno));
+        return FALSE;
     }
+
+    return TRUE;
 }
 
-/* Open the given handle */
-static void
-vfs_data_open_helper (VfsAsyncHandle *ah)
+static gpointer
+vfs_data_thread (gpointer data)
 {
-    g_assert (ah->file != NULL);
-    g_assert (ah->state == VFS_ASYNC_READY);
-
-    ah->state = VFS_ASYNC_PROCESSING;
-    ah->operation = VFS_OP_OPENING;
+    VfsAsyncHandle *ah = (VfsAsyncHandle*)data;
+    GInputStream *istream = NULL;
+    GOutputStream *ostream = NULL;
+    GError *error = NULL;
+    gboolean sync;
 
     /* Note that we always overwrite the file */
     if (ah->writer)
-        g_file_replace_async (ah->file, NULL, FALSE, G_FILE_CREATE_NONE, G_PRIORITY_DEFAULT, ah->cancellable, vfs_data_open_done, ah);
+        ostream = G_OUTPUT_STREAM (g_file_replace (ah->file, NULL, FALSE, G_FILE_CREATE_NONE,
+                                                   ah->cancellable, &error));
     else
-        g_file_read_async (ah->file, G_PRIORITY_DEFAULT, ah->cancellable, vfs_data_open_done, ah);
+        istream = G_INPUT_STREAM (g_file_read (ah->file, ah->cancellable, &error));
+
+    g_mutex_lock (&ah->lock);
+    ah->error = error;
+    error = NULL;
+
+    /* A writer gets the rest of the ring out before closing */
+    while (!ah->closing || (ah->writer && ah->fill > 0 && !ah->error)) {
+
+        /* After an error only closing is left */
+        if (ah->error)
+            g_cond_wait (&ah->cond, &ah->lock);
+
+        else if (ah->seeking && !(ah->writer && ah->fill > 0))
+            vfs_data_thread_seek (ah, ah->writer ? (G_IS_SEEKABLE (ostream) ? G_SEEKABLE (ostream) : NULL)
+                                                 : (G_IS_SEEKABLE (istream) ? G_SEEKABLE (istream) : NULL));
+
+        else if (!ah->writer && !ah->eof && ah->fill < RING_SIZE && !ah->seeking)
+            vfs_data_thread_read (ah, istream);
+
+        else if (ah->writer && (ah->fill >= WRITE_CHUNK ||
+                                (ah->fill > 0 && (ah->seeking || ah->closing))))
+            vfs_data_thread_write (ah, ostream);
+
+        else
+            g_cond_wait (&ah->cond, &ah->lock);
+
+        g_cond_broadcast (&ah->cond);
+    }
+
+    sync = ah->sync && !ah->error;
+    g_mutex_unlock (&ah->lock);
+
+    /*
+     * GPGME doesn't have a way to return errors from close, so they are
+     * kept for seahorse_vfs_data_close(), which also asks for the sync.
+     */
+    if (ostream) {
+        if (sync && g_output_stream_flush (ostream, NULL, &error))
+            vfs_data_fsync (ostream, &error);
+        g_output_stream_close (ostream, NULL, error ? NULL : &error);
+        g_object_unref (ostream);
+    }
+    if (istream) {
+        g_input_stream_close (istream, NULL, NULL);
+        g_object_unref (istream);
+    }
+
+    g_mutex_lock (&ah->lock);
+    if (!ah->error)
+        ah->error = error;
+    else
+        g_clear_error (&error);
+    ah->finished = TRUE;
+    g_cond_broadcast (&ah->cond);
+    g_mutex_unlock (&ah->lock);
+
+    return NULL;
+}
+
+/* Open the file, if that hasn't been done yet */
+static void
+vfs_data_start (VfsAsyncHandle *ah)
+{
+    if (ah->thread)
+        return;
+
+    ah->ring = g_malloc (RING_SIZE);
+    ah->thread = g_thread_new ("vfs-data", vfs_data_thread, ah);
 }
 
 /* Open the given URI */
@@ -214,41 +296,29 @@ vfs_data_open (GFile *file, gboolean write, gboolean delayed)
 {
     VfsAsyncHandle* ah;
 
-    /* We only support delayed opening of write files */
-    g_assert (write || !delayed);
-
     ah = g_new0 (VfsAsyncHandle, 1);
     ah->cancellable = g_cancellable_new ();
-    ah->state = VFS_ASYNC_READY;
-    ah->operation = VFS_OP_NONE;
     ah->file = file;
     ah->writer = write;
+    g_mutex_init (&ah->lock);
+    g_cond_init (&ah->cond);
     g_object_ref (file);
 
     /* Open the file right here and now if requested */
     if (!delayed)
-        vfs_data_open_helper (ah);
+        vfs_data_start (ah);
 
     return ah;
 }
 
-/* Called when a read completes */
+/* Called without the lock, on the main thread */
 static void
-vfs_data_read_done (GObject *source, GAsyncResult *res, gpointer callback_data)
+vfs_data_progress (VfsAsyncHandle *ah, goffset total)
 {
-    VfsAsyncHandle* ah = (VfsAsyncHandle*)callback_data;
-
-    if (ah->state == VFS_ASYNC_PROCESSING) {
-        g_assert (ah->operation == VFS_OP_READING);
-	g_clear_error (&ah->error);
-
-        ah->processed = g_input_stream_read_finish (ah->istream, res, &ah->error);
-        ah->state = VFS_ASYNC_READY;
-        ah->total += ah->processed;
-
-        /* Call progress callback if setup */
-        if (ah->progcb && ah->total >= ah->last + PROGRESS_BLOCK)
-            (ah->progcb) (ah->gdata, ah->total, ah->userdata);
+    /* Call progress callback if setup */
+    if (ah->progcb && total >= ah->last + PROGRESS_BLOCK) {
+        ah->last = total;
+        (ah->progcb) (ah->gdata, total, ah->userdata);
     }
 }
 
@@ -257,67 +327,38 @@ static ssize_t
 vfs_data_read (void *handle, void *buffer, size_t size)
 {
     VfsAsyncHandle* ah = (VfsAsyncHandle*)handle;
-    ssize_t sz = 0;
+    goffset total;
+    ssize_t sz;
 
-    /* Just in case we have an operation, like open */
-    if (!vfs_data_wait_results(ah, TRUE))
-        return -1;
+    /* If the file isn't open yet, then do that now */
+    vfs_data_start (ah);
 
-    g_assert (ah->state == VFS_ASYNC_READY);
+    g_mutex_lock (&ah->lock);
 
-    /* Start async operation */
-    ah->buffer = buffer;
-    ah->state = VFS_ASYNC_PROCESSING;
-    ah->operation = VFS_OP_READING;
-    g_input_stream_read_async (ah->istream, buffer, size, G_PRIORITY_DEFAULT, ah->cancellable, vfs_data_read_done, ah);
+    while (ah->fill == 0 && !ah->eof && !ah->error)
+        vfs_data_wait (ah);
 
-    /* Wait for it */
-    if (!vfs_data_wait_results (ah, TRUE))
+    /* What was read before an error still counts */
+    if (ah->fill == 0 && ah->error) {
+        seahorse_util_set_errno (ah->error);
+        g_mutex_unlock (&ah->lock);
         return -1;
-
-    /* Return results */
-    sz = (ssize_t)ah->processed;
-    ah->state = VFS_ASYNC_READY;
-
-    ah->buffer = NULL;
-    ah->processed = 0;
-
-    return sz;
-}
-
-/* Called when a write completes */
-static void
-vfs_data_write_done (GObject *source, GAsyncResult *res, gpointer callback_data)
-{
-    VfsAsyncHandle* ah = (VfsAsyncHandle*)callback_data;
-
-    if(ah->state == VFS_ASYNC_PROCESSING) {
-        g_assert (ah->operation == VFS_OP_WRITING);
-	g_clear_error (&ah->error);
-
-        ah->processed = g_output_stream_write_finish (ah->ostream, res, &ah->error);
-        ah->state = VFS_ASYNC_READY;
-        ah->total += ah->processed;
-
-        /* Call progress callback if setup */
-        if (ah->progcb && ah->total >= ah->last + PROGRESS_BLOCK)
-            (ah->progcb) (ah->gdata, ah->total, ah->userdata);
     }
-}
 
-/* Called when a flush completes */
-static void
-vfs_data_flush_done (GObject *source, GAsyncResult *res, gpointer callback_data)
-{
-    VfsAsyncHandle* ah = (VfsAsyncHandle*)callback_data;
+    sz = MIN (size, MIN (ah->fill, RING_SIZE - ah->head));
+    memcpy (buffer, ah->ring + ah->head, sz);
+    ah->head = (ah->head + sz) % RING_SIZE;
+    ah->fill -= sz;
+    ah->position += sz;
+    ah->total += sz;
+    total = ah->total;
 
-    if(ah->state == VFS_ASYNC_PROCESSING) {
-        g_assert (ah->operation == VFS_OP_FLUSHING);
-	g_clear_error (&ah->error);
+    g_cond_broadcast (&ah->cond);
+    g_mutex_unlock (&ah->lock);
 
-        g_output_stream_flush_finish (ah->ostream, res, &ah->error);
-        ah->state = VFS_ASYNC_READY;
-    }
+    vfs_data_progress (ah, total);
+
+    return sz;
 }
 
 /* Called by gpgme to write data */
@@ -325,44 +366,48 @@ static ssize_t
 vfs_data_write (void *handle, const void *buffer, size_t size)
 {
     VfsAsyncHandle* ah = (VfsAsyncHandle*)handle;
-    ssize_t sz = 0;
+    gsize written = 0;
+    goffset total;
 
     /* If the file isn't open yet, then do that now */
-    if (!ah->ostream && ah->state == VFS_ASYNC_READY)
-        vfs_data_open_helper (ah);
+    vfs_data_start (ah);
 
-    /* Just in case we have an operation, like open */
-    if (!vfs_data_wait_results(ah, TRUE))
-        return -1;
+    g_mutex_lock (&ah->lock);
 
-    g_assert (ah->state == VFS_ASYNC_READY);
+    while (written < size && !ah->error) {
+        gsize start, length;
 
-    /* Start async operation */
-    ah->buffer = (gpointer)buffer;
-    ah->state = VFS_ASYNC_PROCESSING;
-    ah->operation = VFS_OP_WRITING;
-    g_output_stream_write_async (ah->ostream, buffer, size, G_PRIORITY_DEFAULT, ah->cancellable, vfs_data_write_done, ah);
+        while (ah->fill == RING_SIZE && !ah->error)
+            vfs_data_wait (ah);
+        if (ah->error)
+            break;
 
-    /* Wait for it */
-    if (!vfs_data_wait_results(ah, TRUE))
-        return -1;
+        start = (ah->head + ah->fill) % RING_SIZE;
+        length = MIN (RING_SIZE - start, RING_SIZE - ah->fill);
+        length = MIN (length, size - written);
 
-    /* Return results */
-    sz = (ssize_t)ah->processed;
+        memcpy (ah->ring + start, (const guchar*)buffer + written, length);
+        ah->fill += length;
+        written += length;
+        g_cond_broadcast (&ah->cond);
+    }
 
-    ah->buffer = NULL;
-    ah->processed = 0;
+    /* An error may also be from writing out an earlier chunk */
+    if (ah->error) {
+        seahorse_util_set_errno (ah->error);
+        g_mutex_unlock (&ah->lock);
+        return -1;
+    }
 
-    /* Sadly GPGME doesn't support errors on close, so we have to flush after each write */
-    ah->state = VFS_ASYNC_PROCESSING;
-    ah->operation = VFS_OP_FLUSHING;
-    g_output_stream_flush_async (ah->ostream, G_PRIORITY_DEFAULT, ah->cancellable, vfs_data_flush_done, ah);
+    ah->position += size;
+    ah->total += size;
+    total = ah->total;
 
-    /* Wait for it */
-    if (!vfs_data_wait_results(ah, TRUE))
-        return -1;
+    g_mutex_unlock (&ah->lock);
 
-    return sz;
+    vfs_data_progress (ah, total);
+
+    return size;
 }
 
 /* Called from gpgme to seek a file */
@@ -370,97 +415,50 @@ static off_t
 vfs_data_seek (void *handle, off_t offset, int whence)
 {
     VfsAsyncHandle* ah = (VfsAsyncHandle*)handle;
-    GSeekable *seekable = NULL;
-    GSeekType wh;
+    off_t position;
 
     /* If the file isn't open yet, then do that now */
-    if (!ah->ostream && !ah->istream && ah->state == VFS_ASYNC_READY)
-        vfs_data_open_helper (ah);
-
-    /* Just in case we have an operation, like open */
-    if (!vfs_data_wait_results(ah, TRUE))
-        return (off_t)-1;
-
-    g_assert (ah->state == VFS_ASYNC_READY);
+    vfs_data_start (ah);
 
-    if (ah->writer && G_IS_SEEKABLE (ah->ostream))
-        seekable = G_SEEKABLE (ah->ostream);
-    else
-        seekable = G_SEEKABLE (ah->istream);
-
-    if (!seekable || !g_seekable_can_seek (seekable)) {
-        errno = ENOTSUP;
-        return -1;
-    }
+    g_mutex_lock (&ah->lock);
 
+    /* The stream is ahead of gpgme by what was read into the ring */
     switch(whence)
     {
     case SEEK_SET:
-        wh = G_SEEK_SET;
+        ah->seek_offset = offset;
+        ah->seek_type = G_SEEK_SET;
         break;
     case SEEK_CUR:
-        wh = G_SEEK_CUR;
+        ah->seek_offset = ah->position + offset;
+        ah->seek_type = G_SEEK_SET;
         break;
     case SEEK_END:
-        wh = G_SEEK_END;
+        ah->seek_offset = offset;
+        ah->seek_type = G_SEEK_END;
         break;
     default:
         g_assert_not_reached();
         break;
     }
 
-    /* All seek operations are not async */
-    g_clear_error (&ah->error);
-    g_seekable_seek (seekable, (goffset)offset, wh, ah->cancellable, &ah->error);
+    ah->seeking = TRUE;
+    g_cond_broadcast (&ah->cond);
+    while (ah->seeking && !ah->error)
+        vfs_data_wait (ah);
 
-    /* Start async operation */
-    ah->state = VFS_ASYNC_READY;
-    if (!vfs_data_wait_results (ah, TRUE))
-        return -1;
-
-    /* Return results */
-    ah->state = VFS_ASYNC_READY;
-    return offset;
-}
-
-/* Dummy callback for closing a file */
-static void
-vfs_data_close_done (GObject *source, GAsyncResult *res, gpointer callback_data)
-{
-    /*
-     * GPGME doesn't have a way to return errors from close. So we mitigate this
-     * by always flushing data above. This isn't foolproof, but seems like the
-     * best we can do.
-     */
-}
-
-/* Called to cancel the current operation.
- * Puts the async handle into a cancelled state. */
-static void
-vfs_data_cancel (VfsAsyncHandle *ah)
-{
-    switch (ah->state) {
-    case VFS_ASYNC_CANCELLED:
-        break;
-
-    case VFS_ASYNC_PROCESSING:
-        g_cancellable_cancel (ah->cancellable);
-        break;
-
-    case VFS_ASYNC_READY:
-        break;
+    if (ah->seeking || ah->seek_error) {
+        seahorse_util_set_errno (ah->seeking ? ah->error : ah->seek_error);
+        g_clear_error (&ah->seek_error);
+        ah->seeking = FALSE;
+        g_mutex_unlock (&ah->lock);
+        return (off_t)-1;
     }
 
-    if (ah->ostream)
-        g_output_stream_close_async (ah->ostream, G_PRIORITY_DEFAULT, NULL, vfs_data_close_done, ah);
-    else if (ah->istream)
-        g_input_stream_close_async (ah->istream, G_PRIORITY_DEFAULT, NULL, vfs_data_close_done, ah);
-    else
-	return;
-
-    vfs_data_wait_results (ah, FALSE);
+    position = ah->position;
+    g_mutex_unlock (&ah->lock);
 
-    ah->state = VFS_ASYNC_CANCELLED;
+    return position;
 }
 
 /* Called by gpgme to close a file */
@@ -469,25 +467,31 @@ vfs_data_release (void *handle)
 {
     VfsAsyncHandle* ah = (VfsAsyncHandle*)handle;
 
-    vfs_data_cancel (ah);
+    if (vfs_handles)
+        g_hash_table_remove (vfs_handles, ah->gdata);
 
-    if (ah->file)
-        g_object_unref (ah->file);
-    ah->file = NULL;
+    if (ah->thread) {
+        g_mutex_lock (&ah->lock);
+        ah->closing = TRUE;
 
-    if (ah->istream)
-        g_object_unref (ah->istream);
-    ah->istream = NULL;
+        /* A reader could be stuck on a slow file, whereas a writer
+         * still gets out what gpgme gave it */
+        if (!ah->writer)
+            g_cancellable_cancel (ah->cancellable);
 
-    if (ah->ostream)
-        g_object_unref (ah->ostream);
-    ah->ostream = NULL;
+        g_cond_broadcast (&ah->cond);
+        g_mutex_unlock (&ah->lock);
 
-    if (ah->cancellable)
-        g_object_unref (ah->cancellable);
-    ah->cancellable = NULL;
+        g_thread_join (ah->thread);
+    }
 
+    g_object_unref (ah->file);
+    g_object_unref (ah->cancellable);
+    g_mutex_clear (&ah->lock);
+    g_cond_clear (&ah->cond);
     g_clear_error (&ah->error);
+    g_clear_error (&ah->seek_error);
+    g_free (ah->ring);
 
     g_free (ah);
 }
@@ -529,6 +533,12 @@ create_vfs_data (GFile *file, guint mode, SeahorseVfsProgressCb progcb,
         handle->progcb = progcb;
         handle->userdata = userdata;
         handle->gdata = ret;
+
+        if (ret) {
+            if (!vfs_handles)
+                vfs_handles = g_hash_table_new (g_direct_hash, g_direct_equal);
+            g_hash_table_insert (vfs_handles, ret, handle);
+        }
     }
 
     return ret;
@@ -560,3 +570,50 @@ seahorse_vfs_data_create_full (GFile *file, guint mode, SeahorseVfsProgressCb pr
         seahorse_util_gpgme_to_error (gerr, err);
     return data;
 }
+
+void
+seahorse_vfs_data_progress (gpgme_data_t data, goffset pos)
+{
+    VfsAsyncHandle *ah;
+
+    ah = vfs_handles ? g_hash_table_lookup (vfs_handles, data) : NULL;
+    if (ah)
+        vfs_data_progress (ah, pos);
+}
+
+gboolean
+seahorse_vfs_data_close (gpgme_data_t data, GError **err)
+{
+    VfsAsyncHandle *ah;
+    gboolean ret = TRUE;
+
+    g_return_val_if_fail (!err || !*err, FALSE);
+
+    ah = vfs_handles ? g_hash_table_lookup (vfs_handles, data) : NULL;
+
+    /* Not ours, or a delayed writer that nothing was written to */
+    if (!ah || !ah->thread)
+        return TRUE;
+
+    g_mutex_lock (&ah->lock);
+    ah->closing = TRUE;
+    ah->sync = TRUE;
+    if (!ah->writer)
+        g_cancellable_cancel (ah->cancellable);
+    g_cond_broadcast (&ah->cond);
+
+    while (!ah->finished)
+        vfs_data_wait (ah);
+
+    if (ah->writer && ah->error) {
+        g_propagate_error (err, ah->error);
+        ah->error = NULL;
+        ret = FALSE;
+    }
+    g_mutex_unlock (&ah->lock);
+
+    g_thread_join (ah->thread);
+    ah->thread = NULL;
+
+    return ret;
+}
@@ -39,7 +39,7 @@ typedef void (*SeahorseVfsProgressCb) (gpgme_data_t data, goffset pos,
 
 #define SEAHORSE_VFS_READ   0x00000000
 #define SEAHORSE_VFS_WRITE  0x00000001
-#define SEAHORSE_VFS_DELAY  0x00000010
+#define SEAHORSE_VFS_DELAY  0x00000010    /* Opened when first used */
 
 gpgme_data_t        seahorse_vfs_data_create        (const gchar *uri, guint mode,
                                                      GError **err);
@@ -48,4 +48,14 @@ gpgme_data_t        seahorse_vfs_data_create_full   (GFile *file, guint mode,
                                                      SeahorseVfsProgressCb progcb,
                                                      gpointer userdata, GError **err);
 
+/* Writes out what is left, gets it onto the disk and closes the file,
+ * returning any error on the way. Writes are buffered, and gpgme has no
+ * way of reporting errors from closing, so call this before releasing
+ * the data of a successful operation. */
+gboolean            seahorse_vfs_data_close         (gpgme_data_t data, GError **err);
+
+/* Reports progress on @data as if gpgme had got to @pos, for when the
+ * file is read some other way. */
+void                seahorse_vfs_data_progress      (gpgme_data_t data, goffset pos);
+
 #endif /* __SEAHORSE_VFS_DATA__ */
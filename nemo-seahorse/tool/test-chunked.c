@@ -0,0 +1,295 @@
+/*
+ * Seahorse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "seahorse-chunked.h"
+#include "seahorse-tool.h"
+#include "seahorse-vfs-data.h"
+
+/*
+ * Round trips files through the chunked container. gpg isn't run: the
+ * chunk key is stored as it is, where gpg would have encrypted it.
+ */
+
+/* As in seahorse-chunked.c */
+#define CHUNK_SIZE          (4 * 1024 * 1024)
+#define HEADER_SIZE         32
+#define TAG_SIZE            16
+
+/* The progress window isn't there, so nothing is ever cancelled */
+gboolean
+seahorse_tool_progress_check (void)
+{
+    return TRUE;
+}
+
+void
+seahorse_vfs_data_progress (gpgme_data_t data, goffset pos)
+{
+}
+
+typedef struct {
+    gchar *dir;
+    GFile *plain;
+    GFile *crypt;
+    GFile *out;
+} Fixture;
+
+static GFile*
+file_in (const gchar *dir, const gchar *name)
+{
+    gchar *path = g_build_filename (dir, name, NULL);
+    GFile *file = g_file_new_for_path (path);
+
+    g_free (path);
+    return file;
+}
+
+static void
+setup (Fixture *fix, gconstpointer unused)
+{
+    fix->dir = g_dir_make_tmp ("test-chunked-XXXXXX", NULL);
+    g_assert (fix->dir != NULL);
+
+    fix->plain = file_in (fix->dir, "plain");
+    fix->crypt = file_in (fix->dir, "plain.pgpc");
+    fix->out = file_in (fix->dir, "out");
+}
+
+static void
+teardown (Fixture *fix, gconstpointer unused)
+{
+    g_file_delete (fix->plain, NULL, NULL);
+    g_file_delete (fix->crypt, NULL, NULL);
+    g_file_delete (fix->out, NULL, NULL);
+    g_rmdir (fix->dir);
+
+    g_object_unref (fix->plain);
+    g_object_unref (fix->crypt);
+    g_object_unref (fix->out);
+    g_free (fix->dir);
+}
+
+/* Not all the same, so chunks swapped around would show */
+static GBytes*
+write_plain (Fixture *fix, gsize length)
+{
+    GError *err = NULL;
+    guchar *data;
+    gsize i;
+
+    data = g_malloc (length);
+    for (i = 0; i < length; i++)
+        data[i] = (i * 7 + i / CHUNK_SIZE) & 0xff;
+
+    g_file_replace_contents (fix->plain, (const gchar*)data, length, NULL, FALSE,
+                             G_FILE_CREATE_NONE, NULL, NULL, &err);
+    g_assert_no_error (err);
+
+    return g_bytes_new_take (data, length);
+}
+
+static void
+encrypt (Fixture *fix)
+{
+    SeahorseChunked *chunked;
+    GError *err = NULL;
+    const guchar *key;
+    gsize n_key;
+
+    chunked = seahorse_chunked_encrypt_new (fix->plain, fix->crypt, &err);
+    g_assert_no_error (err);
+
+    key = seahorse_chunked_get_key (chunked, &n_key);
+    seahorse_chunked_finish_encrypt (chunked, (const gchar*)key, n_key, NULL, &err);
+    g_assert_no_error (err);
+
+    seahorse_chunked_free (chunked);
+}
+
+static gboolean
+decrypt (Fixture *fix, GError **err)
+{
+    SeahorseChunked *chunked;
+    const gchar *key;
+    gboolean ret;
+    gsize n_key;
+
+    chunked = seahorse_chunked_decrypt_new (fix->crypt, fix->out, err);
+    if (!chunked)
+        return FALSE;
+
+    key = seahorse_chunked_get_wrapped_key (chunked, &n_key);
+    ret = seahorse_chunked_finish_decrypt (chunked, key, n_key, NULL, err);
+
+    seahorse_chunked_free (chunked);
+    return ret;
+}
+
+static GBytes*
+read_out (Fixture *fix)
+{
+    GError *err = NULL;
+    gchar *contents;
+    gsize length;
+
+    g_file_load_contents (fix->out, NULL, &contents, &length, NULL, &err);
+    g_assert_no_error (err);
+
+    return g_bytes_new_take (contents, length);
+}
+
+static void
+round_trip (Fixture *fix, gsize length)
+{
+    GBytes *plain, *out;
+    GError *err = NULL;
+
+    plain = write_plain (fix, length);
+    encrypt (fix);
+
+    decrypt (fix, &err);
+    g_assert_no_error (err);
+
+    out = read_out (fix);
+    g_assert (g_bytes_equal (plain, out));
+
+    g_bytes_unref (plain);
+    g_bytes_unref (out);
+}
+
+static void
+test_empty (Fixture *fix, gconstpointer unused)
+{
+    round_trip (fix, 0);
+}
+
+static void
+test_small (Fixture *fix, gconstpointer unused)
+{
+    round_trip (fix, 1);
+}
+
+static void
+test_one_chunk (Fixture *fix, gconstpointer unused)
+{
+    round_trip (fix, CHUNK_SIZE);
+}
+
+static void
+test_boundaries (Fixture *fix, gconstpointer unused)
+{
+    round_trip (fix, CHUNK_SIZE - 1);
+    round_trip (fix, CHUNK_SIZE + 1);
+    round_trip (fix, 3 * CHUNK_SIZE);
+    round_trip (fix, 3 * CHUNK_SIZE + 12345);
+}
+
+/* The damaged chunk fails and is left empty, the others still come out */
+static void
+test_tampered (Fixture *fix, gconstpointer unused)
+{
+    GBytes *plain, *out;
+    GFileIOStream *stream;
+    GError *err = NULL;
+    const guchar *p, *o;
+    guchar byte;
+    goffset offset;
+    gsize i;
+
+    plain = write_plain (fix, 3 * CHUNK_SIZE);
+    encrypt (fix);
+
+    /* A byte in the middle of the second chunk */
+    offset = HEADER_SIZE + (CHUNK_SIZE + TAG_SIZE) + CHUNK_SIZE / 2;
+    stream = g_file_open_readwrite (fix->crypt, NULL, &err);
+    g_assert_no_error (err);
+    g_seekable_seek (G_SEEKABLE (stream), offset, G_SEEK_SET, NULL, &err);
+    g_assert_no_error (err);
+    g_input_stream_read_all (g_io_stream_get_input_stream (G_IO_STREAM (stream)),
+                             &byte, 1, NULL, NULL, &err);
+    g_assert_no_error (err);
+    byte ^= 0x01;
+    g_seekable_seek (G_SEEKABLE (stream), offset, G_SEEK_SET, NULL, &err);
+    g_assert_no_error (err);
+    g_output_stream_write_all (g_io_stream_get_output_stream (G_IO_STREAM (stream)),
+                               &byte, 1, NULL, NULL, &err);
+    g_assert_no_error (err);
+    g_io_stream_close (G_IO_STREAM (stream), NULL, &err);
+    g_assert_no_error (err);
+    g_object_unref (stream);
+
+    g_assert (!decrypt (fix, &err));
+    g_assert_error (err, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+    g_clear_error (&err);
+
+    out = read_out (fix);
+    g_assert_cmpuint (g_bytes_get_size (out), ==, g_bytes_get_size (plain));
+
+    p = g_bytes_get_data (plain, NULL);
+    o = g_bytes_get_data (out, NULL);
+    g_assert (memcmp (p, o, CHUNK_SIZE) == 0);
+    for (i = CHUNK_SIZE; i < 2 * CHUNK_SIZE; i++)
+        g_assert_cmpuint (o[i], ==, 0);
+    g_assert (memcmp (p + 2 * CHUNK_SIZE, o + 2 * CHUNK_SIZE, CHUNK_SIZE) == 0);
+
+    g_bytes_unref (plain);
+    g_bytes_unref (out);
+}
+
+/* Cut short, the container doesn't open at all */
+static void
+test_truncated (Fixture *fix, gconstpointer unused)
+{
+    GBytes *plain;
+    GError *err = NULL;
+    gchar *path;
+
+    plain = write_plain (fix, 2 * CHUNK_SIZE);
+    encrypt (fix);
+
+    path = g_file_get_path (fix->crypt);
+    g_assert_cmpint (truncate (path, HEADER_SIZE + CHUNK_SIZE), ==, 0);
+    g_free (path);
+
+    g_assert (!decrypt (fix, &err));
+    g_assert_error (err, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+    g_clear_error (&err);
+
+    g_bytes_unref (plain);
+}
+
+int
+main (int argc, char **argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add ("/chunked/empty", Fixture, NULL, setup, test_empty, teardown);
+    g_test_add ("/chunked/small", Fixture, NULL, setup, test_small, teardown);
+    g_test_add ("/chunked/one-chunk", Fixture, NULL, setup, test_one_chunk, teardown);
+    g_test_add ("/chunked/boundaries", Fixture, NULL, setup, test_boundaries, teardown);
+    g_test_add ("/chunked/tampered", Fixture, NULL, setup, test_tampered, teardown);
+    g_test_add ("/chunked/truncated", Fixture, NULL, setup, test_truncated, teardown);
+
+    return g_test_run ();
+}
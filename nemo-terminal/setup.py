@@ -27,7 +27,7 @@ setup( packages=[],
     #                     'gir1.2-xapp-1.0 (>= 3.8.0)'],
 
     data_files = [
-        ('/usr/share/nemo-python/extensions', ['src/nemo_terminal.py']),
+        ('/usr/share/nemo-python/extensions', ['src/nemo_terminal.py', 'src/nemo_terminal.nemo-python']),
         ('/usr/bin',                          ['src/nemo-terminal-prefs']),
         ('/usr/share/nemo-terminal',          ['src/nemo-terminal-prefs.py',
                                                'pixmap/logo_120x120.png']),